@@ -20,6 +20,9 @@ struct Database
   char*  name;
   int    numTables;
   struct TableMeta* tables;  // pointer to ARRAY of table meta-data
+  struct NameMap*   tableMap;  // case-insensitive name => table (schemamap.h)
+  struct Snapshot*  snapshot;  // non-NULL => schema mapped from a snapshot
+                               // (snapshot.h)
 };
 
 struct TableMeta
@@ -28,6 +31,8 @@ struct TableMeta
   int    recordSize;
   int    numColumns;
   struct ColumnMeta* columns;  // pointer to ARRAY of column meta-data
+  struct NameMap*    columnMap;  // case-insensitive name => column (schemamap.h)
+  struct TableStats* stats;      // NULL => not analyzed (stats.h)
 };
 
 struct ColumnMeta
@@ -96,19 +101,34 @@ void database_close(struct Database* db);
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <unistd.h>
 //
 // #include any other system <.h> files?
 //
 
 #include "analyzer.h"
 #include "ast.h"
+#include "batch.h"
+#include "colresult.h"
 #include "database.h"
+#include "dictionary.h"
+#include "encode.h"
 #include "execute.h"
+#include "insert.h"
+#include "matview.h"
+#include "modify.h"
 #include "parser.h"
+#include "predicate.h"
+#include "profile.h"
 #include "resultset.h"
+#include "sample.h"
+#include "scan.h"
 #include "scanner.h"
+#include "schemamap.h"
+#include "tablefile.h"
 #include "tokenqueue.h"
 #include "util.h"
+#include "wal.h"
 //
 
 //
@@ -117,307 +137,445 @@ void database_close(struct Database* db);
 // implementation of function(s), both private and public
 //
 
-void execute_query(struct Database *db, struct QUERY *query) {
-  // checks if database exist
-  if (db == NULL) {
-    panic("database is NULL");
-  }
-  // checks if query exists
-  if (query == NULL) {
-    panic("query is NULL");
+//
+// intoTable
+//
+// Returns the target table of SELECT ... INTO. If the database has
+// no such table, it is created empty with N columns named names[j]
+// of type types[j] and registered in the schema; an existing table
+// must have exactly these column types. Returns NULL (after printing
+// an error) if the table cannot be used.
+//
+// NOTE: creating the table may move db->tables, see database_addTable().
+//
+static struct TableMeta *intoTable(struct Database *db, char *name,
+                                   char *names[], int types[], int N,
+                                   int recordSize) {
+  struct TableMeta *target = database_findTable(db, name);
+
+  if (target != NULL) {
+    bool matches = (target->numColumns == N);
+    for (int j = 0; matches && j < N; j++) {
+      matches = (target->columns[j].colType == types[j]);
+    }
+    if (!matches) {
+      printf("**Error: the columns of table '%s' do not match the query\n",
+             target->name);
+      return NULL;
+    }
+    return target;
   }
 
-  if (query->queryType != SELECT_QUERY) {
-    printf("**Error: Cannot execute this query\n");
-    return;
+  for (int j = 0; j < N; j++) {
+    for (int k = 0; k < j; k++) {
+      if (strcasecmp(names[j], names[k]) == 0) {
+        printf("**Error: column '%s' appears more than once in INTO table "
+               "'%s'\n",
+               names[j], name);
+        return NULL;
+      }
+    }
   }
-  struct SELECT *select = query->q.select;
 
-  struct TableMeta *table = NULL;
-  // compare the name of the current table in the array with the stored string
-  // in select-> table
-  for (int i = 0; i < db->numTables; i++) {
-    if (icmpStrings(db->tables[i].name, select->table) == 0) {
-      table = &db->tables[i];
-      break;
+  struct ColumnMeta *columns =
+      (struct ColumnMeta *)malloc(sizeof(struct ColumnMeta) * N);
+  char *tableName = strdup(name);
+  if (columns == NULL || tableName == NULL) {
+    panic("No memory");
+  }
+  for (int j = 0; j < N; j++) {
+    columns[j].name = strdup(names[j]);
+    if (columns[j].name == NULL) {
+      panic("No memory");
     }
+    columns[j].colType = types[j];
+    columns[j].indexType = COL_NON_INDEXED;
   }
-  assert(table != NULL);
-  // creates a path to a file by combining the name of the database, a '/'
-  // separator, the name of the table, and the ".data" extension. This path can
-  // be used to access a file associated with the table in the database.
-  char datapath[(2 * DATABASE_MAX_ID_LENGTH) + 10];
-  strcpy(datapath, db->name);
-  strcat(datapath, "/");
-  strcat(datapath, table->name);
-  strcat(datapath, ".data");
-
-  FILE *file = fopen(datapath, "r");
 
+  // the background compactor and checkpoint hold pointers into
+  // db->tables, which adding the table may move
+  modify_waitForCompaction();
+  wal_waitForCheckpoint();
+  target = database_addTable(db, tableName, recordSize, N, columns);
+
+  // start from an empty data file, whatever a previous table of the
+  // same name may have left behind:
+  char path[TABLEFILE_MAX_PATH];
+  tablefile_path(db, target, ".data", path);
+  FILE *file = fopen(path, "w");
   if (file == NULL) {
-    printf("**Error: file '%s'is not found.", datapath);
-    panic("stop execution");
-  }
-  struct ResultSet *result = resultset_create();
-  // adding all the columns of the table to the result set with their respective
-  // name, position, table name, and data type.
-  for (int j = 0; j < table->numColumns; j++) {
-    int columnNum = resultset_insertColumn(result, j + 1, table->name,
-                                           table->columns[j].name, NO_FUNCTION,
-                                           table->columns[j].colType);
-  }
-  // allocating memory dynamically to hold the contents of a table record. The
-  // buffer is being allocated memory with the size of the record plus a few
-  // bytes to hold additional data.
-  int bufferSize = table->recordSize + 3;
-  char *buffer = (char *)malloc(sizeof(char) * bufferSize);
-  if (buffer == NULL) {
-    panic("No memory");
+    printf("**Error: unable to create file '%s'\n", path);
+    return NULL;
   }
-  // infinite loop starts here
-  while (1) {
-    fgets(buffer, bufferSize, file);
-    if (feof(file)) {
-      break;
-    }
+  fclose(file);
+  tablefile_path(db, target, ".dead", path);
+  unlink(path);
 
-    bool k1 = false;
-    bool k2 = false;
+  return target;
+}
 
-    char *cp = buffer;
+//
+// emitInsert
+//
+// Scan callback for streamInto(): appends one projected row to the
+// target table.
+//
+static bool emitInsert(void *state, char *values[]) {
+  return insert_row((struct InsertBatch *)state, values);
+}
 
-    for(int j = 0; j < bufferSize; j++){
-      if(!k1 && !k2){
-        if(*cp == ' '){
-          *(cp) = '\0';
-        }
-        else if(buffer[j]=='\''){
-          k1 = true;
-        }
-        else if(buffer[j] == '"'){
-          k2 = true;
-        }
-        }
-        else if(k1){
-          if(*cp == '\''){
-            k1 = false;
-          }
-          }
-          else{
-            if(*cp == '"')
-            {
-              k2 = false;
-            }
-            }
-          cp++;
+//
+// streamInto
+//
+// Executes SELECT ... INTO for a query without aggregates: every
+// record that satisfies the WHERE clause is projected and appended
+// to the target table as soon as it is read, up to the LIMIT.
+//
+static void streamInto(struct Database *db, struct SELECT *select,
+                       struct Profile *prof) {
+  struct TableMeta *table = database_findTable(db, select->table);
+  assert(table != NULL);
 
-        }
-    
-    int columnNumber = 1;
-    cp = buffer;
-    struct RSColumn *current = result->columns;
-    int rowNumber = resultset_addRow(result);
-
-    while(current != NULL){
-      if(current->coltype == COL_TYPE_INT){
-        resultset_putInt(result, rowNumber, columnNumber, atoi(cp));
-        cp = cp + strlen(cp) + 1; // check this out
-      }
-      else if(current->coltype == COL_TYPE_REAL){
-        resultset_putReal(result, rowNumber, columnNumber, atof(cp));
-        cp = cp + strlen(cp) + 1;
-      }
-      else if(current->coltype == COL_TYPE_STRING){
-        char *end = cp + strlen(cp) - 1;
-        *end ='\0';
-        cp++;
-        resultset_putString(result, rowNumber, columnNumber, cp);
-        cp = cp + strlen(cp) + 2;
-      }
-      columnNumber++;
-      current = current->next;
-    }
+  if (strcasecmp(table->name, select->into->table) == 0) {
+    printf("**Error: cannot SELECT from table '%s' INTO itself\n",
+           table->name);
+    return;
   }
 
-  free(buffer);
-
-  struct WHERE *where = select->where;
-  if (where != NULL) {
-    int columnNumber = resultset_findColumn(
-        result, 1, where->expr->column->table, where->expr->column->name);
-    char *value = where->expr->value;
-
-    struct EXPR *express = where->expr;
+  int N = 0;
+  for (struct COLUMN *c = select->columns; c != NULL; c = c->next) {
+    N++;
+  }
 
-    int oper = express->operator;
+  char **names = (char **)malloc(sizeof(char *) * (N + 1));
+  int *types = (int *)malloc(sizeof(int) * (N + 1));
+  if (names == NULL || types == NULL) {
+    panic("No memory");
+  }
 
-    char *columnName = express->column->name;
+  int j = 0;
+  for (struct COLUMN *c = select->columns; c != NULL; c = c->next, j++) {
+    struct ColumnMeta *column = database_findColumn(table, c->name);
+    assert(column != NULL);
+    names[j] = column->name;
+    types[j] = column->colType;
+  }
 
-    int columnType = table->columns[columnNumber - 1].colType;
+  // the projected fields of a record always fit in the source
+  // table's record size:
+  struct TableMeta *target = intoTable(db, select->into->table, names, types,
+                                       N, table->recordSize);
 
-    for (int i = result->numRows; i > 0; i--) {
-      if (columnType == 1) {
-        int int_test = resultset_getInt(result, i, columnNumber);
-        if (oper == 0) {
-          if (int_test < atoi(value)) {
+  struct InsertBatch *batch = (target != NULL) ? insert_begin(db, target) : NULL;
+  if (batch != NULL) {
+    profile_enter(prof, "scan into");
+    long numRows = scan_select(db, select, emitInsert, batch);
+    bool ok = insert_end(batch);
+    profile_leave(prof, -1, numRows);
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 1) {
-          if (int_test <= atoi(value)) {
+    if (ok && numRows >= 0) {
+      printf("%ld rows written to table '%s'\n", numRows, target->name);
+    }
+  }
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 2) {
-          if (int_test > atoi(value)) {
+  free(types);
+  free(names);
+}
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 3) {
-          if (int_test >= atoi(value)) {
+//
+// intoRecordSize
+//
+// Record size of a table created by writeInto(): wide enough for
+// every row of the result as writeInto() formats it, with room for
+// any int, so that later rows of the same shape fit as well.
+//
+static int intoRecordSize(struct ResultSet *result, int types[]) {
+  int size = result->numCols;  // the spaces between values, and '\n'
+
+  for (int j = 0; j < result->numCols; j++) {
+    int width;
+    if (types[j] == COL_TYPE_INT) {
+      width = 11;  // "-2147483648"
+    } else if (types[j] == COL_TYPE_REAL) {
+      width = 8;  // "0.000000"
+      for (int row = 1; row <= result->numRows; row++) {
+        int n = snprintf(NULL, 0, "%f", resultset_getReal(result, row, j + 1));
+        width = (n > width) ? n : width;
+      }
+    } else {
+      width = 2;  // the quotes
+      for (int row = 1; row <= result->numRows; row++) {
+        char *value = resultset_getString(result, row, j + 1);
+        int n = (int)strlen(value) + 2;
+        width = (n > width) ? n : width;
+        free(value);
+      }
+    }
+    size += width;
+  }
+  return size;
+}
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 4) {
-          if (int_test == atoi(value)) {
+//
+// writeInto
+//
+// Executes the INTO part of a query whose rows had to be computed
+// in full first (i.e. with aggregates): appends the rows of the
+// result set to the target table. Aggregated columns are named
+// after their function, e.g. "max_rating".
+//
+static void writeInto(struct Database *db, struct SELECT *select,
+                      struct ResultSet *result) {
+  int N = result->numCols;
+
+  char(*names)[DATABASE_MAX_ID_LENGTH + 1] =
+      malloc(sizeof(*names) * (N + 1));
+  char **namePtrs = (char **)malloc(sizeof(char *) * (N + 1));
+  int *types = (int *)malloc(sizeof(int) * (N + 1));
+  char **values = (char **)malloc(sizeof(char *) * (N + 1));
+  // "%f" of a real is at most 309 digits, the sign, point and decimals
+  char(*numbers)[320] = malloc(sizeof(*numbers) * (N + 1));
+  if (names == NULL || namePtrs == NULL || types == NULL || values == NULL ||
+      numbers == NULL) {
+    panic("No memory");
+  }
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 5) {
-          if (int_test != atoi(value)) {
+  int j = 0;
+  for (struct RSColumn *c = result->columns; c != NULL; c = c->next, j++) {
+    char *function = "";
+    switch (c->function) {
+      case MIN_FUNCTION:
+        function = "min_";
+        break;
+      case MAX_FUNCTION:
+        function = "max_";
+        break;
+      case SUM_FUNCTION:
+        function = "sum_";
+        break;
+      case AVG_FUNCTION:
+        function = "avg_";
+        break;
+      case COUNT_FUNCTION:
+        function = "count_";
+        break;
+    }
+    snprintf(names[j], sizeof(names[j]), "%s%s", function, c->colName);
+    namePtrs[j] = names[j];
+    types[j] = c->coltype;
+  }
 
+  if (strcasecmp(select->table, select->into->table) == 0) {
+    printf("**Error: cannot SELECT from table '%s' INTO itself\n",
+           select->table);
+  } else {
+    int recordSize = intoRecordSize(result, types);
+    struct TableMeta *target = intoTable(db, select->into->table, namePtrs,
+                                         types, N, recordSize);
+    struct InsertBatch *batch =
+        (target != NULL) ? insert_begin(db, target) : NULL;
+
+    if (batch != NULL) {
+      bool ok = true;
+      int row;
+      for (row = 1; ok && row <= result->numRows; row++) {
+        for (j = 0; j < N; j++) {
+          if (types[j] == COL_TYPE_INT) {
+            snprintf(numbers[j], sizeof(numbers[j]), "%d",
+                     resultset_getInt(result, row, j + 1));
+            values[j] = numbers[j];
+          } else if (types[j] == COL_TYPE_REAL) {
+            snprintf(numbers[j], sizeof(numbers[j]), "%f",
+                     resultset_getReal(result, row, j + 1));
+            values[j] = numbers[j];
           } else {
-            resultset_deleteRow(result, i);
+            values[j] = resultset_getString(result, row, j + 1);
           }
-        } else {
-          resultset_deleteRow(result, i);
         }
-      } else if (columnType == 2) {
-        int double_test = resultset_getReal(result, i, columnNumber);
-        if (oper == 0) {
-          if (double_test < atof(value)) {
-
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 1) {
-          if (double_test <= atof(value)) {
-
-          } else {
-            resultset_deleteRow(result, i);
+        ok = insert_row(batch, values);
+        for (j = 0; j < N; j++) {
+          if (types[j] == COL_TYPE_STRING) {
+            free(values[j]);
           }
-        } else if (oper == 2) {
-          if (double_test > atof(value)) {
+        }
+      }
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 3) {
-          if (double_test >= atof(value)) {
+      ok = insert_end(batch) && ok;
+      if (ok) {
+        printf("%d rows written to table '%s'\n", result->numRows,
+               target->name);
+      }
+    }
+  }
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 4) {
-          if (double_test == atof(value)) {
+  free(numbers);
+  free(values);
+  free(types);
+  free(namePtrs);
+  free(names);
+}
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 5) {
-          if (double_test != atof(value)) {
+void execute_query(struct Database *db, struct QUERY *query) {
+  // checks if database exist
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+  // checks if query exists
+  if (query == NULL) {
+    panic("query is NULL");
+  }
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else {
-          resultset_deleteRow(result, i);
-        }
-      } else if (columnType == 3) {
-        char *string_test = resultset_getString(result, i, columnNumber);
-        if (oper == 0) {
-          if (strcmp(string_test, value) < 0) {
+  if (query->queryType != SELECT_QUERY) {
+    printf("**Error: Cannot execute this query\n");
+    return;
+  }
+  struct SELECT *select = query->q.select;
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 1) {
-          if ((strcmp(string_test, value) < 0) ||
-              (strcmp(string_test, value) == 0)) {
+  // with SIMPLESQL_SAMPLE set, aggregates are estimated from a random
+  // sample of the records instead of computed over all of them
+  if (sample_enabled() && select->into == NULL && !scan_isStreamable(select)) {
+    sample_execute(db, select);
+    return;
+  }
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 2) {
-          if (strcmp(string_test, value) > 0) {
+  // with SIMPLESQL_MATVIEW set, aggregates are answered from a view
+  // kept up to date with the records appended since it was last used
+  if (matview_enabled() && select->into == NULL &&
+      !scan_isStreamable(select) && matview_execute(db, select, NULL)) {
+    return;
+  }
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 3) {
-          if ((strcmp(string_test, value) > 0) ||
-              (strcmp(string_test, value) == 0)) {
+  // NULL unless SIMPLESQL_PROFILE is set, in which case each phase
+  // is timed and the profile is printed after the result
+  struct Profile *prof = profile_create(select->table);
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 4) {
-          if (strcmp(string_test, value) == 0) {
+  // SELECT ... INTO without aggregates never needs the whole result,
+  // so the rows are streamed into the target table as they are read
+  if (select->into != NULL && scan_isStreamable(select)) {
+    streamInto(db, select, prof);
+    profile_print(prof);
+    profile_destroy(prof);
+    return;
+  }
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        } else if (oper == 5) {
-          if (strcmp(string_test, value) != 0) {
+  // resolve the table through the schema map, no need to loop over
+  // db->tables comparing names
+  struct TableMeta *table = database_findTable(db, select->table);
+  assert(table != NULL);
 
-          } else {
-            resultset_deleteRow(result, i);
-          }
-        }
-        free(string_test);
-      }
-    }
+  // the rows are loaded into a columnar result: one typed vector per
+  // column and the strings in one arena, so loading and filtering do
+  // not allocate per row; string columns with few distinct values
+  // are loaded as codes into their dictionary; stale dictionaries
+  // are rebuilt together, in one scan of the table
+  struct Dictionary **dicts = (struct Dictionary **)malloc(
+      sizeof(struct Dictionary *) * (table->numColumns + 1));
+  if (dicts == NULL) {
+    panic("No memory");
   }
+  dictionary_openAll(db, table, dicts);
 
-  // checking if all the columns of the table are present in the select
-  // statement's columns. If any column is not present, it is removed from the
-  // result set. The result set will only contain the columns that are present
-  // in the select statement.
+  struct ColumnarResult *columns = colresult_create();
   for (int j = 0; j < table->numColumns; j++) {
-    bool nan = false;
-    struct ColumnMeta *columnMeta = table->columns;
-    struct COLUMN *everyColumn = select->columns;
-    struct COLUMN *iterate = everyColumn;
-
-    while (iterate != NULL) {
-      if (icmpStrings(iterate->name, columnMeta[j].name) == 0) {
-        nan = true;
-        break;
-      }
-      iterate = iterate->next;
-    }
-
-    if (nan == false) {
-      int Q = resultset_findColumn(result, 1, table->name, columnMeta[j].name);
-      resultset_deleteColumn(result, Q);
+    colresult_addColumn(columns, table->name, table->columns[j].name,
+                        table->columns[j].colType);
+    if (dicts[j] != NULL) {
+      colresult_setDictionary(columns, j, dicts[j]);
     }
   }
+  free(dicts);
 
-  int position = 1;
+  struct WHERE *where = select->where;
 
+  // the scan picks an index range or the zone map when the WHERE
+  // clause allows it, and otherwise reads every record in order
+  struct Scan scan;
+  memset(&scan, 0, sizeof(scan));
+  scan.table = table;
+  scan.result = columns;
+  scan.limit = -1;
+  scan.inOrder = (select->limit != NULL || select->into != NULL);
+  profile_enter(prof, "scan");
+  scan_table(db, where, &scan);
+  profile_detail(prof, scan_pathName(scan.path));
+  profile_addRead(prof, scan.io.bytesRead, scan.io.stallSeconds);
+  profile_leave(prof, scan.numRecords, columns->numRows);
+
+  // the WHERE expression is compiled once into a predicate, which
+  // clears the bits of the rows that do not qualify from the selection
+  // bitmap, 64 rows at a time for numeric comparisons; no row moves
+  if (where != NULL) {
+    profile_enter(prof, "filter");
+    struct Predicate *pred = predicate_compile(table, where->expr);
+    predicate_filter(pred, columns);
+    predicate_destroy(pred);
+    profile_leave(prof, columns->numRows, colresult_numLive(columns));
+  }
+
+  // the select statement's columns, by position in the table, in the
+  // order they are selected
+  int numSelected = 0;
   struct COLUMN *iterate = select->columns;
+  while (iterate != NULL) {
+    numSelected++;
+    iterate = iterate->next;
+  }
+
+  int *selected = (int *)malloc(sizeof(int) * (numSelected + 1));
+  if (selected == NULL) {
+    panic("No memory");
+  }
 
+  int position = 0;
+  bool aggregate = false;
+  iterate = select->columns;
   while (iterate != NULL) {
-    int Q = resultset_findColumn(result, 1, iterate->table, iterate->name);
-    resultset_moveColumn(result, Q, position);
+    struct ColumnMeta *columnMeta = database_findColumn(table, iterate->name);
+    assert(columnMeta != NULL);
+    selected[position++] = (int)(columnMeta - table->columns);
+    aggregate = aggregate || (iterate->function != NO_FUNCTION);
     iterate = iterate->next;
-    position++;
   }
+
+  // without aggregates the LIMIT applies to the rows themselves, so
+  // only those are copied out
+  struct LIMIT *limit = select->limit;
+  if (limit != NULL && !aggregate) {
+    profile_enter(prof, "limit");
+    long numLive = colresult_numLive(columns);
+    colresult_limit(columns, limit->N);
+    profile_leave(prof, numLive, colresult_numLive(columns));
+  }
+
+  // in a binary or CSV format, the rows are written straight from the
+  // column vectors, with no result set in between
+  if (!aggregate && select->into == NULL && encode_format() != ENCODE_TEXT) {
+    profile_enter(prof, "print");
+    long numLive = colresult_numLive(columns);
+    encode_columns(columns, selected, numSelected);
+    batch_countRows(numLive);
+    profile_leave(prof, numLive, -1);
+    free(selected);
+    colresult_destroy(columns);
+
+    profile_print(prof);
+    profile_destroy(prof);
+    return;
+  }
+
+  // the live rows of the selected columns are copied, once, into the
+  // result set that is printed
+  profile_enter(prof, "project");
+  struct ResultSet *result =
+      colresult_toResultSet(columns, selected, numSelected);
+  free(selected);
+  colresult_destroy(columns);
+  profile_leave(prof, result->numRows, result->numRows);
+
+  if (aggregate) {
+    profile_enter(prof, "aggregate");
+  }
+  long numRows = result->numRows;
   position = 1;
   iterate = select->columns;
   while (iterate != NULL) {
@@ -427,18 +585,32 @@ void execute_query(struct Database *db, struct QUERY *query) {
     iterate = iterate->next;
     position++;
   }
-  // checking if a limit has been specified in the select statement and if so,
-  // it is applying the limit to the result set.
-  struct LIMIT *limit = select->limit;
-  if (limit != NULL) {
+  // with aggregates the LIMIT applies to the aggregated rows
+  if (limit != NULL && aggregate) {
     for (int i = result->numRows; i > 0; i--) {
       if (i > limit->N) {
         resultset_deleteRow(result, i);
       }
     }
   }
-  // calling result_set_print() and resultset_destroy() and closing file
-  resultset_print(result);
+  if (aggregate) {
+    profile_leave(prof, numRows, result->numRows);
+  }
+
+  // calling result_set_print() and resultset_destroy(), unless the rows
+  // go INTO a table
+  if (select->into != NULL) {
+    profile_enter(prof, "into");
+    writeInto(db, select, result);
+  } else {
+    profile_enter(prof, "print");
+    encode_resultSet(result);
+    batch_countRows(result->numRows);
+  }
+  profile_leave(prof, result->numRows, -1);
   resultset_destroy(result);
-  fclose(file);
+
+  profile_print(prof);
+  profile_destroy(prof);
 }
+
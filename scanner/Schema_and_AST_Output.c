@@ -18,10 +18,19 @@
 
 #include "analyzer.h"
 #include "ast.h"
+#include "batch.h"
 #include "database.h"
+#include "execute.h"
+#include "explain.h"
+#include "modify.h"
 #include "parser.h"
 #include "scanner.h"
+#include "schemamap.h"
+#include "server.h"
+#include "snapshot.h"
+#include "stats.h"
 #include "util.h"
+#include "wal.h"
 
 static char *var_col[] = {"int", "real", "string"};
 
@@ -168,33 +177,72 @@ char *print_ast(struct QUERY *query) {
   return select->table;
 }
 
-void execute_query(FILE *input, int rSize) {
-  int acc = 0;
-  int Size = rSize + 3;
-  char *buff = (char *)malloc(sizeof(char) * Size);
-  if (buff == NULL)
-    panic("Memory Out\n");
-  while (!feof(input) && acc < 5) {
-    fgets(buff, Size, input);
-    printf("%s", buff);
-    acc += 1;
-  }
+// cleanup function
+// It waits for the background compaction and write-ahead log checkpoint to
+// finish, then frees the statistics, the name maps and the database.
+static void cleanup(struct Database *db) {
+  modify_waitForCompaction();
+  wal_waitForCheckpoint();
+  stats_unload(db);
+  schemamap_destroy(db);
+  snapshot_close(db);
 }
 
 // int main()
 int main() {
   char dbs[DATABASE_MAX_ID_LENGTH + 1];
-  printf("database? ");
+
+  // batch mode: no prompts or dumps, and the output goes through one
+  // large buffer, which must be set up before anything is printed
+  char *script = batch_scriptPath();
+  if (script != NULL) {
+    batch_bufferOutput();
+  } else {
+    printf("database? ");
+  }
   scanf("%s", dbs);
 
-  struct Database *db = database_open(dbs);
+  // the schema is mapped from its binary snapshot when that is
+  // current, and parsed from the meta file otherwise
+  struct Database *db = snapshot_open(dbs);
 
   if (db == NULL) {
     printf("**Error: unable to open database '%s'\n", dbs);
     exit(-1);
   }
 
-  print_schema(db);
+  schemamap_build(db);
+
+  // bring the tables up to date with the statements committed to
+  // the write-ahead log before the program last stopped
+  if (wal_recover(db) < 0) {
+    exit(-1);
+  }
+
+  stats_load(db);
+  if (stats_analyzeEnabled()) {
+    for (int i = 0; i < db->numTables; i++) {
+      stats_analyze(db, &db->tables[i]);
+    }
+  }
+
+  if (script == NULL) {
+    print_schema(db);
+  }
+
+  // server mode: queries come from clients instead of stdin
+  char *socketPath = server_socketPath();
+  if (socketPath != NULL) {
+    bool ok = server_run(db, socketPath);
+    cleanup(db);
+    return ok ? 0 : -1;
+  }
+
+  if (script != NULL) {
+    bool ok = batch_run(db, script);
+    cleanup(db);
+    return ok ? 0 : -1;
+  }
 
   parser_init();
   while (1) {
@@ -209,34 +257,15 @@ int main() {
     }
     struct QUERY *query = analyzer_build(db, tokens);
     if (query != NULL) {
-      char *astTable = print_ast(query);
-
-      char fname[DATABASE_MAX_ID_LENGTH + 1];
-      strcpy(fname, db->name);
-      strcat(fname, "/");
-
-      struct TableMeta *tables = db->tables;
-      int j = -1;
-      for (int i = 0; i < db->numTables; i++) {
-        if (strcasecmp(tables[i].name, astTable) == 0) {
-          j = i;
-          break;
-        }
-      }
-      if (j == -1) {
-        printf("**Error:wrong mismatch with table names\n");
-        exit(-1);
-      }
-      strcat(fname, tables[j].name);
-      strcat(fname, ".data");
-      FILE *input = fopen(fname, "r");
-      if (input == NULL) {
-        printf("**Error: unable to open file '%s'", fname);
+      print_ast(query);
+      if (explain_enabled()) {
+        explain_query(db, query);
+      } else {
+        execute_query(db, query);
       }
-      execute_query(input, tables[j].recordSize);
     }
   }
-  database_close(db);
+  cleanup(db);
   return 0;
 }
 
@@ -0,0 +1,108 @@
+/*aggregate.c*/
+
+//
+// Aggregate functions for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "aggregate.h"
+#include "ast.h"
+#include "database.h"
+#include "fieldparse.h"
+#include "resultset.h"
+
+void aggregate_init(struct AggState states[], int N) {
+  for (int a = 0; a < N; a++) {
+    states[a].count = 0;
+    states[a].isum = 0;
+    states[a].sum = 0.0;
+    states[a].min = INFINITY;
+    states[a].max = -INFINITY;
+  }
+}
+
+void aggregate_fold(struct Aggregate aggs[], struct AggState states[], int N,
+                    char* fields[], int lengths[]) {
+  for (int a = 0; a < N; a++) {
+    struct Aggregate* agg = &aggs[a];
+    states[a].count++;
+    if (agg->function == COUNT_FUNCTION) {
+      continue;
+    }
+
+    double value;
+    if (agg->colType == COL_TYPE_INT) {
+      int i = fieldparse_int(fields[agg->column], lengths[agg->column]);
+      states[a].isum += i;
+      value = i;
+    } else {
+      value = fieldparse_real(fields[agg->column], lengths[agg->column]);
+    }
+    states[a].sum += value;
+    if (value < states[a].min) {
+      states[a].min = value;
+    }
+    if (value > states[a].max) {
+      states[a].max = value;
+    }
+  }
+}
+
+void aggregate_merge(struct AggState into[], struct AggState from[], int N) {
+  for (int a = 0; a < N; a++) {
+    into[a].count += from[a].count;
+    into[a].isum += from[a].isum;
+    into[a].sum += from[a].sum;
+    if (from[a].min < into[a].min) {
+      into[a].min = from[a].min;
+    }
+    if (from[a].max > into[a].max) {
+      into[a].max = from[a].max;
+    }
+  }
+}
+
+int aggregate_type(int function, int colType) {
+  if (function == COUNT_FUNCTION) {
+    return COL_TYPE_INT;
+  } else if (function == AVG_FUNCTION) {
+    return COL_TYPE_REAL;
+  } else {
+    return colType;
+  }
+}
+
+void aggregate_output(struct ResultSet* rs, int row, int position,
+                      struct Aggregate* agg, struct AggState* state) {
+  switch (agg->function) {
+    case COUNT_FUNCTION:
+      resultset_putInt(rs, row, position, (int)state->count);
+      break;
+    case AVG_FUNCTION:
+      resultset_putReal(rs, row, position, state->sum / state->count);
+      break;
+    case SUM_FUNCTION:
+      if (agg->colType == COL_TYPE_INT) {
+        resultset_putInt(rs, row, position, (int)state->isum);
+      } else {
+        resultset_putReal(rs, row, position, state->sum);
+      }
+      break;
+    case MIN_FUNCTION:
+    case MAX_FUNCTION: {
+      double value = (agg->function == MIN_FUNCTION) ? state->min : state->max;
+      if (agg->colType == COL_TYPE_INT) {
+        resultset_putInt(rs, row, position, (int)value);
+      } else {
+        resultset_putReal(rs, row, position, value);
+      }
+      break;
+    }
+  }
+}
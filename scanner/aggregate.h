@@ -0,0 +1,79 @@
+/*aggregate.h*/
+
+//
+// Aggregate functions for SimpleSQL: the running state of MIN, MAX,
+// SUM, AVG and COUNT over the records of a group, shared by GROUP BY
+// and the materialized aggregates. A state is plain data, so states
+// can be written to a spill or sidecar file as they are, and partial
+// states of the same group, e.g. from two threads, combine into the
+// state of the whole.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include "resultset.h"
+
+struct AggState
+{
+  long   count;
+  long   isum;  // SUM over an int column
+  double sum;   // SUM over a real column, and AVG
+  double min;
+  double max;
+};
+
+struct Aggregate
+{
+  int function;  // MIN_FUNCTION, ..., COUNT_FUNCTION (ast.h)
+  int column;    // 0-based table column
+  int colType;
+};
+
+
+//
+// functions:
+//
+
+//
+// aggregate_init
+//
+// Sets states[0..N-1] to the state of no records.
+//
+void aggregate_init(struct AggState states[], int N);
+
+//
+// aggregate_fold
+//
+// Folds one record, split into its fields, into states[0..N-1], the
+// states of aggs[0..N-1].
+//
+void aggregate_fold(struct Aggregate aggs[], struct AggState states[], int N,
+                    char* fields[], int lengths[]);
+
+//
+// aggregate_merge
+//
+// Combines the partial states from[0..N-1] into into[0..N-1].
+//
+void aggregate_merge(struct AggState into[], struct AggState from[], int N);
+
+//
+// aggregate_type
+//
+// Returns the type of the result of the function over a column of
+// the given type.
+//
+int aggregate_type(int function, int colType);
+
+//
+// aggregate_output
+//
+// Puts the value of the aggregate, given its state, into the column
+// at position of the given row of the result set.
+//
+void aggregate_output(struct ResultSet* rs, int row, int position,
+                      struct Aggregate* agg, struct AggState* state);
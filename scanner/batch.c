@@ -0,0 +1,129 @@
+/*batch.c*/
+
+//
+// Batch mode for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "analyzer.h"
+#include "ast.h"
+#include "batch.h"
+#include "database.h"
+#include "execute.h"
+#include "explain.h"
+#include "parser.h"
+#include "util.h"
+
+static char outputBuffer[BATCH_OUTPUT_BYTES];
+
+static long numRowsPrinted = 0;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+char* batch_scriptPath(void) {
+  return getenv("SIMPLESQL_BATCH");
+}
+
+void batch_bufferOutput(void) {
+  setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+}
+
+void batch_countRows(long numRows) {
+  numRowsPrinted += numRows;
+}
+
+bool batch_run(struct Database* db, char* scriptPath) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  int fd = open(scriptPath, O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) < 0) {
+    printf("**Error: unable to open script '%s'\n", scriptPath);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+
+  //
+  // the parser reads a FILE*, so the mapped script is read through
+  // a memory stream; an empty script cannot be mapped, and has no
+  // statements anyway
+  //
+  void* script = NULL;
+  FILE* input = NULL;
+  if (info.st_size > 0) {
+    script = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (script == MAP_FAILED) {
+      printf("**Error: unable to map script '%s'\n", scriptPath);
+      close(fd);
+      return false;
+    }
+    madvise(script, info.st_size, MADV_SEQUENTIAL);
+    input = fmemopen(script, info.st_size, "r");
+    if (input == NULL) {
+      panic("No memory");
+    }
+  }
+  close(fd);  // the mapping stays valid
+
+  long numQueries = 0;
+  numRowsPrinted = 0;
+  double start = now();
+
+  if (input != NULL) {
+    parser_init();
+    while (1) {
+      struct TokenQueue* tokens = parser_parse(input);
+      if (tokens == NULL) {
+        if (parser_eof()) {
+          break;
+        } else {
+          continue;
+        }
+      }
+      struct QUERY* query = analyzer_build(db, tokens);
+      if (query != NULL) {
+        if (explain_enabled()) {
+          explain_query(db, query);
+        } else {
+          execute_query(db, query);
+        }
+        numQueries++;
+      }
+    }
+    fclose(input);
+    munmap(script, info.st_size);
+  }
+
+  fflush(stdout);
+  double seconds = now() - start;
+  if (seconds <= 0) {
+    seconds = 1e-9;
+  }
+
+  fprintf(stderr,
+          "%s: %ld queries, %ld rows in %.3f s (%.0f queries/s, %.0f "
+          "rows/s)\n",
+          scriptPath, numQueries, numRowsPrinted, seconds,
+          numQueries / seconds, numRowsPrinted / seconds);
+  return true;
+}
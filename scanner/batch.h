@@ -0,0 +1,65 @@
+/*batch.h*/
+
+//
+// Batch mode for SimpleSQL: instead of prompting for queries on
+// stdin, the program runs the statements of a script file back to
+// back. The script is mapped into memory rather than read, no
+// prompts or ASTs are printed, and stdout is fully buffered in one
+// BATCH_OUTPUT_BYTES buffer, so a large script costs the queries
+// and not the formatting and flushing of the output. Throughput,
+// queries and result rows per second, is reported on stderr at the
+// end.
+//
+// Set the environment variable SIMPLESQL_BATCH to the path of the
+// script; the name of the database is still read from stdin.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "database.h"
+
+#define BATCH_OUTPUT_BYTES (4 * 1024 * 1024)
+
+
+//
+// functions:
+//
+
+//
+// batch_scriptPath
+//
+// Returns the value of SIMPLESQL_BATCH, or NULL if the program
+// should read queries from stdin.
+//
+char* batch_scriptPath(void);
+
+//
+// batch_bufferOutput
+//
+// Makes stdout fully buffered with a BATCH_OUTPUT_BYTES buffer. Call
+// this before anything is printed.
+//
+void batch_bufferOutput(void);
+
+//
+// batch_run
+//
+// Runs the statements of the script against the database, then
+// flushes stdout and reports the throughput. Returns false if the
+// script cannot be opened.
+//
+bool batch_run(struct Database* db, char* scriptPath);
+
+//
+// batch_countRows
+//
+// Counts rows printed as a query's result towards the throughput;
+// called wherever a result is printed.
+//
+void batch_countRows(long numRows);
@@ -0,0 +1,238 @@
+/*predicate_bench.c*/
+
+//
+// Benchmark of compiled WHERE predicates: measures the cost per row
+// of a comparison, for every column type and operator, dispatched
+// per row on type and operator with the literal parsed per row, the
+// way the executor used to, against the compiled predicate per row
+// and over the selection bitmap. Prints the nanoseconds per row of
+// each, and the speedups.
+//
+// Build and run from the scanner directory, next to the rest of the
+// project's sources:
+//
+//   gcc -O2 -pthread -I. bench/predicate_bench.c predicate.c like.c
+//     colresult.c dictionary.c fieldparse.c readahead.c schemamap.c
+//     tablefile.c resultset.c util.c -lm -o predicate_bench
+//     && ./predicate_bench
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ast.h"
+#include "colresult.h"
+#include "database.h"
+#include "predicate.h"
+#include "schemamap.h"
+#include "util.h"
+
+//
+// each comparison over BENCH_ROWS rows of a generated columnar
+// result, best of BENCH_RUNS:
+//
+#define BENCH_ROWS (4 * 1024 * 1024)
+#define BENCH_RUNS 3
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//
+// dispatchRow
+//
+// The comparison the way the executor made it before predicates
+// were compiled: on every row, a branch on the column type and the
+// operator, and the literal parsed again. Not inlined, so that the
+// parse cannot be hoisted out of the benchmark's loop either.
+//
+static __attribute__((noinline)) bool dispatchRow(struct ColumnarResult* cr,
+                                                  long row, int col,
+                                                  int colType, int oper,
+                                                  char* value) {
+  if (colType == COL_TYPE_INT) {
+    int v = cr->columns[col].data.ints[row];
+    switch (oper) {
+      case EXPR_LT:
+        return v < atoi(value);
+      case EXPR_LTE:
+        return v <= atoi(value);
+      case EXPR_GT:
+        return v > atoi(value);
+      case EXPR_GTE:
+        return v >= atoi(value);
+      case EXPR_EQUAL:
+        return v == atoi(value);
+      case EXPR_NOT_EQUAL:
+        return v != atoi(value);
+    }
+  } else if (colType == COL_TYPE_REAL) {
+    double v = cr->columns[col].data.reals[row];
+    switch (oper) {
+      case EXPR_LT:
+        return v < atof(value);
+      case EXPR_LTE:
+        return v <= atof(value);
+      case EXPR_GT:
+        return v > atof(value);
+      case EXPR_GTE:
+        return v >= atof(value);
+      case EXPR_EQUAL:
+        return v == atof(value);
+      case EXPR_NOT_EQUAL:
+        return v != atof(value);
+    }
+  } else {
+    int cmp = strcmp(colresult_getString(cr, row, col, NULL), value);
+    switch (oper) {
+      case EXPR_LT:
+        return cmp < 0;
+      case EXPR_LTE:
+        return cmp <= 0;
+      case EXPR_GT:
+        return cmp > 0;
+      case EXPR_GTE:
+        return cmp >= 0;
+      case EXPR_EQUAL:
+        return cmp == 0;
+      case EXPR_NOT_EQUAL:
+        return cmp != 0;
+    }
+  }
+  return false;
+}
+
+int main(void) {
+  static struct ColumnMeta columns[] = {
+      {"i", COL_TYPE_INT, COL_NON_INDEXED},
+      {"r", COL_TYPE_REAL, COL_NON_INDEXED},
+      {"s", COL_TYPE_STRING, COL_NON_INDEXED}};
+  static char* literals[] = {"500", "500.5", "s0500000"};
+  static char* operators[] = {"<", "<=", ">", ">=", "=", "<>"};
+
+  struct TableMeta table;
+  memset(&table, 0, sizeof(table));
+  table.name = "benchmark";
+  table.recordSize = 64;
+  table.numColumns = 3;
+  table.columns = columns;
+
+  struct Database db;
+  memset(&db, 0, sizeof(db));
+  db.name = "benchmark";
+  db.numTables = 1;
+  db.tables = &table;
+  schemamap_build(&db);
+
+  //
+  // values uniform over [0, 1000) and strings over [s0000000,
+  // s1000000), so that the literals split them about in half:
+  //
+  struct ColumnarResult* cr = colresult_create();
+  for (int j = 0; j < 3; j++) {
+    colresult_addColumn(cr, table.name, columns[j].name, columns[j].colType);
+  }
+  srand(211);
+  for (long row = 0; row < BENCH_ROWS; row++) {
+    char text[3][32];
+    char* values[3] = {text[0], text[1], text[2]};
+    int lengths[3];
+    lengths[0] = snprintf(text[0], sizeof(text[0]), "%d", rand() % 1000);
+    lengths[1] = snprintf(text[1], sizeof(text[1]), "%.2f",
+                          (rand() % 100000) / 100.0);
+    lengths[2] = snprintf(text[2], sizeof(text[2]), "s%07d",
+                          rand() % 1000000);
+    colresult_addRecord(cr, values, lengths);
+  }
+
+  long numWords = colresult_numWords(cr);
+  unsigned long* selection =
+      (unsigned long*)malloc(sizeof(unsigned long) * (numWords + 1));
+  if (selection == NULL) {
+    panic("No memory");
+  }
+
+  printf("%d rows, ns per row: dispatched per row, compiled per row, "
+         "compiled over the bitmap\n",
+         BENCH_ROWS);
+
+  bool ok = true;
+  for (int j = 0; j < 3; j++) {
+    for (int oper = EXPR_LT; oper <= EXPR_NOT_EQUAL; oper++) {
+      struct COLUMN column;
+      memset(&column, 0, sizeof(column));
+      column.table = table.name;
+      column.name = columns[j].name;
+      struct EXPR expr;
+      memset(&expr, 0, sizeof(expr));
+      expr.column = &column;
+      expr.operator = oper;
+      expr.value = literals[j];
+
+      struct Predicate* pred = predicate_compile(&table, &expr);
+
+      double best[3] = {1e30, 1e30, 1e30};
+      long counts[3] = {0, 0, 0};
+      for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = now();
+        long n = 0;
+        for (long row = 0; row < cr->numRows; row++) {
+          n += dispatchRow(cr, row, j, columns[j].colType, oper, literals[j]);
+        }
+        double seconds = now() - start;
+        best[0] = (seconds < best[0]) ? seconds : best[0];
+        counts[0] = n;
+
+        start = now();
+        n = 0;
+        for (long row = 0; row < cr->numRows; row++) {
+          n += pred->evalColumn(pred, cr, row);
+        }
+        seconds = now() - start;
+        best[1] = (seconds < best[1]) ? seconds : best[1];
+        counts[1] = n;
+
+        memcpy(selection, cr->selection, sizeof(unsigned long) * numWords);
+        start = now();
+        pred->filter(pred, cr, selection);
+        n = 0;
+        for (long w = 0; w < numWords; w++) {
+          n += __builtin_popcountl(selection[w]);
+        }
+        seconds = now() - start;
+        best[2] = (seconds < best[2]) ? seconds : best[2];
+        counts[2] = n;
+      }
+
+      char* type = (columns[j].colType == COL_TYPE_INT)    ? "int"
+                   : (columns[j].colType == COL_TYPE_REAL) ? "real"
+                                                           : "string";
+      if (counts[1] != counts[0] || counts[2] != counts[0]) {
+        printf("**Error: %s %s: the compiled predicate disagrees\n", type,
+               operators[oper]);
+        ok = false;
+      }
+
+      double perRow = 1e9 / cr->numRows;
+      printf("%-6s %-2s: %6.2f, %6.2f (%4.1fx), %6.2f (%5.1fx)\n", type,
+             operators[oper], best[0] * perRow, best[1] * perRow,
+             best[0] / best[1], best[2] * perRow, best[0] / best[2]);
+
+      predicate_destroy(pred);
+    }
+  }
+
+  free(selection);
+  colresult_destroy(cr);
+  schemamap_destroy(&db);
+  return ok ? 0 : 1;
+}
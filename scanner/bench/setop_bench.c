@@ -0,0 +1,203 @@
+/*setop_bench.c*/
+
+//
+// Benchmark of set operations over a large result: writes a table
+// of BENCH_RECORDS records, then runs UNION ALL and UNION of the
+// table with itself in the binary output format, whose rows are
+// thrown away. Prints the seconds each took and the peak memory of
+// the process after it, which stays far below the size of the
+// results: UNION ALL writes its 2 * BENCH_RECORDS rows out a batch
+// at a time, and UNION spills its rows once the hash table grows
+// past SETOP_MEMORY_BYTES.
+//
+// The table is written to a temporary directory, which is removed
+// at the end; no database is touched.
+//
+// Build and run from the scanner directory, next to the rest of the
+// project's sources:
+//
+//   gcc -O2 -pthread -I. bench/setop_bench.c $(ls *.c | grep -v
+//     Schema_and_AST_Output.c) -lm -o setop_bench && ./setop_bench
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "database.h"
+#include "schemamap.h"
+#include "setop.h"
+#include "tablefile.h"
+#include "util.h"
+
+#define BENCH_RECORDS     (10 * 1000 * 1000)
+#define BENCH_RECORD_SIZE 12  // a 9-digit id, padded, and a newline
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//
+// peakMegabytes
+//
+// The most memory the process has used so far.
+//
+static double peakMegabytes(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+//
+// writeTable
+//
+// Writes the records 0, 1, ..., BENCH_RECORDS - 1 to the data file;
+// returns false on error.
+//
+static bool writeTable(char* path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  static char buffer[4096 * BENCH_RECORD_SIZE + 1];  // + snprintf's null
+  bool ok = true;
+  for (long first = 0; ok && first < BENCH_RECORDS; first += 4096) {
+    long n = 0;
+    for (long id = first; id < first + 4096 && id < BENCH_RECORDS; id++) {
+      char* record = buffer + n * BENCH_RECORD_SIZE;
+      snprintf(record, BENCH_RECORD_SIZE + 1, "%-*ld\n",
+               BENCH_RECORD_SIZE - 1, id);
+      n++;
+    }
+    ok = tablefile_write(fd, buffer, n * BENCH_RECORD_SIZE);
+  }
+
+  close(fd);
+  return ok;
+}
+
+//
+// removeDirectory
+//
+// Removes the temporary directory, with the data file and whatever
+// sidecar files the scans left next to it.
+//
+static void removeDirectory(char* dir) {
+  DIR* d = opendir(dir);
+  if (d != NULL) {
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+        continue;
+      }
+      char path[TABLEFILE_MAX_PATH];
+      snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+      unlink(path);
+    }
+    closedir(d);
+  }
+  rmdir(dir);
+}
+
+//
+// run
+//
+// Runs "SELECT id FROM benchmark <op> SELECT id FROM benchmark" with
+// its output thrown away, and returns the seconds it took.
+//
+static double run(struct Database* db, struct SELECT* select, int op) {
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  int devnull = open("/dev/null", O_WRONLY);
+  if (saved < 0 || devnull < 0) {
+    panic("unable to redirect the benchmark's output");
+  }
+  dup2(devnull, STDOUT_FILENO);
+  close(devnull);
+
+  double start = now();
+  setop_execute(db, select, select, op);
+  fflush(stdout);
+  double seconds = now() - start;
+
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  return seconds;
+}
+
+int main(void) {
+  static struct ColumnMeta columns[] = {{"id", COL_TYPE_INT, COL_NON_INDEXED}};
+
+  char dir[] = "/tmp/simplesql-setopbench-XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    printf("**Error: unable to create a temporary directory\n");
+    return 1;
+  }
+
+  struct TableMeta table;
+  memset(&table, 0, sizeof(table));
+  table.name = "benchmark";
+  table.recordSize = BENCH_RECORD_SIZE;
+  table.numColumns = 1;
+  table.columns = columns;
+
+  struct Database db;
+  memset(&db, 0, sizeof(db));
+  db.name = dir;
+  db.numTables = 1;
+  db.tables = &table;
+  schemamap_build(&db);
+
+  char path[TABLEFILE_MAX_PATH];
+  tablefile_path(&db, &table, ".data", path);
+  if (!writeTable(path)) {
+    printf("**Error: unable to write the benchmark's table\n");
+    removeDirectory(dir);
+    schemamap_destroy(&db);
+    return 1;
+  }
+
+  struct COLUMN column;
+  memset(&column, 0, sizeof(column));
+  column.table = table.name;
+  column.name = columns[0].name;
+  struct SELECT select;
+  memset(&select, 0, sizeof(select));
+  select.table = table.name;
+  select.columns = &column;
+
+  setenv("SIMPLESQL_FORMAT", "binary", 1);
+
+  printf("%d records of %d bytes, %.0f MB of data; peak memory before: "
+         "%.1f MB\n",
+         BENCH_RECORDS, BENCH_RECORD_SIZE,
+         (double)BENCH_RECORDS * BENCH_RECORD_SIZE / (1024 * 1024),
+         peakMegabytes());
+
+  // UNION ALL first, since the peak only grows:
+  double seconds = run(&db, &select, SETOP_UNION_ALL);
+  printf("UNION ALL: %ld rows in %6.2f s, peak memory %7.1f MB\n",
+         2L * BENCH_RECORDS, seconds, peakMegabytes());
+
+  seconds = run(&db, &select, SETOP_UNION);
+  printf("UNION:     %ld rows in %6.2f s, peak memory %7.1f MB\n",
+         (long)BENCH_RECORDS, seconds, peakMegabytes());
+
+  removeDirectory(dir);
+  schemamap_destroy(&db);
+  return 0;
+}
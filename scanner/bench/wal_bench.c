@@ -0,0 +1,131 @@
+/*wal_bench.c*/
+
+//
+// Benchmark of the write-ahead log's group commit: every writer
+// thread commits BENCH_COMMITS transactions of one BENCH_RECORD-byte
+// record, for 1, 2, 4, ... up to BENCH_MAX_WRITERS concurrent
+// writers. Prints the commits per second, and how many commits each
+// fdatasync of the log made durable.
+//
+// The log is written to a temporary directory, which is removed at
+// the end; no database is touched.
+//
+// Build and run from the scanner directory, next to the rest of the
+// project's sources; the log's recovery invalidates materialized
+// views, which reach the executor, so link everything but main():
+//
+//   gcc -O2 -pthread -I. bench/wal_bench.c $(ls *.c | grep -v
+//     Schema_and_AST_Output.c) -lm -o wal_bench && ./wal_bench
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "schemamap.h"
+#include "tablefile.h"
+#include "util.h"
+#include "wal.h"
+
+#define BENCH_COMMITS     500
+#define BENCH_RECORD      64
+#define BENCH_MAX_WRITERS 32
+
+static struct Database db;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* writer(void* arg) {
+  struct TableMeta* table = (struct TableMeta*)arg;
+  char record[BENCH_RECORD];
+
+  memset(record, 'x', sizeof(record));
+  for (int i = 0; i < BENCH_COMMITS; i++) {
+    struct WalTxn* txn = wal_begin(&db);
+    wal_write(txn, table, (off_t)i * sizeof(record), record, sizeof(record));
+    if (!wal_commit(txn)) {
+      panic("unable to write the benchmark's write-ahead log");
+    }
+    wal_end(txn);
+  }
+  return NULL;
+}
+
+int main(void) {
+  static struct ColumnMeta columns[] = {{"x", COL_TYPE_STRING, COL_NON_INDEXED}};
+
+  char dir[] = "/tmp/simplesql-walbench-XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    printf("**Error: unable to create a temporary directory\n");
+    return 1;
+  }
+
+  //
+  // a database of one table, whose data file is never created: the
+  // checkpoints between rounds only empty the log
+  //
+  struct TableMeta table;
+  memset(&table, 0, sizeof(table));
+  table.name = "benchmark";
+  table.recordSize = BENCH_RECORD;
+  table.numColumns = 1;
+  table.columns = columns;
+
+  db.name = dir;
+  db.numTables = 1;
+  db.tables = &table;
+  schemamap_build(&db);
+
+  pthread_t threads[BENCH_MAX_WRITERS];
+
+  printf("%d commits of %d bytes per writer\n", BENCH_COMMITS, BENCH_RECORD);
+
+  bool ok = true;
+  for (int N = 1; N <= BENCH_MAX_WRITERS; N *= 2) {
+    long syncsBefore = wal_numSyncs();
+
+    double start = now();
+    for (int t = 0; t < N; t++) {
+      if (pthread_create(&threads[t], NULL, writer, &table) != 0) {
+        panic("unable to start benchmark thread");
+      }
+    }
+    for (int t = 0; t < N; t++) {
+      pthread_join(threads[t], NULL);
+    }
+    double seconds = now() - start;
+
+    long commits = (long)N * BENCH_COMMITS;
+    long syncs = wal_numSyncs() - syncsBefore;
+    printf("%2d writers: %9.0f commits/s, %5.1f commits per fdatasync\n", N,
+           commits / seconds, (syncs > 0) ? (double)commits / syncs : 0.0);
+
+    wal_waitForCheckpoint();
+    if (!wal_checkpoint(&db)) {
+      printf("**Error: unable to empty the benchmark's write-ahead log\n");
+      ok = false;
+      break;
+    }
+  }
+
+  char path[TABLEFILE_MAX_PATH];
+  snprintf(path, sizeof(path), "%s/wal.log", dir);
+  unlink(path);
+  rmdir(dir);
+
+  schemamap_destroy(&db);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/*bloom.c*/
+
+//
+// Bloom filters for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "bloom.h"
+#include "util.h"
+
+//
+// mix
+//
+// Spreads the bits of the hash, so that both halves are usable on
+// their own even for short values.
+//
+static unsigned long mix(unsigned long h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdul;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ul;
+  h ^= h >> 33;
+  return h;
+}
+
+//
+// the i-th bit of a value is h1 + i * h2, the halves of its mixed
+// hash, modulo the size of the filter; h2 is odd, so the bits differ
+//
+void bloom_setBits(unsigned long* bits, long numBits, unsigned long hash) {
+  unsigned long h = mix(hash);
+  unsigned long h1 = h & 0xffffffffu, h2 = (h >> 32) | 1;
+  unsigned long mask = (unsigned long)numBits - 1;
+
+  for (int i = 0; i < BLOOM_HASHES; i++) {
+    unsigned long bit = (h1 + i * h2) & mask;
+    bits[bit / 64] |= 1ul << (bit % 64);
+  }
+}
+
+bool bloom_testBits(unsigned long* bits, long numBits, unsigned long hash) {
+  unsigned long h = mix(hash);
+  unsigned long h1 = h & 0xffffffffu, h2 = (h >> 32) | 1;
+  unsigned long mask = (unsigned long)numBits - 1;
+
+  for (int i = 0; i < BLOOM_HASHES; i++) {
+    unsigned long bit = (h1 + i * h2) & mask;
+    if ((bits[bit / 64] & (1ul << (bit % 64))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct Bloom* bloom_create(long expectedKeys, long maxBytes) {
+  struct Bloom* bloom = (struct Bloom*)malloc(sizeof(struct Bloom));
+  if (bloom == NULL) {
+    panic("No memory");
+  }
+
+  long numBits = 64;
+  while (numBits < expectedKeys * BLOOM_BITS_PER_KEY &&
+         2 * numBits / 8 <= maxBytes) {
+    numBits *= 2;
+  }
+
+  bloom->numBits = numBits;
+  bloom->bits = (unsigned long*)calloc(numBits / 64, sizeof(unsigned long));
+  if (bloom->bits == NULL) {
+    panic("No memory");
+  }
+  return bloom;
+}
+
+void bloom_destroy(struct Bloom* bloom) {
+  if (bloom == NULL) {
+    return;
+  }
+  free(bloom->bits);
+  free(bloom);
+}
+
+void bloom_add(struct Bloom* bloom, unsigned long hash) {
+  bloom_setBits(bloom->bits, bloom->numBits, hash);
+}
+
+bool bloom_mayContain(struct Bloom* bloom, unsigned long hash) {
+  return bloom_testBits(bloom->bits, bloom->numBits, hash);
+}
@@ -0,0 +1,70 @@
+/*bloom.h*/
+
+//
+// Bloom filters for SimpleSQL: a set of hashed values in a bit
+// array, which can tell for sure that a value is not in the set,
+// and otherwise says it may be. Each value sets BLOOM_HASHES bits,
+// derived from its 64-bit hash (e.g. rowkey_hash()), so with
+// BLOOM_BITS_PER_KEY bits per value about 2% of the values that are
+// not in the set still pass.
+//
+// The bits can live in a filter of their own, e.g. one built from
+// the rows of a query at runtime, or in a larger array holding many
+// filters of the same size, e.g. one per block of a table.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#define BLOOM_HASHES       5
+#define BLOOM_BITS_PER_KEY 8
+
+struct Bloom
+{
+  long numBits;         // always a power of 2
+  unsigned long* bits;  // numBits / 64 words
+};
+
+
+//
+// functions:
+//
+
+//
+// bloom_create
+//
+// Returns an empty filter sized for the expected number of values,
+// but at most maxBytes.
+//
+// NOTE: it is the callers responsibility to free the filter by
+// calling bloom_destroy().
+//
+struct Bloom* bloom_create(long expectedKeys, long maxBytes);
+
+//
+// bloom_destroy
+//
+void bloom_destroy(struct Bloom* bloom);
+
+//
+// bloom_add / bloom_mayContain
+//
+// Adds the value with the given hash to the filter / returns false
+// if it was certainly never added.
+//
+void bloom_add(struct Bloom* bloom, unsigned long hash);
+bool bloom_mayContain(struct Bloom* bloom, unsigned long hash);
+
+//
+// bloom_setBits / bloom_testBits
+//
+// The same, over a filter of numBits bits (a power of 2) stored at
+// bits, e.g. one of several in a larger array.
+//
+void bloom_setBits(unsigned long* bits, long numBits, unsigned long hash);
+bool bloom_testBits(unsigned long* bits, long numBits, unsigned long hash);
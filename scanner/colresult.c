@@ -0,0 +1,321 @@
+/*colresult.c*/
+
+//
+// Columnar result sets for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "colresult.h"
+#include "database.h"
+#include "dictionary.h"
+#include "fieldparse.h"
+#include "resultset.h"
+#include "util.h"
+
+struct ColumnarResult* colresult_create(void) {
+  struct ColumnarResult* cr =
+      (struct ColumnarResult*)malloc(sizeof(struct ColumnarResult));
+  if (cr == NULL) {
+    panic("No memory");
+  }
+
+  cr->numRows = 0;
+  cr->capacity = 0;
+  cr->numCols = 0;
+  cr->columns = NULL;
+  cr->selection = NULL;
+  cr->arena = NULL;
+  cr->arenaSize = 0;
+  cr->arenaCapacity = 0;
+  return cr;
+}
+
+void colresult_destroy(struct ColumnarResult* cr) {
+  if (cr == NULL) {
+    return;
+  }
+
+  for (int j = 0; j < cr->numCols; j++) {
+    free(cr->columns[j].data.ints);  // any member, they share the pointer
+    dictionary_close(cr->columns[j].dict);
+  }
+  free(cr->columns);
+  free(cr->selection);
+  free(cr->arena);
+  free(cr);
+}
+
+int colresult_addColumn(struct ColumnarResult* cr, char* tableName,
+                        char* colName, int colType) {
+  assert(cr->numRows == 0);
+
+  cr->columns = (struct ColVector*)realloc(
+      cr->columns, sizeof(struct ColVector) * (cr->numCols + 1));
+  if (cr->columns == NULL) {
+    panic("No memory");
+  }
+
+  struct ColVector* column = &cr->columns[cr->numCols];
+  column->tableName = tableName;
+  column->colName = colName;
+  column->colType = colType;
+  column->dict = NULL;
+  column->data.ints = NULL;
+
+  return cr->numCols++;
+}
+
+void colresult_setDictionary(struct ColumnarResult* cr, int col,
+                             struct Dictionary* dict) {
+  assert(cr->numRows == 0 && cr->columns[col].colType == COL_TYPE_STRING);
+
+  dictionary_close(cr->columns[col].dict);
+  cr->columns[col].dict = dict;
+}
+
+//
+// grow
+//
+// Makes room for at least one more row in every vector.
+//
+static void grow(struct ColumnarResult* cr) {
+  if (cr->numRows < cr->capacity) {
+    return;
+  }
+
+  long capacity = (cr->capacity == 0) ? 1024 : 2 * cr->capacity;
+
+  for (int j = 0; j < cr->numCols; j++) {
+    struct ColVector* column = &cr->columns[j];
+    size_t size = (column->colType == COL_TYPE_INT)    ? sizeof(int)
+                  : (column->colType == COL_TYPE_REAL) ? sizeof(double)
+                  : (column->dict != NULL)             ? sizeof(int)
+                                                       : sizeof(struct StringView);
+    void* data = realloc(column->data.ints, size * capacity);
+    if (data == NULL) {
+      panic("No memory");
+    }
+    column->data.ints = (int*)data;
+  }
+
+  // capacity is a multiple of the word size, so the bitmap grows in
+  // whole words, which start out all 0:
+  long oldWords = cr->capacity / COLRESULT_WORD_BITS;
+  long numWords = capacity / COLRESULT_WORD_BITS;
+  cr->selection = (unsigned long*)realloc(cr->selection,
+                                          sizeof(unsigned long) * numWords);
+  if (cr->selection == NULL) {
+    panic("No memory");
+  }
+  memset(cr->selection + oldWords, 0,
+         sizeof(unsigned long) * (numWords - oldWords));
+  cr->capacity = capacity;
+}
+
+//
+// appendString
+//
+// Copies the string, of the given length, and a '\0' to the end of
+// the arena.
+//
+static struct StringView appendString(struct ColumnarResult* cr, char* s,
+                                      int length) {
+  struct StringView view;
+
+  if (cr->arenaSize + length + 1 > cr->arenaCapacity) {
+    long capacity = (cr->arenaCapacity == 0) ? 64 * 1024 : cr->arenaCapacity;
+    while (cr->arenaSize + length + 1 > capacity) {
+      capacity *= 2;
+    }
+    cr->arena = (char*)realloc(cr->arena, capacity);
+    if (cr->arena == NULL) {
+      panic("No memory");
+    }
+    cr->arenaCapacity = capacity;
+  }
+
+  memcpy(cr->arena + cr->arenaSize, s, length);
+  cr->arena[cr->arenaSize + length] = '\0';
+  view.offset = cr->arenaSize;
+  view.length = length;
+  cr->arenaSize += length + 1;
+  return view;
+}
+
+//
+// decode
+//
+// Turns a dictionary column back into string views, copying each
+// row's value into the arena.
+//
+static void decode(struct ColumnarResult* cr, struct ColVector* column) {
+  struct StringView* strings = (struct StringView*)malloc(
+      sizeof(struct StringView) * (cr->capacity + 1));
+  if (strings == NULL) {
+    panic("No memory");
+  }
+
+  struct Dictionary* dict = column->dict;
+  for (long row = 0; row < cr->numRows; row++) {
+    int code = column->data.codes[row];
+    strings[row] = appendString(cr, dict->entries[code], dict->lengths[code]);
+  }
+
+  free(column->data.codes);
+  column->data.strings = strings;
+  column->dict = NULL;
+  dictionary_close(dict);
+}
+
+long colresult_addRecord(struct ColumnarResult* cr, char* values[],
+                         int lengths[]) {
+  grow(cr);
+
+  long row = cr->numRows;
+  for (int j = 0; j < cr->numCols; j++) {
+    struct ColVector* column = &cr->columns[j];
+
+    if (column->colType == COL_TYPE_INT) {
+      column->data.ints[row] = fieldparse_int(values[j], lengths[j]);
+    } else if (column->colType == COL_TYPE_REAL) {
+      column->data.reals[row] = fieldparse_real(values[j], lengths[j]);
+    } else if (column->dict != NULL) {
+      int code = dictionary_find(column->dict, values[j], lengths[j]);
+      if (code >= 0) {
+        column->data.codes[row] = code;
+        continue;
+      }
+      decode(cr, column);
+      column->data.strings[row] = appendString(cr, values[j], lengths[j]);
+    } else {
+      column->data.strings[row] = appendString(cr, values[j], lengths[j]);
+    }
+  }
+
+  cr->selection[row / COLRESULT_WORD_BITS] |=
+      1ul << (row % COLRESULT_WORD_BITS);
+  cr->numRows++;
+  return row;
+}
+
+int colresult_getInt(struct ColumnarResult* cr, long row, int col) {
+  return cr->columns[col].data.ints[row];
+}
+
+double colresult_getReal(struct ColumnarResult* cr, long row, int col) {
+  return cr->columns[col].data.reals[row];
+}
+
+char* colresult_getString(struct ColumnarResult* cr, long row, int col,
+                          int* length) {
+  struct Dictionary* dict = cr->columns[col].dict;
+  if (dict != NULL) {
+    int code = cr->columns[col].data.codes[row];
+    if (length != NULL) {
+      *length = dict->lengths[code];
+    }
+    return dict->entries[code];
+  }
+
+  struct StringView view = cr->columns[col].data.strings[row];
+
+  if (length != NULL) {
+    *length = view.length;
+  }
+  return cr->arena + view.offset;
+}
+
+long colresult_numWords(struct ColumnarResult* cr) {
+  return (cr->numRows + COLRESULT_WORD_BITS - 1) / COLRESULT_WORD_BITS;
+}
+
+bool colresult_isLive(struct ColumnarResult* cr, long row) {
+  return (cr->selection[row / COLRESULT_WORD_BITS] >>
+          (row % COLRESULT_WORD_BITS)) & 1;
+}
+
+long colresult_numLive(struct ColumnarResult* cr) {
+  long N = 0;
+
+  for (long w = 0; w < colresult_numWords(cr); w++) {
+    N += __builtin_popcountl(cr->selection[w]);
+  }
+  return N;
+}
+
+void colresult_deleteRow(struct ColumnarResult* cr, long row) {
+  cr->selection[row / COLRESULT_WORD_BITS] &=
+      ~(1ul << (row % COLRESULT_WORD_BITS));
+}
+
+void colresult_limit(struct ColumnarResult* cr, long N) {
+  long numWords = colresult_numWords(cr);
+  long kept = 0;
+  long w = 0;
+
+  // skip the words whose rows all fit under the limit
+  while (w < numWords && kept + __builtin_popcountl(cr->selection[w]) <= N) {
+    kept += __builtin_popcountl(cr->selection[w]);
+    w++;
+  }
+  if (w == numWords) {
+    return;
+  }
+
+  // keep only the lowest (N - kept) bits of this word
+  unsigned long bits = cr->selection[w];
+  for (long k = kept; k < N; k++) {
+    bits &= bits - 1;  // clears the lowest set bit
+  }
+  cr->selection[w] ^= bits;
+
+  for (w++; w < numWords; w++) {
+    cr->selection[w] = 0;
+  }
+}
+
+struct ResultSet* colresult_toResultSet(struct ColumnarResult* cr,
+                                        int columns[], int N) {
+  struct ResultSet* rs = resultset_create();
+
+  for (int k = 0; k < N; k++) {
+    struct ColVector* column = &cr->columns[columns[k]];
+    resultset_insertColumn(rs, k + 1, column->tableName, column->colName,
+                           NO_FUNCTION, column->colType);
+  }
+
+  for (long w = 0; w < colresult_numWords(cr); w++) {
+    unsigned long bits = cr->selection[w];
+
+    while (bits != 0) {
+      long row = w * COLRESULT_WORD_BITS + __builtin_ctzl(bits);
+      bits &= bits - 1;
+
+      int rsRow = resultset_addRow(rs);
+      for (int k = 0; k < N; k++) {
+        struct ColVector* column = &cr->columns[columns[k]];
+
+        if (column->colType == COL_TYPE_INT) {
+          resultset_putInt(rs, rsRow, k + 1, column->data.ints[row]);
+        } else if (column->colType == COL_TYPE_REAL) {
+          resultset_putReal(rs, rsRow, k + 1, column->data.reals[row]);
+        } else {
+          resultset_putString(rs, rsRow, k + 1,
+                              colresult_getString(cr, row, columns[k], NULL));
+        }
+      }
+    }
+  }
+
+  return rs;
+}
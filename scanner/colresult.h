@@ -0,0 +1,186 @@
+/*colresult.h*/
+
+//
+// Columnar result sets for SimpleSQL. Each column is one contiguous
+// typed vector (ints, reals, or string views into a shared arena),
+// so loading, filtering and reading a cell need no allocation per
+// row. Which rows are still live is kept in a selection bitmap, one
+// bit per row: filters and LIMIT only clear bits, 64 rows at a time
+// where they can, and nothing moves until the live rows are copied
+// out, once, into a resultset.h ResultSet for output. A string
+// column with a dictionary (see dictionary.h) holds codes instead
+// of copies of its values.
+//
+// Unlike resultset.h, rows and columns are 0-based.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "dictionary.h"
+#include "resultset.h"
+
+//
+// a string value: offset of its first char in the arena, where it
+// is followed by a '\0', and its length:
+//
+struct StringView
+{
+  long offset;
+  int  length;
+};
+
+struct ColVector
+{
+  char* tableName;  // NOT owned, e.g. points into the schema
+  char* colName;    // NOT owned
+  int   colType;
+  struct Dictionary* dict;  // owned; non-NULL => strings stored as codes
+  union
+  {
+    int*    ints;
+    double* reals;
+    struct StringView* strings;
+    int*    codes;  // dictionary codes, when dict != NULL
+  } data;
+};
+
+//
+// rows per word of the selection bitmap:
+//
+#define COLRESULT_WORD_BITS 64
+
+struct ColumnarResult
+{
+  long   numRows;   // rows loaded, live or not
+  long   capacity;  // rows each vector has room for
+  int    numCols;
+  struct ColVector* columns;  // pointer to ARRAY of columns
+  unsigned long* selection;   // bit (row % 64) of word (row / 64) is set
+                              // while the row is live; bits past numRows
+                              // are always 0
+  char*  arena;     // string values
+  long   arenaSize;
+  long   arenaCapacity;
+};
+
+
+//
+// functions:
+//
+
+//
+// colresult_create
+//
+// Returns an empty result with no columns.
+//
+// NOTE: it is the callers responsibility to free the result by
+// calling colresult_destroy().
+//
+struct ColumnarResult* colresult_create(void);
+
+//
+// colresult_destroy
+//
+// Frees the result, including its vectors and string arena.
+//
+void colresult_destroy(struct ColumnarResult* cr);
+
+//
+// colresult_addColumn
+//
+// Appends a column of the given type; columns must all be added
+// before the first row. Returns the column's position.
+//
+int colresult_addColumn(struct ColumnarResult* cr, char* tableName,
+                        char* colName, int colType);
+
+//
+// colresult_setDictionary
+//
+// Stores the string column as codes of the dictionary, which the
+// result takes ownership of; call before the first row. A value
+// that is not in the dictionary, e.g. appended since it was built,
+// turns the column back into plain strings.
+//
+void colresult_setDictionary(struct ColumnarResult* cr, int col,
+                             struct Dictionary* dict);
+
+//
+// colresult_addRecord
+//
+// Appends one live row whose values are given in text form, one
+// per column (strings without quotes), along with their lengths,
+// e.g. the fields of a record split by fieldparse_split(). Returns
+// the row's position.
+//
+long colresult_addRecord(struct ColumnarResult* cr, char* values[],
+                         int lengths[]);
+
+//
+// colresult_getInt / colresult_getReal / colresult_getString
+//
+// Return the value of a cell. The string is NOT a copy: it points
+// into the arena and is valid until the next row is added.
+//
+int colresult_getInt(struct ColumnarResult* cr, long row, int col);
+double colresult_getReal(struct ColumnarResult* cr, long row, int col);
+char* colresult_getString(struct ColumnarResult* cr, long row, int col,
+                          int* length);
+
+//
+// colresult_numWords
+//
+// Number of words in the selection bitmap.
+//
+long colresult_numWords(struct ColumnarResult* cr);
+
+//
+// colresult_isLive
+//
+// Returns true if the row has not been deleted.
+//
+bool colresult_isLive(struct ColumnarResult* cr, long row);
+
+//
+// colresult_numLive
+//
+// Returns the number of live rows, counting the bits of the
+// selection bitmap.
+//
+long colresult_numLive(struct ColumnarResult* cr);
+
+//
+// colresult_deleteRow
+//
+// Removes the row from the result in O(1) by clearing its bit; the
+// positions of the other rows do not change.
+//
+void colresult_deleteRow(struct ColumnarResult* cr, long row);
+
+//
+// colresult_limit
+//
+// Deletes every live row after the first N live rows; whole words
+// of the bitmap are counted and cleared at a time.
+//
+void colresult_limit(struct ColumnarResult* cr, long N);
+
+//
+// colresult_toResultSet
+//
+// Compacts the result: copies the live rows, visiting only the set
+// bits of the selection bitmap, into a new ResultSet, with the columns
+// given by position in columns[0..N-1]; a column may be listed
+// more than once.
+//
+// NOTE: it is the callers responsibility to free the ResultSet by
+// calling resultset_destroy().
+//
+struct ResultSet* colresult_toResultSet(struct ColumnarResult* cr,
+                                        int columns[], int N);
@@ -0,0 +1,539 @@
+/*dictionary.c*/
+
+//
+// Dictionary encoding for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "dictionary.h"
+#include "fieldparse.h"
+#include "readahead.h"
+#include "tablefile.h"
+#include "util.h"
+
+#define DICTIONARY_MAGIC "SQLDICT1"
+
+struct DictionaryHeader
+{
+  char magic[8];
+  int  numEntries;  // -1 => too many distinct values to encode
+  int  poolBytes;
+};
+
+static unsigned int hash(char* value, int length) {
+  unsigned int h = 2166136261u;
+
+  for (int i = 0; i < length; i++) {
+    h ^= (unsigned char)value[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+//
+// slotOf
+//
+// The slot of the value in the hash table: the one holding its
+// code, or the empty slot where it belongs.
+//
+static int slotOf(char** entries, int* lengths, int* slots, int capacity,
+                  char* value, int length) {
+  int mask = capacity - 1;
+  int s = (int)(hash(value, length) & mask);
+
+  while (slots[s] != -1) {
+    int code = slots[s];
+    if (lengths[code] == length && memcmp(entries[code], value, length) == 0) {
+      break;
+    }
+    s = (s + 1) & mask;
+  }
+  return s;
+}
+
+static int compareEntries(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+//
+// create
+//
+// Builds a dictionary over N distinct values, given as
+// '\0'-terminated strings; the values are copied.
+//
+static struct Dictionary* create(char** values, int N) {
+  struct Dictionary* dict = (struct Dictionary*)malloc(sizeof(struct Dictionary));
+  char** sorted = (char**)malloc(sizeof(char*) * (N + 1));
+  if (dict == NULL || sorted == NULL) {
+    panic("No memory");
+  }
+
+  memcpy(sorted, values, sizeof(char*) * N);
+  qsort(sorted, N, sizeof(char*), compareEntries);
+
+  long poolBytes = 0;
+  for (int i = 0; i < N; i++) {
+    poolBytes += strlen(sorted[i]) + 1;
+  }
+
+  dict->numEntries = N;
+  dict->entries = (char**)malloc(sizeof(char*) * (N + 1));
+  dict->lengths = (int*)malloc(sizeof(int) * (N + 1));
+  dict->pool = (char*)malloc(poolBytes + 1);
+  dict->capacity = 16;
+  while (dict->capacity < 2 * N) {
+    dict->capacity *= 2;
+  }
+  dict->slots = (int*)malloc(sizeof(int) * dict->capacity);
+  if (dict->entries == NULL || dict->lengths == NULL || dict->pool == NULL ||
+      dict->slots == NULL) {
+    panic("No memory");
+  }
+
+  char* cp = dict->pool;
+  for (int code = 0; code < N; code++) {
+    int length = (int)strlen(sorted[code]);
+    memcpy(cp, sorted[code], length + 1);
+    dict->entries[code] = cp;
+    dict->lengths[code] = length;
+    cp += length + 1;
+  }
+  free(sorted);
+
+  for (int s = 0; s < dict->capacity; s++) {
+    dict->slots[s] = -1;
+  }
+  for (int code = 0; code < N; code++) {
+    int s = slotOf(dict->entries, dict->lengths, dict->slots, dict->capacity,
+                   dict->entries[code], dict->lengths[code]);
+    dict->slots[s] = code;
+  }
+  return dict;
+}
+
+void dictionary_close(struct Dictionary* dict) {
+  if (dict == NULL) {
+    return;
+  }
+  free(dict->slots);
+  free(dict->pool);
+  free(dict->lengths);
+  free(dict->entries);
+  free(dict);
+}
+
+int dictionary_find(struct Dictionary* dict, char* value, int length) {
+  int s = slotOf(dict->entries, dict->lengths, dict->slots, dict->capacity,
+                 value, length);
+  return dict->slots[s];
+}
+
+void dictionary_range(struct Dictionary* dict, char* value, int* lo,
+                      int* hi) {
+  int first = 0, last = dict->numEntries;  // first entry >= value
+
+  while (first < last) {
+    int mid = first + (last - first) / 2;
+    if (strcmp(dict->entries[mid], value) < 0) {
+      first = mid + 1;
+    } else {
+      last = mid;
+    }
+  }
+
+  *lo = first;
+  *hi = (first < dict->numEntries && strcmp(dict->entries[first], value) == 0)
+            ? first + 1  // entries are distinct
+            : first;
+}
+
+static void dictionaryPath(struct Database* db, struct TableMeta* table,
+                           struct ColumnMeta* column, char* path) {
+  char suffix[DATABASE_MAX_ID_LENGTH + 8];
+
+  snprintf(suffix, sizeof(suffix), ".%s.dict", column->name);
+  tablefile_path(db, table, suffix, path);
+}
+
+//
+// save
+//
+// Writes the dictionary, or a marker that the column has too many
+// distinct values if dict is NULL, via a temporary file.
+//
+static bool save(struct Database* db, struct TableMeta* table,
+                 struct ColumnMeta* column, struct Dictionary* dict) {
+  char path[TABLEFILE_MAX_PATH];
+  char tmppath[TABLEFILE_MAX_PATH + 4];
+
+  dictionaryPath(db, table, column, path);
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+
+  FILE* output = fopen(tmppath, "w");
+  if (output == NULL) {
+    return false;
+  }
+
+  struct DictionaryHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, DICTIONARY_MAGIC, sizeof(header.magic));
+  header.numEntries = -1;
+  header.poolBytes = 0;
+  if (dict != NULL) {
+    header.numEntries = dict->numEntries;
+    for (int code = 0; code < dict->numEntries; code++) {
+      header.poolBytes += dict->lengths[code] + 1;
+    }
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, output) == 1;
+  if (ok && dict != NULL) {
+    size_t N = dict->numEntries;
+    ok = fwrite(dict->lengths, sizeof(int), N, output) == N &&
+         fwrite(dict->pool, 1, header.poolBytes, output) ==
+             (size_t)header.poolBytes;
+  }
+
+  ok = (fclose(output) == 0) && ok;
+  if (!ok || rename(tmppath, path) < 0) {
+    unlink(tmppath);
+    return false;
+  }
+  return true;
+}
+
+//
+// load
+//
+// Reads the sidecar file into *dict (NULL if the column is not
+// encoded); returns false if the file is missing, stale or corrupt.
+//
+static bool load(struct Database* db, struct TableMeta* table,
+                 struct ColumnMeta* column, struct Dictionary** dict) {
+  char path[TABLEFILE_MAX_PATH];
+  char datapath[TABLEFILE_MAX_PATH];
+  struct stat info, dataInfo;
+
+  dictionaryPath(db, table, column, path);
+  tablefile_path(db, table, ".data", datapath);
+
+  if (stat(path, &info) < 0 || stat(datapath, &dataInfo) < 0) {
+    return false;
+  }
+  if (info.st_mtim.tv_sec < dataInfo.st_mtim.tv_sec ||
+      (info.st_mtim.tv_sec == dataInfo.st_mtim.tv_sec &&
+       info.st_mtim.tv_nsec < dataInfo.st_mtim.tv_nsec)) {
+    return false;
+  }
+
+  FILE* input = fopen(path, "r");
+  if (input == NULL) {
+    return false;
+  }
+
+  struct DictionaryHeader header;
+  if (fread(&header, sizeof(header), 1, input) != 1 ||
+      memcmp(header.magic, DICTIONARY_MAGIC, sizeof(header.magic)) != 0 ||
+      header.numEntries > DICTIONARY_MAX_ENTRIES || header.poolBytes < 0) {
+    fclose(input);
+    return false;
+  }
+  if (header.numEntries < 0) {
+    fclose(input);
+    *dict = NULL;
+    return true;
+  }
+
+  int N = header.numEntries;
+  int* lengths = (int*)malloc(sizeof(int) * (N + 1));
+  char* pool = (char*)malloc(header.poolBytes + 1);
+  char** values = (char**)malloc(sizeof(char*) * (N + 1));
+  if (lengths == NULL || pool == NULL || values == NULL) {
+    panic("No memory");
+  }
+
+  bool ok = fread(lengths, sizeof(int), N, input) == (size_t)N &&
+            fread(pool, 1, header.poolBytes, input) ==
+                (size_t)header.poolBytes;
+  long offset = 0;
+  for (int code = 0; ok && code < N; code++) {
+    ok = (lengths[code] >= 0 && offset + lengths[code] < header.poolBytes &&
+          pool[offset + lengths[code]] == '\0');
+    values[code] = pool + offset;
+    offset += lengths[code] + 1;
+  }
+  fclose(input);
+
+  *dict = ok ? create(values, N) : NULL;
+  free(values);
+  free(pool);
+  free(lengths);
+  return ok;
+}
+
+//
+// a column's distinct values, as they are collected by build():
+//
+struct Builder
+{
+  int    col;       // 0-based column
+  int    N;
+  char** values;    // copies, in the order first seen
+  int*   lengths;
+  int*   slots;     // 2 * DICTIONARY_MAX_ENTRIES, stays at most 50% full
+  bool   tooMany;
+};
+
+//
+// collect
+//
+// Adds the value to the builder's distinct values unless it is one
+// of them already; gives up on the column once there are too many.
+//
+static void collect(struct Builder* b, char* value, int length) {
+  int s = slotOf(b->values, b->lengths, b->slots, 2 * DICTIONARY_MAX_ENTRIES,
+                 value, length);
+  if (b->slots[s] != -1) {
+    return;
+  }
+  if (b->N == DICTIONARY_MAX_ENTRIES) {
+    b->tooMany = true;
+    return;
+  }
+
+  b->values[b->N] = (char*)malloc(length + 1);
+  if (b->values[b->N] == NULL) {
+    panic("No memory");
+  }
+  memcpy(b->values[b->N], value, length);
+  b->values[b->N][length] = '\0';
+  b->lengths[b->N] = length;
+  b->slots[s] = b->N++;
+}
+
+//
+// build
+//
+// Collects the distinct values of the N given columns with one scan
+// of the table, into dicts[0..N-1], NULL for a column with too many.
+// Returns false if the table cannot be read.
+//
+static bool build(struct Database* db, struct TableMeta* table, int cols[],
+                  int N, struct Dictionary* dicts[]) {
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  int fd = open(datapath, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct Builder* builders = (struct Builder*)malloc(sizeof(struct Builder) * N);
+  char* buffer = (char*)malloc(table->recordSize + 1);
+  char** fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  int* fieldLengths = (int*)malloc(sizeof(int) * table->numColumns);
+  if (builders == NULL || buffer == NULL || fields == NULL ||
+      fieldLengths == NULL) {
+    panic("No memory");
+  }
+  for (int i = 0; i < N; i++) {
+    struct Builder* b = &builders[i];
+    b->col = cols[i];
+    b->N = 0;
+    b->values = (char**)malloc(sizeof(char*) * (DICTIONARY_MAX_ENTRIES + 1));
+    b->lengths = (int*)malloc(sizeof(int) * (DICTIONARY_MAX_ENTRIES + 1));
+    b->slots = (int*)malloc(sizeof(int) * 2 * DICTIONARY_MAX_ENTRIES);
+    b->tooMany = false;
+    if (b->values == NULL || b->lengths == NULL || b->slots == NULL) {
+      panic("No memory");
+    }
+    for (int s = 0; s < 2 * DICTIONARY_MAX_ENTRIES; s++) {
+      b->slots[s] = -1;
+    }
+  }
+
+  long numRecords = tablefile_numRecords(fd, table);
+  struct ReadAhead* ra =
+      readahead_start(fd, 0, (off_t)numRecords * table->recordSize,
+                      table->recordSize);
+
+  int numCollecting = N;  // columns not given up on
+  char* chunk;
+  long length;
+  while (numCollecting > 0 && (chunk = readahead_next(ra, &length)) != NULL) {
+    long numInChunk = length / table->recordSize;
+    for (long r = 0; numCollecting > 0 && r < numInChunk; r++) {
+      memcpy(buffer, chunk + r * table->recordSize, table->recordSize);
+      buffer[table->recordSize] = '\0';
+      if (tablefile_isDeleted(buffer) ||
+          fieldparse_split(buffer, fields, fieldLengths, table->numColumns) <
+              table->numColumns) {
+        continue;
+      }
+
+      for (int i = 0; i < N; i++) {
+        struct Builder* b = &builders[i];
+        if (!b->tooMany) {
+          collect(b, fields[b->col], fieldLengths[b->col]);
+          numCollecting -= b->tooMany;
+        }
+      }
+    }
+  }
+  readahead_finish(ra, NULL);
+  close(fd);
+
+  for (int i = 0; i < N; i++) {
+    struct Builder* b = &builders[i];
+    dicts[i] = b->tooMany ? NULL : create(b->values, b->N);
+
+    for (int v = 0; v < b->N; v++) {
+      free(b->values[v]);
+    }
+    free(b->slots);
+    free(b->lengths);
+    free(b->values);
+  }
+  free(fieldLengths);
+  free(fields);
+  free(buffer);
+  free(builders);
+  return true;
+}
+
+struct Dictionary* dictionary_open(struct Database* db,
+                                   struct TableMeta* table,
+                                   struct ColumnMeta* column) {
+  if (column->colType != COL_TYPE_STRING) {
+    return NULL;
+  }
+
+  struct Dictionary* dict = NULL;
+  if (!load(db, table, column, &dict)) {
+    int col = (int)(column - table->columns);
+    if (!build(db, table, &col, 1, &dict)) {
+      return NULL;
+    }
+    save(db, table, column, dict);
+  }
+  return dict;
+}
+
+void dictionary_openAll(struct Database* db, struct TableMeta* table,
+                        struct Dictionary* dicts[]) {
+  int* cols = (int*)malloc(sizeof(int) * (table->numColumns + 1));
+  struct Dictionary** built = (struct Dictionary**)malloc(
+      sizeof(struct Dictionary*) * (table->numColumns + 1));
+  if (cols == NULL || built == NULL) {
+    panic("No memory");
+  }
+
+  // load the ones that are up to date; the others are built together
+  int N = 0;
+  for (int j = 0; j < table->numColumns; j++) {
+    dicts[j] = NULL;
+    if (table->columns[j].colType == COL_TYPE_STRING &&
+        !load(db, table, &table->columns[j], &dicts[j])) {
+      cols[N++] = j;
+    }
+  }
+
+  if (N > 0 && build(db, table, cols, N, built)) {
+    for (int i = 0; i < N; i++) {
+      dicts[cols[i]] = built[i];
+      save(db, table, &table->columns[cols[i]], built[i]);
+    }
+  }
+
+  free(built);
+  free(cols);
+}
+
+bool dictionary_load(struct Database* db, struct TableMeta* table,
+                     struct ColumnMeta* column, struct Dictionary** dict) {
+  *dict = NULL;
+  if (column->colType != COL_TYPE_STRING) {
+    return false;
+  }
+  return load(db, table, column, dict);
+}
+
+struct Dictionary* dictionary_add(struct Dictionary* dict, char* values[],
+                                  long N) {
+  if (dict == NULL) {
+    return NULL;
+  }
+
+  //
+  // codes are positions in the sorted entries, and only ever held in
+  // memory, so new values are merged in and the codes renumbered;
+  // the hash table finds the values that are new
+  //
+  char** merged = NULL;
+  int numMerged = dict->numEntries;
+  int* slots = NULL;
+  int capacity = 2 * DICTIONARY_MAX_ENTRIES;
+
+  for (long i = 0; i < N; i++) {
+    int length = (int)strlen(values[i]);
+    if (dictionary_find(dict, values[i], length) != -1) {
+      continue;
+    }
+
+    if (merged == NULL) {
+      merged = (char**)malloc(sizeof(char*) * (DICTIONARY_MAX_ENTRIES + 1));
+      slots = (int*)malloc(sizeof(int) * capacity);
+      if (merged == NULL || slots == NULL) {
+        panic("No memory");
+      }
+      memcpy(merged, dict->entries, sizeof(char*) * dict->numEntries);
+      for (int s = 0; s < capacity; s++) {
+        slots[s] = -1;
+      }
+    }
+
+    // the same new value may come more than once
+    int s = (int)(hash(values[i], length) & (capacity - 1));
+    while (slots[s] != -1 && strcmp(merged[slots[s]], values[i]) != 0) {
+      s = (s + 1) & (capacity - 1);
+    }
+    if (slots[s] != -1) {
+      continue;
+    }
+    if (numMerged == DICTIONARY_MAX_ENTRIES) {
+      free(slots);
+      free(merged);
+      dictionary_close(dict);
+      return NULL;  // too many distinct values now
+    }
+    slots[s] = numMerged;
+    merged[numMerged++] = values[i];
+  }
+
+  if (merged == NULL) {
+    return dict;  // nothing new
+  }
+
+  struct Dictionary* extended = create(merged, numMerged);
+  free(slots);
+  free(merged);
+  dictionary_close(dict);
+  return extended;
+}
+
+bool dictionary_save(struct Database* db, struct TableMeta* table,
+                     struct ColumnMeta* column, struct Dictionary* dict) {
+  return save(db, table, column, dict);
+}
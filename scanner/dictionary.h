@@ -0,0 +1,126 @@
+/*dictionary.h*/
+
+//
+// Dictionary encoding for low-cardinality string columns: the
+// distinct values of the column, sorted, so that a value can be
+// stored as its position in the dictionary, its code. Codes compare
+// the way strcmp() compares the values, so equality and range
+// predicates become integer comparisons on codes, and a code is a
+// shorter group key than the string.
+//
+// A column's dictionary is saved in a sidecar file next to the
+// table's data file, <table>.<column>.dict, and rebuilt by a scan of
+// the table when missing or older than the data; the dictionaries of
+// all of a table's string columns are rebuilt in the same scan.
+// Writers keep a dictionary that was up to date before the write up
+// to date, adding the values they write. A column with more than
+// DICTIONARY_MAX_ENTRIES distinct values is not encoded.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "database.h"
+
+#define DICTIONARY_MAX_ENTRIES 4096
+
+struct Dictionary
+{
+  int    numEntries;
+  char** entries;   // sorted; entries[code], '\0'-terminated
+  int*   lengths;   // lengths[code]
+  char*  pool;      // the strings
+  int    capacity;  // hash slots, always a power of 2
+  int*   slots;     // code of the value hashed there, -1 => empty
+};
+
+
+//
+// functions:
+//
+
+//
+// dictionary_open
+//
+// Returns the dictionary of a string column, building it if need
+// be, or NULL if the column is not a string column, has too many
+// distinct values, or the table cannot be read.
+//
+// NOTE: it is the callers responsibility to free the dictionary by
+// calling dictionary_close().
+//
+struct Dictionary* dictionary_open(struct Database* db,
+                                   struct TableMeta* table,
+                                   struct ColumnMeta* column);
+
+//
+// dictionary_openAll
+//
+// Sets dicts[j] to the dictionary of column j for every column of the
+// table, as dictionary_open() does, but builds all the ones that need
+// building with a single scan of the table.
+//
+// NOTE: it is the callers responsibility to free each dictionary by
+// calling dictionary_close().
+//
+void dictionary_openAll(struct Database* db, struct TableMeta* table,
+                        struct Dictionary* dicts[]);
+
+//
+// dictionary_load
+//
+// Reads the dictionary of a string column if it is up to date with
+// the data file, without building it: sets *dict, to NULL if the
+// column has too many distinct values to be encoded, and returns
+// true. Returns false if the dictionary would have to be rebuilt.
+//
+bool dictionary_load(struct Database* db, struct TableMeta* table,
+                     struct ColumnMeta* column, struct Dictionary** dict);
+
+//
+// dictionary_add
+//
+// Returns the dictionary with the N values ('\0'-terminated) added,
+// which renumbers the codes, or NULL if the column now has too many
+// distinct values; dict is freed, or returned if none is new. Returns
+// NULL if dict is NULL.
+//
+struct Dictionary* dictionary_add(struct Dictionary* dict, char* values[],
+                                  long N);
+
+//
+// dictionary_save
+//
+// Writes the dictionary of the column, or the marker that it is not
+// encoded if dict is NULL, which makes it up to date with the data
+// file. Returns false if it cannot be written.
+//
+bool dictionary_save(struct Database* db, struct TableMeta* table,
+                     struct ColumnMeta* column, struct Dictionary* dict);
+
+//
+// dictionary_close
+//
+void dictionary_close(struct Dictionary* dict);
+
+//
+// dictionary_find
+//
+// Returns the code of the value, of the given length, or -1 if it is
+// not in the dictionary.
+//
+int dictionary_find(struct Dictionary* dict, char* value, int length);
+
+//
+// dictionary_range
+//
+// Sets [*lo, *hi) to the codes of the entries equal to value: *lo
+// is the code of the first entry >= value and *hi of the first entry
+// > value, so *lo == *hi if the value is not in the dictionary.
+//
+void dictionary_range(struct Dictionary* dict, char* value, int* lo, int* hi);
@@ -0,0 +1,712 @@
+/*encode.c*/
+
+//
+// Result output formats for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ast.h"
+#include "colresult.h"
+#include "database.h"
+#include "encode.h"
+#include "resultset.h"
+#include "util.h"
+
+//
+// where the rows come from: a ResultSet, rows 1..numRows, or the
+// live rows of a ColumnarResult:
+//
+struct Source
+{
+  int    numCols;
+  char** names;   // owned, e.g. "max_rating"
+  int*   types;   // COL_TYPE_*
+  struct ResultSet*      rs;
+  struct ColumnarResult* cr;
+  int*   columns; // the columns of cr, by position
+  long   next;    // the next row of rs, or word of cr's bitmap
+  unsigned long bits;  // the bits of word next - 1 not yet visited
+  char*  string;  // the last string copied out of rs
+};
+
+//
+// the chunk being formatted; written out whenever the next value
+// would not fit:
+//
+struct Writer
+{
+  char* chunk;
+  long  length;
+  long  total;    // bytes written so far, for padding
+};
+
+
+static void writer_flush(struct Writer* w) {
+  if (w->length > 0) {
+    fwrite(w->chunk, 1, w->length, stdout);
+    w->length = 0;
+  }
+}
+
+static void writer_put(struct Writer* w, void* bytes, long length) {
+  w->total += length;
+  if (w->length + length > ENCODE_CHUNK_BYTES) {
+    writer_flush(w);
+  }
+  // a buffer at least as big as a chunk goes out as is, not copied:
+  if (length >= ENCODE_CHUNK_BYTES) {
+    fwrite(bytes, 1, length, stdout);
+    return;
+  }
+  memcpy(w->chunk + w->length, bytes, length);
+  w->length += length;
+}
+
+static void writer_pad(struct Writer* w) {
+  static char zeros[8];
+  long padding = (8 - w->total % 8) % 8;
+  writer_put(w, zeros, padding);
+}
+
+static void writer_putInt32(struct Writer* w, int32_t value) {
+  writer_put(w, &value, sizeof(value));
+}
+
+static void writer_putInt64(struct Writer* w, int64_t value) {
+  writer_put(w, &value, sizeof(value));
+}
+
+//
+// writer_putBuffer
+//
+// An arrow buffer: its length, its bytes, and padding to 8 bytes.
+//
+static void writer_putBuffer(struct Writer* w, void* bytes, long length) {
+  writer_putInt64(w, length);
+  writer_put(w, bytes, length);
+  writer_pad(w);
+}
+
+
+//
+// columnName
+//
+// Name of a result column in the output, after its function the way
+// SELECT ... INTO names the columns it creates, e.g. "max_rating".
+//
+static char* columnName(char* colName, int function) {
+  char* prefix = "";
+  switch (function) {
+    case MIN_FUNCTION:
+      prefix = "min_";
+      break;
+    case MAX_FUNCTION:
+      prefix = "max_";
+      break;
+    case SUM_FUNCTION:
+      prefix = "sum_";
+      break;
+    case AVG_FUNCTION:
+      prefix = "avg_";
+      break;
+    case COUNT_FUNCTION:
+      prefix = "count_";
+      break;
+  }
+
+  char* name = (char*)malloc(strlen(prefix) + strlen(colName) + 1);
+  if (name == NULL) {
+    panic("No memory");
+  }
+  strcpy(name, prefix);
+  strcat(name, colName);
+  return name;
+}
+
+static void source_init(struct Source* src, int numCols) {
+  memset(src, 0, sizeof(*src));
+  src->numCols = numCols;
+  src->names = (char**)malloc(sizeof(char*) * (numCols + 1));
+  src->types = (int*)malloc(sizeof(int) * (numCols + 1));
+  if (src->names == NULL || src->types == NULL) {
+    panic("No memory");
+  }
+}
+
+static void source_free(struct Source* src) {
+  for (int k = 0; k < src->numCols; k++) {
+    free(src->names[k]);
+  }
+  free(src->names);
+  free(src->types);
+  free(src->string);
+}
+
+//
+// source_rows
+//
+// Fills rows[] with the next at most max rows of the source, and
+// returns how many; 0 at the end.
+//
+static long source_rows(struct Source* src, long rows[], long max) {
+  long n = 0;
+
+  if (src->rs != NULL) {
+    while (n < max && src->next <= src->rs->numRows) {
+      rows[n++] = src->next++;
+    }
+    return n;
+  }
+
+  while (n < max) {
+    while (src->bits == 0) {
+      if (src->next >= colresult_numWords(src->cr)) {
+        return n;
+      }
+      src->bits = src->cr->selection[src->next++];
+    }
+    rows[n++] = (src->next - 1) * COLRESULT_WORD_BITS +
+                __builtin_ctzl(src->bits);
+    src->bits &= src->bits - 1;
+  }
+  return n;
+}
+
+static int source_getInt(struct Source* src, long row, int k) {
+  if (src->rs != NULL) {
+    return resultset_getInt(src->rs, (int)row, k + 1);
+  }
+  return src->cr->columns[src->columns[k]].data.ints[row];
+}
+
+static double source_getReal(struct Source* src, long row, int k) {
+  if (src->rs != NULL) {
+    return resultset_getReal(src->rs, (int)row, k + 1);
+  }
+  return src->cr->columns[src->columns[k]].data.reals[row];
+}
+
+//
+// source_getString
+//
+// The string is valid until the next call.
+//
+static char* source_getString(struct Source* src, long row, int k,
+                              int* length) {
+  if (src->rs != NULL) {
+    free(src->string);
+    src->string = resultset_getString(src->rs, (int)row, k + 1);
+    *length = (int)strlen(src->string);
+    return src->string;
+  }
+  return colresult_getString(src->cr, row, src->columns[k], length);
+}
+
+//
+// a stream being written: its source, the chunk being formatted,
+// and the scratch buffers of its format, kept from batch to batch:
+//
+struct Encoder
+{
+  int    format;
+  struct Source src;
+  struct Writer w;
+  long*  rows;     // the rows of the batch being written
+  int*   types;    // ENCODE_TYPE_* of each column
+  struct ColVector** vectors;  // arrow: the columns of cr, else NULL
+  char*  row;      // binary: a row, built apart since its length
+  long   rowCapacity;          // comes first
+  char*  gathered; // arrow: values gathered from rows that are not
+                   // contiguous, string offsets and bytes
+  int32_t* offsets;
+  char** values;
+  int*   lengths;
+  char*  data;
+  long   capacity;
+};
+
+
+//
+// writeCsv
+//
+static void writeCsv(struct Encoder* enc, long n) {
+  struct Source* src = &enc->src;
+  struct Writer* w = &enc->w;
+  long* rows = enc->rows;
+
+  char number[32];
+  for (long i = 0; i < n; i++) {
+    for (int k = 0; k < src->numCols; k++) {
+      if (k > 0) {
+        writer_put(w, ",", 1);
+      }
+
+      if (src->types[k] == COL_TYPE_INT) {
+        int len = snprintf(number, sizeof(number), "%d",
+                           source_getInt(src, rows[i], k));
+        writer_put(w, number, len);
+      } else if (src->types[k] == COL_TYPE_REAL) {
+        int len = snprintf(number, sizeof(number), "%.17g",
+                           source_getReal(src, rows[i], k));
+        writer_put(w, number, len);
+      } else {
+        int length;
+        char* value = source_getString(src, rows[i], k, &length);
+
+        // quoted only if it has to be:
+        if (strcspn(value, ",\"\r\n") == (size_t)length) {
+          writer_put(w, value, length);
+          continue;
+        }
+        writer_put(w, "\"", 1);
+        for (int c = 0; c < length; c++) {
+          if (value[c] == '"') {
+            writer_put(w, "\"", 1);
+          }
+          writer_put(w, &value[c], 1);
+        }
+        writer_put(w, "\"", 1);
+      }
+    }
+    writer_put(w, "\n", 1);
+  }
+}
+
+//
+// writeSchema
+//
+// The schema of both binary formats.
+//
+static void writeSchema(struct Source* src, struct Writer* w, int types[]) {
+  writer_putInt32(w, src->numCols);
+  for (int k = 0; k < src->numCols; k++) {
+    int length = (int)strlen(src->names[k]);
+    writer_putInt32(w, types[k]);
+    writer_putInt32(w, length);
+    writer_put(w, src->names[k], length);
+  }
+}
+
+static int encodedType(int colType) {
+  if (colType == COL_TYPE_INT) {
+    return ENCODE_TYPE_INT32;
+  } else if (colType == COL_TYPE_REAL) {
+    return ENCODE_TYPE_FLOAT64;
+  } else {
+    return ENCODE_TYPE_UTF8;
+  }
+}
+
+//
+// writeBinary
+//
+static void writeBinary(struct Encoder* enc, long n) {
+  struct Source* src = &enc->src;
+  struct Writer* w = &enc->w;
+  long* rows = enc->rows;
+
+  for (long i = 0; i < n; i++) {
+    uint32_t length = 0;
+
+    for (int k = 0; k < src->numCols; k++) {
+      int32_t i32;
+      double f64;
+      char* value;
+      int32_t valueLength;
+      long needed;
+
+      if (src->types[k] == COL_TYPE_INT) {
+        i32 = source_getInt(src, rows[i], k);
+        value = (char*)&i32;
+        valueLength = sizeof(i32);
+        needed = sizeof(i32);
+      } else if (src->types[k] == COL_TYPE_REAL) {
+        f64 = source_getReal(src, rows[i], k);
+        value = (char*)&f64;
+        valueLength = sizeof(f64);
+        needed = sizeof(f64);
+      } else {
+        int len;
+        value = source_getString(src, rows[i], k, &len);
+        valueLength = len;
+        needed = sizeof(int32_t) + len;
+      }
+
+      if (length + needed > enc->rowCapacity) {
+        while (length + needed > enc->rowCapacity) {
+          enc->rowCapacity *= 2;
+        }
+        enc->row = (char*)realloc(enc->row, enc->rowCapacity);
+        if (enc->row == NULL) {
+          panic("No memory");
+        }
+      }
+
+      if (src->types[k] == COL_TYPE_STRING) {
+        memcpy(enc->row + length, &valueLength, sizeof(valueLength));
+        length += sizeof(valueLength);
+      }
+      memcpy(enc->row + length, value, valueLength);
+      length += valueLength;
+    }
+
+    writer_put(w, &length, sizeof(length));
+    writer_put(w, enc->row, length);
+  }
+}
+
+//
+// writeStrings
+//
+// A utf8 array of n values, offsets then bytes, the bytes gathered
+// in *data (grown as need be).
+//
+static void writeStrings(struct Writer* w, int32_t offsets[], char** data,
+                         long* capacity, long n, char* values[],
+                         int lengths[]) {
+  offsets[0] = 0;
+  for (long i = 0; i < n; i++) {
+    if (offsets[i] + lengths[i] > *capacity) {
+      while (offsets[i] + lengths[i] > *capacity) {
+        *capacity *= 2;
+      }
+      *data = (char*)realloc(*data, *capacity);
+      if (*data == NULL) {
+        panic("No memory");
+      }
+    }
+    memcpy(*data + offsets[i], values[i], lengths[i]);
+    offsets[i + 1] = offsets[i] + lengths[i];
+  }
+
+  writer_putBuffer(w, offsets, sizeof(int32_t) * (n + 1));
+  writer_putBuffer(w, *data, offsets[n]);
+}
+
+//
+// writeArrow
+//
+// One record batch of n rows.
+//
+static void writeArrow(struct Encoder* enc, long n) {
+  struct Source* src = &enc->src;
+  struct Writer* w = &enc->w;
+  long* rows = enc->rows;
+  int* types = enc->types;
+  struct ColVector** vectors = enc->vectors;
+
+  bool contiguous = (rows[n - 1] - rows[0] + 1 == n);
+
+  writer_putInt64(w, n);
+  for (int k = 0; k < src->numCols; k++) {
+    if (types[k] == ENCODE_TYPE_UTF8) {
+      //
+      // the values point into the result until the next string is
+      // copied out of a result set, so those are gathered first:
+      //
+      for (long i = 0; i < n; i++) {
+        enc->values[i] = source_getString(src, rows[i], k, &enc->lengths[i]);
+        if (src->rs != NULL) {
+          enc->values[i] = strdup(enc->values[i]);
+          if (enc->values[i] == NULL) {
+            panic("No memory");
+          }
+        }
+      }
+      writeStrings(w, enc->offsets, &enc->data, &enc->capacity, n,
+                   enc->values, enc->lengths);
+      if (src->rs != NULL) {
+        for (long i = 0; i < n; i++) {
+          free(enc->values[i]);
+        }
+      }
+      continue;
+    }
+
+    int size = (types[k] == ENCODE_TYPE_FLOAT64) ? sizeof(double)
+                                                  : sizeof(int32_t);
+
+    //
+    // a run of contiguous rows of a columnar result is a slice of
+    // the column's vector, which is written as is:
+    //
+    if (vectors[k] != NULL && contiguous) {
+      char* vector = (types[k] == ENCODE_TYPE_FLOAT64)
+                         ? (char*)vectors[k]->data.reals
+                         : (char*)vectors[k]->data.ints;
+      writer_putBuffer(w, vector + rows[0] * size, n * size);
+      continue;
+    }
+
+    for (long i = 0; i < n; i++) {
+      if (types[k] == ENCODE_TYPE_FLOAT64) {
+        ((double*)enc->gathered)[i] = source_getReal(src, rows[i], k);
+      } else if (types[k] == ENCODE_TYPE_DICTIONARY) {
+        ((int32_t*)enc->gathered)[i] = vectors[k]->data.codes[rows[i]];
+      } else {
+        ((int32_t*)enc->gathered)[i] = source_getInt(src, rows[i], k);
+      }
+    }
+    writer_putBuffer(w, enc->gathered, n * size);
+  }
+}
+
+//
+// encoder_start
+//
+// Writes the start of the stream, up to its first row: the header
+// line, or the magic, schema and, in the arrow format, the
+// dictionaries. The names and types of the source must be set.
+//
+static void encoder_start(struct Encoder* enc) {
+  struct Source* src = &enc->src;
+  struct Writer* w = &enc->w;
+  int N = src->numCols;
+
+  w->chunk = (char*)malloc(ENCODE_CHUNK_BYTES);
+  w->length = 0;
+  w->total = 0;
+  enc->rows = (long*)malloc(sizeof(long) * ENCODE_BATCH_ROWS);
+  enc->types = (int*)malloc(sizeof(int) * (N + 1));
+  if (w->chunk == NULL || enc->rows == NULL || enc->types == NULL) {
+    panic("No memory");
+  }
+
+  if (enc->format == ENCODE_CSV) {
+    for (int k = 0; k < N; k++) {
+      if (k > 0) {
+        writer_put(w, ",", 1);
+      }
+      writer_put(w, src->names[k], strlen(src->names[k]));
+    }
+    writer_put(w, "\n", 1);
+    return;
+  }
+
+  if (enc->format == ENCODE_BINARY) {
+    for (int k = 0; k < N; k++) {
+      enc->types[k] = encodedType(src->types[k]);
+    }
+    writer_put(w, "SQLROWS1", 8);
+    writeSchema(src, w, enc->types);
+
+    enc->rowCapacity = 256;
+    enc->row = (char*)malloc(enc->rowCapacity);
+    if (enc->row == NULL) {
+      panic("No memory");
+    }
+    return;
+  }
+
+  enc->vectors =
+      (struct ColVector**)malloc(sizeof(struct ColVector*) * (N + 1));
+  if (enc->vectors == NULL) {
+    panic("No memory");
+  }
+  for (int k = 0; k < N; k++) {
+    enc->vectors[k] =
+        (src->cr != NULL) ? &src->cr->columns[src->columns[k]] : NULL;
+    enc->types[k] = encodedType(src->types[k]);
+    if (enc->vectors[k] != NULL && enc->vectors[k]->dict != NULL) {
+      enc->types[k] = ENCODE_TYPE_DICTIONARY;
+    }
+  }
+
+  writer_put(w, "SQLARRW1", 8);
+  writeSchema(src, w, enc->types);
+  writer_pad(w);
+
+  enc->gathered = (char*)malloc(sizeof(double) * ENCODE_BATCH_ROWS);
+  enc->offsets =
+      (int32_t*)malloc(sizeof(int32_t) * (DICTIONARY_MAX_ENTRIES +
+                                          ENCODE_BATCH_ROWS + 1));
+  enc->values = (char**)malloc(sizeof(char*) * (DICTIONARY_MAX_ENTRIES +
+                                                ENCODE_BATCH_ROWS));
+  enc->lengths =
+      (int*)malloc(sizeof(int) * (DICTIONARY_MAX_ENTRIES + ENCODE_BATCH_ROWS));
+  enc->capacity = 64 * 1024;
+  enc->data = (char*)malloc(enc->capacity);
+  if (enc->gathered == NULL || enc->offsets == NULL || enc->values == NULL ||
+      enc->lengths == NULL || enc->data == NULL) {
+    panic("No memory");
+  }
+
+  for (int k = 0; k < N; k++) {
+    if (enc->types[k] == ENCODE_TYPE_DICTIONARY) {
+      struct Dictionary* dict = enc->vectors[k]->dict;
+      writer_putInt64(w, dict->numEntries);
+      writeStrings(w, enc->offsets, &enc->data, &enc->capacity,
+                   dict->numEntries, dict->entries, dict->lengths);
+    }
+  }
+}
+
+//
+// encoder_write
+//
+// Writes the rows of the source not yet written, a batch at a time.
+//
+static void encoder_write(struct Encoder* enc) {
+  long n;
+  while ((n = source_rows(&enc->src, enc->rows, ENCODE_BATCH_ROWS)) > 0) {
+    if (enc->format == ENCODE_CSV) {
+      writeCsv(enc, n);
+    } else if (enc->format == ENCODE_BINARY) {
+      writeBinary(enc, n);
+    } else {
+      writeArrow(enc, n);
+    }
+  }
+}
+
+//
+// encoder_finish
+//
+// Ends the stream, writes out what is left of the chunk, and frees
+// the encoder's buffers; the source is the caller's.
+//
+static void encoder_finish(struct Encoder* enc) {
+  struct Writer* w = &enc->w;
+
+  if (enc->format == ENCODE_BINARY) {
+    uint32_t end = 0;
+    writer_put(w, &end, sizeof(end));
+  } else if (enc->format == ENCODE_ARROW) {
+    writer_putInt64(w, 0);
+  }
+  writer_flush(w);
+
+  free(w->chunk);
+  free(enc->rows);
+  free(enc->types);
+  free(enc->vectors);
+  free(enc->row);
+  free(enc->gathered);
+  free(enc->offsets);
+  free(enc->values);
+  free(enc->lengths);
+  free(enc->data);
+}
+
+//
+// encoder_init
+//
+// An encoder of the format over a source of numCols columns, whose
+// names and types the caller then sets.
+//
+static void encoder_init(struct Encoder* enc, int format, int numCols) {
+  memset(enc, 0, sizeof(*enc));
+  enc->format = format;
+  source_init(&enc->src, numCols);
+}
+
+//
+// encoder_setColumns
+//
+// Names and types the source's columns after those of the result set.
+//
+static void encoder_setColumns(struct Encoder* enc, struct ResultSet* rs) {
+  int k = 0;
+  for (struct RSColumn* c = rs->columns; c != NULL; c = c->next, k++) {
+    enc->src.names[k] = columnName(c->colName, c->function);
+    enc->src.types[k] = c->coltype;
+  }
+}
+
+
+int encode_format(void) {
+  char* format = getenv("SIMPLESQL_FORMAT");
+  if (format == NULL) {
+    return ENCODE_TEXT;
+  } else if (strcasecmp(format, "csv") == 0) {
+    return ENCODE_CSV;
+  } else if (strcasecmp(format, "binary") == 0) {
+    return ENCODE_BINARY;
+  } else if (strcasecmp(format, "arrow") == 0) {
+    return ENCODE_ARROW;
+  } else {
+    return ENCODE_TEXT;
+  }
+}
+
+void encode_resultSet(struct ResultSet* rs) {
+  int format = encode_format();
+  if (format == ENCODE_TEXT) {
+    resultset_print(rs);
+    return;
+  }
+
+  struct Encoder enc;
+  encoder_init(&enc, format, rs->numCols);
+  encoder_setColumns(&enc, rs);
+  enc.src.rs = rs;
+  enc.src.next = 1;
+
+  encoder_start(&enc);
+  encoder_write(&enc);
+  encoder_finish(&enc);
+  source_free(&enc.src);
+}
+
+void encode_columns(struct ColumnarResult* cr, int columns[], int N) {
+  int format = encode_format();
+  if (format == ENCODE_TEXT) {
+    panic("encode_columns called for the text format");
+  }
+
+  struct Encoder enc;
+  encoder_init(&enc, format, N);
+  enc.src.cr = cr;
+  enc.src.columns = columns;
+
+  for (int k = 0; k < N; k++) {
+    struct ColVector* column = &cr->columns[columns[k]];
+    enc.src.names[k] = columnName(column->colName, NO_FUNCTION);
+    enc.src.types[k] = column->colType;
+  }
+
+  encoder_start(&enc);
+  encoder_write(&enc);
+  encoder_finish(&enc);
+  source_free(&enc.src);
+}
+
+struct Encoder* encode_begin(struct ResultSet* rs) {
+  int format = encode_format();
+  if (format == ENCODE_TEXT) {
+    panic("encode_begin called for the text format");
+  }
+
+  struct Encoder* enc = (struct Encoder*)malloc(sizeof(struct Encoder));
+  if (enc == NULL) {
+    panic("No memory");
+  }
+  encoder_init(enc, format, rs->numCols);
+  encoder_setColumns(enc, rs);
+
+  encoder_start(enc);
+  return enc;
+}
+
+void encode_rows(struct Encoder* enc, struct ResultSet* rs) {
+  enc->src.rs = rs;
+  enc->src.next = 1;
+  encoder_write(enc);
+  enc->src.rs = NULL;
+}
+
+void encode_end(struct Encoder* enc) {
+  encoder_finish(enc);
+  source_free(&enc->src);
+  free(enc);
+}
@@ -0,0 +1,124 @@
+/*encode.h*/
+
+//
+// Result output formats for SimpleSQL. Besides the text printed by
+// resultset_print(), a result can be written for programs to read,
+// selected by the environment variable SIMPLESQL_FORMAT:
+//
+// "csv": a header line of column names, then one line per row;
+// a string is quoted, with its quotes doubled, only if it contains a
+// comma, quote or line break, and reals are written with 17
+// significant digits, so they read back exactly.
+//
+// "binary": length-prefixed rows. The stream starts with the magic
+// "SQLROWS1" and the schema, then each row is its length in bytes
+// (uint32) followed by its values: int32, float64, or a string as
+// its length (int32) and bytes. A length of 0 ends the stream.
+//
+// "arrow": columnar record batches in the Arrow memory layout, so a
+// reader can wrap the buffers as arrays without parsing or copying.
+// The stream starts with the magic "SQLARRW1" and the schema, then
+// the dictionary (an utf8 array) of every dictionary-encoded column,
+// then batches of at most ENCODE_BATCH_ROWS rows: the number of rows
+// (int64, 0 ends the stream) and each column's buffers: the values
+// (int32, float64, or the int32 indices into the dictionary), or for
+// a utf8 column the int32 offsets, numRows + 1 of them, and the
+// bytes. Every buffer is preceded by its length in bytes (int64) and
+// padded to a multiple of 8 bytes; columns have no nulls, so there
+// are no validity buffers.
+//
+// The schema, in both binary formats: the number of columns (int32)
+// and per column its type (int32, ENCODE_TYPE_*) and name, as its
+// length (int32) and bytes, padded to 8 bytes in the arrow format.
+// Numbers are in the byte order of the machine, little-endian on
+// x86 and ARM.
+//
+// Output is formatted a chunk of ENCODE_CHUNK_BYTES at a time, so a
+// large result is never formatted in memory all at once; arrow
+// batches of rows that are contiguous in a columnar result are
+// written straight from its column vectors. A result produced a
+// batch of rows at a time can be written as it is produced, by
+// encode_begin(), encode_rows() and encode_end(), so it is never
+// held in memory all at once either.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include "colresult.h"
+#include "resultset.h"
+
+#define ENCODE_TEXT   0
+#define ENCODE_CSV    1
+#define ENCODE_BINARY 2
+#define ENCODE_ARROW  3
+
+#define ENCODE_TYPE_INT32      1
+#define ENCODE_TYPE_FLOAT64    2
+#define ENCODE_TYPE_UTF8       3
+#define ENCODE_TYPE_DICTIONARY 4  // int32 indices into a utf8 dictionary
+
+#define ENCODE_CHUNK_BYTES (256 * 1024)
+#define ENCODE_BATCH_ROWS  (64 * 1024)
+
+struct Encoder;  // opaque
+
+
+//
+// functions:
+//
+
+//
+// encode_format
+//
+// Returns the format selected by SIMPLESQL_FORMAT, ENCODE_TEXT if it
+// is not set or not one of "csv", "binary" or "arrow".
+//
+int encode_format(void);
+
+//
+// encode_resultSet
+//
+// Writes the result set to stdout in the selected format; in the
+// text format, by resultset_print().
+//
+void encode_resultSet(struct ResultSet* rs);
+
+//
+// encode_columns
+//
+// Writes the live rows of the given columns of the columnar result,
+// columns[0..N-1] in that order, to stdout in the selected format,
+// which must not be ENCODE_TEXT, without first copying them into a
+// result set. A column with a dictionary is written in the arrow
+// format as ENCODE_TYPE_DICTIONARY.
+//
+void encode_columns(struct ColumnarResult* cr, int columns[], int N);
+
+//
+// encode_begin
+//
+// Starts writing a result to stdout in the selected format, which
+// must not be ENCODE_TEXT: writes the start of the stream, with the
+// columns of the result set, and returns the encoder of its rows.
+//
+struct Encoder* encode_begin(struct ResultSet* rs);
+
+//
+// encode_rows
+//
+// Writes all the rows of the result set, which has the columns the
+// stream was started with; the result set can then be emptied or
+// destroyed, and the next rows written from another.
+//
+void encode_rows(struct Encoder* enc, struct ResultSet* rs);
+
+//
+// encode_end
+//
+// Ends the stream and frees the encoder.
+//
+void encode_end(struct Encoder* enc);
@@ -0,0 +1,404 @@
+/*explain.c*/
+
+//
+// EXPLAIN for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "database.h"
+#include "explain.h"
+#include "index.h"
+#include "matview.h"
+#include "sample.h"
+#include "scan.h"
+#include "schemamap.h"
+#include "stats.h"
+#include "zonemap.h"
+
+static char* opers[] = {"<", "<=", ">", ">=", "=", "<>", "like"};
+
+static char* functions[] = {"", "MIN", "MAX", "SUM", "AVG", "COUNT"};
+
+//
+// fixed selectivities (fraction of rows that qualify) by operator,
+// used when neither an index, the statistics nor the zone map can
+// tell:
+//
+static double defaultSelectivity[] = {1.0 / 3, 1.0 / 3, 1.0 / 3, 1.0 / 3,
+                                      0.1,     0.9,     0.1};
+
+#define EXPLAIN_MAX_STEPS 8
+#define EXPLAIN_LINE      256
+
+bool explain_enabled(void) {
+  return getenv("SIMPLESQL_EXPLAIN") != NULL;
+}
+
+//
+// indexSelectivity
+//
+// Fraction of the index entries that satisfy the comparison; the
+// index is sorted, so this is exact.
+//
+static double indexSelectivity(struct Index* index, int oper, char* value) {
+  if (index->numEntries == 0) {
+    return 0;
+  }
+
+  long lo = index_lowerBound(index, value);  // first entry >= value
+  long hi = index_upperBound(index, value);  // first entry > value
+  long N = index->numEntries;
+  long count;
+
+  switch (oper) {
+    case EXPR_LT:
+      count = lo;
+      break;
+    case EXPR_LTE:
+      count = hi;
+      break;
+    case EXPR_GT:
+      count = N - hi;
+      break;
+    case EXPR_GTE:
+      count = N - lo;
+      break;
+    case EXPR_EQUAL:
+      count = hi - lo;
+      break;
+    default:  // <>
+      count = N - (hi - lo);
+      break;
+  }
+  return (double)count / N;
+}
+
+//
+// zoneFraction
+//
+// Estimated fraction of the n records of a zone, whose values lie
+// in [min, max], that satisfy "value <oper> v", assuming the values
+// are spread evenly over the zone.
+//
+static double zoneFraction(struct ZoneEntry* zone, long n, bool isInt,
+                           int oper, double v) {
+  double width = zone->max - zone->min;
+  double f;
+
+  if (zone->min > zone->max) {
+    return defaultSelectivity[oper];  // no numeric values recorded
+  }
+
+  switch (oper) {
+    case EXPR_LT:
+    case EXPR_LTE:
+      if (width == 0) {
+        return (zone->min < v || (oper == EXPR_LTE && zone->min == v)) ? 1 : 0;
+      }
+      f = (v - zone->min) / width;
+      break;
+    case EXPR_GT:
+    case EXPR_GTE:
+      if (width == 0) {
+        return (zone->max > v || (oper == EXPR_GTE && zone->max == v)) ? 1 : 0;
+      }
+      f = (zone->max - v) / width;
+      break;
+    default:  // = and <>
+      if (v < zone->min || v > zone->max) {
+        f = 0;
+      } else if (width == 0) {
+        f = 1;
+      } else {
+        f = isInt ? 1 / (width + 1) : 1.0 / n;  // reals: assume distinct
+      }
+      if (oper == EXPR_NOT_EQUAL) {
+        f = 1 - f;
+      }
+      break;
+  }
+  return (f < 0) ? 0 : (f > 1) ? 1 : f;
+}
+
+//
+// estimateSelectivity
+//
+// Estimated fraction of the table's records that satisfy the WHERE
+// clause; *source is set to where the estimate comes from.
+//
+static double estimateSelectivity(struct Database* db,
+                                  struct TableMeta* table,
+                                  struct WHERE* where, struct ScanPlan* plan,
+                                  char** source) {
+  if (where == NULL) {
+    *source = "no WHERE clause";
+    return 1;
+  }
+
+  int oper = where->expr->operator;
+  struct ColumnMeta* column =
+      database_findColumn(table, where->expr->column->name);
+  assert(column != NULL);
+
+  // a LIKE index range holds every match, plus the keys with the
+  // right prefix that the rest of the pattern rejects
+  if (plan->path == SCAN_INDEX) {
+    *source = "index range";
+    return (plan->numRecords > 0)
+               ? (double)plan->numCandidates / plan->numRecords
+               : 0;
+  }
+
+  if (oper != EXPR_LIKE && column->indexType != COL_NON_INDEXED) {
+    struct Index* index = index_open(db, table, column);
+    if (index != NULL) {
+      double selectivity = indexSelectivity(index, oper, where->expr->value);
+      index_close(index);
+      *source = "index";
+      return selectivity;
+    }
+  }
+
+  double selectivity =
+      stats_selectivity(table, column, oper, where->expr->value);
+  if (selectivity >= 0) {
+    *source = "statistics";
+    return selectivity;
+  }
+
+  if (oper != EXPR_LIKE &&
+      (column->colType == COL_TYPE_INT || column->colType == COL_TYPE_REAL) &&
+      plan->numRecords > 0) {
+    struct ZoneMap* zm = zonemap_open(db, table);
+    if (zm != NULL) {
+      int colIndex = (int)(column - table->columns);
+      bool isInt = (column->colType == COL_TYPE_INT);
+      double v = isInt ? atoi(where->expr->value) : atof(where->expr->value);
+      double matches = 0;
+
+      for (long first = 0, b = 0; first < plan->numRecords;
+           first += zm->blockRecords, b++) {
+        long n = plan->numRecords - first;
+        if (n > zm->blockRecords) {
+          n = zm->blockRecords;
+        }
+        if (b < zm->numBlocks) {
+          struct ZoneEntry* zone = &zm->entries[b * zm->numColumns + colIndex];
+          matches += n * zoneFraction(zone, n, isInt, oper, v);
+        } else {
+          matches += n * defaultSelectivity[oper];  // not covered yet
+        }
+      }
+      zonemap_close(zm);
+
+      *source = "zone map";
+      return matches / plan->numRecords;
+    }
+  }
+
+  *source = "default selectivity";
+  return defaultSelectivity[oper];
+}
+
+//
+// columnList
+//
+// Formats the selected columns, e.g. "Movies.title, MAX(Movies.year)".
+//
+static void columnList(struct COLUMN* columns, char* list, int size) {
+  int length = 0;
+
+  list[0] = '\0';
+  for (struct COLUMN* c = columns; c != NULL && length < size; c = c->next) {
+    char* separator = (c == columns) ? "" : ", ";
+    if (c->function == NO_FUNCTION) {
+      length += snprintf(list + length, size - length, "%s%s.%s", separator,
+                         c->table, c->name);
+    } else {
+      length += snprintf(list + length, size - length, "%s%s(%s.%s)",
+                         separator, functions[c->function], c->table, c->name);
+    }
+  }
+}
+
+void explain_query(struct Database* db, struct QUERY* query) {
+  if (query->queryType != SELECT_QUERY) {
+    printf("**Error: Cannot explain this query\n");
+    return;
+  }
+
+  struct SELECT* select = query->q.select;
+  struct TableMeta* table = database_findTable(db, select->table);
+  assert(table != NULL);
+
+  struct ScanPlan plan;
+  if (!scan_plan(db, table, select->where, &plan)) {
+    printf("**Error: unable to read table '%s'\n", table->name);
+    return;
+  }
+
+  bool aggregate = !scan_isStreamable(select);
+  bool streamed = (select->into != NULL && !aggregate);
+  bool sampled = (aggregate && select->into == NULL && sample_enabled());
+  long numFolded =
+      (aggregate && select->into == NULL && !sampled && matview_enabled())
+          ? matview_numFolded(db, select, NULL)
+          : -1;
+  bool viewed = (numFolded >= 0);
+
+  char* source;
+  double selectivity =
+      estimateSelectivity(db, table, select->where, &plan, &source);
+  double liveFraction =
+      (plan.numRecords > 0)
+          ? (double)(plan.numRecords - plan.numDeleted) / plan.numRecords
+          : 0;
+
+  long scanned = (long)(plan.numCandidates * liveFraction + 0.5);
+  long rows = (long)(plan.numRecords * liveFraction * selectivity + 0.5);
+  if (sampled) {
+    // a uniform sample, whatever path the WHERE clause allows
+    long numSampled = sample_size(plan.numRecords);
+    double fraction =
+        (plan.numRecords > 0) ? (double)numSampled / plan.numRecords : 0;
+    plan.numCandidates = numSampled;
+    scanned = (long)(numSampled * liveFraction + 0.5);
+    rows = (long)(rows * fraction + 0.5);
+  }
+  if (rows > scanned) {
+    rows = scanned;
+  }
+
+  //
+  // the steps, from the scan up to the output:
+  //
+  char steps[EXPLAIN_MAX_STEPS][EXPLAIN_LINE];
+  int numSteps = 0;
+
+  if (sampled) {
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Sample %s: %ld of %ld records at random, in rounds doubling "
+             "from %d, est. %ld live rows",
+             table->name, plan.numCandidates, plan.numRecords,
+             SAMPLE_FIRST_ROUND, scanned);
+  } else if (viewed) {
+    // only the records appended since the view was last used are read
+    long numNew = (plan.numRecords > numFolded) ? plan.numRecords - numFolded
+                                                : 0;
+    scanned = (long)(numNew * liveFraction + 0.5);
+    rows = (long)(numNew * liveFraction * selectivity + 0.5);
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Scan %s: materialized view, folds in the %ld of %ld records "
+             "appended since, est. %ld live rows",
+             table->name, numNew, plan.numRecords, scanned);
+  } else if (plan.path == SCAN_FULL) {
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Scan %s: full, read-ahead, %ld records, est. %ld live rows",
+             table->name, plan.numRecords, scanned);
+  } else if (plan.path == SCAN_INDEX) {
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Scan %s: index range on %s LIKE prefix, %ld of %ld records, "
+             "est. %ld live rows",
+             table->name, select->where->expr->column->name,
+             plan.numCandidates, plan.numRecords, scanned);
+  } else {
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Scan %s: %s pruned, %ld of %ld blocks, %ld of %ld "
+             "records, est. %ld live rows",
+             table->name,
+             (select->where->expr->operator == EXPR_EQUAL)
+                 ? "zone map and Bloom filters"
+                 : "zone map",
+             plan.numBlocksRead, plan.numBlocks, plan.numCandidates,
+             plan.numRecords, scanned);
+  }
+
+  if (select->where != NULL) {
+    struct EXPR* expr = select->where->expr;
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Filter: %s.%s %s %s, %s, est. %ld rows (%s)", expr->column->table,
+             expr->column->name, opers[expr->operator], expr->value,
+             (streamed || sampled || viewed) ? "per record"
+                                   : "vectorized over the selection bitmap",
+             rows, source);
+  }
+
+  if (select->limit != NULL && !aggregate) {
+    if (rows > select->limit->N) {
+      rows = select->limit->N;
+    }
+    snprintf(steps[numSteps++], EXPLAIN_LINE, "Limit %d: %s, est. %ld rows",
+             select->limit->N,
+             streamed ? "stops the scan" : "trims the selection bitmap", rows);
+  }
+
+  char list[EXPLAIN_LINE / 2];
+  columnList(select->columns, list, sizeof(list));
+  if (!streamed && !sampled && !viewed) {
+    snprintf(steps[numSteps++], EXPLAIN_LINE, "Project: %s, est. %ld rows",
+             list, rows);
+  }
+
+  if (sampled) {
+    rows = 1;
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Aggregate: %s, estimated from the sample with %s confidence "
+             "intervals, est. 1 rows",
+             list, SAMPLE_CONFIDENCE);
+  } else if (viewed) {
+    rows = 1;
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Aggregate: %s, from the running state of the view, est. 1 rows",
+             list);
+  } else if (aggregate) {
+    rows = (rows > 0) ? 1 : 0;
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Aggregate: over the materialized rows, not streaming, est. %ld "
+             "rows",
+             rows);
+    if (select->limit != NULL) {
+      if (rows > select->limit->N) {
+        rows = select->limit->N;
+      }
+      snprintf(steps[numSteps++], EXPLAIN_LINE, "Limit %d: est. %ld rows",
+               select->limit->N, rows);
+    }
+  }
+
+  if (streamed) {
+    snprintf(steps[numSteps++], EXPLAIN_LINE,
+             "Insert into %s: %s, streamed a record at a time, est. %ld rows",
+             select->into->table, list, rows);
+  } else if (select->into != NULL) {
+    snprintf(steps[numSteps++], EXPLAIN_LINE, "Insert into %s: est. %ld rows",
+             select->into->table, rows);
+  } else {
+    snprintf(steps[numSteps++], EXPLAIN_LINE, "Print: est. %ld rows", rows);
+  }
+
+  printf("**QUERY PLAN**\n");
+  for (int i = numSteps - 1; i >= 0; i--) {
+    printf("%*s%s\n", 2 * (numSteps - 1 - i), "", steps[i]);
+  }
+
+  // parsed, but not evaluated by the executor:
+  if (select->join != NULL) {
+    printf("Join %s: not supported by the executor, ignored\n",
+           select->join->table);
+  }
+  if (select->orderby != NULL) {
+    printf("Order By %s.%s: not supported by the executor, ignored\n",
+           select->orderby->column->table, select->orderby->column->name);
+  }
+  printf("**END OF QUERY PLAN**\n");
+}
@@ -0,0 +1,44 @@
+/*explain.h*/
+
+//
+// EXPLAIN for SimpleSQL: prints the physical plan the executor will
+// run for a query, without running it. Set the environment variable
+// SIMPLESQL_EXPLAIN to have the program print plans instead of
+// executing queries.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "database.h"
+
+
+//
+// functions:
+//
+
+//
+// explain_enabled
+//
+// Returns true if SIMPLESQL_EXPLAIN is set.
+//
+bool explain_enabled(void);
+
+//
+// explain_query
+//
+// Prints the plan of the query, one step per line from the output
+// down to the table scan: how the table is read (full scan, index
+// range or zone map), how the WHERE clause, LIMIT and aggregates
+// are evaluated, and the estimated number of rows out of each step.
+// Estimates come from the index on the WHERE column when there is
+// one, then from the table's statistics (see stats.h) or its zone
+// map, and from fixed selectivities otherwise.
+//
+void explain_query(struct Database* db, struct QUERY* query);
@@ -0,0 +1,270 @@
+/*fieldparse.c*/
+
+//
+// Field parsing for SimpleSQL records.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#define _GNU_SOURCE  // strtod_l
+
+#include <float.h>
+#include <locale.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fieldparse.h"
+#include "util.h"
+
+int fieldparse_split(char* record, char* fields[], int lengths[],
+                     int maxFields) {
+  int numFields = 0;
+  char* cp = record;
+
+  while (numFields < maxFields) {
+    while (*cp == ' ') {
+      cp++;
+    }
+    if (*cp == '\0' || *cp == '\n') {
+      break;
+    }
+
+    char* start;
+    if (*cp == '\'' || *cp == '"') {
+      // string value: everything up to the matching quote
+      char quote = *cp++;
+      start = cp;
+      while (*cp != quote && *cp != '\0') {
+        cp++;
+      }
+    } else {
+      start = cp;
+      while (*cp != ' ' && *cp != '\n' && *cp != '\0') {
+        cp++;
+      }
+    }
+
+    char* end = cp;
+    if (*cp != '\0') {
+      cp++;
+    }
+    *end = '\0';
+
+    fields[numFields] = start;
+    if (lengths != NULL) {
+      lengths[numFields] = (int)(end - start);
+    }
+    numFields++;
+  }
+
+  return numFields;
+}
+
+//
+// loadWord
+//
+// Loads 8 chars into a word with the first char in the low byte.
+//
+static uint64_t loadWord(const char* s) {
+  uint64_t word;
+
+  memcpy(&word, s, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64(word);
+#endif
+  return word;
+}
+
+//
+// isEightDigits
+//
+// Returns true if every byte of the word is '0'..'9': the high
+// nibble must be 3, and adding 6 must not carry out of the low one.
+//
+static bool isEightDigits(uint64_t word) {
+  return ((word & 0xF0F0F0F0F0F0F0F0ull) |
+          (((word + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+         0x3333333333333333ull;
+}
+
+//
+// parseEightDigits
+//
+// Converts a word of 8 digits, the most significant in the low
+// byte, with three multiplies instead of a loop: pairs of digits
+// are combined into 2-digit values, then 4-digit, then 8-digit.
+//
+static uint32_t parseEightDigits(uint64_t word) {
+  word -= 0x3030303030303030ull;
+  word = (word * 10) + (word >> 8);
+  word = (((word & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+          (((word >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >>
+         32;
+  return (uint32_t)word;
+}
+
+static const uint64_t intPowersOf10[] = {1,      10,      100,     1000,
+                                         10000,  100000,  1000000, 10000000,
+                                         100000000};
+
+int fieldparse_int(const char* s, int length) {
+  const char* end = s + length;
+  bool negative = false;
+  uint64_t value = 0;
+
+  if (s < end && (*s == '-' || *s == '+')) {
+    negative = (*s == '-');
+    s++;
+  }
+
+  while (end - s >= 8) {
+    uint64_t word = loadWord(s);
+    if (!isEightDigits(word)) {
+      break;
+    }
+    value = value * 100000000 + parseEightDigits(word);
+    s += 8;
+  }
+
+  // 1 to 7 digits left: pad on the left with '0's to a whole word
+  int n = (int)(end - s);
+  if (n > 0 && n < 8) {
+    char padded[8];
+    memset(padded, '0', sizeof(padded));
+    memcpy(padded + 8 - n, s, n);
+
+    uint64_t word = loadWord(padded);
+    if (isEightDigits(word)) {
+      value = value * intPowersOf10[n] + parseEightDigits(word);
+      s = end;
+    }
+  }
+
+  // whatever is left contains a non-digit; convert up to it
+  while (s < end && *s >= '0' && *s <= '9') {
+    value = value * 10 + (*s - '0');
+    s++;
+  }
+
+  return negative ? (int)(0 - value) : (int)value;
+}
+
+//
+// the "C" locale, created on first use: strtod() follows the
+// program's locale, which may use ',' as the decimal point
+//
+static pthread_once_t cLocaleOnce = PTHREAD_ONCE_INIT;
+static locale_t cLocale;
+
+static void createCLocale(void) {
+  cLocale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+  if (cLocale == (locale_t)0) {
+    panic("unable to create the C locale");
+  }
+}
+
+//
+// parseSlow
+//
+// strtod_l() in the "C" locale over a null-terminated copy of the
+// field.
+//
+static double parseSlow(const char* s, int length) {
+  char local[64];
+  char* copy = local;
+
+  if (length >= (int)sizeof(local)) {
+    copy = (char*)malloc(length + 1);
+    if (copy == NULL) {
+      panic("No memory");
+    }
+  }
+  memcpy(copy, s, length);
+  copy[length] = '\0';
+
+  pthread_once(&cLocaleOnce, createCLocale);
+  double value = strtod_l(copy, NULL, cLocale);
+
+  if (copy != local) {
+    free(copy);
+  }
+  return value;
+}
+
+//
+// every power of 10 up to 1e22 is exactly representable as a double:
+//
+static const double powersOf10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+double fieldparse_real(const char* s, int length) {
+  const char* p = s;
+  const char* end = s + length;
+  bool negative = false;
+  uint64_t mantissa = 0;
+  int numDigits = 0;
+  int exponent = 0;
+
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    p++;
+  }
+
+  while (p < end && *p >= '0' && *p <= '9') {
+    mantissa = mantissa * 10 + (*p - '0');
+    numDigits++;
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      mantissa = mantissa * 10 + (*p - '0');
+      numDigits++;
+      exponent--;
+      p++;
+    }
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negativeExponent = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negativeExponent = (*p == '-');
+      p++;
+    }
+    int e = 0;
+    const char* digits = p;
+    while (p < end && *p >= '0' && *p <= '9' && e < 100000) {
+      e = e * 10 + (*p - '0');
+      p++;
+    }
+    if (p == digits) {
+      return parseSlow(s, length);
+    }
+    exponent += negativeExponent ? -e : e;
+  }
+
+  //
+  // Clinger's fast path: when the mantissa and the power of 10 are
+  // both exact doubles, one IEEE multiply or divide rounds the true
+  // value correctly. Anything else (more than 19 digits, so the
+  // mantissa may have overflowed, a large exponent, trailing chars,
+  // inf, nan, ...) goes to strtod():
+  //
+  if (FLT_EVAL_METHOD != 0 || p != end || numDigits == 0 || numDigits > 19 ||
+      mantissa > (1ull << 53) || exponent < -22 || exponent > 22) {
+    return parseSlow(s, length);
+  }
+
+  double value = (double)mantissa;
+  value = (exponent < 0) ? value / powersOf10[-exponent]
+                         : value * powersOf10[exponent];
+  return negative ? -value : value;
+}
@@ -0,0 +1,51 @@
+/*fieldparse.h*/
+
+//
+// Field parsing for SimpleSQL records: splitting a record into its
+// fields, and converting int and real fields to binary. Unlike
+// atoi() and atof(), the parsers are given the field's length, do
+// not skip whitespace, and do not depend on the locale.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+
+//
+// functions:
+//
+
+//
+// fieldparse_split
+//
+// Splits a record in place into its fields in a single pass: the
+// byte after each field is replaced by '\0', fields[i] points to
+// the value of column i, with the quotes of string values removed,
+// and, if lengths is not NULL, lengths[i] is its length. Returns
+// the number of fields found, at most maxFields.
+//
+int fieldparse_split(char* record, char* fields[], int lengths[],
+                     int maxFields);
+
+//
+// fieldparse_int
+//
+// Converts the length chars at s, an optional sign followed by
+// digits, to an int; 8 digits are converted at a time. Like atoi,
+// conversion stops at the first char that is not a digit.
+//
+int fieldparse_int(const char* s, int length);
+
+//
+// fieldparse_real
+//
+// Converts the length chars at s to a double, rounded exactly as
+// strtod() would. Values with at most 19 significant digits and a
+// small decimal exponent, e.g. "3.25" or "-0.001", are converted
+// with a single multiply or divide; anything else is handed to
+// strtod().
+//
+double fieldparse_real(const char* s, int length);
@@ -0,0 +1,659 @@
+/*groupby.c*/
+
+//
+// GROUP BY for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "aggregate.h"
+#include "ast.h"
+#include "batch.h"
+#include "database.h"
+#include "dictionary.h"
+#include "encode.h"
+#include "fieldparse.h"
+#include "groupby.h"
+#include "grouptable.h"
+#include "matview.h"
+#include "predicate.h"
+#include "readahead.h"
+#include "resultset.h"
+#include "rowkey.h"
+#include "schemamap.h"
+#include "stats.h"
+#include "tablefile.h"
+#include "util.h"
+
+//
+// a spilled partition is split again, on the next 4 bits of the
+// hash, if its groups still do not fit; past this depth the groups
+// must share most of their hash, so the table is simply allowed to
+// grow:
+//
+#define GROUPBY_MAX_DEPTH 8
+
+//
+// the query, shared read-only by the threads:
+//
+struct GroupBy
+{
+  struct TableMeta* table;
+  int    fd;
+  struct Predicate* pred;  // NULL => every record
+  int    numGroupColumns;
+  int*   groupColumns;     // 0-based table columns
+  int*   groupTypes;
+  struct Dictionary** dicts;  // per group column, NULL => not encoded
+  int    numAggs;
+  struct Aggregate* aggs;
+  long   memoryPerThread;
+  long   expectedGroups;   // per thread, from the statistics; 0 => unknown
+};
+
+struct Worker
+{
+  struct GroupBy* gb;
+  long   first, last;  // records [first, last)
+  struct GroupTable* table;  // the aggregate states of each group
+  FILE*  partitions[GROUPBY_PARTITIONS];  // NULL until spilled
+  char** values;
+  char*  key;
+  int    keyCapacity;
+  struct ReadAheadStats io;
+  pthread_t thread;
+};
+
+static struct GroupTable* table_create(struct GroupBy* gb,
+                                      long expectedGroups) {
+  return grouptable_create(gb->numAggs * (int)sizeof(struct AggState),
+                           expectedGroups);
+}
+
+//
+// findStates
+//
+// Returns the aggregate states of the group, adding the group with
+// empty states if it is new. The pointer is only valid until the
+// next call.
+//
+static struct AggState* findStates(struct GroupTable* t, int numAggs,
+                                   char* key, int length,
+                                   unsigned long hash) {
+  bool isNew;
+  struct AggState* states =
+      (struct AggState*)grouptable_find(t, key, length, hash, &isNew);
+  if (isNew) {
+    aggregate_init(states, numAggs);
+  }
+  return states;
+}
+
+//
+// spill format: hash, key length, key, then the group's states
+//
+static void writeGroup(FILE* output, unsigned long hash, char* key,
+                       int length, struct AggState* states, int numAggs) {
+  if (fwrite(&hash, sizeof(hash), 1, output) != 1 ||
+      fwrite(&length, sizeof(int), 1, output) != 1 ||
+      fwrite(key, 1, length, output) != (size_t)length ||
+      fwrite(states, sizeof(struct AggState), numAggs, output) !=
+          (size_t)numAggs) {
+    panic("unable to write GROUP BY spill file");
+  }
+}
+
+//
+// partitionOf
+//
+// The partition of a group at the given depth: depth 0 splits on
+// the top 4 bits of the hash, each level below on the next 4.
+//
+static int partitionOf(unsigned long hash, int depth) {
+  return (int)(hash >> (60 - 4 * depth)) & (GROUPBY_PARTITIONS - 1);
+}
+
+static void createPartitions(FILE* partitions[]) {
+  for (int p = 0; p < GROUPBY_PARTITIONS; p++) {
+    partitions[p] = tmpfile();
+    if (partitions[p] == NULL) {
+      panic("unable to create GROUP BY spill file");
+    }
+  }
+}
+
+//
+// spillGroups
+//
+// Appends the groups of the table to the partition files of the
+// given depth.
+//
+static void spillGroups(struct GroupTable* t, FILE* partitions[], int depth,
+                        int numAggs) {
+  for (long g = 0; g < t->count; g++) {
+    struct GroupKey* k = &t->keys[g];
+    writeGroup(partitions[partitionOf(k->hash, depth)], k->hash,
+               grouptable_key(t, g), k->length, grouptable_payload(t, g),
+               numAggs);
+  }
+}
+
+//
+// spillTable
+//
+// Appends the worker's groups to its partition files, creating
+// them on first use, and starts the worker over with an empty
+// table. Partial states of a group may thus be spread over several
+// spills, and are combined when the partition is merged.
+//
+static void spillTable(struct Worker* w) {
+  if (w->partitions[0] == NULL) {
+    createPartitions(w->partitions);
+  }
+
+  spillGroups(w->table, w->partitions, 0, w->gb->numAggs);
+  grouptable_destroy(w->table);
+  w->table = table_create(w->gb, 0);
+}
+
+//
+// aggregateRecord
+//
+// Folds one record, already split into its fields, into the
+// worker's table.
+//
+static void aggregateRecord(struct Worker* w, char* fields[], int lengths[]) {
+  struct GroupBy* gb = w->gb;
+
+  for (int k = 0; k < gb->numGroupColumns; k++) {
+    w->values[k] = fields[gb->groupColumns[k]];
+  }
+  int length = rowkey_encode(gb->groupTypes, gb->dicts, gb->numGroupColumns,
+                             w->values, &w->key, &w->keyCapacity);
+  struct AggState* states = findStates(w->table, gb->numAggs, w->key, length,
+                                       rowkey_hash(w->key, length));
+  aggregate_fold(gb->aggs, states, gb->numAggs, fields, lengths);
+
+  if (grouptable_bytes(w->table) > gb->memoryPerThread) {
+    spillTable(w);
+  }
+}
+
+//
+// scanRange
+//
+// Thread body: reads records [first, last), through read-ahead,
+// and aggregates the live ones that satisfy the WHERE clause.
+//
+static void* scanRange(void* arg) {
+  struct Worker* w = (struct Worker*)arg;
+  struct GroupBy* gb = w->gb;
+  struct TableMeta* table = gb->table;
+
+  char* buffer = (char*)malloc(table->recordSize + 1);
+  char** fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  int* lengths = (int*)malloc(sizeof(int) * table->numColumns);
+  if (buffer == NULL || fields == NULL || lengths == NULL) {
+    panic("No memory");
+  }
+
+  struct ReadAhead* ra = readahead_start(
+      gb->fd, (off_t)w->first * table->recordSize,
+      (off_t)(w->last - w->first) * table->recordSize, table->recordSize);
+
+  char* chunk;
+  long length;
+  while ((chunk = readahead_next(ra, &length)) != NULL) {
+    long numInChunk = length / table->recordSize;
+    for (long r = 0; r < numInChunk; r++) {
+      memcpy(buffer, chunk + r * table->recordSize, table->recordSize);
+      buffer[table->recordSize] = '\0';
+
+      if (tablefile_isDeleted(buffer) ||
+          fieldparse_split(buffer, fields, lengths, table->numColumns) <
+              table->numColumns) {
+        continue;
+      }
+      if (gb->pred != NULL &&
+          !gb->pred->evalRecord(gb->pred, fields, lengths)) {
+        continue;
+      }
+      aggregateRecord(w, fields, lengths);
+    }
+  }
+
+  readahead_finish(ra, &w->io);
+  free(lengths);
+  free(fields);
+  free(buffer);
+  return NULL;
+}
+
+//
+// outputGroups
+//
+// Adds one row per group of the table to the result set, with the
+// columns in the order of the query; stops after *remaining rows
+// unless *remaining is negative.
+//
+static void outputGroups(struct GroupBy* gb, struct GroupTable* t,
+                         struct SELECT* select, struct ResultSet* result,
+                         long* remaining) {
+  char** starts = (char**)malloc(sizeof(char*) * (gb->numGroupColumns + 1));
+  if (starts == NULL) {
+    panic("No memory");
+  }
+
+  for (long g = 0; g < t->count && *remaining != 0; g++) {
+    char* cp = grouptable_key(t, g);
+    for (int k = 0; k < gb->numGroupColumns; k++) {
+      starts[k] = cp;
+      cp = rowkey_skip(gb->groupTypes[k], cp);
+    }
+
+    struct AggState* states = (struct AggState*)grouptable_payload(t, g);
+    int row = resultset_addRow(result);
+    int position = 1;
+    int a = 0;
+
+    for (struct COLUMN* c = select->columns; c != NULL;
+         c = c->next, position++) {
+      if (c->function == NO_FUNCTION) {
+        struct ColumnMeta* column = database_findColumn(gb->table, c->name);
+        int col = (int)(column - gb->table->columns);
+        int k = 0;
+        while (gb->groupColumns[k] != col) {
+          k++;
+        }
+        rowkey_output(result, row, position, &gb->groupTypes[k], &gb->dicts[k],
+                      1, starts[k]);
+        continue;
+      }
+
+      aggregate_output(result, row, position, &gb->aggs[a], &states[a]);
+      a++;
+    }
+
+    if (*remaining > 0) {
+      (*remaining)--;
+    }
+  }
+
+  free(starts);
+}
+
+//
+// mergePartition
+//
+// Combines the partial states in the spill files of one partition,
+// e.g. partition p of every worker, and outputs the groups. If the
+// groups outgrow GROUPBY_MEMORY_BYTES they are split again, on the
+// next 4 bits of the hash, and the parts merged one at a time.
+//
+static void mergePartition(struct GroupBy* gb, FILE* inputs[], int numInputs,
+                           int depth, struct SELECT* select,
+                           struct ResultSet* result, long* remaining) {
+  struct GroupTable* merged = table_create(gb, 0);
+  FILE* parts[GROUPBY_PARTITIONS];
+
+  struct AggState* states = (struct AggState*)malloc(
+      sizeof(struct AggState) * (gb->numAggs + 1));
+  char* key = NULL;
+  int capacity = 0;
+  if (states == NULL) {
+    panic("No memory");
+  }
+
+  for (int i = 0; i < numInputs; i++) {
+    FILE* input = inputs[i];
+    rewind(input);
+
+    unsigned long hash;
+    int length;
+    while (fread(&hash, sizeof(hash), 1, input) == 1 &&
+           fread(&length, sizeof(int), 1, input) == 1) {
+      if (length > capacity) {
+        capacity = 2 * length;
+        key = (char*)realloc(key, capacity);
+        if (key == NULL) {
+          panic("No memory");
+        }
+      }
+      if (fread(key, 1, length, input) != (size_t)length ||
+          fread(states, sizeof(struct AggState), gb->numAggs, input) !=
+              (size_t)gb->numAggs) {
+        panic("unable to read GROUP BY spill file");
+      }
+
+      // once split, the partial states go straight to the parts
+      if (merged == NULL) {
+        writeGroup(parts[partitionOf(hash, depth + 1)], hash, key, length,
+                   states, gb->numAggs);
+        continue;
+      }
+
+      aggregate_merge(findStates(merged, gb->numAggs, key, length, hash),
+                      states, gb->numAggs);
+      if (grouptable_bytes(merged) > GROUPBY_MEMORY_BYTES &&
+          depth + 1 < GROUPBY_MAX_DEPTH) {
+        createPartitions(parts);
+        spillGroups(merged, parts, depth + 1, gb->numAggs);
+        grouptable_destroy(merged);
+        merged = NULL;
+      }
+    }
+  }
+  free(key);
+  free(states);
+
+  if (merged != NULL) {
+    outputGroups(gb, merged, select, result, remaining);
+    grouptable_destroy(merged);
+    return;
+  }
+
+  for (int p = 0; p < GROUPBY_PARTITIONS; p++) {
+    mergePartition(gb, &parts[p], 1, depth + 1, select, result, remaining);
+    fclose(parts[p]);
+  }
+}
+
+//
+// prepare
+//
+// Resolves the group columns and aggregates of the query into gb;
+// returns false (after printing an error) if the query cannot be
+// grouped this way.
+//
+static bool prepare(struct Database* db, struct GroupBy* gb,
+                    struct SELECT* select, struct COLUMN* groupBy) {
+  struct TableMeta* table = gb->table;
+
+  // string group keys shrink to a code where the column is encoded;
+  // the dictionaries that need building are built in one scan
+  struct Dictionary** dicts = (struct Dictionary**)malloc(
+      sizeof(struct Dictionary*) * (table->numColumns + 1));
+  if (dicts == NULL) {
+    panic("No memory");
+  }
+  dictionary_openAll(db, table, dicts);
+
+  bool found = true;
+  for (struct COLUMN* c = groupBy; c != NULL; c = c->next) {
+    struct ColumnMeta* column = database_findColumn(table, c->name);
+    if (column == NULL) {
+      printf("**Error: GROUP BY column '%s' is not in table '%s'\n", c->name,
+             table->name);
+      found = false;
+      break;
+    }
+    int col = (int)(column - table->columns);
+    gb->groupColumns[gb->numGroupColumns] = col;
+    gb->groupTypes[gb->numGroupColumns] = column->colType;
+    gb->dicts[gb->numGroupColumns] = dicts[col];
+    dicts[col] = NULL;  // now gb's; a column grouped twice is not encoded
+    gb->numGroupColumns++;
+  }
+
+  for (int j = 0; j < table->numColumns; j++) {
+    dictionary_close(dicts[j]);
+  }
+  free(dicts);
+  if (!found) {
+    return false;
+  }
+
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    struct ColumnMeta* column = database_findColumn(table, c->name);
+    assert(column != NULL);
+    int col = (int)(column - table->columns);
+
+    if (c->function == NO_FUNCTION) {
+      bool grouped = false;
+      for (int k = 0; k < gb->numGroupColumns; k++) {
+        grouped = grouped || (gb->groupColumns[k] == col);
+      }
+      if (!grouped) {
+        printf("**Error: column '%s' must be in GROUP BY or aggregated\n",
+               column->name);
+        return false;
+      }
+      continue;
+    }
+
+    if (c->function != COUNT_FUNCTION && column->colType == COL_TYPE_STRING) {
+      printf("**Error: GROUP BY cannot compute this aggregate of string "
+             "column '%s'\n",
+             column->name);
+      return false;
+    }
+    gb->aggs[gb->numAggs].function = c->function;
+    gb->aggs[gb->numAggs].column = col;
+    gb->aggs[gb->numAggs].colType = column->colType;
+    gb->numAggs++;
+  }
+
+  return true;
+}
+
+void groupby_execute(struct Database* db, struct SELECT* select,
+                     struct COLUMN* groupBy) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  if (matview_enabled() && select->into == NULL &&
+      matview_execute(db, select, groupBy)) {
+    return;
+  }
+
+  struct TableMeta* table = database_findTable(db, select->table);
+  assert(table != NULL);
+
+  int numColumns = 0, numGroup = 0;
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    numColumns++;
+  }
+  for (struct COLUMN* c = groupBy; c != NULL; c = c->next) {
+    numGroup++;
+  }
+
+  struct GroupBy gb;
+  gb.table = table;
+  gb.fd = -1;
+  gb.pred = NULL;
+  gb.numGroupColumns = 0;
+  gb.groupColumns = (int*)malloc(sizeof(int) * (numGroup + 1));
+  gb.groupTypes = (int*)malloc(sizeof(int) * (numGroup + 1));
+  gb.dicts = (struct Dictionary**)malloc(sizeof(struct Dictionary*) *
+                                         (numGroup + 1));
+  gb.numAggs = 0;
+  gb.aggs = (struct Aggregate*)malloc(sizeof(struct Aggregate) *
+                                      (numColumns + 1));
+  if (gb.groupColumns == NULL || gb.groupTypes == NULL || gb.dicts == NULL ||
+      gb.aggs == NULL) {
+    panic("No memory");
+  }
+
+  if (select->into != NULL) {
+    printf("**Error: GROUP BY ... INTO is not supported\n");
+  } else if (prepare(db, &gb, select, groupBy)) {
+    char datapath[TABLEFILE_MAX_PATH];
+    tablefile_path(db, table, ".data", datapath);
+
+    gb.fd = open(datapath, O_RDONLY);
+    if (gb.fd < 0) {
+      printf("**Error: file '%s'is not found.", datapath);
+      panic("stop execution");
+    }
+    if (select->where != NULL) {
+      gb.pred = predicate_compile(table, select->where->expr);
+    }
+
+    //
+    // split the records into one contiguous range per thread:
+    //
+    long numRecords = tablefile_numRecords(gb.fd, table);
+    int numWorkers = 1;
+    if (numRecords >= GROUPBY_PARALLEL_RECORDS) {
+      long cpus = (GROUPBY_THREADS > 0) ? GROUPBY_THREADS
+                                        : sysconf(_SC_NPROCESSORS_ONLN);
+      numWorkers = (cpus > GROUPBY_MAX_THREADS) ? GROUPBY_MAX_THREADS
+                   : (cpus > 1)                 ? (int)cpus
+                                                : 1;
+    }
+    gb.memoryPerThread = GROUPBY_MEMORY_BYTES / numWorkers;
+
+    //
+    // the distinct values of the group columns, if the table has been
+    // analyzed, or else their dictionaries, bound the groups a thread
+    // can see; capped well below the point where a thread would spill
+    //
+    long perWorker = (numRecords + numWorkers - 1) / numWorkers;
+    double groups = 1;
+    for (int k = 0; k < gb.numGroupColumns && groups > 0; k++) {
+      double distinct =
+          stats_distinct(table, &table->columns[gb.groupColumns[k]]);
+      if (distinct < 0 && gb.dicts[k] != NULL) {
+        distinct = gb.dicts[k]->numEntries;
+      }
+      groups = (distinct < 0) ? 0 : groups * distinct;
+    }
+    long groupBytes = 2 * (long)sizeof(struct GroupSlot) +
+                      (long)sizeof(struct GroupKey) +
+                      gb.numAggs * (long)sizeof(struct AggState);
+    long maxGroups = gb.memoryPerThread / (4 * groupBytes);
+    gb.expectedGroups = (groups > perWorker) ? perWorker : (long)groups;
+    if (gb.expectedGroups > maxGroups) {
+      gb.expectedGroups = maxGroups;
+    }
+
+    struct Worker* workers =
+        (struct Worker*)calloc(numWorkers, sizeof(struct Worker));
+    if (workers == NULL) {
+      panic("No memory");
+    }
+    for (int w = 0; w < numWorkers; w++) {
+      workers[w].gb = &gb;
+      workers[w].first = w * perWorker;
+      workers[w].last = (w + 1 < numWorkers) ? (w + 1) * perWorker : numRecords;
+      workers[w].table = table_create(&gb, gb.expectedGroups);
+      workers[w].values = (char**)malloc(sizeof(char*) * (numGroup + 1));
+      if (workers[w].values == NULL) {
+        panic("No memory");
+      }
+    }
+
+    if (numWorkers == 1) {
+      scanRange(&workers[0]);
+    } else {
+      for (int w = 0; w < numWorkers; w++) {
+        if (pthread_create(&workers[w].thread, NULL, scanRange, &workers[w]) !=
+            0) {
+          panic("unable to start GROUP BY thread");
+        }
+      }
+      for (int w = 0; w < numWorkers; w++) {
+        pthread_join(workers[w].thread, NULL);
+      }
+    }
+
+    struct ReadAheadStats io;
+    memset(&io, 0, sizeof(io));
+    for (int w = 0; w < numWorkers; w++) {
+      io.bytesRead += workers[w].io.bytesRead;
+      io.numReads += workers[w].io.numReads;
+      io.stallSeconds += workers[w].io.stallSeconds;
+      io.cpuSeconds += workers[w].io.cpuSeconds;
+    }
+    readahead_report(table->name, &io);
+
+    //
+    // merge the partial tables: in memory if they fit, otherwise one
+    // partition at a time
+    //
+    bool spilled = false;
+    long bytes = 0;
+    for (int w = 0; w < numWorkers; w++) {
+      spilled = spilled || (workers[w].partitions[0] != NULL);
+      bytes += grouptable_bytes(workers[w].table);
+    }
+    spilled = spilled || (numWorkers > 1 && bytes > GROUPBY_MEMORY_BYTES);
+
+    struct ResultSet* result = resultset_create();
+    int position = 1;
+    for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+      struct ColumnMeta* column = database_findColumn(table, c->name);
+      resultset_insertColumn(result, position++, table->name, column->name,
+                             c->function,
+                             aggregate_type(c->function, column->colType));
+    }
+    long remaining = (select->limit != NULL) ? select->limit->N : -1;
+
+    if (!spilled) {
+      struct GroupTable* merged = workers[0].table;
+      for (int w = 1; w < numWorkers; w++) {
+        struct GroupTable* t = workers[w].table;
+        for (long g = 0; g < t->count; g++) {
+          struct GroupKey* k = &t->keys[g];
+          aggregate_merge(findStates(merged, gb.numAggs, grouptable_key(t, g),
+                                     k->length, k->hash),
+                          (struct AggState*)grouptable_payload(t, g),
+                          gb.numAggs);
+        }
+      }
+      outputGroups(&gb, merged, select, result, &remaining);
+    } else {
+      FILE* inputs[GROUPBY_MAX_THREADS];
+      for (int w = 0; w < numWorkers; w++) {
+        spillTable(&workers[w]);
+      }
+      for (int p = 0; p < GROUPBY_PARTITIONS; p++) {
+        for (int w = 0; w < numWorkers; w++) {
+          inputs[w] = workers[w].partitions[p];
+        }
+        mergePartition(&gb, inputs, numWorkers, 0, select, result, &remaining);
+      }
+    }
+
+    encode_resultSet(result);
+    batch_countRows(result->numRows);
+    resultset_destroy(result);
+
+    for (int w = 0; w < numWorkers; w++) {
+      for (int p = 0; p < GROUPBY_PARTITIONS; p++) {
+        if (workers[w].partitions[p] != NULL) {
+          fclose(workers[w].partitions[p]);
+        }
+      }
+      grouptable_destroy(workers[w].table);
+      free(workers[w].values);
+      free(workers[w].key);
+    }
+    free(workers);
+
+    if (gb.pred != NULL) {
+      predicate_destroy(gb.pred);
+    }
+    close(gb.fd);
+  }
+
+  for (int k = 0; k < gb.numGroupColumns; k++) {
+    dictionary_close(gb.dicts[k]);
+  }
+  free(gb.aggs);
+  free(gb.dicts);
+  free(gb.groupTypes);
+  free(gb.groupColumns);
+}
@@ -0,0 +1,65 @@
+/*groupby.h*/
+
+//
+// GROUP BY for SimpleSQL. Aggregates are computed per group in an
+// open-addressing hash table keyed by the group columns. Large
+// tables are scanned by several threads, each aggregating its own
+// range of blocks into a table of its own, and the partial tables
+// are merged at the end. A table that grows past its share of
+// GROUPBY_MEMORY_BYTES is spilled: its partial aggregates are
+// written to GROUPBY_PARTITIONS temporary files by hash, and the
+// partitions are merged one at a time, each split again on more
+// bits of the hash if its groups still do not fit.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include "ast.h"
+#include "database.h"
+
+//
+// memory for the group tables, across all threads, before they are
+// spilled, and the number of partitions a spill splits groups into:
+//
+#ifndef GROUPBY_MEMORY_BYTES
+#define GROUPBY_MEMORY_BYTES (64 * 1024 * 1024)
+#endif
+#define GROUPBY_PARTITIONS   16
+
+//
+// the scan is split across one thread per CPU, at most
+// GROUPBY_MAX_THREADS, and only for tables with at least
+// GROUPBY_PARALLEL_RECORDS records. GROUPBY_THREADS, if not 0, is
+// the number of threads instead of the CPUs. The memory, the
+// records and the threads can be set at build time, as
+// tests/groupby_test.c does to spill and split small tables:
+//
+#define GROUPBY_MAX_THREADS      8
+#ifndef GROUPBY_PARALLEL_RECORDS
+#define GROUPBY_PARALLEL_RECORDS (64 * 1024)
+#endif
+#ifndef GROUPBY_THREADS
+#define GROUPBY_THREADS 0
+#endif
+
+
+//
+// functions:
+//
+
+//
+// groupby_execute
+//
+// Executes the query grouped by the given columns and prints the
+// result: one row per group, in no particular order. Every column
+// of the query must either be a group column or an aggregate;
+// SUM, AVG, MIN and MAX require a numeric column. The query's WHERE
+// clause selects the rows to group, and its LIMIT the number of
+// groups printed.
+//
+void groupby_execute(struct Database* db, struct SELECT* select,
+                     struct COLUMN* groupBy);
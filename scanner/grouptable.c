@@ -0,0 +1,181 @@
+/*grouptable.c*/
+
+//
+// Hash tables of row keys for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "grouptable.h"
+#include "util.h"
+
+static void clearSlots(struct GroupTable* t) {
+  t->slots =
+      (struct GroupSlot*)malloc(sizeof(struct GroupSlot) * t->capacity);
+  if (t->slots == NULL) {
+    panic("No memory");
+  }
+  for (long s = 0; s < t->capacity; s++) {
+    t->slots[s].group = -1;
+  }
+}
+
+struct GroupTable* grouptable_create(int payloadBytes, long expectedGroups) {
+  struct GroupTable* t = (struct GroupTable*)malloc(sizeof(struct GroupTable));
+  if (t == NULL) {
+    panic("No memory");
+  }
+
+  t->payloadBytes = payloadBytes;
+  t->capacity = 64;
+  while (t->capacity < 2 * expectedGroups) {
+    t->capacity *= 2;
+  }
+  clearSlots(t);
+
+  t->count = 0;
+  t->groupsCapacity = (expectedGroups > 16) ? expectedGroups : 16;
+  t->keys =
+      (struct GroupKey*)malloc(sizeof(struct GroupKey) * t->groupsCapacity);
+  t->payloads = (char*)malloc((long)payloadBytes * t->groupsCapacity + 1);
+  t->arenaCapacity = 1024;
+  t->arenaSize = 0;
+  t->arena = (char*)malloc(t->arenaCapacity);
+  if (t->keys == NULL || t->payloads == NULL || t->arena == NULL) {
+    panic("No memory");
+  }
+  return t;
+}
+
+void grouptable_destroy(struct GroupTable* t) {
+  if (t == NULL) {
+    return;
+  }
+  free(t->arena);
+  free(t->payloads);
+  free(t->keys);
+  free(t->slots);
+  free(t);
+}
+
+long grouptable_bytes(struct GroupTable* t) {
+  return t->capacity * (long)sizeof(struct GroupSlot) +
+         t->groupsCapacity * ((long)sizeof(struct GroupKey) + t->payloadBytes) +
+         t->arenaCapacity;
+}
+
+//
+// slotOf
+//
+// Returns the slot holding the key, or the empty slot where it
+// belongs.
+//
+static long slotOf(struct GroupTable* t, char* key, int length,
+                   unsigned long hash) {
+  long mask = t->capacity - 1;
+  long s = (long)(hash & mask);
+
+  while (t->slots[s].group != -1) {
+    if (t->slots[s].hash == hash) {
+      struct GroupKey* k = &t->keys[t->slots[s].group];
+      if (k->length == length &&
+          memcmp(t->arena + k->offset, key, length) == 0) {
+        break;
+      }
+    }
+    s = (s + 1) & mask;
+  }
+  return s;
+}
+
+static void grow(struct GroupTable* t) {
+  struct GroupSlot* old = t->slots;
+  long oldCapacity = t->capacity;
+
+  t->capacity *= 2;
+  clearSlots(t);
+
+  long mask = t->capacity - 1;
+  for (long i = 0; i < oldCapacity; i++) {
+    if (old[i].group == -1) {
+      continue;
+    }
+    long s = (long)(old[i].hash & mask);
+    while (t->slots[s].group != -1) {
+      s = (s + 1) & mask;
+    }
+    t->slots[s] = old[i];
+  }
+  free(old);
+}
+
+void* grouptable_find(struct GroupTable* t, char* key, int length,
+                      unsigned long hash, bool* isNew) {
+  long s = slotOf(t, key, length, hash);
+
+  if (isNew != NULL) {
+    *isNew = (t->slots[s].group == -1);
+  }
+  if (t->slots[s].group != -1) {
+    return grouptable_payload(t, t->slots[s].group);
+  }
+
+  long g = t->count;
+  if (g == t->groupsCapacity) {
+    t->groupsCapacity *= 2;
+    t->keys = (struct GroupKey*)realloc(
+        t->keys, sizeof(struct GroupKey) * t->groupsCapacity);
+    t->payloads = (char*)realloc(
+        t->payloads, (long)t->payloadBytes * t->groupsCapacity + 1);
+    if (t->keys == NULL || t->payloads == NULL) {
+      panic("No memory");
+    }
+  }
+  if (t->arenaSize + length > t->arenaCapacity) {
+    while (t->arenaSize + length > t->arenaCapacity) {
+      t->arenaCapacity *= 2;
+    }
+    t->arena = (char*)realloc(t->arena, t->arenaCapacity);
+    if (t->arena == NULL) {
+      panic("No memory");
+    }
+  }
+
+  memcpy(t->arena + t->arenaSize, key, length);
+  t->keys[g].hash = hash;
+  t->keys[g].offset = t->arenaSize;
+  t->keys[g].length = length;
+  t->arenaSize += length;
+  t->slots[s].hash = hash;
+  t->slots[s].group = g;
+
+  t->count++;
+  if (2 * t->count > t->capacity) {
+    grow(t);
+  }
+  return grouptable_payload(t, g);
+}
+
+void* grouptable_lookup(struct GroupTable* t, char* key, int length,
+                        unsigned long hash) {
+  long s = slotOf(t, key, length, hash);
+
+  if (t->slots[s].group == -1) {
+    return NULL;
+  }
+  return grouptable_payload(t, t->slots[s].group);
+}
+
+char* grouptable_key(struct GroupTable* t, long g) {
+  return t->arena + t->keys[g].offset;
+}
+
+void* grouptable_payload(struct GroupTable* t, long g) {
+  return t->payloads + g * t->payloadBytes;
+}
@@ -0,0 +1,106 @@
+/*grouptable.h*/
+
+//
+// Hash tables of row keys for SimpleSQL, as used by GROUP BY, the
+// materialized aggregates and set operations. Keys (rowkey.h) are
+// copied into an arena, and each distinct key, a "group", gets a
+// fixed-size value of payloadBytes, e.g. the aggregate states of a
+// group or the flag that a row was output. Groups are numbered
+// 0, 1, ... in the order they first appeared, which is also the
+// order in which they are enumerated.
+//
+// The table is open addressing with linear probing, kept at most
+// half full; a slot holds the key's hash, so probing reads a key
+// from the arena only when the hashes match.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+struct GroupSlot
+{
+  unsigned long hash;
+  long group;  // -1 => empty slot
+};
+
+struct GroupKey
+{
+  unsigned long hash;
+  long offset;  // into the arena
+  int  length;
+};
+
+struct GroupTable
+{
+  int  payloadBytes;
+  long capacity;  // slots, always a power of 2
+  struct GroupSlot* slots;
+  long count;     // groups
+  long groupsCapacity;
+  struct GroupKey* keys;  // per group
+  char* payloads;         // per group, payloadBytes each
+  char* arena;
+  long  arenaSize;
+  long  arenaCapacity;
+};
+
+
+//
+// functions:
+//
+
+//
+// grouptable_create
+//
+// Returns an empty table with room for the expected number of
+// groups (0 if unknown), so it does not rehash as it fills.
+//
+// NOTE: it is the callers responsibility to free the table by
+// calling grouptable_destroy().
+//
+struct GroupTable* grouptable_create(int payloadBytes, long expectedGroups);
+
+//
+// grouptable_destroy
+//
+void grouptable_destroy(struct GroupTable* t);
+
+//
+// grouptable_bytes
+//
+// Returns the memory held by the table.
+//
+long grouptable_bytes(struct GroupTable* t);
+
+//
+// grouptable_find
+//
+// Returns the payload of the key's group, adding the group if it is
+// new, in which case the payload is uninitialized; *isNew (unless
+// isNew is NULL) tells which. The pointer is only valid until the
+// next call.
+//
+void* grouptable_find(struct GroupTable* t, char* key, int length,
+                      unsigned long hash, bool* isNew);
+
+//
+// grouptable_lookup
+//
+// Returns the payload of the key's group, or NULL if the key is not
+// in the table.
+//
+void* grouptable_lookup(struct GroupTable* t, char* key, int length,
+                        unsigned long hash);
+
+//
+// grouptable_key / grouptable_payload
+//
+// Return the key / payload of group g, 0 <= g < t->count.
+//
+char* grouptable_key(struct GroupTable* t, long g);
+void* grouptable_payload(struct GroupTable* t, long g);
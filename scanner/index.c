@@ -0,0 +1,573 @@
+/*index.c*/
+
+//
+// Secondary indexes for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "index.h"
+#include "tablefile.h"
+#include "util.h"
+
+#define INDEX_MAGIC "SQLIDX03"  // 03: tagged with the data file
+
+struct IndexHeader
+{
+  char magic[8];
+  int  colType;
+  int  keySize;
+  long numEntries;
+  unsigned long device;  // of the data file the index was built
+  unsigned long inode;   // from; compaction replaces the file
+};
+
+//
+// one entry while building, before it is packed into the file:
+//
+struct BuildEntry
+{
+  long   recno;
+  int    i;
+  double r;
+  char*  s;
+};
+
+static int compareRecnos(const struct BuildEntry* x,
+                         const struct BuildEntry* y) {
+  return (x->recno < y->recno) ? -1 : (x->recno > y->recno) ? 1 : 0;
+}
+
+static int compareInts(const void* a, const void* b) {
+  const struct BuildEntry* x = a;
+  const struct BuildEntry* y = b;
+
+  if (x->i != y->i) {
+    return (x->i < y->i) ? -1 : 1;
+  }
+  return compareRecnos(x, y);
+}
+
+static int compareReals(const void* a, const void* b) {
+  const struct BuildEntry* x = a;
+  const struct BuildEntry* y = b;
+
+  if (x->r != y->r) {
+    return (x->r < y->r) ? -1 : 1;
+  }
+  return compareRecnos(x, y);
+}
+
+static int compareStrings(const void* a, const void* b) {
+  const struct BuildEntry* x = a;
+  const struct BuildEntry* y = b;
+  int cmp = strcmp(x->s, y->s);
+
+  return (cmp != 0) ? cmp : compareRecnos(x, y);
+}
+
+static int (*comparatorFor(int colType))(const void*, const void*) {
+  if (colType == COL_TYPE_INT) {
+    return compareInts;
+  } else if (colType == COL_TYPE_REAL) {
+    return compareReals;
+  } else {
+    return compareStrings;
+  }
+}
+
+//
+// buildEntry
+//
+// Converts a field's text into a build entry; returns the length
+// of a string value (0 for numbers) so the caller can size keys.
+//
+static int buildEntry(struct BuildEntry* entry, int colType, char* value,
+                      long recno) {
+  entry->recno = recno;
+  entry->s = NULL;
+
+  if (colType == COL_TYPE_INT) {
+    entry->i = atoi(value);
+  } else if (colType == COL_TYPE_REAL) {
+    entry->r = atof(value);
+  } else {
+    int length = strlen(value);
+    entry->s = (char*)malloc(length + 1);
+    if (entry->s == NULL) {
+      panic("No memory");
+    }
+    strcpy(entry->s, value);
+    return length;
+  }
+  return 0;
+}
+
+//
+// packEntry
+//
+// Writes the entry in file form: key, then record number.
+//
+static void packEntry(char* out, struct BuildEntry* entry, int colType,
+                      int keySize) {
+  memset(out, 0, keySize);
+  if (colType == COL_TYPE_INT) {
+    memcpy(out, &entry->i, sizeof(int));
+  } else if (colType == COL_TYPE_REAL) {
+    memcpy(out, &entry->r, sizeof(double));
+  } else {
+    strcpy(out, entry->s);
+  }
+  memcpy(out + keySize, &entry->recno, sizeof(long));
+}
+
+//
+// unpackEntry
+//
+// The inverse of packEntry, for entry pos of an open index; string
+// keys are NOT copied.
+//
+static void unpackEntry(struct Index* index, long pos,
+                        struct BuildEntry* entry) {
+  char* key = index->entries + pos * index->entrySize;
+
+  entry->s = NULL;
+  if (index->colType == COL_TYPE_INT) {
+    memcpy(&entry->i, key, sizeof(int));
+  } else if (index->colType == COL_TYPE_REAL) {
+    memcpy(&entry->r, key, sizeof(double));
+  } else {
+    entry->s = key;
+  }
+  memcpy(&entry->recno, key + index->keySize, sizeof(long));
+}
+
+static void index_path(struct Database* db, struct TableMeta* table,
+                       struct ColumnMeta* column, char* path) {
+  char suffix[DATABASE_MAX_ID_LENGTH + 8];
+
+  snprintf(suffix, sizeof(suffix), ".%s.idx", column->name);
+  tablefile_path(db, table, suffix, path);
+}
+
+//
+// compareKey
+//
+// Compares the key of entry pos with a WHERE-style literal value.
+//
+static int compareKey(struct Index* index, long pos, char* value) {
+  char* key = index->entries + pos * index->entrySize;
+
+  if (index->colType == COL_TYPE_INT) {
+    int k, v = atoi(value);
+    memcpy(&k, key, sizeof(int));
+    return (k < v) ? -1 : (k > v);
+  } else if (index->colType == COL_TYPE_REAL) {
+    double k, v = atof(value);
+    memcpy(&k, key, sizeof(double));
+    return (k < v) ? -1 : (k > v);
+  } else {
+    return strncmp(key, value, index->keySize);
+  }
+}
+
+static bool index_write(struct Database* db, struct TableMeta* table,
+                        struct ColumnMeta* column, int keySize, char* entries,
+                        long numEntries, unsigned long device,
+                        unsigned long inode) {
+  char path[TABLEFILE_MAX_PATH];
+  char tmppath[TABLEFILE_MAX_PATH + 4];
+
+  index_path(db, table, column, path);
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+
+  FILE* output = fopen(tmppath, "w");
+  if (output == NULL) {
+    return false;
+  }
+
+  struct IndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+  header.colType = column->colType;
+  header.keySize = keySize;
+  header.numEntries = numEntries;
+  header.device = device;
+  header.inode = inode;
+
+  size_t entrySize = keySize + sizeof(long);
+  bool ok = fwrite(&header, sizeof(header), 1, output) == 1 &&
+            (numEntries == 0 ||
+             fwrite(entries, entrySize, numEntries, output) ==
+                 (size_t)numEntries);
+
+  ok = (fclose(output) == 0) && ok;
+
+  //
+  // rename so readers never see a half-written index:
+  //
+  if (!ok || rename(tmppath, path) < 0) {
+    unlink(tmppath);
+    return false;
+  }
+  return true;
+}
+
+//
+// index_build
+//
+// Scans the data file once, sorts the column's values and writes
+// the sidecar file.
+//
+static bool index_build(struct Database* db, struct TableMeta* table,
+                        struct ColumnMeta* column) {
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  int fd = open(datapath, O_RDONLY);
+  struct stat data;
+  if (fd < 0 || fstat(fd, &data) < 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+
+  long numRecords = tablefile_numRecords(fd, table);
+  int colIndex = (int)(column - table->columns);
+  int colType = column->colType;
+
+  struct BuildEntry* build = (struct BuildEntry*)malloc(
+      sizeof(struct BuildEntry) * (numRecords + 1));
+  char* buffer = (char*)malloc(table->recordSize + 1);
+  char** fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  if (build == NULL || buffer == NULL || fields == NULL) {
+    panic("No memory");
+  }
+
+  long N = 0;
+  int keySize = (colType == COL_TYPE_INT)    ? sizeof(int)
+                : (colType == COL_TYPE_REAL) ? sizeof(double)
+                                             : 1;
+
+  for (long recno = 0; recno < numRecords; recno++) {
+    if (!tablefile_readRecord(fd, table, recno, buffer)) {
+      break;
+    }
+    if (tablefile_isDeleted(buffer) ||
+        tablefile_splitFields(buffer, fields, table->numColumns) <=
+            colIndex) {
+      continue;
+    }
+
+    int length = buildEntry(&build[N], colType, fields[colIndex], recno);
+    if (length + 1 > keySize) {
+      keySize = length + 1;
+    }
+    N++;
+  }
+  close(fd);
+  free(fields);
+  free(buffer);
+
+  qsort(build, N, sizeof(struct BuildEntry), comparatorFor(colType));
+
+  //
+  // pack into fixed-size entries: key, then record number
+  //
+  int entrySize = keySize + sizeof(long);
+  char* entries = (char*)calloc(N + 1, entrySize);
+  if (entries == NULL) {
+    panic("No memory");
+  }
+
+  for (long i = 0; i < N; i++) {
+    packEntry(entries + i * entrySize, &build[i], colType, keySize);
+    free(build[i].s);
+  }
+  free(build);
+
+  bool ok = index_write(db, table, column, keySize, entries, N,
+                        (unsigned long)data.st_dev,
+                        (unsigned long)data.st_ino);
+  free(entries);
+  return ok;
+}
+
+static bool isStale(char* indexpath, char* datapath) {
+  struct stat indexInfo, dataInfo;
+
+  if (stat(indexpath, &indexInfo) < 0) {
+    return true;
+  }
+  if (stat(datapath, &dataInfo) < 0) {
+    return false;
+  }
+
+  if (indexInfo.st_mtim.tv_sec != dataInfo.st_mtim.tv_sec) {
+    return indexInfo.st_mtim.tv_sec < dataInfo.st_mtim.tv_sec;
+  }
+  return indexInfo.st_mtim.tv_nsec < dataInfo.st_mtim.tv_nsec;
+}
+
+//
+// mapIndex
+//
+// Maps the sidecar file into memory; returns NULL (and *size
+// undefined) if it is missing, of an older format, of another
+// column type, or built from another data file than the one
+// described by data (if not NULL).
+//
+static struct IndexHeader* mapIndex(char* path, struct ColumnMeta* column,
+                                    struct stat* data, size_t* size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(struct IndexHeader)) {
+    close(fd);
+    return NULL;
+  }
+
+  void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return NULL;
+  }
+
+  struct IndexHeader* header = (struct IndexHeader*)mapping;
+  if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+      header->colType != column->colType ||
+      (data != NULL && (header->device != (unsigned long)data->st_dev ||
+                        header->inode != (unsigned long)data->st_ino))) {
+    munmap(mapping, info.st_size);
+    return NULL;
+  }
+
+  *size = info.st_size;
+  return header;
+}
+
+struct Index* index_open(struct Database* db, struct TableMeta* table,
+                         struct ColumnMeta* column) {
+  if (column->indexType == COL_NON_INDEXED) {
+    return NULL;
+  }
+
+  char path[TABLEFILE_MAX_PATH];
+  char datapath[TABLEFILE_MAX_PATH];
+  index_path(db, table, column, path);
+  tablefile_path(db, table, ".data", datapath);
+
+  bool built = isStale(path, datapath);
+  if (built && !index_build(db, table, column)) {
+    return NULL;
+  }
+
+  // a file of an older format, or built from the data file before
+  // it was compacted, is rebuilt as well
+  struct stat info;
+  struct stat* data = (stat(datapath, &info) == 0) ? &info : NULL;
+  size_t size;
+  struct IndexHeader* header = mapIndex(path, column, data, &size);
+  if (header == NULL && !built && index_build(db, table, column)) {
+    header = mapIndex(path, column, data, &size);
+  }
+  if (header == NULL) {
+    return NULL;
+  }
+
+  struct Index* index = (struct Index*)malloc(sizeof(struct Index));
+  if (index == NULL) {
+    panic("No memory");
+  }
+
+  index->colType = header->colType;
+  index->keySize = header->keySize;
+  index->entrySize = header->keySize + sizeof(long);
+  index->numEntries = header->numEntries;
+  index->entries = (char*)header + sizeof(struct IndexHeader);
+  index->mapping = header;
+  index->mappingSize = size;
+
+  return index;
+}
+
+void index_close(struct Index* index) {
+  if (index == NULL) {
+    return;
+  }
+  munmap(index->mapping, index->mappingSize);
+  free(index);
+}
+
+long index_lowerBound(struct Index* index, char* value) {
+  long lo = 0, hi = index->numEntries;
+
+  while (lo < hi) {
+    long mid = lo + (hi - lo) / 2;
+    if (compareKey(index, mid, value) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+long index_upperBound(struct Index* index, char* value) {
+  long lo = 0, hi = index->numEntries;
+
+  while (lo < hi) {
+    long mid = lo + (hi - lo) / 2;
+    if (compareKey(index, mid, value) <= 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+void index_prefixRange(struct Index* index, char* prefix, long* lo,
+                       long* hi) {
+  size_t length = strlen(prefix);
+
+  *lo = index_lowerBound(index, prefix);
+
+  //
+  // first entry past the prefix: keys that start with the prefix
+  // compare equal on the first length chars
+  //
+  long l = *lo, h = index->numEntries;
+  while (l < h) {
+    long mid = l + (h - l) / 2;
+    if (strncmp(index->entries + mid * index->entrySize, prefix, length) <= 0) {
+      l = mid + 1;
+    } else {
+      h = mid;
+    }
+  }
+  *hi = l;
+}
+
+long index_recno(struct Index* index, long pos) {
+  long recno;
+
+  memcpy(&recno, index->entries + pos * index->entrySize + index->keySize,
+         sizeof(long));
+  return recno;
+}
+
+char* index_key(struct Index* index, long pos) {
+  return index->entries + pos * index->entrySize;
+}
+
+bool index_merge(struct Database* db, struct TableMeta* table,
+                 struct ColumnMeta* column, struct Index** index,
+                 char* values[], long recnos[], long N) {
+  struct Index* old = *index;
+  int colType = column->colType;
+  int keySize = old->keySize;
+
+  struct BuildEntry* added =
+      (struct BuildEntry*)malloc(sizeof(struct BuildEntry) * (N + 1));
+  if (added == NULL) {
+    panic("No memory");
+  }
+
+  for (long i = 0; i < N; i++) {
+    int length = buildEntry(&added[i], colType, values[i], recnos[i]);
+    if (length + 1 > keySize) {
+      keySize = length + 1;
+    }
+  }
+  int (*compare)(const void*, const void*) = comparatorFor(colType);
+  qsort(added, N, sizeof(struct BuildEntry), compare);
+
+  //
+  // one merge pass over the old entries and the sorted new ones; the
+  // key size may have grown if a new string is longer than any old
+  // one, so every entry is repacked:
+  //
+  long total = old->numEntries + N;
+  int entrySize = keySize + sizeof(long);
+  char* entries = (char*)malloc(entrySize * (total + 1));
+  if (entries == NULL) {
+    panic("No memory");
+  }
+
+  long i = 0, j = 0, k = 0;
+  struct BuildEntry current;
+  while (i < old->numEntries || j < N) {
+    if (i < old->numEntries) {
+      unpackEntry(old, i, &current);
+    }
+    if (j < N && (i >= old->numEntries || compare(&added[j], &current) < 0)) {
+      packEntry(entries + k * entrySize, &added[j], colType, keySize);
+      free(added[j].s);
+      j++;
+    } else {
+      packEntry(entries + k * entrySize, &current, colType, keySize);
+      i++;
+    }
+    k++;
+  }
+  free(added);
+
+  struct IndexHeader* header = (struct IndexHeader*)old->mapping;
+  bool ok = index_write(db, table, column, keySize, entries, total,
+                        header->device, header->inode);
+  free(entries);
+  if (!ok) {
+    return false;
+  }
+
+  index_close(old);
+  *index = index_open(db, table, column);
+  return *index != NULL;
+}
+
+bool index_isFresh(struct Database* db, struct TableMeta* table,
+                   struct ColumnMeta* column) {
+  char path[TABLEFILE_MAX_PATH];
+  char datapath[TABLEFILE_MAX_PATH];
+
+  index_path(db, table, column, path);
+  tablefile_path(db, table, ".data", datapath);
+  if (isStale(path, datapath)) {
+    return false;
+  }
+
+  struct stat info;
+  struct stat* data = (stat(datapath, &info) == 0) ? &info : NULL;
+  size_t size;
+  struct IndexHeader* header = mapIndex(path, column, data, &size);
+  if (header == NULL) {
+    return false;
+  }
+  munmap(header, size);
+  return true;
+}
+
+void index_touch(struct Database* db, struct TableMeta* table,
+                 struct ColumnMeta* column) {
+  char path[TABLEFILE_MAX_PATH];
+
+  index_path(db, table, column, path);
+  utimensat(AT_FDCWD, path, NULL, 0);
+}
@@ -0,0 +1,123 @@
+/*index.h*/
+
+//
+// Secondary indexes for indexed columns. An index is a sorted
+// array of (key, record number) entries, stored in the sidecar
+// file "<table>.<column>.idx" and mapped into memory. It is built
+// from the data file the first time it is needed, and rebuilt if
+// the data file is newer or has been replaced, e.g. by compaction.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "database.h"
+
+struct Index
+{
+  int    colType;     // int, real or string
+  int    keySize;     // bytes per key; strings are null-padded
+  int    entrySize;   // keySize + sizeof(long) for the record number
+  long   numEntries;
+  char*  entries;     // sorted by key, then by record number
+  void*  mapping;     // the mmap'd file, header included
+  size_t mappingSize;
+};
+
+
+//
+// functions:
+//
+
+//
+// index_open
+//
+// Opens the index on the given column, building it first if the
+// sidecar file is missing, older than the data file or built from
+// another one. Returns NULL if the column is not indexed or the
+// index cannot be built.
+//
+// NOTE: it is the callers responsibility to free the resources
+// by calling index_close().
+//
+struct Index* index_open(struct Database* db, struct TableMeta* table,
+                         struct ColumnMeta* column);
+
+//
+// index_close
+//
+void index_close(struct Index* index);
+
+//
+// index_lowerBound / index_upperBound
+//
+// Position of the first entry whose key is >= (resp. >) the given
+// value, which is in the same text form as a WHERE literal.
+//
+long index_lowerBound(struct Index* index, char* value);
+long index_upperBound(struct Index* index, char* value);
+
+//
+// index_prefixRange
+//
+// For a string index, sets [*lo, *hi) to the entries whose key
+// starts with prefix.
+//
+void index_prefixRange(struct Index* index, char* prefix, long* lo,
+                       long* hi);
+
+//
+// index_recno
+//
+// Returns the record number stored in entry pos.
+//
+long index_recno(struct Index* index, long pos);
+
+//
+// index_key
+//
+// Returns a pointer to the key of entry pos: an int, a double or a
+// null-terminated string depending on colType. Entries are sorted
+// by key, so equal keys are adjacent.
+//
+char* index_key(struct Index* index, long pos);
+
+//
+// index_merge
+//
+// Merges N new (value, record number) pairs into the index, where
+// values are in the same text form as the fields of a record, and
+// rewrites the sidecar file. *index is closed and replaced by the
+// merged index. Used by writers to maintain the index as records
+// are appended, without rebuilding it from the data file.
+//
+bool index_merge(struct Database* db, struct TableMeta* table,
+                 struct ColumnMeta* column, struct Index** index,
+                 char* values[], long recnos[], long N);
+
+//
+// index_isFresh
+//
+// Returns true if the index exists and is up to date with the data
+// file, i.e. index_open() would not rebuild it.
+//
+bool index_isFresh(struct Database* db, struct TableMeta* table,
+                   struct ColumnMeta* column);
+
+//
+// index_touch
+//
+// Marks the index as up to date with the data file. Writers call
+// this, for indexes that were fresh beforehand, after changing the
+// data file in a way that leaves the index valid (e.g. deleting
+// records, or updating other columns), so that it is not needlessly
+// rebuilt.
+//
+void index_touch(struct Database* db, struct TableMeta* table,
+                 struct ColumnMeta* column);
@@ -0,0 +1,274 @@
+/*insert.c*/
+
+//
+// Bulk appends to SimpleSQL tables.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "index.h"
+#include "insert.h"
+#include "modify.h"
+#include "tablefile.h"
+#include "util.h"
+#include "wal.h"
+#include "zonemap.h"
+
+struct InsertBatch* insert_begin(struct Database* db,
+                                 struct TableMeta* table) {
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  //
+  // bring the zone map and indexes up to date BEFORE appending, so
+  // the new records can be folded in rather than forcing a rebuild:
+  //
+  modify_waitForCompaction();
+  wal_waitForCheckpoint();
+
+  struct ZoneMap* zonemap = zonemap_open(db, table);
+  struct Index** indexes =
+      (struct Index**)calloc(table->numColumns, sizeof(struct Index*));
+  if (indexes == NULL) {
+    panic("No memory");
+  }
+  for (int j = 0; j < table->numColumns; j++) {
+    indexes[j] = index_open(db, table, &table->columns[j]);
+  }
+
+  // dictionaries that are up to date are extended; stale ones are
+  // left for the next query to rebuild
+  struct Dictionary** dicts = (struct Dictionary**)calloc(
+      table->numColumns, sizeof(struct Dictionary*));
+  bool* dictsFresh = (bool*)calloc(table->numColumns, sizeof(bool));
+  if (dicts == NULL || dictsFresh == NULL) {
+    panic("No memory");
+  }
+  for (int j = 0; j < table->numColumns; j++) {
+    dictsFresh[j] = dictionary_load(db, table, &table->columns[j], &dicts[j]);
+  }
+
+  int fd = open(datapath, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd < 0) {
+    printf("**Error: unable to open file '%s' for writing\n", datapath);
+    for (int j = 0; j < table->numColumns; j++) {
+      index_close(indexes[j]);
+      dictionary_close(dicts[j]);
+    }
+    free(indexes);
+    free(dicts);
+    free(dictsFresh);
+    zonemap_close(zonemap);
+    return NULL;
+  }
+
+  struct InsertBatch* batch =
+      (struct InsertBatch*)malloc(sizeof(struct InsertBatch));
+  if (batch == NULL) {
+    panic("No memory");
+  }
+
+  batch->db = db;
+  batch->table = table;
+  batch->fd = fd;
+  batch->numRecords = tablefile_numRecords(fd, table);
+  batch->capacity = INSERT_BATCH_BYTES / table->recordSize;
+  if (batch->capacity < 1) {
+    batch->capacity = 1;
+  }
+  batch->numBuffered = 0;
+  batch->buffer = (char*)malloc(batch->capacity * table->recordSize);
+  batch->fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  if (batch->buffer == NULL || batch->fields == NULL) {
+    panic("No memory");
+  }
+  batch->zonemap = zonemap;
+  batch->indexes = indexes;
+  batch->dicts = dicts;
+  batch->dictsFresh = dictsFresh;
+
+  return batch;
+}
+
+bool insert_row(struct InsertBatch* batch, char* values[]) {
+  struct TableMeta* table = batch->table;
+  char* record = batch->buffer + batch->numBuffered * table->recordSize;
+
+  if (!tablefile_formatRecord(table, values, record)) {
+    return false;
+  }
+  batch->numBuffered++;
+
+  if (batch->numBuffered == batch->capacity) {
+    return insert_flush(batch);
+  }
+  return true;
+}
+
+//
+// dropSidecars
+//
+// Closes the batch's zone map, indexes and dictionaries without
+// saving them, so that they are left stale and rebuilt when next
+// opened.
+//
+static void dropSidecars(struct InsertBatch* batch) {
+  zonemap_close(batch->zonemap);
+  batch->zonemap = NULL;
+  for (int j = 0; j < batch->table->numColumns; j++) {
+    index_close(batch->indexes[j]);
+    batch->indexes[j] = NULL;
+    batch->dictsFresh[j] = false;
+  }
+}
+
+bool insert_flush(struct InsertBatch* batch) {
+  struct TableMeta* table = batch->table;
+  long N = batch->numBuffered;
+  size_t bytes = (size_t)N * table->recordSize;
+
+  if (N == 0) {
+    return true;
+  }
+
+  //
+  // the lock keeps other processes' appends from landing between
+  // the offset logged and the one written to, and from the zone map
+  // and indexes until the new records are in them
+  //
+  flock(batch->fd, LOCK_EX);
+
+  //
+  // the batch is one transaction: durable once in the log, so the
+  // append itself is not synced
+  //
+  off_t offset = lseek(batch->fd, 0, SEEK_END);
+  struct WalTxn* txn = wal_begin(batch->db);
+  wal_write(txn, table, offset, batch->buffer, bytes);
+  bool committed = (offset >= 0) && wal_commit(txn);
+  bool written =
+      committed && tablefile_write(batch->fd, batch->buffer, bytes);
+  if (committed && !written) {
+    // recovery must not append what the caller is told failed
+    if (!wal_abort(txn) || ftruncate(batch->fd, offset) < 0) {
+      panic("unable to undo a failed append");
+    }
+  }
+  wal_end(txn);
+
+  if (!written) {
+    flock(batch->fd, LOCK_UN);
+    printf("**Error: unable to append to table '%s'\n", table->name);
+    batch->numBuffered = 0;
+    return false;
+  }
+
+  // the zone map, indexes and dictionaries do not describe records
+  // another process appended since they were read
+  long first = (long)(offset / table->recordSize);
+  if (first != batch->numRecords) {
+    dropSidecars(batch);
+  }
+
+  //
+  // the records are written; now fold them into the zone map and the
+  // indexes. The buffer is split in place (it is refilled from the
+  // start anyway), and the index values point into it.
+  //
+  char*** values = (char***)calloc(table->numColumns, sizeof(char**));
+  long* recnos = (long*)malloc(sizeof(long) * N);
+  if (values == NULL || recnos == NULL) {
+    panic("No memory");
+  }
+  for (int j = 0; j < table->numColumns; j++) {
+    if (batch->indexes[j] != NULL || batch->dictsFresh[j]) {
+      values[j] = (char**)malloc(sizeof(char*) * N);
+      if (values[j] == NULL) {
+        panic("No memory");
+      }
+    }
+  }
+
+  for (long r = 0; r < N; r++) {
+    char* record = batch->buffer + r * table->recordSize;
+    long recno = first + r;
+
+    record[table->recordSize - 1] = '\0';
+    tablefile_splitFields(record, batch->fields, table->numColumns);
+
+    if (batch->zonemap != NULL) {
+      zonemap_add(batch->zonemap, table, recno, batch->fields);
+    }
+    for (int j = 0; j < table->numColumns; j++) {
+      if (values[j] != NULL) {
+        values[j][r] = batch->fields[j];
+      }
+    }
+    recnos[r] = recno;
+  }
+
+  bool ok = true;
+  if (batch->zonemap != NULL) {
+    ok = zonemap_save(batch->db, table, batch->zonemap);
+  }
+  for (int j = 0; j < table->numColumns; j++) {
+    if (batch->indexes[j] != NULL) {
+      ok = index_merge(batch->db, table, &table->columns[j],
+                       &batch->indexes[j], values[j], recnos, N) &&
+           ok;
+    }
+    if (batch->dictsFresh[j]) {
+      batch->dicts[j] = dictionary_add(batch->dicts[j], values[j], N);
+      ok = dictionary_save(batch->db, table, &table->columns[j],
+                           batch->dicts[j]) &&
+           ok;
+    }
+    free(values[j]);
+  }
+  free(values);
+  free(recnos);
+  flock(batch->fd, LOCK_UN);
+
+  batch->numRecords = first + N;
+  batch->numBuffered = 0;
+
+  if (!ok) {
+    printf("**Error: unable to update the indexes of table '%s'\n",
+           table->name);
+  }
+  return ok;
+}
+
+bool insert_end(struct InsertBatch* batch) {
+  if (batch == NULL) {
+    return false;
+  }
+
+  bool ok = insert_flush(batch);
+
+  close(batch->fd);
+  for (int j = 0; j < batch->table->numColumns; j++) {
+    index_close(batch->indexes[j]);
+    dictionary_close(batch->dicts[j]);
+  }
+  free(batch->indexes);
+  free(batch->dicts);
+  free(batch->dictsFresh);
+  zonemap_close(batch->zonemap);
+  free(batch->fields);
+  free(batch->buffer);
+  free(batch);
+
+  return ok;
+}
@@ -0,0 +1,88 @@
+/*insert.h*/
+
+//
+// Bulk appends to a table. Rows are formatted into fixed-width
+// records of table->recordSize bytes and buffered; a full buffer
+// is committed to the write-ahead log (wal.h) and appended to
+// "<table>.data" with one write, and the table's indexes, zone map
+// and dictionaries are then updated for just the new records.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "database.h"
+#include "dictionary.h"
+#include "index.h"
+#include "zonemap.h"
+
+//
+// bytes of formatted records buffered before a batch is written:
+//
+#define INSERT_BATCH_BYTES (4 * 1024 * 1024)
+
+struct InsertBatch
+{
+  struct Database*  db;
+  struct TableMeta* table;
+  int    fd;             // data file, opened for appending
+  long   numRecords;     // records already in the data file
+  char*  buffer;         // formatted records not yet written
+  long   capacity;       // in records
+  long   numBuffered;
+  char** fields;         // scratch, one per column
+  struct ZoneMap* zonemap;
+  struct Index**  indexes;  // indexes[j] for column j, NULL if not indexed
+  struct Dictionary** dicts;  // dicts[j] for string column j, NULL if not
+                              // encoded
+  bool*  dictsFresh;          // dictsFresh[j]: kept up to date
+};
+
+
+//
+// functions:
+//
+
+//
+// insert_begin
+//
+// Opens the table for appending. Returns NULL (after printing an
+// error) if the data file cannot be opened.
+//
+// NOTE: it is the callers responsibility to finish the batch by
+// calling insert_end().
+//
+struct InsertBatch* insert_begin(struct Database* db,
+                                 struct TableMeta* table);
+
+//
+// insert_row
+//
+// Formats one row, given as one text value per column in table
+// order (strings without quotes), and buffers it; writes the batch
+// if the buffer is full. Returns false if the row does not fit the
+// table's schema or record size, or if a write fails.
+//
+bool insert_row(struct InsertBatch* batch, char* values[]);
+
+//
+// insert_flush
+//
+// Commits the buffered records to the write-ahead log, appends them
+// to the data file, and folds them into the zone map, indexes and
+// dictionaries, holding an flock on the data file throughout.
+//
+bool insert_flush(struct InsertBatch* batch);
+
+//
+// insert_end
+//
+// Flushes the batch and frees its resources. Returns false if the
+// final flush failed.
+//
+bool insert_end(struct InsertBatch* batch);
@@ -0,0 +1,241 @@
+/*like.c*/
+
+//
+// Compiled LIKE patterns for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#define _GNU_SOURCE  // memmem
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "like.h"
+#include "util.h"
+
+//
+// segment_matchAt
+//
+// Does the segment match the chars starting at s? The caller
+// guarantees at least segment->length chars are available.
+//
+static bool segment_matchAt(struct LikeSegment* segment, char* s) {
+  if (!segment->hasUnderscore) {
+    return memcmp(s, segment->text, segment->length) == 0;
+  }
+
+  for (int i = 0; i < segment->length; i++) {
+    if (segment->text[i] != '_' && segment->text[i] != s[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// segment_find
+//
+// Returns the leftmost position >= start where the segment matches
+// entirely before end, or -1 if there is none.
+//
+static long segment_find(struct LikeSegment* segment, char* s, long start,
+                         long end) {
+  if (end - start < segment->length) {
+    return -1;
+  }
+
+  if (!segment->hasUnderscore) {
+    char* found = memmem(s + start, end - start, segment->text,
+                         segment->length);
+    return (found == NULL) ? -1 : (long)(found - s);
+  }
+
+  for (long pos = start; pos + segment->length <= end; pos++) {
+    if (segment_matchAt(segment, s + pos)) {
+      return pos;
+    }
+  }
+  return -1;
+}
+
+struct LikePattern* like_compile(char* pattern) {
+  if (pattern == NULL) {
+    panic("pattern is NULL (like_compile)");
+  }
+
+  struct LikePattern* like =
+      (struct LikePattern*)malloc(sizeof(struct LikePattern));
+  int length = strlen(pattern);
+
+  if (like == NULL) {
+    panic("No memory");
+  }
+
+  //
+  // the copy is cut up in place, one null-terminated segment per
+  // run of chars between '%' wildcards:
+  //
+  like->pattern = (char*)malloc(length + 1);
+  like->segments =
+      (struct LikeSegment*)malloc(sizeof(struct LikeSegment) * (length + 1));
+  if (like->pattern == NULL || like->segments == NULL) {
+    panic("No memory");
+  }
+  strcpy(like->pattern, pattern);
+
+  like->numSegments = 0;
+  like->minLength = 0;
+  like->anchoredStart = (length == 0 || pattern[0] != '%');
+  like->anchoredEnd = (length == 0 || pattern[length - 1] != '%');
+
+  bool anyPercent = false;
+  bool anyUnderscore = false;
+  char* cp = like->pattern;
+
+  while (*cp != '\0') {
+    if (*cp == '%') {
+      anyPercent = true;
+      cp++;
+      continue;
+    }
+
+    struct LikeSegment* segment = &like->segments[like->numSegments];
+    segment->text = cp;
+    segment->hasUnderscore = false;
+    while (*cp != '\0' && *cp != '%') {
+      if (*cp == '_') {
+        segment->hasUnderscore = true;
+        anyUnderscore = true;
+      }
+      cp++;
+    }
+    segment->length = (int)(cp - segment->text);
+    like->minLength += segment->length;
+    like->numSegments++;
+
+    if (*cp == '%') {
+      anyPercent = true;
+      *cp = '\0';
+      cp++;
+    }
+  }
+
+  //
+  // pick a fast path if the pattern has one:
+  //
+  like->kind = LIKE_GENERAL;
+  if (!anyPercent && !anyUnderscore) {
+    like->kind = LIKE_EXACT;
+  } else if (like->numSegments == 1 && !anyUnderscore) {
+    if (like->anchoredStart) {
+      like->kind = LIKE_PREFIX;
+    } else if (like->anchoredEnd) {
+      like->kind = LIKE_SUFFIX;
+    } else {
+      like->kind = LIKE_CONTAINS;
+    }
+  }
+
+  return like;
+}
+
+bool like_match(struct LikePattern* like, char* s, size_t length) {
+  if (length < (size_t)like->minLength) {
+    return false;
+  }
+  if (like->numSegments == 0) {
+    // '' only matches the empty string, '%' matches everything
+    return !like->anchoredStart || length == 0;
+  }
+
+  struct LikeSegment* first = &like->segments[0];
+  struct LikeSegment* last = &like->segments[like->numSegments - 1];
+
+  switch (like->kind) {
+    case LIKE_EXACT:
+      return length == (size_t)first->length &&
+             memcmp(s, first->text, length) == 0;
+    case LIKE_PREFIX:
+      return memcmp(s, first->text, first->length) == 0;
+    case LIKE_SUFFIX:
+      return memcmp(s + length - first->length, first->text,
+                    first->length) == 0;
+    case LIKE_CONTAINS:
+      return memmem(s, length, first->text, first->length) != NULL;
+    default:
+      break;
+  }
+
+  //
+  // general case: anchored segments must match at either end, and
+  // every other segment is matched at its leftmost position after
+  // the previous one. Taking the leftmost match is always safe for
+  // '%' wildcards, so there is never a need to backtrack.
+  //
+  if (like->anchoredStart && like->anchoredEnd && like->numSegments == 1) {
+    // no '%' at all, e.g. 'a_c'
+    return length == (size_t)first->length && segment_matchAt(first, s);
+  }
+
+  long pos = 0;
+  long end = (long)length;
+  int lo = 0;
+  int hi = like->numSegments - 1;
+
+  if (like->anchoredStart) {
+    if (!segment_matchAt(first, s)) {
+      return false;
+    }
+    pos = first->length;
+    lo++;
+  }
+
+  if (like->anchoredEnd) {
+    end = (long)length - last->length;
+    if (end < pos || !segment_matchAt(last, s + end)) {
+      return false;
+    }
+    hi--;
+  }
+
+  for (int i = lo; i <= hi; i++) {
+    long found = segment_find(&like->segments[i], s, pos, end);
+    if (found < 0) {
+      return false;
+    }
+    pos = found + like->segments[i].length;
+  }
+
+  return true;
+}
+
+int like_prefix(struct LikePattern* like, char* prefix) {
+  if (!like->anchoredStart || like->numSegments == 0) {
+    prefix[0] = '\0';
+    return 0;
+  }
+
+  struct LikeSegment* first = &like->segments[0];
+  int length = 0;
+
+  while (length < first->length && first->text[length] != '_') {
+    prefix[length] = first->text[length];
+    length++;
+  }
+  prefix[length] = '\0';
+  return length;
+}
+
+void like_destroy(struct LikePattern* like) {
+  if (like == NULL) {
+    return;
+  }
+  free(like->segments);
+  free(like->pattern);
+  free(like);
+}
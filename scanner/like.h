@@ -0,0 +1,85 @@
+/*like.h*/
+
+//
+// Compiled LIKE patterns. A pattern is compiled once per query;
+// patterns of the form 'abc', 'abc%', '%abc' and '%abc%' match
+// with a single memcmp / memmem, everything else with a matcher
+// that never backtracks.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+enum LikeKind
+{
+  LIKE_EXACT = 0,  // 'abc'
+  LIKE_PREFIX,     // 'abc%'
+  LIKE_SUFFIX,     // '%abc'
+  LIKE_CONTAINS,   // '%abc%'
+  LIKE_GENERAL     // anything else, e.g. 'a_c%x%z'
+};
+
+//
+// the text between two '%' wildcards; '_' matches any one char
+//
+struct LikeSegment
+{
+  char* text;
+  int   length;
+  bool  hasUnderscore;
+};
+
+struct LikePattern
+{
+  int    kind;
+  char*  pattern;      // copy of the pattern, owned
+  int    numSegments;
+  struct LikeSegment* segments;  // pointer to ARRAY of segments
+  bool   anchoredStart;  // pattern does not start with '%'
+  bool   anchoredEnd;    // pattern does not end with '%'
+  int    minLength;      // shortest string that can match
+};
+
+
+//
+// functions:
+//
+
+//
+// like_compile
+//
+// Compiles the pattern; '%' matches any sequence of chars and '_'
+// matches exactly one char.
+//
+// NOTE: it is the callers responsibility to free the pattern by
+// calling like_destroy().
+//
+struct LikePattern* like_compile(char* pattern);
+
+//
+// like_match
+//
+// Returns true if the string of the given length matches.
+//
+bool like_match(struct LikePattern* like, char* s, size_t length);
+
+//
+// like_prefix
+//
+// Returns the literal prefix every match must start with (chars up
+// to the first wildcard), copied into prefix, which must hold
+// strlen(pattern) + 1 chars. Returns the prefix length; 0 means
+// the pattern starts with a wildcard.
+//
+int like_prefix(struct LikePattern* like, char* prefix);
+
+//
+// like_destroy
+//
+void like_destroy(struct LikePattern* like);
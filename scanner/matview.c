@@ -0,0 +1,812 @@
+/*matview.c*/
+
+//
+// Materialized aggregates for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "aggregate.h"
+#include "ast.h"
+#include "batch.h"
+#include "database.h"
+#include "encode.h"
+#include "fieldparse.h"
+#include "grouptable.h"
+#include "matview.h"
+#include "predicate.h"
+#include "readahead.h"
+#include "resultset.h"
+#include "rowkey.h"
+#include "schemamap.h"
+#include "tablefile.h"
+#include "util.h"
+
+#define MATVIEW_MAGIC "SQLMVIW1"
+#define MATVIEW_MAX_SIGNATURE 512
+#define MATVIEW_MAX_KEY (64 * 1024)
+
+//
+// a view that has not changed is saved again, to record that it was
+// used, at most this often:
+//
+#define MATVIEW_TOUCH_SECONDS 60
+
+static char* functions[] = {"", "MIN", "MAX", "SUM", "AVG", "COUNT"};
+static char* opers[] = {"<", "<=", ">", ">=", "=", "<>", "like"};
+
+//
+// loading, folding into and saving the views of a table is one
+// critical section, so a view is never saved over the invalidation
+// of the records it was folded from: the mutex orders this process's
+// threads, and an flock of the table's lock file (which, unlike the
+// sidecar, is never replaced) the other processes:
+//
+static pthread_mutex_t matviewLock = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// sidecar format: the header, then per view a ViewHeader followed by
+// bodyBytes of groups, each its key length, key (rowkey.h, without
+// dictionaries, so keys outlive a rebuilt dictionary) and the
+// states of its aggregates
+//
+struct MatviewHeader
+{
+  char magic[8];
+  int  numViews;
+  int  recordSize;
+  unsigned long device;  // of the data file the views were folded
+  unsigned long inode;   // from; compaction replaces the file
+};
+
+struct ViewHeader
+{
+  char signature[MATVIEW_MAX_SIGNATURE];  // the query, '\0'-padded
+  long numRecords;  // records [0, numRecords) are folded in
+  long lastUsed;    // time()
+  int  numAggs;
+  long numGroups;
+  long bodyBytes;
+};
+
+//
+// a view as saved, the body unparsed:
+//
+struct StoredView
+{
+  struct ViewHeader header;
+  char* body;
+};
+
+//
+// the view of the query, its groups in the order they first
+// appeared, each with the states of the query's aggregates:
+//
+struct View
+{
+  struct ViewHeader header;
+  struct GroupTable* groups;
+};
+
+//
+// the query, resolved against the table:
+//
+struct Query
+{
+  struct TableMeta* table;
+  char   signature[MATVIEW_MAX_SIGNATURE];
+  int    numGroupColumns;
+  int*   groupColumns;  // 0-based table columns
+  int*   groupTypes;
+  int    numAggs;
+  struct Aggregate* aggs;
+};
+
+bool matview_enabled(void) {
+  return getenv("SIMPLESQL_MATVIEW") != NULL;
+}
+
+static void matviewPath(struct Database* db, struct TableMeta* table,
+                        char* path) {
+  tablefile_path(db, table, ".mview", path);
+}
+
+//
+// lockViews
+//
+// Takes the flock (LOCK_SH or LOCK_EX) on the table's views, and
+// returns the lock file's descriptor for unlockViews(); -1 if the
+// lock file cannot be created, e.g. in a read-only directory, in
+// which case no other process can save a view either.
+//
+static int lockViews(struct Database* db, struct TableMeta* table,
+                     int operation) {
+  char path[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".mview.lock", path);
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd >= 0) {
+    flock(fd, operation);
+  }
+  return fd;
+}
+
+static void unlockViews(int lockfd) {
+  if (lockfd >= 0) {
+    flock(lockfd, LOCK_UN);
+    close(lockfd);
+  }
+}
+
+//
+// view_create
+//
+// Returns a view of the query with no groups and no records folded.
+//
+static struct View* view_create(struct Query* q) {
+  struct View* v = (struct View*)malloc(sizeof(struct View));
+  if (v == NULL) {
+    panic("No memory");
+  }
+
+  memset(&v->header, 0, sizeof(v->header));
+  memcpy(v->header.signature, q->signature, MATVIEW_MAX_SIGNATURE);
+  v->header.numAggs = q->numAggs;
+  v->groups = grouptable_create(q->numAggs * (int)sizeof(struct AggState), 0);
+  return v;
+}
+
+static void view_destroy(struct View* v) {
+  if (v == NULL) {
+    return;
+  }
+  grouptable_destroy(v->groups);
+  free(v);
+}
+
+//
+// view_find
+//
+// Returns the aggregate states of the group, adding the group with
+// empty states if it is new (*isNew, unless NULL, tells which). The
+// pointer is only valid until the next call.
+//
+static struct AggState* view_find(struct View* v, char* key, int length,
+                                  unsigned long hash, bool* isNew) {
+  bool added;
+  struct AggState* states =
+      (struct AggState*)grouptable_find(v->groups, key, length, hash, &added);
+  if (added) {
+    aggregate_init(states, v->header.numAggs);
+  }
+  if (isNew != NULL) {
+    *isNew = added;
+  }
+  return states;
+}
+
+//
+// view_parse
+//
+// Returns the view saved with the given header and body, or NULL if
+// the body is corrupt.
+//
+static struct View* view_parse(struct Query* q, struct StoredView* stored) {
+  if (stored->header.numAggs != q->numAggs) {
+    return NULL;
+  }
+
+  struct View* v = view_create(q);
+  long stateBytes = (long)sizeof(struct AggState) * q->numAggs;
+  char* cp = stored->body;
+  char* end = stored->body + stored->header.bodyBytes;
+
+  for (long g = 0; g < stored->header.numGroups; g++) {
+    int length;
+    if (end - cp < (long)sizeof(int)) {
+      view_destroy(v);
+      return NULL;
+    }
+    memcpy(&length, cp, sizeof(int));
+    cp += sizeof(int);
+    if (length < 0 || length > MATVIEW_MAX_KEY ||
+        end - cp < length + stateBytes) {
+      view_destroy(v);
+      return NULL;
+    }
+
+    bool isNew;
+    struct AggState* states =
+        view_find(v, cp, length, rowkey_hash(cp, length), &isNew);
+    if (!isNew) {  // the same key twice
+      view_destroy(v);
+      return NULL;
+    }
+    memcpy(states, cp + length, stateBytes);
+    cp += length + stateBytes;
+  }
+
+  v->header.numRecords = stored->header.numRecords;
+  v->header.lastUsed = stored->header.lastUsed;
+  return v;
+}
+
+//
+// loadViews
+//
+// Reads the table's saved views into stored[], skipping their bodies
+// unless withBodies; returns how many. Views folded from another
+// data file than the one described by data, e.g. before the table
+// was compacted, are discarded.
+//
+static int loadViews(struct Database* db, struct TableMeta* table,
+                     struct stat* data, struct StoredView stored[],
+                     bool withBodies) {
+  char path[TABLEFILE_MAX_PATH];
+  matviewPath(db, table, path);
+
+  FILE* input = fopen(path, "r");
+  if (input == NULL) {
+    return 0;
+  }
+
+  struct MatviewHeader header;
+  if (fread(&header, sizeof(header), 1, input) != 1 ||
+      memcmp(header.magic, MATVIEW_MAGIC, sizeof(header.magic)) != 0 ||
+      header.numViews < 0 || header.numViews > MATVIEW_MAX_VIEWS ||
+      header.recordSize != table->recordSize ||
+      header.device != (unsigned long)data->st_dev ||
+      header.inode != (unsigned long)data->st_ino) {
+    fclose(input);
+    return 0;
+  }
+
+  int N = 0;
+  while (N < header.numViews) {
+    struct StoredView* sv = &stored[N];
+    if (fread(&sv->header, sizeof(sv->header), 1, input) != 1 ||
+        sv->header.signature[MATVIEW_MAX_SIGNATURE - 1] != '\0' ||
+        sv->header.numAggs <= 0 || sv->header.numGroups < 0 ||
+        sv->header.bodyBytes < 0 || sv->header.numRecords < 0) {
+      break;
+    }
+
+    sv->body = NULL;
+    if (!withBodies) {
+      if (fseek(input, sv->header.bodyBytes, SEEK_CUR) < 0) {
+        break;
+      }
+    } else {
+      sv->body = (char*)malloc(sv->header.bodyBytes + 1);
+      if (sv->body == NULL) {
+        panic("No memory");
+      }
+      if (fread(sv->body, 1, sv->header.bodyBytes, input) !=
+          (size_t)sv->header.bodyBytes) {
+        free(sv->body);
+        break;
+      }
+    }
+    N++;
+  }
+  fclose(input);
+
+  // a truncated file keeps the views read in full
+  return N;
+}
+
+static bool writeView(FILE* output, struct View* v) {
+  struct GroupTable* t = v->groups;
+  int numAggs = v->header.numAggs;
+
+  v->header.numGroups = t->count;
+  v->header.bodyBytes = 0;
+  for (long g = 0; g < t->count; g++) {
+    v->header.bodyBytes += sizeof(int) + t->keys[g].length +
+                           (long)sizeof(struct AggState) * numAggs;
+  }
+
+  if (fwrite(&v->header, sizeof(v->header), 1, output) != 1) {
+    return false;
+  }
+  for (long g = 0; g < t->count; g++) {
+    int length = t->keys[g].length;
+    if (fwrite(&length, sizeof(int), 1, output) != 1 ||
+        fwrite(grouptable_key(t, g), 1, length, output) != (size_t)length ||
+        fwrite(grouptable_payload(t, g), sizeof(struct AggState), numAggs,
+               output) != (size_t)numAggs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// saveViews
+//
+// Writes the views, the given one (if not NULL) and the stored ones
+// but for the one at index skip (-1 => none), via a temporary file.
+// The least recently used stored views are dropped to keep at most
+// MATVIEW_MAX_VIEWS.
+//
+static bool saveViews(struct Database* db, struct TableMeta* table,
+                      struct stat* data, struct View* v,
+                      struct StoredView stored[], int numStored, int skip) {
+  char path[TABLEFILE_MAX_PATH];
+  char tmppath[TABLEFILE_MAX_PATH + 32];
+
+  matviewPath(db, table, path);
+  snprintf(tmppath, sizeof(tmppath), "%s.%d.tmp", path, (int)getpid());
+
+  bool keep[MATVIEW_MAX_VIEWS];
+  int numViews = (v != NULL) ? 1 : 0;
+  for (int i = 0; i < numStored; i++) {
+    keep[i] = (i != skip);
+    numViews += keep[i] ? 1 : 0;
+  }
+  while (numViews > MATVIEW_MAX_VIEWS) {
+    int oldest = -1;
+    for (int i = 0; i < numStored; i++) {
+      if (keep[i] && (oldest < 0 || stored[i].header.lastUsed <
+                                        stored[oldest].header.lastUsed)) {
+        oldest = i;
+      }
+    }
+    keep[oldest] = false;
+    numViews--;
+  }
+
+  FILE* output = fopen(tmppath, "w");
+  if (output == NULL) {
+    return false;
+  }
+
+  struct MatviewHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MATVIEW_MAGIC, sizeof(header.magic));
+  header.numViews = numViews;
+  header.recordSize = table->recordSize;
+  header.device = (unsigned long)data->st_dev;
+  header.inode = (unsigned long)data->st_ino;
+
+  bool ok = fwrite(&header, sizeof(header), 1, output) == 1;
+  if (ok && v != NULL) {
+    ok = writeView(output, v);
+  }
+  for (int i = 0; ok && i < numStored; i++) {
+    if (keep[i]) {
+      ok = fwrite(&stored[i].header, sizeof(stored[i].header), 1, output) ==
+               1 &&
+           fwrite(stored[i].body, 1, stored[i].header.bodyBytes, output) ==
+               (size_t)stored[i].header.bodyBytes;
+    }
+  }
+
+  ok = (fclose(output) == 0) && ok;
+  if (!ok || rename(tmppath, path) < 0) {
+    unlink(tmppath);
+    return false;
+  }
+  return true;
+}
+
+//
+// compile
+//
+// Resolves the group columns and aggregates of the query into q,
+// and its signature: the group columns, aggregates and WHERE
+// clause, which together determine the view. Returns false if the
+// query cannot be answered from a view.
+//
+static bool compile(struct TableMeta* table, struct SELECT* select,
+                    struct COLUMN* groupBy, struct Query* q) {
+  char* sig = q->signature;
+  int room = MATVIEW_MAX_SIGNATURE;
+  int n;
+
+  memset(q->signature, 0, sizeof(q->signature));
+  n = snprintf(sig, room, "group=");
+  sig += n;
+  room -= n;
+
+  for (struct COLUMN* c = groupBy; c != NULL; c = c->next) {
+    struct ColumnMeta* column = database_findColumn(table, c->name);
+    if (column == NULL) {
+      return false;
+    }
+    q->groupColumns[q->numGroupColumns] = (int)(column - table->columns);
+    q->groupTypes[q->numGroupColumns] = column->colType;
+    q->numGroupColumns++;
+
+    n = snprintf(sig, room, "%s%s", column->name, (c->next != NULL) ? "," : "");
+    if (n >= room) {
+      return false;
+    }
+    sig += n;
+    room -= n;
+  }
+
+  n = snprintf(sig, room, ";aggs=");
+  if (n >= room) {
+    return false;
+  }
+  sig += n;
+  room -= n;
+
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    struct ColumnMeta* column = database_findColumn(table, c->name);
+    assert(column != NULL);
+    int col = (int)(column - table->columns);
+
+    if (c->function == NO_FUNCTION) {
+      bool grouped = false;
+      for (int k = 0; k < q->numGroupColumns; k++) {
+        grouped = grouped || (q->groupColumns[k] == col);
+      }
+      if (!grouped) {
+        return false;
+      }
+      continue;
+    }
+    if (c->function != COUNT_FUNCTION && column->colType == COL_TYPE_STRING) {
+      return false;
+    }
+
+    q->aggs[q->numAggs].function = c->function;
+    q->aggs[q->numAggs].column = col;
+    q->aggs[q->numAggs].colType = column->colType;
+    q->numAggs++;
+
+    n = snprintf(sig, room, "%s(%s),", functions[c->function], column->name);
+    if (n >= room) {
+      return false;
+    }
+    sig += n;
+    room -= n;
+  }
+  if (q->numAggs == 0) {
+    return false;
+  }
+
+  if (select->where != NULL) {
+    struct EXPR* expr = select->where->expr;
+    n = snprintf(sig, room, ";where=%s %s %d:%s", expr->column->name,
+                 opers[expr->operator], expr->litType, expr->value);
+    if (n >= room) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void query_destroy(struct Query* q) {
+  free(q->aggs);
+  free(q->groupTypes);
+  free(q->groupColumns);
+}
+
+//
+// query_create
+//
+// Resolves the query into q; returns false, with q freed, if it
+// cannot be answered from a view.
+//
+static bool query_create(struct Database* db, struct SELECT* select,
+                         struct COLUMN* groupBy, struct Query* q) {
+  struct TableMeta* table = database_findTable(db, select->table);
+  assert(table != NULL);
+
+  int numColumns = 0, numGroup = 0;
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    numColumns++;
+  }
+  for (struct COLUMN* c = groupBy; c != NULL; c = c->next) {
+    numGroup++;
+  }
+
+  q->table = table;
+  q->numGroupColumns = 0;
+  q->groupColumns = (int*)malloc(sizeof(int) * (numGroup + 1));
+  q->groupTypes = (int*)malloc(sizeof(int) * (numGroup + 1));
+  q->numAggs = 0;
+  q->aggs = (struct Aggregate*)malloc(sizeof(struct Aggregate) *
+                                      (numColumns + 1));
+  if (q->groupColumns == NULL || q->groupTypes == NULL || q->aggs == NULL) {
+    panic("No memory");
+  }
+
+  if (select->into != NULL || !compile(table, select, groupBy, q)) {
+    query_destroy(q);
+    return false;
+  }
+  return true;
+}
+
+static int findView(struct Query* q, struct StoredView stored[], int N) {
+  for (int i = 0; i < N; i++) {
+    if (memcmp(stored[i].header.signature, q->signature,
+               MATVIEW_MAX_SIGNATURE) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+//
+// fold
+//
+// Folds records [first, last) of the open data file, the live ones
+// that satisfy the predicate (NULL => every record), into the view.
+//
+static void fold(struct Query* q, struct View* v, struct Predicate* pred,
+                 int fd, long first, long last, struct ReadAheadStats* io) {
+  struct TableMeta* table = q->table;
+
+  char* buffer = (char*)malloc(table->recordSize + 1);
+  char** fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  int* lengths = (int*)malloc(sizeof(int) * table->numColumns);
+  char** values = (char**)malloc(sizeof(char*) * (q->numGroupColumns + 1));
+  int keyCapacity = 64;
+  char* key = (char*)malloc(keyCapacity);
+  if (buffer == NULL || fields == NULL || lengths == NULL || values == NULL ||
+      key == NULL) {
+    panic("No memory");
+  }
+
+  struct ReadAhead* ra = readahead_start(
+      fd, (off_t)first * table->recordSize,
+      (off_t)(last - first) * table->recordSize, table->recordSize);
+
+  char* chunk;
+  long length;
+  while ((chunk = readahead_next(ra, &length)) != NULL) {
+    long numInChunk = length / table->recordSize;
+    for (long r = 0; r < numInChunk; r++) {
+      memcpy(buffer, chunk + r * table->recordSize, table->recordSize);
+      buffer[table->recordSize] = '\0';
+
+      if (tablefile_isDeleted(buffer) ||
+          fieldparse_split(buffer, fields, lengths, table->numColumns) <
+              table->numColumns) {
+        continue;
+      }
+      if (pred != NULL && !pred->evalRecord(pred, fields, lengths)) {
+        continue;
+      }
+
+      for (int k = 0; k < q->numGroupColumns; k++) {
+        values[k] = fields[q->groupColumns[k]];
+      }
+      int n = rowkey_encode(q->groupTypes, NULL, q->numGroupColumns, values,
+                            &key, &keyCapacity);
+      struct AggState* states =
+          view_find(v, key, n, rowkey_hash(key, n), NULL);
+      aggregate_fold(q->aggs, states, q->numAggs, fields, lengths);
+    }
+  }
+
+  readahead_finish(ra, io);
+  free(key);
+  free(values);
+  free(lengths);
+  free(fields);
+  free(buffer);
+}
+
+//
+// output
+//
+// Prints one row per group of the view, with the columns in the
+// order of the query, up to the query's LIMIT.
+//
+static void output(struct Query* q, struct View* v, struct SELECT* select) {
+  struct TableMeta* table = q->table;
+  struct ResultSet* result = resultset_create();
+
+  int position = 1;
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    struct ColumnMeta* column = database_findColumn(table, c->name);
+    resultset_insertColumn(result, position++, table->name, column->name,
+                           c->function,
+                           aggregate_type(c->function, column->colType));
+  }
+
+  char** starts = (char**)malloc(sizeof(char*) * (q->numGroupColumns + 1));
+  if (starts == NULL) {
+    panic("No memory");
+  }
+
+  long numRows = v->groups->count;
+  if (select->limit != NULL && select->limit->N < numRows) {
+    numRows = (select->limit->N > 0) ? select->limit->N : 0;
+  }
+
+  for (long g = 0; g < numRows; g++) {
+    char* cp = grouptable_key(v->groups, g);
+    for (int k = 0; k < q->numGroupColumns; k++) {
+      starts[k] = cp;
+      cp = rowkey_skip(q->groupTypes[k], cp);
+    }
+
+    struct AggState* states =
+        (struct AggState*)grouptable_payload(v->groups, g);
+    int row = resultset_addRow(result);
+    int a = 0;
+    position = 1;
+
+    for (struct COLUMN* c = select->columns; c != NULL;
+         c = c->next, position++) {
+      if (c->function == NO_FUNCTION) {
+        struct ColumnMeta* column = database_findColumn(table, c->name);
+        int col = (int)(column - table->columns);
+        int k = 0;
+        while (q->groupColumns[k] != col) {
+          k++;
+        }
+        rowkey_output(result, row, position, &q->groupTypes[k], NULL, 1,
+                      starts[k]);
+        continue;
+      }
+
+      aggregate_output(result, row, position, &q->aggs[a], &states[a]);
+      a++;
+    }
+  }
+
+  encode_resultSet(result);
+  batch_countRows(result->numRows);
+  resultset_destroy(result);
+  free(starts);
+}
+
+bool matview_execute(struct Database* db, struct SELECT* select,
+                     struct COLUMN* groupBy) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  struct Query q;
+  if (!query_create(db, select, groupBy, &q)) {
+    return false;
+  }
+  struct TableMeta* table = q.table;
+
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  pthread_mutex_lock(&matviewLock);
+  int lockfd = lockViews(db, table, LOCK_EX);
+
+  int fd = open(datapath, O_RDONLY);
+  struct stat data;
+  if (fd < 0 || fstat(fd, &data) < 0) {
+    printf("**Error: file '%s'is not found.", datapath);
+    panic("stop execution");
+  }
+  long numRecords = tablefile_numRecords(fd, table);
+  if (numRecords < 0) {
+    numRecords = 0;
+  }
+
+  struct StoredView stored[MATVIEW_MAX_VIEWS];
+  int numStored = loadViews(db, table, &data, stored, true);
+  int index = findView(&q, stored, numStored);
+
+  struct View* v = NULL;
+  if (index >= 0 && stored[index].header.numRecords <= numRecords) {
+    v = view_parse(&q, &stored[index]);
+  }
+  bool created = (v == NULL);
+  if (created) {
+    v = view_create(&q);
+  }
+
+  //
+  // fold in the records appended since the view was last used:
+  //
+  long first = v->header.numRecords;
+  if (first < numRecords) {
+    struct Predicate* pred = NULL;
+    if (select->where != NULL) {
+      pred = predicate_compile(table, select->where->expr);
+    }
+
+    struct ReadAheadStats io;
+    memset(&io, 0, sizeof(io));
+    fold(&q, v, pred, fd, first, numRecords, &io);
+    readahead_report(table->name, &io);
+
+    if (pred != NULL) {
+      predicate_destroy(pred);
+    }
+  }
+  close(fd);
+
+  output(&q, v, select);
+
+  long now = (long)time(NULL);
+  bool changed = created || (first < numRecords) ||
+                 (now - v->header.lastUsed >= MATVIEW_TOUCH_SECONDS);
+  v->header.numRecords = numRecords;
+  v->header.lastUsed = now;
+  if (changed) {
+    // a view with too many groups is answered, but not kept
+    struct View* saved = (v->groups->count <= MATVIEW_MAX_GROUPS) ? v : NULL;
+    if (saved != NULL || index >= 0) {
+      saveViews(db, table, &data, saved, stored, numStored, index);
+    }
+  }
+
+  unlockViews(lockfd);
+  pthread_mutex_unlock(&matviewLock);
+
+  for (int i = 0; i < numStored; i++) {
+    free(stored[i].body);
+  }
+  view_destroy(v);
+  query_destroy(&q);
+  return true;
+}
+
+long matview_numFolded(struct Database* db, struct SELECT* select,
+                       struct COLUMN* groupBy) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  struct Query q;
+  if (!query_create(db, select, groupBy, &q)) {
+    return -1;
+  }
+
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, q.table, ".data", datapath);
+
+  long numFolded = -1;
+  pthread_mutex_lock(&matviewLock);
+  int lockfd = lockViews(db, q.table, LOCK_SH);
+
+  struct stat data;
+  if (stat(datapath, &data) == 0) {
+    struct StoredView stored[MATVIEW_MAX_VIEWS];
+    int numStored = loadViews(db, q.table, &data, stored, false);
+    int index = findView(&q, stored, numStored);
+    if (index >= 0) {
+      numFolded = stored[index].header.numRecords;
+    }
+  }
+
+  unlockViews(lockfd);
+  pthread_mutex_unlock(&matviewLock);
+  query_destroy(&q);
+  return numFolded;
+}
+
+void matview_invalidate(struct Database* db, struct TableMeta* table) {
+  if (db == NULL || table == NULL) {
+    panic("one or more parameters are NULL (matview_invalidate)");
+  }
+
+  char path[TABLEFILE_MAX_PATH];
+  matviewPath(db, table, path);
+
+  pthread_mutex_lock(&matviewLock);
+  int lockfd = lockViews(db, table, LOCK_EX);
+  unlink(path);
+  unlockViews(lockfd);
+  pthread_mutex_unlock(&matviewLock);
+}
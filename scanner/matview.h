@@ -0,0 +1,83 @@
+/*matview.h*/
+
+//
+// Materialized aggregates for SimpleSQL. A query whose columns are
+// all aggregates (COUNT, SUM, AVG, MIN, MAX), optionally grouped,
+// is answered from a view: the running state of its aggregates,
+// per group, over the records [0, numRecords) of the data file. On
+// the next run of the same query only the records appended since,
+// found from the size of the data file, are folded in, so answering
+// costs as much as the new data rather than the whole table.
+//
+// The views of a table, at most MATVIEW_MAX_VIEWS, the least
+// recently used going first, are saved in the sidecar file
+// <table>.mview. Records are only ever appended by INSERT; UPDATE,
+// DELETE and compaction drop the table's views, which are rebuilt
+// by the next query.
+//
+// Set the environment variable SIMPLESQL_MATVIEW to have aggregate
+// queries answered this way.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "database.h"
+
+#define MATVIEW_MAX_VIEWS 16
+
+//
+// a view with more groups than this is still answered, but not
+// saved:
+//
+#define MATVIEW_MAX_GROUPS (1024 * 1024)
+
+
+//
+// functions:
+//
+
+//
+// matview_enabled
+//
+// Returns true if SIMPLESQL_MATVIEW is set.
+//
+bool matview_enabled(void);
+
+//
+// matview_execute
+//
+// Answers the query, grouped by the given columns (NULL if not
+// grouped), from its view, creating the view or folding in the
+// records appended since it was last used, and prints the result:
+// one row per group, or one row if not grouped and any record
+// qualifies. Returns false, having printed nothing, if the query
+// cannot be answered from a view, e.g. it selects a column that is
+// neither aggregated nor grouped; the caller then executes it as
+// usual.
+//
+bool matview_execute(struct Database* db, struct SELECT* select,
+                     struct COLUMN* groupBy);
+
+//
+// matview_numFolded
+//
+// Returns the number of records the query's view already covers,
+// or -1 if the query has no view (yet).
+//
+long matview_numFolded(struct Database* db, struct SELECT* select,
+                       struct COLUMN* groupBy);
+
+//
+// matview_invalidate
+//
+// Drops the table's views, e.g. after its records were modified in
+// place.
+//
+void matview_invalidate(struct Database* db, struct TableMeta* table);
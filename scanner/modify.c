@@ -0,0 +1,560 @@
+/*modify.c*/
+
+//
+// UPDATE and DELETE for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "database.h"
+#include "dictionary.h"
+#include "fieldparse.h"
+#include "index.h"
+#include "matview.h"
+#include "modify.h"
+#include "predicate.h"
+#include "schemamap.h"
+#include "tablefile.h"
+#include "util.h"
+#include "wal.h"
+#include "zonemap.h"
+
+//
+// records read per pread when scanning the data file, and examined
+// per write-ahead log transaction:
+//
+#define MODIFY_SCAN_RECORDS 4096
+
+enum ModifyKind
+{
+  MODIFY_DELETE = 0,
+  MODIFY_UPDATE
+};
+
+//
+// state shared by every record of one UPDATE / DELETE:
+//
+struct Modification
+{
+  struct Database*  db;
+  struct TableMeta* table;
+  int    kind;
+  int    fd;
+  struct Predicate* pred;  // NULL => every record
+  int    column;           // 0-based column to set (UPDATE)
+  char*  value;            // its new value (UPDATE)
+  char*  scratch;          // copy of the record being examined
+  char*  newRecord;        // the rewritten record (UPDATE)
+  char** fields;
+  int*   lengths;          // length of each field
+  char** values;
+  struct ZoneMap* zonemap;
+  struct WalTxn* txn;      // the batch's writes, applied once committed
+  long   pending;          // records modified in the batch
+  long   count;            // records modified and applied
+  bool   ok;
+};
+
+//
+// serializes modifications and compaction within this process:
+//
+static pthread_mutex_t modifyLock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t compactorLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t compactor;
+static bool compactorRunning = false;
+
+//
+// the number of deleted records is kept in the sidecar file
+// "<table>.dead", so the share of dead records is known without
+// scanning the data file:
+//
+long modify_numDeleted(struct Database* db, struct TableMeta* table) {
+  char path[TABLEFILE_MAX_PATH];
+  long count = 0;
+
+  tablefile_path(db, table, ".dead", path);
+  FILE* input = fopen(path, "r");
+  if (input != NULL) {
+    if (fscanf(input, "%ld", &count) != 1) {
+      count = 0;
+    }
+    fclose(input);
+  }
+  return count;
+}
+
+static void writeDeadCount(struct Database* db, struct TableMeta* table,
+                           long count) {
+  char path[TABLEFILE_MAX_PATH];
+
+  tablefile_path(db, table, ".dead", path);
+  FILE* output = fopen(path, "w");
+  if (output != NULL) {
+    fprintf(output, "%ld\n", count);
+    fclose(output);
+  }
+}
+
+//
+// modifyRecord
+//
+// Deletes or rewrites record recno if it satisfies the predicate;
+// record points to the recordSize bytes read from the file.
+//
+static void modifyRecord(struct Modification* m, long recno, char* record) {
+  struct TableMeta* table = m->table;
+  off_t offset = (off_t)recno * table->recordSize;
+
+  memcpy(m->scratch, record, table->recordSize);
+  m->scratch[table->recordSize] = '\0';
+
+  if (tablefile_isDeleted(m->scratch) ||
+      fieldparse_split(m->scratch, m->fields, m->lengths, table->numColumns) !=
+          table->numColumns) {
+    return;
+  }
+  if (m->pred != NULL && !m->pred->evalRecord(m->pred, m->fields, m->lengths)) {
+    return;
+  }
+
+  if (m->kind == MODIFY_DELETE) {
+    char tombstone = TABLEFILE_TOMBSTONE;
+    wal_write(m->txn, table, offset, &tombstone, 1);
+  } else {
+    for (int j = 0; j < table->numColumns; j++) {
+      m->values[j] = m->fields[j];
+    }
+    m->values[m->column] = m->value;
+
+    if (!tablefile_formatRecord(table, m->values, m->newRecord)) {
+      m->ok = false;
+      return;
+    }
+    wal_write(m->txn, table, offset, m->newRecord, table->recordSize);
+    if (m->zonemap != NULL) {
+      zonemap_add(m->zonemap, table, recno, m->values);
+    }
+  }
+
+  m->pending++;
+}
+
+//
+// commitBatch
+//
+// Commits the writes of the records examined since the last batch
+// and applies them to the data file, then starts the next batch
+// unless this is the last one. Every record is examined once, so its
+// write can wait until the batch is committed; batches keep the log
+// entry, and the memory it is built in, bounded however many records
+// the statement modifies, and let a checkpoint empty the log between
+// them.
+//
+static void commitBatch(struct Modification* m, bool last) {
+  if (m->ok && m->pending > 0) {
+    m->ok = wal_commit(m->txn) && wal_apply(m->txn, m->table, m->fd);
+    if (m->ok) {
+      m->count += m->pending;
+    }
+  }
+  m->pending = 0;
+  wal_end(m->txn);
+
+  m->txn = (last || !m->ok) ? NULL : wal_begin(m->db);
+}
+
+static int compareRecnos(const void* a, const void* b) {
+  long x = *(const long*)a, y = *(const long*)b;
+
+  return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+//
+// indexCandidates
+//
+// If the WHERE column is indexed and the operator is <, <=, >, >=
+// or =, returns the record numbers in the matching index range, in
+// file order, and sets *N. Returns NULL if no index applies.
+//
+static long* indexCandidates(struct Database* db, struct TableMeta* table,
+                             struct EXPR* where, long* N) {
+  if (where == NULL || where->operator < EXPR_LT ||
+      where->operator > EXPR_EQUAL) {
+    return NULL;
+  }
+
+  struct ColumnMeta* column = database_findColumn(table, where->column->name);
+  if (column == NULL || column->indexType == COL_NON_INDEXED) {
+    return NULL;
+  }
+
+  struct Index* index = index_open(db, table, column);
+  if (index == NULL) {
+    return NULL;
+  }
+
+  long lo = 0, hi = index->numEntries;
+  switch (where->operator) {
+    case EXPR_LT:
+      hi = index_lowerBound(index, where->value);
+      break;
+    case EXPR_LTE:
+      hi = index_upperBound(index, where->value);
+      break;
+    case EXPR_GT:
+      lo = index_upperBound(index, where->value);
+      break;
+    case EXPR_GTE:
+      lo = index_lowerBound(index, where->value);
+      break;
+    case EXPR_EQUAL:
+      lo = index_lowerBound(index, where->value);
+      hi = index_upperBound(index, where->value);
+      break;
+  }
+
+  *N = hi - lo;
+  long* recnos = (long*)malloc(sizeof(long) * (*N + 1));
+  if (recnos == NULL) {
+    panic("No memory");
+  }
+  for (long i = 0; i < *N; i++) {
+    recnos[i] = index_recno(index, lo + i);
+  }
+  index_close(index);
+
+  qsort(recnos, *N, sizeof(long), compareRecnos);
+  return recnos;
+}
+
+static void* compactThread(void* arg) {
+  struct Database* db = ((struct Database**)arg)[0];
+  struct TableMeta* table = ((struct TableMeta**)arg)[1];
+
+  free(arg);
+  modify_compact(db, table);
+  return NULL;
+}
+
+//
+// compactInBackground
+//
+// Starts a compaction of the table unless one is already running.
+//
+static void compactInBackground(struct Database* db,
+                                struct TableMeta* table) {
+  pthread_mutex_lock(&compactorLock);
+
+  if (!compactorRunning) {
+    void** arg = (void**)malloc(2 * sizeof(void*));
+    if (arg == NULL) {
+      panic("No memory");
+    }
+    arg[0] = db;
+    arg[1] = table;
+    compactorRunning =
+        (pthread_create(&compactor, NULL, compactThread, arg) == 0);
+    if (!compactorRunning) {
+      free(arg);
+    }
+  }
+
+  pthread_mutex_unlock(&compactorLock);
+}
+
+//
+// modify
+//
+// Runs an UPDATE or DELETE: finds the candidate records, modifies
+// the ones that satisfy the WHERE expression, and then brings the
+// indexes and zone map up to date.
+//
+static long modify(struct Database* db, struct TableMeta* table, int kind,
+                   int column, char* value, struct EXPR* where) {
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  pthread_mutex_lock(&modifyLock);
+
+  int fd = open(datapath, O_RDWR);
+  if (fd < 0) {
+    pthread_mutex_unlock(&modifyLock);
+    printf("**Error: unable to open file '%s' for writing\n", datapath);
+    return -1;
+  }
+
+  //
+  // note which indexes are up to date BEFORE changing the file, so
+  // the ones that stay valid can be kept:
+  //
+  bool* fresh = (bool*)calloc(table->numColumns, sizeof(bool));
+  if (fresh == NULL) {
+    panic("No memory");
+  }
+  for (int j = 0; j < table->numColumns; j++) {
+    if (table->columns[j].indexType != COL_NON_INDEXED) {
+      fresh[j] = index_isFresh(db, table, &table->columns[j]);
+    }
+  }
+
+  // and which dictionaries, which stay valid with the updated value
+  // added: one that holds a value no record has any more still works
+  struct Dictionary** dicts = (struct Dictionary**)calloc(
+      table->numColumns, sizeof(struct Dictionary*));
+  bool* dictsFresh = (bool*)calloc(table->numColumns, sizeof(bool));
+  if (dicts == NULL || dictsFresh == NULL) {
+    panic("No memory");
+  }
+  for (int j = 0; j < table->numColumns; j++) {
+    dictsFresh[j] = dictionary_load(db, table, &table->columns[j], &dicts[j]);
+  }
+
+  struct Modification m;
+  m.db = db;
+  m.table = table;
+  m.kind = kind;
+  m.fd = fd;
+  m.pred = (where == NULL) ? NULL : predicate_compile(table, where);
+  m.column = column;
+  m.value = value;
+  m.scratch = (char*)malloc(table->recordSize + 1);
+  m.newRecord = (char*)malloc(table->recordSize);
+  m.fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  m.lengths = (int*)malloc(sizeof(int) * table->numColumns);
+  m.values = (char**)malloc(sizeof(char*) * table->numColumns);
+  m.zonemap = zonemap_open(db, table);
+  m.txn = wal_begin(db);
+  m.pending = 0;
+  m.count = 0;
+  m.ok = true;
+  if (m.scratch == NULL || m.newRecord == NULL || m.fields == NULL ||
+      m.lengths == NULL || m.values == NULL) {
+    panic("No memory");
+  }
+
+  long numRecords = tablefile_numRecords(fd, table);
+  long N = 0;
+  long* recnos = indexCandidates(db, table, where, &N);
+
+  if (recnos != NULL) {
+    char* record = (char*)malloc(table->recordSize + 1);
+    if (record == NULL) {
+      panic("No memory");
+    }
+    for (long i = 0; i < N && m.ok; i++) {
+      if (tablefile_readRecord(fd, table, recnos[i], record)) {
+        modifyRecord(&m, recnos[i], record);
+      }
+      if ((i + 1) % MODIFY_SCAN_RECORDS == 0 && i + 1 < N) {
+        commitBatch(&m, false);
+      }
+    }
+    free(record);
+    free(recnos);
+  } else {
+    long blockBytes = (long)MODIFY_SCAN_RECORDS * table->recordSize;
+    char* block = (char*)malloc(blockBytes);
+    if (block == NULL) {
+      panic("No memory");
+    }
+    for (long first = 0; first < numRecords && m.ok;
+         first += MODIFY_SCAN_RECORDS) {
+      ssize_t n = pread(fd, block, blockBytes, (off_t)first * table->recordSize);
+      if (n <= 0) {
+        break;
+      }
+      long numInBlock = n / table->recordSize;
+      for (long r = 0; r < numInBlock && m.ok; r++) {
+        modifyRecord(&m, first + r, block + r * table->recordSize);
+      }
+      if (first + MODIFY_SCAN_RECORDS < numRecords) {
+        commitBatch(&m, false);
+      }
+    }
+    free(block);
+  }
+
+  if (m.txn != NULL) {
+    commitBatch(&m, true);
+  }
+  close(fd);
+
+  //
+  // the zone map only ever widens, so it is still valid; indexes are
+  // too, except for the index on an updated column, which is left
+  // stale and rebuilt the next time it is opened:
+  //
+  if (m.zonemap != NULL) {
+    zonemap_save(db, table, m.zonemap);
+    zonemap_close(m.zonemap);
+  }
+  for (int j = 0; j < table->numColumns; j++) {
+    if (fresh[j] && !(kind == MODIFY_UPDATE && j == column)) {
+      index_touch(db, table, &table->columns[j]);
+    }
+    if (dictsFresh[j]) {
+      if (kind == MODIFY_UPDATE && j == column) {
+        dicts[j] = dictionary_add(dicts[j], &value, 1);
+      }
+      dictionary_save(db, table, &table->columns[j], dicts[j]);
+    }
+    dictionary_close(dicts[j]);
+  }
+
+  // the records changed in place, which no view can fold in
+  if (m.count > 0) {
+    matview_invalidate(db, table);
+  }
+
+  long dead = 0;
+  if (kind == MODIFY_DELETE && m.count > 0) {
+    dead = modify_numDeleted(db, table) + m.count;
+    writeDeadCount(db, table, dead);
+  }
+
+  predicate_destroy(m.pred);
+  free(m.values);
+  free(m.lengths);
+  free(m.fields);
+  free(m.newRecord);
+  free(m.scratch);
+  free(fresh);
+  free(dicts);
+  free(dictsFresh);
+
+  pthread_mutex_unlock(&modifyLock);
+
+  if (numRecords > 0 && dead > MODIFY_COMPACT_THRESHOLD * numRecords) {
+    compactInBackground(db, table);
+  }
+
+  if (!m.ok) {
+    printf("**Error: unable to modify table '%s'\n", table->name);
+    return -1;
+  }
+  return m.count;
+}
+
+long modify_delete(struct Database* db, struct TableMeta* table,
+                   struct EXPR* where) {
+  if (db == NULL || table == NULL) {
+    panic("one or more parameters are NULL (modify_delete)");
+  }
+  return modify(db, table, MODIFY_DELETE, 0, NULL, where);
+}
+
+long modify_update(struct Database* db, struct TableMeta* table,
+                   char* column, char* value, struct EXPR* where) {
+  if (db == NULL || table == NULL || column == NULL || value == NULL) {
+    panic("one or more parameters are NULL (modify_update)");
+  }
+
+  struct ColumnMeta* columnMeta = database_findColumn(table, column);
+  if (columnMeta == NULL) {
+    printf("**Error: table '%s' has no column '%s'\n", table->name, column);
+    return -1;
+  }
+  return modify(db, table, MODIFY_UPDATE, (int)(columnMeta - table->columns),
+                value, where);
+}
+
+bool modify_compact(struct Database* db, struct TableMeta* table) {
+  char datapath[TABLEFILE_MAX_PATH];
+  char tmppath[TABLEFILE_MAX_PATH];
+
+  tablefile_path(db, table, ".data", datapath);
+  tablefile_path(db, table, ".data.tmp", tmppath);
+
+  pthread_mutex_lock(&modifyLock);
+
+  int input = open(datapath, O_RDONLY);
+  int output = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (input < 0 || output < 0) {
+    if (input >= 0) {
+      close(input);
+    }
+    if (output >= 0) {
+      close(output);
+      unlink(tmppath);
+    }
+    pthread_mutex_unlock(&modifyLock);
+    return false;
+  }
+
+  long blockBytes = (long)MODIFY_SCAN_RECORDS * table->recordSize;
+  char* block = (char*)malloc(blockBytes);
+  if (block == NULL) {
+    panic("No memory");
+  }
+
+  //
+  // copy the live records of each block down over the dead ones,
+  // then write the block's live records with one write:
+  //
+  bool ok = true;
+  off_t offset = 0;
+  while (ok) {
+    ssize_t n = pread(input, block, blockBytes, offset);
+    if (n <= 0) {
+      ok = (n == 0);
+      break;
+    }
+    offset += n;
+
+    long numInBlock = n / table->recordSize;
+    long numLive = 0;
+    for (long r = 0; r < numInBlock; r++) {
+      char* record = block + r * table->recordSize;
+      if (!tablefile_isDeleted(record)) {
+        if (numLive != r) {
+          memmove(block + numLive * table->recordSize, record,
+                  table->recordSize);
+        }
+        numLive++;
+      }
+    }
+    ok = tablefile_write(output, block, numLive * table->recordSize);
+  }
+  free(block);
+
+  ok = ok && (fsync(output) == 0);
+  close(output);
+  close(input);
+
+  // the log's offsets are into the file being replaced
+  ok = ok && wal_checkpoint(db);
+
+  if (ok && rename(tmppath, datapath) == 0) {
+    writeDeadCount(db, table, 0);
+    matview_invalidate(db, table);
+  } else {
+    unlink(tmppath);
+    ok = false;
+  }
+
+  pthread_mutex_unlock(&modifyLock);
+  return ok;
+}
+
+void modify_waitForCompaction(void) {
+  pthread_mutex_lock(&compactorLock);
+
+  if (compactorRunning) {
+    pthread_join(compactor, NULL);
+    compactorRunning = false;
+  }
+
+  pthread_mutex_unlock(&compactorLock);
+}
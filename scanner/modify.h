@@ -0,0 +1,83 @@
+/*modify.h*/
+
+//
+// UPDATE and DELETE for SimpleSQL. Matching records are found
+// through an index when the WHERE column has one, and otherwise by
+// scanning the data file. Records are fixed-width, so an updated
+// record is rewritten in place at recno * recordSize, and a
+// deleted record is marked by overwriting its first byte with
+// TABLEFILE_TOMBSTONE. The writes are committed to the write-ahead
+// log (wal.h) a batch of records at a time, each batch before any of
+// its writes is made, so a statement that fails part way leaves the
+// batches before the failure applied. Once the share of
+// deleted records crosses MODIFY_COMPACT_THRESHOLD, the data file
+// is compacted by a background thread.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "database.h"
+
+//
+// share of deleted records at which the table is compacted:
+//
+#define MODIFY_COMPACT_THRESHOLD 0.25
+
+
+//
+// functions:
+//
+
+//
+// modify_delete
+//
+// Deletes the records of the table that satisfy the expression,
+// or every record if where is NULL. Returns the number of records
+// deleted, or -1 on error.
+//
+long modify_delete(struct Database* db, struct TableMeta* table,
+                   struct EXPR* where);
+
+//
+// modify_update
+//
+// Sets the named column to value (in text form, strings without
+// quotes) in every record that satisfies the expression, or in
+// every record if where is NULL. Returns the number of records
+// updated, or -1 on error.
+//
+long modify_update(struct Database* db, struct TableMeta* table,
+                   char* column, char* value, struct EXPR* where);
+
+//
+// modify_compact
+//
+// Rewrites the table's data file without its deleted records. The
+// table's indexes and zone map are rebuilt the next time they are
+// opened, since record numbers change.
+//
+bool modify_compact(struct Database* db, struct TableMeta* table);
+
+//
+// modify_numDeleted
+//
+// Returns the number of deleted records still in the table's data
+// file, i.e. 0 if every record is live.
+//
+long modify_numDeleted(struct Database* db, struct TableMeta* table);
+
+//
+// modify_waitForCompaction
+//
+// Blocks until a background compaction, if any, has finished. Call
+// before appending to a table, before adding one to the schema, and
+// before the program exits, together with wal_waitForCheckpoint().
+//
+void modify_waitForCompaction(void);
@@ -0,0 +1,448 @@
+/*predicate.c*/
+
+//
+// Compiled WHERE predicates for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "colresult.h"
+#include "database.h"
+#include "dictionary.h"
+#include "fieldparse.h"
+#include "like.h"
+#include "predicate.h"
+#include "resultset.h"
+#include "schemamap.h"
+#include "util.h"
+
+//
+// comparators, one per (column type x operator). The macros stamp
+// out a function for each pair so the comparison is compiled into
+// the function body rather than chosen per row. Each comparator
+// comes in three forms: over a result set row, over the fields of
+// a record, and over a row of a columnar result (column is 1-based
+// in all three). Int and real comparators also get a filter form,
+// which compares a whole word of 64 rows into a bit mask with no
+// branches, and ANDs it into the selection bitmap.
+//
+#define DEFINE_VECTOR_FILTER(NAME, OP, TYPE, MEMBER, LITERAL)              \
+  static void NAME##_filter(struct Predicate* p, struct ColumnarResult* cr,\
+                            unsigned long* selection) {                    \
+    TYPE* values = cr->columns[p->column - 1].data.MEMBER;                 \
+    TYPE literal = p->literal.LITERAL;                                     \
+    long numWords = colresult_numWords(cr);                                \
+    for (long w = 0; w < numWords; w++) {                                  \
+      if (selection[w] == 0) {                                             \
+        continue;                                                          \
+      }                                                                    \
+      TYPE* v = values + w * COLRESULT_WORD_BITS;                          \
+      long n = cr->numRows - w * COLRESULT_WORD_BITS;                      \
+      if (n > COLRESULT_WORD_BITS) {                                       \
+        n = COLRESULT_WORD_BITS;                                           \
+      }                                                                    \
+      unsigned long mask = 0;                                              \
+      for (long i = 0; i < n; i++) {                                       \
+        mask |= (unsigned long)(v[i] OP literal) << i;                     \
+      }                                                                    \
+      selection[w] &= mask;                                                \
+    }                                                                      \
+  }
+
+#define DEFINE_INT_CMP(NAME, OP)                                           \
+  static bool NAME(struct Predicate* p, struct ResultSet* rs, int row) {   \
+    return resultset_getInt(rs, row, p->column) OP p->literal.i;           \
+  }                                                                        \
+  static bool NAME##_record(struct Predicate* p, char* fields[],           \
+                            int lengths[]) {                               \
+    int j = p->column - 1;                                                 \
+    return fieldparse_int(fields[j], lengths[j]) OP p->literal.i;          \
+  }                                                                        \
+  static bool NAME##_column(struct Predicate* p, struct ColumnarResult* cr,\
+                            long row) {                                    \
+    return cr->columns[p->column - 1].data.ints[row] OP p->literal.i;      \
+  }                                                                        \
+  DEFINE_VECTOR_FILTER(NAME, OP, int, ints, i)
+
+#define DEFINE_REAL_CMP(NAME, OP)                                          \
+  static bool NAME(struct Predicate* p, struct ResultSet* rs, int row) {   \
+    return resultset_getReal(rs, row, p->column) OP p->literal.r;          \
+  }                                                                        \
+  static bool NAME##_record(struct Predicate* p, char* fields[],           \
+                            int lengths[]) {                               \
+    int j = p->column - 1;                                                 \
+    return fieldparse_real(fields[j], lengths[j]) OP p->literal.r;         \
+  }                                                                        \
+  static bool NAME##_column(struct Predicate* p, struct ColumnarResult* cr,\
+                            long row) {                                    \
+    return cr->columns[p->column - 1].data.reals[row] OP p->literal.r;     \
+  }                                                                        \
+  DEFINE_VECTOR_FILTER(NAME, OP, double, reals, r)
+
+#define DEFINE_STRING_CMP(NAME, OP)                                        \
+  static bool NAME(struct Predicate* p, struct ResultSet* rs, int row) {   \
+    char* s = resultset_getString(rs, row, p->column);                     \
+    int cmp = strcmp(s, p->literal.s);                                     \
+    free(s);                                                               \
+    return cmp OP 0;                                                       \
+  }                                                                        \
+  static bool NAME##_record(struct Predicate* p, char* fields[],           \
+                            int lengths[]) {                               \
+    return strcmp(fields[p->column - 1], p->literal.s) OP 0;               \
+  }                                                                        \
+  static bool NAME##_column(struct Predicate* p, struct ColumnarResult* cr,\
+                            long row) {                                    \
+    char* s = colresult_getString(cr, row, p->column - 1, NULL);           \
+    return strcmp(s, p->literal.s) OP 0;                                   \
+  }
+
+#define DEFINE_COMPARATORS(DEFINE, PREFIX) \
+  DEFINE(PREFIX##_lt, <)                   \
+  DEFINE(PREFIX##_lte, <=)                 \
+  DEFINE(PREFIX##_gt, >)                   \
+  DEFINE(PREFIX##_gte, >=)                 \
+  DEFINE(PREFIX##_eq, ==)                  \
+  DEFINE(PREFIX##_ne, !=)
+
+DEFINE_COMPARATORS(DEFINE_INT_CMP, int)
+DEFINE_COMPARATORS(DEFINE_REAL_CMP, real)
+DEFINE_COMPARATORS(DEFINE_STRING_CMP, string)
+
+//
+// comparators[colType - 1][operator], with operators in the same
+// order as the analyzer: <, <=, >, >=, =, <>
+//
+#define NUM_COMPARE_OPERATORS 6
+
+static FilterPredicateFn numericFilters[][NUM_COMPARE_OPERATORS] = {
+    {int_lt_filter, int_lte_filter, int_gt_filter, int_gte_filter,
+     int_eq_filter, int_ne_filter},
+    {real_lt_filter, real_lte_filter, real_gt_filter, real_gte_filter,
+     real_eq_filter, real_ne_filter}};
+
+static PredicateFn comparators[][NUM_COMPARE_OPERATORS] = {
+    {int_lt, int_lte, int_gt, int_gte, int_eq, int_ne},
+    {real_lt, real_lte, real_gt, real_gte, real_eq, real_ne},
+    {string_lt, string_lte, string_gt, string_gte, string_eq, string_ne}};
+
+static RecordPredicateFn recordComparators[][NUM_COMPARE_OPERATORS] = {
+    {int_lt_record, int_lte_record, int_gt_record, int_gte_record,
+     int_eq_record, int_ne_record},
+    {real_lt_record, real_lte_record, real_gt_record, real_gte_record,
+     real_eq_record, real_ne_record},
+    {string_lt_record, string_lte_record, string_gt_record,
+     string_gte_record, string_eq_record, string_ne_record}};
+
+static ColumnPredicateFn columnComparators[][NUM_COMPARE_OPERATORS] = {
+    {int_lt_column, int_lte_column, int_gt_column, int_gte_column,
+     int_eq_column, int_ne_column},
+    {real_lt_column, real_lte_column, real_gt_column, real_gte_column,
+     real_eq_column, real_ne_column},
+    {string_lt_column, string_lte_column, string_gt_column,
+     string_gte_column, string_eq_column, string_ne_column}};
+
+static bool string_like(struct Predicate* p, struct ResultSet* rs, int row) {
+  char* s = resultset_getString(rs, row, p->column);
+  bool match = like_match(p->like, s, strlen(s));
+  free(s);
+  return match;
+}
+
+static bool string_like_record(struct Predicate* p, char* fields[],
+                               int lengths[]) {
+  int j = p->column - 1;
+  return like_match(p->like, fields[j], lengths[j]);
+}
+
+static bool string_like_column(struct Predicate* p, struct ColumnarResult* cr,
+                               long row) {
+  int length;
+  char* s = colresult_getString(cr, row, p->column - 1, &length);
+  return like_match(p->like, s, length);
+}
+
+//
+// filter_rows
+//
+// Filter form for the string comparators and LIKE: evaluates the
+// predicate on each row whose bit is still set. The results are
+// collected into a mask rather than cleared bit by bit, since a
+// branch on them is mispredicted about as often as it is taken.
+//
+static void filter_rows(struct Predicate* p, struct ColumnarResult* cr,
+                        unsigned long* selection) {
+  long numWords = colresult_numWords(cr);
+
+  for (long w = 0; w < numWords; w++) {
+    unsigned long bits = selection[w];
+    unsigned long mask = 0;
+    while (bits != 0) {
+      int bit = __builtin_ctzl(bits);
+      bits &= bits - 1;
+      long row = w * COLRESULT_WORD_BITS + bit;
+      mask |= (unsigned long)p->evalColumn(p, cr, row) << bit;
+    }
+    selection[w] = mask;
+  }
+}
+
+//
+// string_filter
+//
+// Filter form of the string comparators. Over a dictionary column
+// the literal is looked up once, which turns the comparison into a
+// test of whether the code is in a range: [lo, hi) holds the codes
+// equal to the literal, for = (and, negated, <>), and ranges from
+// or up to it serve the others. The codes are then tested a word
+// of 64 rows at a time, like the numeric filters.
+//
+static void string_filter(struct Predicate* p, struct ColumnarResult* cr,
+                          unsigned long* selection) {
+  struct ColVector* column = &cr->columns[p->column - 1];
+  if (column->dict == NULL) {
+    filter_rows(p, cr, selection);
+    return;
+  }
+
+  int lo, hi;
+  dictionary_range(column->dict, p->literal.s, &lo, &hi);
+
+  int first = lo, last = hi;
+  unsigned long flip = 0;  // all 1s => rows outside the range qualify
+  switch (p->oper) {
+    case EXPR_LT:
+      first = 0;
+      last = lo;
+      break;
+    case EXPR_LTE:
+      first = 0;
+      last = hi;
+      break;
+    case EXPR_GT:
+      first = hi;
+      last = column->dict->numEntries;
+      break;
+    case EXPR_GTE:
+      first = lo;
+      last = column->dict->numEntries;
+      break;
+    case EXPR_NOT_EQUAL:
+      flip = ~0ul;
+      break;
+    default:  // =
+      break;
+  }
+
+  unsigned int width = (unsigned int)(last - first);
+  long numWords = colresult_numWords(cr);
+  for (long w = 0; w < numWords; w++) {
+    if (selection[w] == 0) {
+      continue;
+    }
+    int* codes = column->data.codes + w * COLRESULT_WORD_BITS;
+    long n = cr->numRows - w * COLRESULT_WORD_BITS;
+    if (n > COLRESULT_WORD_BITS) {
+      n = COLRESULT_WORD_BITS;
+    }
+    unsigned long mask = 0;
+    for (long i = 0; i < n; i++) {
+      mask |= (unsigned long)((unsigned int)(codes[i] - first) < width) << i;
+    }
+    selection[w] &= mask ^ flip;  // bits past numRows are 0 already
+  }
+}
+
+static bool pred_false(struct Predicate* p, struct ResultSet* rs, int row) {
+  return false;
+}
+
+static bool pred_false_record(struct Predicate* p, char* fields[],
+                              int lengths[]) {
+  return false;
+}
+
+static bool pred_false_column(struct Predicate* p, struct ColumnarResult* cr,
+                              long row) {
+  return false;
+}
+
+static bool pred_and(struct Predicate* p, struct ResultSet* rs, int row) {
+  return p->left->eval(p->left, rs, row) && p->right->eval(p->right, rs, row);
+}
+
+static bool pred_or(struct Predicate* p, struct ResultSet* rs, int row) {
+  return p->left->eval(p->left, rs, row) || p->right->eval(p->right, rs, row);
+}
+
+static bool pred_and_record(struct Predicate* p, char* fields[],
+                            int lengths[]) {
+  return p->left->evalRecord(p->left, fields, lengths) &&
+         p->right->evalRecord(p->right, fields, lengths);
+}
+
+static bool pred_or_record(struct Predicate* p, char* fields[],
+                           int lengths[]) {
+  return p->left->evalRecord(p->left, fields, lengths) ||
+         p->right->evalRecord(p->right, fields, lengths);
+}
+
+static void pred_false_filter(struct Predicate* p, struct ColumnarResult* cr,
+                              unsigned long* selection) {
+  memset(selection, 0, sizeof(unsigned long) * colresult_numWords(cr));
+}
+
+static void pred_and_filter(struct Predicate* p, struct ColumnarResult* cr,
+                            unsigned long* selection) {
+  p->left->filter(p->left, cr, selection);
+  p->right->filter(p->right, cr, selection);
+}
+
+//
+// pred_or_filter
+//
+// The right side is only evaluated on the rows the left side
+// rejected.
+//
+static void pred_or_filter(struct Predicate* p, struct ColumnarResult* cr,
+                           unsigned long* selection) {
+  long numWords = colresult_numWords(cr);
+  unsigned long* rest =
+      (unsigned long*)malloc(sizeof(unsigned long) * (numWords + 1));
+  if (rest == NULL) {
+    panic("No memory");
+  }
+
+  memcpy(rest, selection, sizeof(unsigned long) * numWords);
+  p->left->filter(p->left, cr, selection);
+  for (long w = 0; w < numWords; w++) {
+    rest[w] &= ~selection[w];
+  }
+  p->right->filter(p->right, cr, rest);
+  for (long w = 0; w < numWords; w++) {
+    selection[w] |= rest[w];
+  }
+  free(rest);
+}
+
+static bool pred_and_column(struct Predicate* p, struct ColumnarResult* cr,
+                            long row) {
+  return p->left->evalColumn(p->left, cr, row) &&
+         p->right->evalColumn(p->right, cr, row);
+}
+
+static bool pred_or_column(struct Predicate* p, struct ColumnarResult* cr,
+                           long row) {
+  return p->left->evalColumn(p->left, cr, row) ||
+         p->right->evalColumn(p->right, cr, row);
+}
+
+static struct Predicate* predicate_alloc(int kind) {
+  struct Predicate* pred = (struct Predicate*)malloc(sizeof(struct Predicate));
+  if (pred == NULL) {
+    panic("No memory");
+  }
+
+  pred->kind = kind;
+  pred->eval = pred_false;
+  pred->evalRecord = pred_false_record;
+  pred->evalColumn = pred_false_column;
+  pred->filter = pred_false_filter;
+  pred->column = 0;
+  pred->oper = -1;
+  pred->literal.s = NULL;
+  pred->like = NULL;
+  pred->left = NULL;
+  pred->right = NULL;
+  return pred;
+}
+
+struct Predicate* predicate_compile(struct TableMeta* table,
+                                    struct EXPR* expr) {
+  if (table == NULL || expr == NULL) {
+    panic("one or more parameters are NULL (predicate_compile)");
+  }
+
+  struct ColumnMeta* column = database_findColumn(table, expr->column->name);
+  assert(column != NULL);
+
+  struct Predicate* pred = predicate_alloc(PRED_COMPARE);
+  pred->column = (int)(column - table->columns) + 1;
+
+  //
+  // parse the literal once, here, instead of once per row:
+  //
+  if (column->colType == COL_TYPE_INT) {
+    pred->literal.i = atoi(expr->value);
+  } else if (column->colType == COL_TYPE_REAL) {
+    pred->literal.r = atof(expr->value);
+  } else {
+    pred->literal.s = expr->value;
+  }
+
+  int oper = expr->operator;
+  pred->oper = oper;
+  if (oper >= 0 && oper < NUM_COMPARE_OPERATORS &&
+      column->colType >= COL_TYPE_INT && column->colType <= COL_TYPE_STRING) {
+    pred->eval = comparators[column->colType - 1][oper];
+    pred->evalRecord = recordComparators[column->colType - 1][oper];
+    pred->evalColumn = columnComparators[column->colType - 1][oper];
+    pred->filter = (column->colType == COL_TYPE_STRING)
+                       ? string_filter
+                       : numericFilters[column->colType - 1][oper];
+  } else if (oper == EXPR_LIKE && column->colType == COL_TYPE_STRING) {
+    pred->like = like_compile(expr->value);
+    pred->eval = string_like;
+    pred->evalRecord = string_like_record;
+    pred->evalColumn = string_like_column;
+    pred->filter = filter_rows;
+  }
+
+  return pred;
+}
+
+struct Predicate* predicate_and(struct Predicate* left,
+                                struct Predicate* right) {
+  struct Predicate* pred = predicate_alloc(PRED_AND);
+  pred->eval = pred_and;
+  pred->evalRecord = pred_and_record;
+  pred->evalColumn = pred_and_column;
+  pred->filter = pred_and_filter;
+  pred->left = left;
+  pred->right = right;
+  return pred;
+}
+
+struct Predicate* predicate_or(struct Predicate* left,
+                               struct Predicate* right) {
+  struct Predicate* pred = predicate_alloc(PRED_OR);
+  pred->eval = pred_or;
+  pred->evalRecord = pred_or_record;
+  pred->evalColumn = pred_or_column;
+  pred->filter = pred_or_filter;
+  pred->left = left;
+  pred->right = right;
+  return pred;
+}
+
+void predicate_destroy(struct Predicate* pred) {
+  if (pred == NULL) {
+    return;
+  }
+  predicate_destroy(pred->left);
+  predicate_destroy(pred->right);
+  like_destroy(pred->like);
+  free(pred);
+}
+
+void predicate_filter(struct Predicate* pred, struct ColumnarResult* cr) {
+  pred->filter(pred, cr, cr->selection);
+}
@@ -0,0 +1,128 @@
+/*predicate.h*/
+
+//
+// Compiled WHERE predicates. The analyzed expression is lowered
+// once per query into a function pointer plus a pre-parsed literal,
+// so the per-row loop no longer dispatches on column type and
+// operator.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "colresult.h"
+#include "database.h"
+#include "like.h"
+#include "resultset.h"
+
+struct Predicate;
+
+//
+// evaluates the predicate against one row of the result set,
+// returning true if the row qualifies:
+//
+typedef bool (*PredicateFn)(struct Predicate* pred, struct ResultSet* rs,
+                            int row);
+
+//
+// evaluates the predicate against one record of the table, already
+// split into its fields and their lengths (see fieldparse_split):
+//
+typedef bool (*RecordPredicateFn)(struct Predicate* pred, char* fields[],
+                                  int lengths[]);
+
+//
+// evaluates the predicate against one row of a columnar result
+// (see colresult.h):
+//
+typedef bool (*ColumnPredicateFn)(struct Predicate* pred,
+                                  struct ColumnarResult* cr, long row);
+
+//
+// clears the bits of the rows that do not qualify from a selection
+// bitmap over a columnar result:
+//
+typedef void (*FilterPredicateFn)(struct Predicate* pred,
+                                  struct ColumnarResult* cr,
+                                  unsigned long* selection);
+
+enum PredicateKind
+{
+  PRED_COMPARE = 0,  // column <op> literal
+  PRED_AND,          // left AND right
+  PRED_OR            // left OR right
+};
+
+struct Predicate
+{
+  int         kind;
+  PredicateFn eval;
+  RecordPredicateFn evalRecord;
+  ColumnPredicateFn evalColumn;
+  FilterPredicateFn filter;
+  int         column;  // position in the result set (PRED_COMPARE)
+  int         oper;    // the EXPR's operator (PRED_COMPARE)
+  union
+  {
+    int    i;
+    double r;
+    char*  s;  // NOT owned, points into the query's EXPR
+  } literal;
+  struct LikePattern* like;  // compiled pattern, owned (LIKE only)
+  struct Predicate* left;   // PRED_AND / PRED_OR
+  struct Predicate* right;  // PRED_AND / PRED_OR
+};
+
+
+//
+// functions:
+//
+
+//
+// predicate_compile
+//
+// Lowers the expression into a compiled predicate, assuming the
+// result set (or columnar result) holds every column of the table
+// in table order.
+// LIKE on a string column compiles its pattern here, once. Other
+// operators the executor cannot evaluate compile to a predicate
+// that rejects every row.
+//
+// NOTE: it is the callers responsibility to free the predicate by
+// calling predicate_destroy().
+//
+struct Predicate* predicate_compile(struct TableMeta* table,
+                                    struct EXPR* expr);
+
+//
+// predicate_and / predicate_or
+//
+// Combines two compiled predicates; the result takes ownership of
+// both.
+//
+struct Predicate* predicate_and(struct Predicate* left,
+                                struct Predicate* right);
+struct Predicate* predicate_or(struct Predicate* left,
+                               struct Predicate* right);
+
+//
+// predicate_destroy
+//
+// Frees the predicate, including any sub-predicates.
+//
+void predicate_destroy(struct Predicate* pred);
+
+//
+// predicate_filter
+//
+// Deletes the live rows of the columnar result that do not satisfy
+// the predicate, by clearing their bits in its selection bitmap;
+// numeric comparisons are evaluated a word of 64 rows at a time.
+//
+void predicate_filter(struct Predicate* pred, struct ColumnarResult* cr);
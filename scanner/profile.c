@@ -0,0 +1,282 @@
+/*profile.c*/
+
+//
+// Query profiling for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "profile.h"
+#include "util.h"
+
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//
+// heapInUse
+//
+// Bytes currently allocated from the heap, including blocks that
+// malloc mapped separately; 0 where the C library cannot tell.
+//
+static long heapInUse(void) {
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 info = mallinfo2();
+  return (long)(info.uordblks + info.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+struct Profile* profile_create(char* table) {
+  char* format = getenv("SIMPLESQL_PROFILE");
+  if (format == NULL) {
+    return NULL;
+  }
+
+  struct Profile* prof = (struct Profile*)malloc(sizeof(struct Profile));
+  if (prof == NULL) {
+    panic("No memory");
+  }
+
+  if (strcmp(format, "json") == 0) {
+    prof->format = PROFILE_JSON;
+  } else if (strcmp(format, "tree") == 0) {
+    prof->format = PROFILE_TREE;
+  } else {
+    free(prof);
+    return NULL;
+  }
+
+  prof->table = table;
+  prof->numPhases = 0;
+  prof->capacity = 16;
+  prof->current = -1;
+  prof->phases =
+      (struct ProfilePhase*)malloc(sizeof(struct ProfilePhase) * prof->capacity);
+  if (prof->phases == NULL) {
+    panic("No memory");
+  }
+
+  // the whole query is the root phase
+  profile_enter(prof, "query");
+  profile_detail(prof, table);
+  return prof;
+}
+
+void profile_destroy(struct Profile* prof) {
+  if (prof == NULL) {
+    return;
+  }
+
+  free(prof->phases);
+  free(prof);
+}
+
+void profile_enter(struct Profile* prof, char* name) {
+  if (prof == NULL) {
+    return;
+  }
+
+  if (prof->numPhases == prof->capacity) {
+    prof->capacity *= 2;
+    prof->phases = (struct ProfilePhase*)realloc(
+        prof->phases, sizeof(struct ProfilePhase) * prof->capacity);
+    if (prof->phases == NULL) {
+      panic("No memory");
+    }
+  }
+
+  struct ProfilePhase* phase = &prof->phases[prof->numPhases];
+  phase->name = name;
+  phase->detail[0] = '\0';
+  phase->parent = prof->current;
+  phase->seconds = 0;
+  phase->rowsIn = -1;
+  phase->rowsOut = -1;
+  phase->bytesRead = 0;
+  phase->stallSeconds = 0;
+  phase->heapBytes = 0;
+  phase->heapStart = heapInUse();
+  phase->start = now();  // last, so the bookkeeping is not timed
+
+  prof->current = prof->numPhases++;
+}
+
+void profile_detail(struct Profile* prof, char* detail) {
+  if (prof == NULL || prof->current < 0) {
+    return;
+  }
+
+  struct ProfilePhase* phase = &prof->phases[prof->current];
+  snprintf(phase->detail, sizeof(phase->detail), "%s", detail);
+}
+
+void profile_addRead(struct Profile* prof, long bytes, double stallSeconds) {
+  if (prof == NULL || prof->current < 0) {
+    return;
+  }
+
+  prof->phases[prof->current].bytesRead += bytes;
+  prof->phases[prof->current].stallSeconds += stallSeconds;
+}
+
+void profile_leave(struct Profile* prof, long rowsIn, long rowsOut) {
+  if (prof == NULL || prof->current < 0) {
+    return;
+  }
+
+  struct ProfilePhase* phase = &prof->phases[prof->current];
+  phase->seconds = now() - phase->start;
+  phase->heapBytes = heapInUse() - phase->heapStart;
+  phase->rowsIn = rowsIn;
+  phase->rowsOut = rowsOut;
+
+  // reads by a phase are also reads by the phases around it
+  if (phase->parent >= 0) {
+    prof->phases[phase->parent].bytesRead += phase->bytesRead;
+    prof->phases[phase->parent].stallSeconds += phase->stallSeconds;
+  }
+  prof->current = phase->parent;
+}
+
+//
+// printBytes
+//
+// Prints a byte count in the largest unit that keeps it >= 1.
+//
+static void printBytes(long bytes) {
+  double value = (bytes < 0) ? -bytes : bytes;
+  char* unit = "bytes";
+
+  if (value >= 1024.0 * 1024.0) {
+    value /= 1024.0 * 1024.0;
+    unit = "MB";
+  } else if (value >= 1024.0) {
+    value /= 1024.0;
+    unit = "KB";
+  }
+
+  if (unit[0] == 'b') {
+    printf("%ld %s", (bytes < 0) ? -bytes : bytes, unit);
+  } else {
+    printf("%.1f %s", value, unit);
+  }
+}
+
+static void printTree(struct Profile* prof, int p, int depth) {
+  struct ProfilePhase* phase = &prof->phases[p];
+
+  printf("%*s%s", 2 * depth, "", phase->name);
+  if (phase->detail[0] != '\0') {
+    printf(" [%s]", phase->detail);
+  }
+  printf(": %.3f ms", phase->seconds * 1000);
+  if (phase->rowsIn >= 0) {
+    printf(", rows in %ld", phase->rowsIn);
+  }
+  if (phase->rowsOut >= 0) {
+    printf(", rows out %ld", phase->rowsOut);
+  }
+  if (phase->bytesRead > 0) {
+    printf(", ");
+    printBytes(phase->bytesRead);
+    printf(" read");
+  }
+  if (phase->stallSeconds > 0) {
+    printf(", %.3f ms stalled on I/O", phase->stallSeconds * 1000);
+  }
+  if (phase->heapBytes != 0) {
+    printf(", heap %c", (phase->heapBytes > 0) ? '+' : '-');
+    printBytes(phase->heapBytes);
+  }
+  printf("\n");
+
+  for (int child = p + 1; child < prof->numPhases; child++) {
+    if (prof->phases[child].parent == p) {
+      printTree(prof, child, depth + 1);
+    }
+  }
+}
+
+//
+// printJsonString
+//
+// Prints s as a JSON string literal.
+//
+static void printJsonString(char* s) {
+  putchar('"');
+  for (char* cp = s; *cp != '\0'; cp++) {
+    if (*cp == '"' || *cp == '\\') {
+      printf("\\%c", *cp);
+    } else if ((unsigned char)*cp < ' ') {
+      printf("\\u%04x", *cp);
+    } else {
+      putchar(*cp);
+    }
+  }
+  putchar('"');
+}
+
+static void printJson(struct Profile* prof, int p) {
+  struct ProfilePhase* phase = &prof->phases[p];
+
+  printf("{\"name\":");
+  printJsonString(phase->name);
+  printf(",\"detail\":");
+  printJsonString(phase->detail);
+  printf(",\"ms\":%.3f,\"rowsIn\":%ld,\"rowsOut\":%ld,\"bytesRead\":%ld,"
+         "\"ioStallMs\":%.3f,\"heapBytes\":%ld,\"children\":[",
+         phase->seconds * 1000, phase->rowsIn, phase->rowsOut,
+         phase->bytesRead, phase->stallSeconds * 1000, phase->heapBytes);
+
+  bool first = true;
+  for (int child = p + 1; child < prof->numPhases; child++) {
+    if (prof->phases[child].parent == p) {
+      if (!first) {
+        putchar(',');
+      }
+      printJson(prof, child);
+      first = false;
+    }
+  }
+  printf("]}");
+}
+
+void profile_print(struct Profile* prof) {
+  if (prof == NULL) {
+    return;
+  }
+
+  while (prof->current >= 0) {
+    profile_leave(prof, -1, -1);
+  }
+
+  if (prof->format == PROFILE_JSON) {
+    printf("{\"table\":");
+    printJsonString(prof->table);
+    printf(",\"profile\":");
+    printJson(prof, 0);
+    printf("}\n");
+  } else {
+    printf("**PROFILE**\n");
+    printTree(prof, 0, 0);
+    printf("**END OF PROFILE**\n");
+  }
+}
@@ -0,0 +1,108 @@
+/*profile.h*/
+
+//
+// Query profiling for SimpleSQL. When the environment variable
+// SIMPLESQL_PROFILE is "tree" or "json", the executor times each
+// phase of a query (scan, filter, aggregate, output, ...) with the
+// monotonic clock and records its rows in and out, bytes read, time
+// stalled on I/O and change in heap usage, then prints the phases
+// after the result: as an indented tree, or as one line of JSON for
+// monitoring.
+//
+// Every function accepts a NULL profile and then does nothing, so
+// the executor calls them unconditionally.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#define PROFILE_TREE 0
+#define PROFILE_JSON 1
+
+struct ProfilePhase
+{
+  char*  name;          // NOT owned, e.g. a string literal
+  char   detail[64];    // e.g. the access path of a scan, or ""
+  int    parent;        // index of the enclosing phase, -1 => none
+  double start;         // seconds, monotonic
+  double seconds;
+  long   rowsIn;        // -1 => not applicable
+  long   rowsOut;       // -1 => not applicable
+  long   bytesRead;
+  double stallSeconds;  // waiting for reads to complete
+  long   heapStart;     // heap bytes in use when the phase began
+  long   heapBytes;     // change in heap bytes in use
+};
+
+struct Profile
+{
+  int    format;      // PROFILE_TREE or PROFILE_JSON
+  char*  table;       // NOT owned
+  struct ProfilePhase* phases;  // pointer to ARRAY of phases, in order
+  int    numPhases;
+  int    capacity;
+  int    current;     // innermost phase not yet left, -1 => none
+};
+
+
+//
+// functions:
+//
+
+//
+// profile_create
+//
+// Returns a new profile of a query over the given table if
+// SIMPLESQL_PROFILE asks for one, and NULL otherwise.
+//
+// NOTE: it is the callers responsibility to free the profile by
+// calling profile_destroy().
+//
+struct Profile* profile_create(char* table);
+
+//
+// profile_destroy
+//
+void profile_destroy(struct Profile* prof);
+
+//
+// profile_enter
+//
+// Starts a phase, nested in the current one; the name is not
+// copied. The phase ends with the matching profile_leave().
+//
+void profile_enter(struct Profile* prof, char* name);
+
+//
+// profile_detail
+//
+// Describes the current phase, e.g. "zone map" for a scan.
+//
+void profile_detail(struct Profile* prof, char* detail);
+
+//
+// profile_addRead
+//
+// Adds to the bytes read by the current phase and the time it was
+// stalled waiting for them.
+//
+void profile_addRead(struct Profile* prof, long bytes, double stallSeconds);
+
+//
+// profile_leave
+//
+// Ends the current phase, recording the rows it consumed and
+// produced (-1 if not applicable).
+//
+void profile_leave(struct Profile* prof, long rowsIn, long rowsOut);
+
+//
+// profile_print
+//
+// Prints the phases in the profile's format, ending any phases
+// still open.
+//
+void profile_print(struct Profile* prof);
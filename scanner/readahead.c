@@ -0,0 +1,359 @@
+/*readahead.c*/
+
+//
+// Asynchronous read-ahead for sequential scans.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "readahead.h"
+#include "util.h"
+
+//
+// Chunk k is read into buffer k % READAHEAD_DEPTH. A buffer is in
+// use from the time its read is issued until the caller, having
+// decoded the chunk, asks for the next one; then it is reused for
+// the chunk READAHEAD_DEPTH further on.
+//
+struct ReadAhead
+{
+  int    fd;
+  off_t  offset;      // of the next chunk to read
+  off_t  end;
+  long   chunkBytes;
+  char*  buffers[READAHEAD_DEPTH];
+  long   lengths[READAHEAD_DEPTH];  // bytes read, < 0 => error
+  bool   inUse[READAHEAD_DEPTH];    // read issued, not yet handed back
+  bool   ready[READAHEAD_DEPTH];    // read completed
+  int    head;        // buffer of the next chunk to return
+  bool   holding;     // the caller holds the buffer before head
+  double returnedAt;  // when the last chunk was returned, 0 => none
+  struct ReadAheadStats stats;
+#ifdef HAVE_LIBURING
+  struct io_uring ring;
+#else
+  pthread_t       reader;
+  pthread_mutex_t lock;
+  pthread_cond_t  changed;
+  bool            stop;  // set by readahead_finish()
+  bool            done;  // the reader thread has issued its last read
+#endif
+};
+
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//
+// nextRead
+//
+// Claims the next chunk of the range: sets *offset and returns its
+// length, or 0 if the whole range has been claimed.
+//
+static long nextRead(struct ReadAhead* ra, off_t* offset) {
+  if (ra->offset >= ra->end) {
+    return 0;
+  }
+
+  long n = ra->chunkBytes;
+  if (ra->end - ra->offset < n) {
+    n = (long)(ra->end - ra->offset);
+  }
+  *offset = ra->offset;
+  ra->offset += n;
+  return n;
+}
+
+#ifdef HAVE_LIBURING
+
+//
+// issueRead
+//
+// Queues a read of the next chunk into buffer b; returns false if
+// there is nothing left to read. The caller submits.
+//
+static bool issueRead(struct ReadAhead* ra, int b) {
+  off_t offset;
+  long n = nextRead(ra, &offset);
+  if (n == 0) {
+    return false;
+  }
+
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ra->ring);
+  if (sqe == NULL) {
+    panic("io_uring submission queue is full");
+  }
+  io_uring_prep_read(sqe, ra->fd, ra->buffers[b], (unsigned)n, offset);
+  io_uring_sqe_set_data(sqe, (void*)(long)b);
+
+  ra->inUse[b] = true;
+  ra->ready[b] = false;
+  return true;
+}
+
+//
+// reapOne
+//
+// Waits for one read to complete, in whatever order the device
+// finishes them.
+//
+static void reapOne(struct ReadAhead* ra) {
+  struct io_uring_cqe* cqe;
+
+  if (io_uring_wait_cqe(&ra->ring, &cqe) < 0) {
+    panic("io_uring wait failed");
+  }
+  int b = (int)(long)io_uring_cqe_get_data(cqe);
+  ra->lengths[b] = cqe->res;
+  ra->ready[b] = true;
+  io_uring_cqe_seen(&ra->ring, cqe);
+}
+
+static void startReads(struct ReadAhead* ra) {
+  if (io_uring_queue_init(READAHEAD_DEPTH, &ra->ring, 0) < 0) {
+    panic("unable to set up io_uring");
+  }
+  for (int b = 0; b < READAHEAD_DEPTH; b++) {
+    issueRead(ra, b);
+  }
+  io_uring_submit(&ra->ring);
+}
+
+//
+// waitForHead
+//
+// Hands the buffer the caller held back for the next read, then
+// waits for the head buffer's read. Returns false at the end.
+//
+static bool waitForHead(struct ReadAhead* ra) {
+  if (ra->holding) {
+    int b = (ra->head + READAHEAD_DEPTH - 1) % READAHEAD_DEPTH;
+    ra->inUse[b] = false;
+    ra->ready[b] = false;
+    if (issueRead(ra, b)) {
+      io_uring_submit(&ra->ring);
+    }
+  }
+
+  if (!ra->inUse[ra->head]) {
+    return false;
+  }
+  while (!ra->ready[ra->head]) {
+    reapOne(ra);
+  }
+  return true;
+}
+
+static void stopReads(struct ReadAhead* ra) {
+  for (int b = 0; b < READAHEAD_DEPTH; b++) {
+    while (ra->inUse[b] && !ra->ready[b]) {
+      reapOne(ra);
+    }
+  }
+  io_uring_queue_exit(&ra->ring);
+}
+
+#else
+
+//
+// readChunks
+//
+// Reader thread: reads the chunks in order into the buffers as
+// they are handed back, staying up to READAHEAD_DEPTH chunks ahead.
+//
+static void* readChunks(void* arg) {
+  struct ReadAhead* ra = (struct ReadAhead*)arg;
+  int b = 0;
+
+  pthread_mutex_lock(&ra->lock);
+  while (true) {
+    while (!ra->stop && ra->inUse[b]) {
+      pthread_cond_wait(&ra->changed, &ra->lock);
+    }
+
+    off_t offset;
+    long n = ra->stop ? 0 : nextRead(ra, &offset);
+    if (n == 0) {
+      break;
+    }
+    ra->inUse[b] = true;
+    ra->ready[b] = false;
+    pthread_mutex_unlock(&ra->lock);
+
+    ssize_t length = pread(ra->fd, ra->buffers[b], n, offset);
+
+    pthread_mutex_lock(&ra->lock);
+    ra->lengths[b] = length;
+    ra->ready[b] = true;
+    pthread_cond_broadcast(&ra->changed);
+    if (length <= 0) {
+      break;  // error: the caller stops at this chunk
+    }
+    b = (b + 1) % READAHEAD_DEPTH;
+  }
+  ra->done = true;
+  pthread_cond_broadcast(&ra->changed);
+  pthread_mutex_unlock(&ra->lock);
+
+  return NULL;
+}
+
+static void startReads(struct ReadAhead* ra) {
+  pthread_mutex_init(&ra->lock, NULL);
+  pthread_cond_init(&ra->changed, NULL);
+  ra->stop = false;
+  ra->done = false;
+
+  if (pthread_create(&ra->reader, NULL, readChunks, ra) != 0) {
+    panic("unable to start read-ahead thread");
+  }
+}
+
+static bool waitForHead(struct ReadAhead* ra) {
+  int b = ra->head;
+
+  pthread_mutex_lock(&ra->lock);
+  if (ra->holding) {
+    //
+    // the buffer's chunk has been returned, so it is not ready again
+    // until the reader has read the next chunk into it; left set, the
+    // head would look ready before the reader had claimed it:
+    //
+    int held = (b + READAHEAD_DEPTH - 1) % READAHEAD_DEPTH;
+    ra->inUse[held] = false;
+    ra->ready[held] = false;
+    pthread_cond_broadcast(&ra->changed);
+  }
+  while (!ra->ready[b] && !(ra->done && !ra->inUse[b])) {
+    pthread_cond_wait(&ra->changed, &ra->lock);
+  }
+  bool ready = ra->inUse[b] && ra->ready[b];
+  pthread_mutex_unlock(&ra->lock);
+
+  return ready;
+}
+
+static void stopReads(struct ReadAhead* ra) {
+  pthread_mutex_lock(&ra->lock);
+  ra->stop = true;
+  pthread_cond_broadcast(&ra->changed);
+  pthread_mutex_unlock(&ra->lock);
+
+  pthread_join(ra->reader, NULL);
+  pthread_cond_destroy(&ra->changed);
+  pthread_mutex_destroy(&ra->lock);
+}
+
+#endif
+
+struct ReadAhead* readahead_start(int fd, off_t offset, off_t length,
+                                  int recordSize) {
+  struct ReadAhead* ra = (struct ReadAhead*)malloc(sizeof(struct ReadAhead));
+  if (ra == NULL) {
+    panic("No memory");
+  }
+  memset(ra, 0, sizeof(struct ReadAhead));
+
+  ra->fd = fd;
+  ra->offset = offset;
+  ra->end = offset + ((length > 0) ? length : 0);
+  ra->chunkBytes = (READAHEAD_CHUNK_BYTES / recordSize) * recordSize;
+  if (ra->chunkBytes == 0) {
+    ra->chunkBytes = recordSize;
+  }
+
+  for (int b = 0; b < READAHEAD_DEPTH; b++) {
+    void* buffer;
+    if (posix_memalign(&buffer, READAHEAD_ALIGNMENT, ra->chunkBytes) != 0) {
+      panic("No memory");
+    }
+    ra->buffers[b] = (char*)buffer;
+  }
+
+  // let the kernel read ahead aggressively as well
+  posix_fadvise(fd, offset, length, POSIX_FADV_SEQUENTIAL);
+
+  startReads(ra);
+  return ra;
+}
+
+char* readahead_next(struct ReadAhead* ra, long* length) {
+  double start = now();
+
+  if (ra->returnedAt > 0) {
+    ra->stats.cpuSeconds += start - ra->returnedAt;
+  }
+
+  bool ready = waitForHead(ra);
+  ra->holding = false;
+
+  double end = now();
+  ra->stats.stallSeconds += end - start;
+  ra->returnedAt = end;
+
+  int b = ra->head;
+  if (!ready || ra->lengths[b] <= 0) {
+    ra->returnedAt = 0;
+    return NULL;
+  }
+
+  ra->stats.bytesRead += ra->lengths[b];
+  ra->stats.numReads++;
+  ra->holding = true;
+  ra->head = (b + 1) % READAHEAD_DEPTH;
+
+  *length = ra->lengths[b];
+  return ra->buffers[b];
+}
+
+void readahead_finish(struct ReadAhead* ra, struct ReadAheadStats* stats) {
+  if (ra->returnedAt > 0) {
+    ra->stats.cpuSeconds += now() - ra->returnedAt;
+  }
+
+  stopReads(ra);
+
+  if (stats != NULL) {
+    stats->bytesRead += ra->stats.bytesRead;
+    stats->numReads += ra->stats.numReads;
+    stats->stallSeconds += ra->stats.stallSeconds;
+    stats->cpuSeconds += ra->stats.cpuSeconds;
+  }
+
+  for (int b = 0; b < READAHEAD_DEPTH; b++) {
+    free(ra->buffers[b]);
+  }
+  free(ra);
+}
+
+void readahead_report(char* tableName, struct ReadAheadStats* stats) {
+  if (getenv("SIMPLESQL_IOSTATS") == NULL || stats->numReads == 0) {
+    return;
+  }
+
+  double total = stats->stallSeconds + stats->cpuSeconds;
+  fprintf(stderr,
+          "%s: %.1f MB in %ld reads, %.1f ms stalled on I/O, %.1f ms CPU "
+          "(%.0f%% stalled)\n",
+          tableName, stats->bytesRead / (1024.0 * 1024.0), stats->numReads,
+          stats->stallSeconds * 1000, stats->cpuSeconds * 1000,
+          (total > 0) ? 100 * stats->stallSeconds / total : 0.0);
+}
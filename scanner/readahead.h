@@ -0,0 +1,85 @@
+/*readahead.h*/
+
+//
+// Asynchronous read-ahead for sequential scans of <table>.data: a
+// byte range of the file is read in large chunks into a ring of
+// READAHEAD_DEPTH page-aligned buffers, so the next chunks are
+// being read while the caller decodes the current one. Reads are
+// issued with io_uring when built with HAVE_LIBURING (and linked
+// with -luring), and otherwise by a reader thread using pread().
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <sys/types.h>
+
+//
+// target size of one read; each chunk holds whole records:
+//
+#define READAHEAD_CHUNK_BYTES (1024 * 1024)
+
+//
+// number of buffers, i.e. up to READAHEAD_DEPTH - 1 chunks are read
+// ahead of the one being decoded:
+//
+#define READAHEAD_DEPTH 3
+
+#define READAHEAD_ALIGNMENT 4096
+
+struct ReadAheadStats
+{
+  long   bytesRead;
+  long   numReads;
+  double stallSeconds;  // waiting for a chunk to arrive
+  double cpuSeconds;    // between chunks, i.e. decoding them
+};
+
+struct ReadAhead;  // opaque
+
+
+//
+// functions:
+//
+
+//
+// readahead_start
+//
+// Starts reading bytes [offset, offset + length) of the open file
+// in chunks that are a multiple of recordSize bytes. The file
+// must not be closed before readahead_finish().
+//
+struct ReadAhead* readahead_start(int fd, off_t offset, off_t length,
+                                  int recordSize);
+
+//
+// readahead_next
+//
+// Waits for the next chunk and returns it, setting *length to the
+// number of bytes read; returns NULL at the end of the range or on
+// a read error. The chunk is valid until the next call, which
+// hands its buffer back for another read.
+//
+char* readahead_next(struct ReadAhead* ra, long* length);
+
+//
+// readahead_finish
+//
+// Waits for any reads still outstanding, frees the buffers, and
+// adds the scan's byte counts and timings to *stats (if not NULL).
+//
+void readahead_finish(struct ReadAhead* ra, struct ReadAheadStats* stats);
+
+//
+// readahead_report
+//
+// If the environment variable SIMPLESQL_IOSTATS is set, prints the
+// bytes read by the scans of the table and the time they stalled
+// on I/O against the time spent on CPU to stderr, e.g. "Movies:
+// 12.0 MB in 12 reads, 3.1 ms stalled on I/O, 40.2 ms CPU (7%
+// stalled)".
+//
+void readahead_report(char* tableName, struct ReadAheadStats* stats);
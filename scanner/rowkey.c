@@ -0,0 +1,122 @@
+/*rowkey.c*/
+
+//
+// Binary row keys for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "database.h"
+#include "fieldparse.h"
+#include "resultset.h"
+#include "rowkey.h"
+#include "util.h"
+
+int rowkey_encode(int types[], struct Dictionary* dicts[], int N,
+                  char* values[], char** key, int* capacity) {
+  int length = 0;
+
+  for (int j = 0; j < N; j++) {
+    int n = (int)strlen(values[j]);
+    if (length + n + 16 > *capacity) {
+      *capacity = 2 * (length + n + 16);
+      *key = (char*)realloc(*key, *capacity);
+      if (*key == NULL) {
+        panic("No memory");
+      }
+    }
+
+    if (types[j] == COL_TYPE_INT) {
+      int i = fieldparse_int(values[j], n);
+      memcpy(*key + length, &i, sizeof(int));
+      length += sizeof(int);
+    } else if (types[j] == COL_TYPE_REAL) {
+      double r = fieldparse_real(values[j], n);
+      if (r == 0.0) {
+        r = 0.0;  // -0.0 and 0.0 are the same value
+      }
+      memcpy(*key + length, &r, sizeof(double));
+      length += sizeof(double);
+    } else {
+      int code = (dicts == NULL || dicts[j] == NULL)
+                     ? -1
+                     : dictionary_find(dicts[j], values[j], n);
+      if (code >= 0) {
+        int coded = -1 - code;
+        memcpy(*key + length, &coded, sizeof(int));
+        length += sizeof(int);
+      } else {
+        memcpy(*key + length, &n, sizeof(int));
+        memcpy(*key + length + sizeof(int), values[j], n);
+        length += sizeof(int) + n;
+      }
+    }
+  }
+  return length;
+}
+
+unsigned long rowkey_hash(char* key, int length) {
+  unsigned long h = 14695981039346656037ul;
+
+  for (int i = 0; i < length; i++) {
+    h ^= (unsigned char)key[i];
+    h *= 1099511628211ul;
+  }
+  return h;
+}
+
+char* rowkey_output(struct ResultSet* rs, int row, int firstColumn,
+                    int types[], struct Dictionary* dicts[], int N,
+                    char* key) {
+  char* cp = key;
+
+  for (int j = 0; j < N; j++) {
+    if (types[j] == COL_TYPE_INT) {
+      int i;
+      memcpy(&i, cp, sizeof(int));
+      resultset_putInt(rs, row, firstColumn + j, i);
+      cp += sizeof(int);
+    } else if (types[j] == COL_TYPE_REAL) {
+      double r;
+      memcpy(&r, cp, sizeof(double));
+      resultset_putReal(rs, row, firstColumn + j, r);
+      cp += sizeof(double);
+    } else {
+      int n;
+      memcpy(&n, cp, sizeof(int));
+      if (n < 0) {  // a code
+        resultset_putString(rs, row, firstColumn + j, dicts[j]->entries[-1 - n]);
+        cp += sizeof(int);
+        continue;
+      }
+      char* s = (char*)malloc(n + 1);
+      if (s == NULL) {
+        panic("No memory");
+      }
+      memcpy(s, cp + sizeof(int), n);
+      s[n] = '\0';
+      resultset_putString(rs, row, firstColumn + j, s);
+      free(s);
+      cp += sizeof(int) + n;
+    }
+  }
+  return cp;
+}
+
+char* rowkey_skip(int type, char* key) {
+  if (type == COL_TYPE_INT) {
+    return key + sizeof(int);
+  } else if (type == COL_TYPE_REAL) {
+    return key + sizeof(double);
+  } else {
+    int n;
+    memcpy(&n, key, sizeof(int));
+    return key + sizeof(int) + ((n < 0) ? 0 : n);  // n < 0 => a code
+  }
+}
@@ -0,0 +1,65 @@
+/*rowkey.h*/
+
+//
+// Binary row keys for SimpleSQL: a row's values, in text form, are
+// encoded so that two rows are equal exactly when their encodings
+// are byte-for-byte equal. Ints and reals are stored in binary, so
+// "7" and "07" (or "1.5" and "1.50") compare equal, and strings are
+// prefixed by their length. Used wherever rows are hashed, e.g. by
+// set operations and GROUP BY.
+//
+// A string column may come with a dictionary (NULL if not): a value
+// in the dictionary is then stored as its code, in place of the
+// length, as -1 - code; a value not in it is stored as usual.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include "dictionary.h"
+#include "resultset.h"
+
+
+//
+// functions:
+//
+
+//
+// rowkey_encode
+//
+// Encodes values[0..N-1], whose column types are types[0..N-1] and
+// dictionaries dicts[0..N-1] (dicts itself may be NULL, for none),
+// into *key, growing the buffer (of *capacity bytes) as needed.
+// Returns the length of the encoding.
+//
+int rowkey_encode(int types[], struct Dictionary* dicts[], int N,
+                  char* values[], char** key, int* capacity);
+
+//
+// rowkey_hash
+//
+// FNV-1a over the encoded row.
+//
+unsigned long rowkey_hash(char* key, int length);
+
+//
+// rowkey_output
+//
+// Decodes an encoded row into columns firstColumn .. firstColumn+N-1
+// of the given row of the result set. Returns a pointer just past
+// the encoding.
+//
+char* rowkey_output(struct ResultSet* rs, int row, int firstColumn,
+                    int types[], struct Dictionary* dicts[], int N,
+                    char* key);
+
+//
+// rowkey_skip
+//
+// Returns a pointer just past one encoded value of the given type,
+// e.g. to find the start of the j-th value of a row key.
+//
+char* rowkey_skip(int type, char* key);
@@ -0,0 +1,490 @@
+/*sample.c*/
+
+//
+// Approximate aggregates for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <assert.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "batch.h"
+#include "database.h"
+#include "encode.h"
+#include "fieldparse.h"
+#include "predicate.h"
+#include "resultset.h"
+#include "sample.h"
+#include "schemamap.h"
+#include "tablefile.h"
+#include "util.h"
+
+#define SAMPLE_FEISTEL_ROUNDS 4
+
+static char* functions[] = {"", "MIN", "MAX", "SUM", "AVG", "COUNT"};
+
+//
+// one aggregate of the query, and what the sample says about it:
+//
+struct Estimate
+{
+  int    function;
+  int    column;      // 0-based table column
+  int    colType;
+  long   count;       // qualifying rows in the sample
+  double sum;         // of the column over the qualifying rows
+  double sumSquares;
+  double min, max;
+};
+
+struct Sampler
+{
+  struct TableMeta* table;
+  int    fd;
+  long   numRecords;  // N, the population
+  long   numSampled;  // n, records drawn so far, live or not
+  int    halfBits;    // the permutation is over 2^(2 * halfBits) values
+  unsigned long keys[SAMPLE_FEISTEL_ROUNDS];
+  struct Predicate* pred;  // NULL => every live record
+  int    numEstimates;
+  struct Estimate* estimates;
+  char*  buffer;      // one record
+  char*  span;        // SAMPLE_MAX_SPAN bytes
+  char** fields;
+  int*   lengths;
+  long   bytesRead;
+};
+
+bool sample_enabled(void) {
+  char* percent = getenv("SIMPLESQL_SAMPLE");
+
+  return percent != NULL && atof(percent) > 0;
+}
+
+long sample_size(long numRecords) {
+  char* text = getenv("SIMPLESQL_SAMPLE");
+  double percent = (text != NULL) ? atof(text) : 0;
+
+  if (percent > 100) {
+    percent = 100;
+  }
+  return (percent > 0) ? (long)ceil(numRecords * percent / 100) : 0;
+}
+
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long mix(unsigned long h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdul;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ul;
+  h ^= h >> 33;
+  return h;
+}
+
+//
+// permute
+//
+// The i-th record of the sample: a Feistel network scrambles the
+// indexes [0, 2^(2 * halfBits)), and indexes past the end of the
+// table are scrambled again until they land in [0, N), which maps
+// [0, N) onto itself. So the first n indexes are n distinct records,
+// a uniform sample without replacement, and a larger sample always
+// extends a smaller one.
+//
+static long permute(struct Sampler* s, long i) {
+  unsigned long mask = (1ul << s->halfBits) - 1;
+  unsigned long x = (unsigned long)i;
+
+  do {
+    unsigned long left = x >> s->halfBits, right = x & mask;
+    for (int r = 0; r < SAMPLE_FEISTEL_ROUNDS; r++) {
+      unsigned long t = left ^ (mix(right ^ s->keys[r]) & mask);
+      left = right;
+      right = t;
+    }
+    x = (left << s->halfBits) | right;
+  } while (x >= (unsigned long)s->numRecords);
+
+  return (long)x;
+}
+
+static int compareRecnos(const void* a, const void* b) {
+  long x = *(const long*)a, y = *(const long*)b;
+
+  return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+//
+// foldRecord
+//
+// Adds one sampled record, in s->buffer, to the estimates.
+//
+static void foldRecord(struct Sampler* s) {
+  struct TableMeta* table = s->table;
+
+  if (tablefile_isDeleted(s->buffer) ||
+      fieldparse_split(s->buffer, s->fields, s->lengths, table->numColumns) <
+          table->numColumns) {
+    return;
+  }
+  if (s->pred != NULL &&
+      !s->pred->evalRecord(s->pred, s->fields, s->lengths)) {
+    return;
+  }
+
+  for (int a = 0; a < s->numEstimates; a++) {
+    struct Estimate* e = &s->estimates[a];
+    e->count++;
+    if (e->function == COUNT_FUNCTION) {
+      continue;
+    }
+
+    char* field = s->fields[e->column];
+    int length = s->lengths[e->column];
+    double x = (e->colType == COL_TYPE_INT) ? fieldparse_int(field, length)
+                                            : fieldparse_real(field, length);
+    e->sum += x;
+    e->sumSquares += x * x;
+    if (x < e->min) {
+      e->min = x;
+    }
+    if (x > e->max) {
+      e->max = x;
+    }
+  }
+}
+
+//
+// sampleMore
+//
+// Draws records [numSampled, target) of the sample and folds them
+// in. They are read in file order, and sampled records close to
+// each other with one pread().
+//
+static void sampleMore(struct Sampler* s, long target) {
+  long k = target - s->numSampled;
+  long* recnos = (long*)malloc(sizeof(long) * (k + 1));
+  if (recnos == NULL) {
+    panic("No memory");
+  }
+  for (long i = 0; i < k; i++) {
+    recnos[i] = permute(s, s->numSampled + i);
+  }
+  qsort(recnos, k, sizeof(long), compareRecnos);
+
+  int recordSize = s->table->recordSize;
+  long maxSpanRecords = SAMPLE_MAX_SPAN / recordSize;
+  long maxGapRecords = SAMPLE_MAX_GAP / recordSize;
+
+  for (long i = 0; i < k;) {
+    long first = recnos[i];
+    long j = i + 1;
+    while (j < k && recnos[j] - recnos[j - 1] <= maxGapRecords + 1 &&
+           recnos[j] - first < maxSpanRecords) {
+      j++;
+    }
+
+    long spanBytes = (recnos[j - 1] - first + 1) * recordSize;
+    ssize_t n = pread(s->fd, s->span, spanBytes, (off_t)first * recordSize);
+    if (n > 0) {
+      s->bytesRead += n;
+    }
+    for (long m = i; m < j; m++) {
+      long offset = (recnos[m] - first) * recordSize;
+      if (offset + recordSize > n) {
+        break;  // e.g. the file shrank
+      }
+      memcpy(s->buffer, s->span + offset, recordSize);
+      s->buffer[recordSize] = '\0';
+      foldRecord(s);
+    }
+    i = j;
+  }
+
+  s->numSampled = target;
+  free(recnos);
+}
+
+//
+// estimate
+//
+// The estimate of an aggregate over the whole table and the half
+// width of its confidence interval (0 if exact, -1 if the sample
+// cannot bound it). The sample is without replacement, so the
+// variances shrink by the finite population correction 1 - n/N and
+// a sample of the whole table is exact.
+//
+static double estimate(struct Sampler* s, struct Estimate* e, double* half) {
+  double N = s->numRecords;
+  double n = s->numSampled;
+  double fpc = (N > 0) ? 1 - n / N : 0;
+
+  *half = 0;
+  if (n == 0) {
+    return 0;
+  }
+
+  switch (e->function) {
+    case COUNT_FUNCTION: {
+      double p = e->count / n;  // fraction of the records that qualify
+      if (n > 1) {
+        *half = SAMPLE_Z * N * sqrt(p * (1 - p) / (n - 1) * fpc);
+      }
+      return N * p;
+    }
+    case SUM_FUNCTION: {
+      // the mean of the column over all records, 0 where not qualifying
+      double mean = e->sum / n;
+      if (n > 1) {
+        double variance = (e->sumSquares - n * mean * mean) / (n - 1);
+        *half = SAMPLE_Z * N * sqrt((variance > 0 ? variance : 0) / n * fpc);
+      }
+      return N * mean;
+    }
+    case AVG_FUNCTION: {
+      if (e->count == 0) {
+        *half = -1;
+        return 0;
+      }
+      double q = e->count;
+      double mean = e->sum / q;
+      if (q > 1) {
+        double variance = (e->sumSquares - q * mean * mean) / (q - 1);
+        *half = SAMPLE_Z * sqrt((variance > 0 ? variance : 0) / q * fpc);
+      }
+      return mean;
+    }
+    default:  // MIN, MAX: the sample's own, a bound on one side only
+      if (e->count == 0) {
+        *half = -1;
+        return 0;
+      }
+      *half = (n < N) ? -1 : 0;
+      return (e->function == MIN_FUNCTION) ? e->min : e->max;
+  }
+}
+
+//
+// printEstimates
+//
+// Prints the estimates after a round.
+//
+static void printEstimates(struct Sampler* s, double seconds) {
+  printf("**ESTIMATES after %ld of %ld records (%.2f%%), %ld bytes read, "
+         "%.3f secs, %s confidence**\n",
+         s->numSampled, s->numRecords,
+         (s->numRecords > 0) ? 100.0 * s->numSampled / s->numRecords : 0.0,
+         s->bytesRead, seconds, SAMPLE_CONFIDENCE);
+
+  for (int a = 0; a < s->numEstimates; a++) {
+    struct Estimate* e = &s->estimates[a];
+    double half;
+    double value = estimate(s, e, &half);
+    char* name = s->table->columns[e->column].name;
+
+    if (e->function != COUNT_FUNCTION && e->count == 0) {
+      printf("%s(%s.%s) = ? (no qualifying rows sampled)\n",
+             functions[e->function], s->table->name, name);
+    } else if (half < 0) {
+      printf("%s(%s.%s) %s %f (in the sample)\n", functions[e->function],
+             s->table->name, name, (e->function == MIN_FUNCTION) ? "<=" : ">=",
+             value);
+    } else {
+      printf("%s(%s.%s) = %f +/- %f\n", functions[e->function],
+             s->table->name, name, value, half);
+    }
+  }
+}
+
+//
+// prepare
+//
+// Checks the query can be estimated and sets up its estimates.
+// Returns false (after printing an error) if not.
+//
+static bool prepare(struct Sampler* s, struct SELECT* select) {
+  struct TableMeta* table = s->table;
+
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    struct ColumnMeta* column = database_findColumn(table, c->name);
+    assert(column != NULL);
+
+    if (c->function == NO_FUNCTION) {
+      printf("**Error: a sampled query can only select aggregates, column "
+             "'%s' is not aggregated\n",
+             column->name);
+      return false;
+    }
+    if (c->function != COUNT_FUNCTION && column->colType == COL_TYPE_STRING) {
+      printf("**Error: sampling cannot estimate this aggregate of string "
+             "column '%s'\n",
+             column->name);
+      return false;
+    }
+
+    struct Estimate* e = &s->estimates[s->numEstimates++];
+    memset(e, 0, sizeof(struct Estimate));
+    e->function = c->function;
+    e->column = (int)(column - table->columns);
+    e->colType = column->colType;
+    e->min = INFINITY;
+    e->max = -INFINITY;
+  }
+  return true;
+}
+
+//
+// output
+//
+// Prints the final estimates as the query's result, one row with a
+// column per aggregate, typed as the exact query's would be, except
+// that a SUM is estimated as a real even over an int column.
+//
+static void output(struct Sampler* s) {
+  struct ResultSet* result = resultset_create();
+  int row = resultset_addRow(result);
+
+  for (int a = 0; a < s->numEstimates; a++) {
+    struct Estimate* e = &s->estimates[a];
+    int colType = e->colType;
+    if (e->function == COUNT_FUNCTION) {
+      colType = COL_TYPE_INT;
+    } else if (e->function == AVG_FUNCTION || e->function == SUM_FUNCTION) {
+      colType = COL_TYPE_REAL;
+    }
+    resultset_insertColumn(result, a + 1, s->table->name,
+                           s->table->columns[e->column].name, e->function,
+                           colType);
+
+    double half;
+    double value = estimate(s, e, &half);
+    if (colType == COL_TYPE_INT) {
+      resultset_putInt(result, row, a + 1, (int)llround(value));
+    } else {
+      resultset_putReal(result, row, a + 1, value);
+    }
+  }
+
+  encode_resultSet(result);
+  batch_countRows(result->numRows);
+  resultset_destroy(result);
+}
+
+void sample_execute(struct Database* db, struct SELECT* select) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  struct TableMeta* table = database_findTable(db, select->table);
+  assert(table != NULL);
+
+  if (select->into != NULL) {
+    printf("**Error: a sampled query cannot write INTO a table\n");
+    return;
+  }
+
+  int numColumns = 0;
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    numColumns++;
+  }
+
+  struct Sampler s;
+  memset(&s, 0, sizeof(s));
+  s.table = table;
+  s.estimates =
+      (struct Estimate*)malloc(sizeof(struct Estimate) * (numColumns + 1));
+  if (s.estimates == NULL) {
+    panic("No memory");
+  }
+  if (!prepare(&s, select)) {
+    free(s.estimates);
+    return;
+  }
+
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  s.fd = open(datapath, O_RDONLY);
+  if (s.fd < 0) {
+    printf("**Error: file '%s'is not found.", datapath);
+    panic("stop execution");
+  }
+  s.numRecords = tablefile_numRecords(s.fd, table);
+  if (s.numRecords < 0) {
+    s.numRecords = 0;
+  }
+
+  s.buffer = (char*)malloc(table->recordSize + 1);
+  s.span = (char*)malloc(SAMPLE_MAX_SPAN + table->recordSize);
+  s.fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  s.lengths = (int*)malloc(sizeof(int) * table->numColumns);
+  if (s.buffer == NULL || s.span == NULL || s.fields == NULL ||
+      s.lengths == NULL) {
+    panic("No memory");
+  }
+  if (select->where != NULL) {
+    s.pred = predicate_compile(table, select->where->expr);
+  }
+
+  // a fresh permutation, i.e. a different sample, for every query
+  s.halfBits = 1;
+  while ((1l << (2 * s.halfBits)) < s.numRecords) {
+    s.halfBits++;
+  }
+  unsigned long seed =
+      (unsigned long)time(NULL) ^ ((unsigned long)getpid() << 32);
+  for (int r = 0; r < SAMPLE_FEISTEL_ROUNDS; r++) {
+    seed = mix(seed + 0x9e3779b97f4a7c15ul);
+    s.keys[r] = seed;
+  }
+
+  long target = sample_size(s.numRecords);
+
+  //
+  // rounds of SAMPLE_FIRST_ROUND, then doubling, records; the
+  // estimates are text, so in a binary or CSV format only the final
+  // result is written:
+  //
+  bool progress = (encode_format() == ENCODE_TEXT);
+  double start = now();
+  long round = SAMPLE_FIRST_ROUND;
+  while (s.numSampled < target) {
+    long next = (round < target) ? round : target;
+    sampleMore(&s, next);
+    if (progress && s.numSampled < target) {
+      printEstimates(&s, now() - start);
+    }
+    round *= 2;
+  }
+  if (progress) {
+    printEstimates(&s, now() - start);
+  }
+  output(&s);
+
+  if (s.pred != NULL) {
+    predicate_destroy(s.pred);
+  }
+  free(s.lengths);
+  free(s.fields);
+  free(s.span);
+  free(s.buffer);
+  free(s.estimates);
+  close(s.fd);
+}
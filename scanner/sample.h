@@ -0,0 +1,76 @@
+/*sample.h*/
+
+//
+// Approximate aggregates for SimpleSQL (TABLESAMPLE): COUNT, SUM,
+// AVG, MIN and MAX estimated from a uniform random sample of the
+// table's records, without replacement. Records are fixed-width,
+// so a sampled record is read at a known offset and the rest of
+// the file is never touched.
+//
+// The sample is drawn in rounds that double it, starting with
+// SAMPLE_FIRST_ROUND records, and the estimates, with confidence
+// intervals of SAMPLE_CONFIDENCE, are printed after every round, so
+// they refine progressively the longer the query runs. The last
+// round's estimates are printed as the query's result.
+//
+// Set the environment variable SIMPLESQL_SAMPLE to the percentage
+// of the records to sample, e.g. 1 or 0.05, to have queries whose
+// columns are all aggregates estimated this way.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "database.h"
+
+#define SAMPLE_FIRST_ROUND 1024
+
+//
+// the confidence of the intervals, and its z-score:
+//
+#define SAMPLE_CONFIDENCE "95%"
+#define SAMPLE_Z          1.96
+
+//
+// sampled records at most SAMPLE_MAX_GAP bytes apart are read with
+// one read, of at most SAMPLE_MAX_SPAN bytes:
+//
+#define SAMPLE_MAX_GAP  4096
+#define SAMPLE_MAX_SPAN (64 * 1024)
+
+
+//
+// functions:
+//
+
+//
+// sample_enabled
+//
+// Returns true if SIMPLESQL_SAMPLE is set to a percentage > 0.
+//
+bool sample_enabled(void);
+
+//
+// sample_size
+//
+// Returns the number of records sampled from a table of the given
+// number of records.
+//
+long sample_size(long numRecords);
+
+//
+// sample_execute
+//
+// Estimates the query's aggregates over the records that satisfy
+// its WHERE clause from a sample of SIMPLESQL_SAMPLE percent of the
+// table, printing the estimates after each round and the final ones
+// as the result. Every column of the query must be an aggregate;
+// SUM, AVG, MIN and MAX require a numeric column.
+//
+void sample_execute(struct Database* db, struct SELECT* select);
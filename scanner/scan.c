@@ -0,0 +1,513 @@
+/*scan.c*/
+
+//
+// Table scans for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "colresult.h"
+#include "database.h"
+#include "fieldparse.h"
+#include "index.h"
+#include "like.h"
+#include "modify.h"
+#include "predicate.h"
+#include "readahead.h"
+#include "scan.h"
+#include "schemamap.h"
+#include "sharedscan.h"
+#include "tablefile.h"
+#include "util.h"
+#include "zonemap.h"
+
+//
+// consumeRecord
+//
+// Hands one record read by a scan to its destination; deleted
+// records are skipped. Returns false once the scan can stop, i.e.
+// the LIMIT has been reached or emit asked to stop.
+//
+static bool consumeRecord(struct Scan* scan, char* buffer) {
+  scan->numRecords++;
+  if (tablefile_isDeleted(buffer)) {
+    return true;
+  }
+
+  int numFields = fieldparse_split(buffer, scan->fields, scan->lengths,
+                                   scan->table->numColumns);
+  if (numFields < scan->table->numColumns) {
+    return true;  // malformed record
+  }
+
+  if (scan->emit == NULL) {
+    colresult_addRecord(scan->result, scan->fields, scan->lengths);
+    return true;
+  }
+  if (scan->pred != NULL &&
+      !scan->pred->evalRecord(scan->pred, scan->fields, scan->lengths)) {
+    return true;
+  }
+
+  for (int j = 0; j < scan->numProjected; j++) {
+    scan->values[j] = scan->fields[scan->projection[j]];
+  }
+  if (!scan->emit(scan->state, scan->values)) {
+    scan->stopped = true;
+    return false;
+  }
+
+  scan->numRows++;
+  return scan->limit < 0 || scan->numRows < scan->limit;
+}
+
+static int compareRecnos(const void* a, const void* b) {
+  long x = *(const long*)a, y = *(const long*)b;
+
+  return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+//
+// likePrefix
+//
+// If the WHERE clause is a LIKE on an indexed string column whose
+// pattern starts with a literal prefix, returns the prefix (to be
+// freed by the caller) and sets *column; otherwise returns NULL.
+//
+static char* likePrefix(struct TableMeta* table, struct WHERE* where,
+                        struct ColumnMeta** column) {
+  if (where == NULL || where->expr->operator != EXPR_LIKE) {
+    return NULL;
+  }
+
+  *column = database_findColumn(table, where->expr->column->name);
+  if (*column == NULL || (*column)->colType != COL_TYPE_STRING ||
+      (*column)->indexType == COL_NON_INDEXED) {
+    return NULL;
+  }
+
+  struct LikePattern* like = like_compile(where->expr->value);
+  char* prefix = (char*)malloc(strlen(where->expr->value) + 1);
+  if (prefix == NULL) {
+    panic("No memory");
+  }
+  int prefixLength = like_prefix(like, prefix);
+  like_destroy(like);
+
+  if (prefixLength == 0) {
+    free(prefix);
+    return NULL;
+  }
+  return prefix;
+}
+
+//
+// zoneColumn
+//
+// If the WHERE clause compares a numeric column using <, <=, >, >=
+// or =, or any column using =, returns the column; otherwise
+// returns NULL.
+//
+static struct ColumnMeta* zoneColumn(struct TableMeta* table,
+                                     struct WHERE* where) {
+  if (where == NULL || where->expr->operator < EXPR_LT ||
+      where->expr->operator > EXPR_EQUAL) {
+    return NULL;
+  }
+
+  struct ColumnMeta* column =
+      database_findColumn(table, where->expr->column->name);
+  if (column == NULL ||
+      (column->colType != COL_TYPE_INT && column->colType != COL_TYPE_REAL &&
+       where->expr->operator != EXPR_EQUAL)) {
+    return NULL;
+  }
+  return column;
+}
+
+//
+// blockMayMatch
+//
+// Returns false if the zone map shows that no record of the block
+// satisfies the WHERE clause: its [min, max] rules the value out,
+// or, for =, its Bloom filter does.
+//
+static bool blockMayMatch(struct ZoneMap* zm, long block,
+                          struct TableMeta* table, struct ColumnMeta* column,
+                          struct WHERE* where) {
+  int colIndex = (int)(column - table->columns);
+  int oper = where->expr->operator;
+
+  if (column->colType == COL_TYPE_INT || column->colType == COL_TYPE_REAL) {
+    double value = (column->colType == COL_TYPE_INT)
+                       ? atoi(where->expr->value)
+                       : atof(where->expr->value);
+    if (!zonemap_blockMayMatch(zm, block, colIndex, oper, value)) {
+      return false;
+    }
+  }
+
+  return oper != EXPR_EQUAL ||
+         zonemap_blockMayContain(
+             zm, block, colIndex,
+             zonemap_hash(table, colIndex, where->expr->value));
+}
+
+//
+// indexScan
+//
+// If the WHERE clause is a LIKE whose pattern starts with a literal
+// prefix, and the column is indexed, reads only the records whose
+// key starts with that prefix, in file order. The WHERE predicate
+// is still applied for the rest of the pattern. Returns false if
+// there is no such index range, in which case nothing was read.
+//
+static bool indexScan(struct Database* db, struct WHERE* where, FILE* file,
+                      struct Scan* scan, char* buffer) {
+  struct TableMeta* table = scan->table;
+  struct ColumnMeta* column;
+
+  char* prefix = likePrefix(table, where, &column);
+  if (prefix == NULL) {
+    return false;
+  }
+
+  struct Index* index = index_open(db, table, column);
+  if (index == NULL) {
+    free(prefix);
+    return false;
+  }
+
+  long lo, hi;
+  index_prefixRange(index, prefix, &lo, &hi);
+  free(prefix);
+
+  long N = hi - lo;
+  long* recnos = (long*)malloc(sizeof(long) * (N + 1));
+  if (recnos == NULL) {
+    panic("No memory");
+  }
+  for (long i = 0; i < N; i++) {
+    recnos[i] = index_recno(index, lo + i);
+  }
+  index_close(index);
+
+  // reading in file order keeps the rows in the same order as a full scan
+  qsort(recnos, N, sizeof(long), compareRecnos);
+
+  int fd = fileno(file);
+  scan->path = SCAN_INDEX;
+  for (long i = 0; i < N; i++) {
+    if (!tablefile_readRecord(fd, table, recnos[i], buffer)) {
+      continue;
+    }
+    scan->io.bytesRead += table->recordSize;
+    scan->io.numReads++;
+    if (!consumeRecord(scan, buffer)) {
+      break;
+    }
+  }
+  free(recnos);
+
+  return true;
+}
+
+//
+// zoneScan
+//
+// If the WHERE clause compares a numeric column using <, <=, >, >=
+// or =, or any column using =, reads the file a block at a time,
+// skipping the blocks whose zone map entry or Bloom filter shows
+// they cannot contain a match. Returns false if the zone map does
+// not apply, or rules out no block, in which case nothing was read
+// and a full scan, with read-ahead, does better.
+//
+static bool zoneScan(struct Database* db, struct WHERE* where, FILE* file,
+                     struct Scan* scan, char* buffer) {
+  struct TableMeta* table = scan->table;
+
+  struct ColumnMeta* column = zoneColumn(table, where);
+  if (column == NULL) {
+    return false;
+  }
+
+  struct ZoneMap* zm = zonemap_open(db, table);
+  if (zm == NULL) {
+    return false;
+  }
+
+  int fd = fileno(file);
+  long numRecords = tablefile_numRecords(fd, table);
+  long numBlocks = (numRecords + zm->blockRecords - 1) / zm->blockRecords;
+  long blockBytes = (long)zm->blockRecords * table->recordSize;
+  bool* candidates = (bool*)malloc(sizeof(bool) * (numBlocks + 1));
+  if (candidates == NULL) {
+    panic("No memory");
+  }
+
+  long numCandidates = 0;
+  for (long b = 0; b < numBlocks; b++) {
+    candidates[b] = blockMayMatch(zm, b, table, column, where);
+    numCandidates += candidates[b];
+  }
+  zonemap_close(zm);
+  if (numCandidates == numBlocks) {
+    free(candidates);
+    return false;
+  }
+
+  char* block = (char*)malloc(blockBytes);
+  if (block == NULL) {
+    panic("No memory");
+  }
+
+  scan->path = SCAN_ZONE_MAP;
+  bool more = true;
+  for (long b = 0; more && b < numBlocks; b++) {
+    if (!candidates[b]) {
+      continue;
+    }
+
+    ssize_t n = pread(fd, block, blockBytes, (off_t)b * blockBytes);
+    if (n <= 0) {
+      break;
+    }
+    scan->io.bytesRead += n;
+    scan->io.numReads++;
+
+    long numInBlock = n / table->recordSize;
+    for (long r = 0; more && r < numInBlock; r++) {
+      memcpy(buffer, block + r * table->recordSize, table->recordSize);
+      buffer[table->recordSize] = '\0';
+      more = consumeRecord(scan, buffer);
+    }
+  }
+
+  free(block);
+  free(candidates);
+  return true;
+}
+
+//
+// fullScan
+//
+// Reads every record of the file in order. The file is read ahead
+// in large chunks, so the next chunks are being read while the
+// records of this one are decoded and filtered.
+//
+static void fullScan(FILE* file, struct Scan* scan, char* buffer) {
+  struct TableMeta* table = scan->table;
+  int fd = fileno(file);
+
+  // joins another query's scan of the file, when scans are shared;
+  // a shared scan starts where it joins, so not if the query keeps
+  // the first rows of the file (LIMIT) or writes them (INTO) in order
+  struct SharedScan* shared =
+      scan->inOrder ? NULL : sharedscan_attach(fd, table);
+  struct ReadAhead* ra = NULL;
+  if (shared == NULL) {
+    long numRecords = tablefile_numRecords(fd, table);
+    ra = readahead_start(fd, 0, (off_t)numRecords * table->recordSize,
+                         table->recordSize);
+  }
+
+  bool more = true;
+  while (more) {
+    long length;
+    char* chunk = (shared != NULL) ? sharedscan_next(shared, &length)
+                                   : readahead_next(ra, &length);
+    if (chunk == NULL) {
+      break;
+    }
+    long numInChunk = length / table->recordSize;
+    for (long r = 0; more && r < numInChunk; r++) {
+      memcpy(buffer, chunk + r * table->recordSize, table->recordSize);
+      buffer[table->recordSize] = '\0';
+      more = consumeRecord(scan, buffer);
+    }
+  }
+
+  if (shared != NULL) {
+    sharedscan_detach(shared, &scan->io);
+  } else {
+    readahead_finish(ra, &scan->io);
+  }
+}
+
+void scan_table(struct Database* db, struct WHERE* where,
+                struct Scan* scan) {
+  struct TableMeta* table = scan->table;
+
+  // creates a path to a file by combining the name of the database, a '/'
+  // separator, the name of the table, and the ".data" extension.
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  FILE* file = fopen(datapath, "r");
+
+  if (file == NULL) {
+    printf("**Error: file '%s'is not found.", datapath);
+    panic("stop execution");
+  }
+  // the buffer holds one record plus a null terminator
+  char* buffer = (char*)malloc(sizeof(char) * (table->recordSize + 1));
+  scan->fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  scan->lengths = (int*)malloc(sizeof(int) * table->numColumns);
+  if (buffer == NULL || scan->fields == NULL || scan->lengths == NULL) {
+    panic("No memory");
+  }
+
+  // an index range scan reads only the candidate records, a zone map
+  // scan only the blocks that can match; otherwise every record of the
+  // file is read in order
+  scan->path = SCAN_FULL;
+  if (!indexScan(db, where, file, scan, buffer) &&
+      !zoneScan(db, where, file, scan, buffer)) {
+    fullScan(file, scan, buffer);
+    readahead_report(table->name, &scan->io);
+  }
+
+  free(scan->lengths);
+  scan->lengths = NULL;
+  free(scan->fields);
+  scan->fields = NULL;
+  free(buffer);
+  fclose(file);
+}
+
+bool scan_plan(struct Database* db, struct TableMeta* table,
+               struct WHERE* where, struct ScanPlan* plan) {
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  int fd = open(datapath, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  long numRecords = tablefile_numRecords(fd, table);
+  close(fd);
+
+  memset(plan, 0, sizeof(struct ScanPlan));
+  plan->path = SCAN_FULL;
+  plan->numRecords = (numRecords > 0) ? numRecords : 0;
+  plan->numDeleted = modify_numDeleted(db, table);
+  plan->numCandidates = plan->numRecords;
+
+  struct ColumnMeta* column;
+  char* prefix = likePrefix(table, where, &column);
+  struct Index* index = (prefix != NULL) ? index_open(db, table, column) : NULL;
+  if (index != NULL) {
+    long lo, hi;
+    index_prefixRange(index, prefix, &lo, &hi);
+    index_close(index);
+
+    plan->path = SCAN_INDEX;
+    plan->numCandidates = hi - lo;
+    free(prefix);
+    return true;
+  }
+  free(prefix);
+
+  column = zoneColumn(table, where);
+  struct ZoneMap* zm = (column != NULL) ? zonemap_open(db, table) : NULL;
+  if (zm != NULL) {
+    plan->path = SCAN_ZONE_MAP;
+    plan->numCandidates = 0;
+    plan->numBlocks =
+        (plan->numRecords + zm->blockRecords - 1) / zm->blockRecords;
+    for (long b = 0; b < plan->numBlocks; b++) {
+      if (blockMayMatch(zm, b, table, column, where)) {
+        long n = plan->numRecords - b * zm->blockRecords;
+        plan->numCandidates += (n < zm->blockRecords) ? n : zm->blockRecords;
+        plan->numBlocksRead++;
+      }
+    }
+    zonemap_close(zm);
+
+    // as in zoneScan(), nothing ruled out means a full scan
+    if (plan->numBlocksRead == plan->numBlocks) {
+      plan->path = SCAN_FULL;
+      plan->numCandidates = plan->numRecords;
+      plan->numBlocks = 0;
+      plan->numBlocksRead = 0;
+    }
+  }
+
+  return true;
+}
+
+char* scan_pathName(int path) {
+  static char* names[] = {"full", "index range", "zone map"};
+
+  return names[path];
+}
+
+bool scan_isStreamable(struct SELECT* select) {
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    if (c->function != NO_FUNCTION) {
+      return false;
+    }
+  }
+  return true;
+}
+
+long scan_select(struct Database* db, struct SELECT* select,
+                 ScanEmitFn emit, void* state) {
+  struct TableMeta* table = database_findTable(db, select->table);
+  assert(table != NULL);
+
+  int N = 0;
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    N++;
+  }
+
+  int* projection = (int*)malloc(sizeof(int) * (N + 1));
+  char** values = (char**)malloc(sizeof(char*) * (N + 1));
+  if (projection == NULL || values == NULL) {
+    panic("No memory");
+  }
+
+  int j = 0;
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next, j++) {
+    struct ColumnMeta* column = database_findColumn(table, c->name);
+    assert(column != NULL);
+    projection[j] = (int)(column - table->columns);
+  }
+
+  struct Scan scan;
+  memset(&scan, 0, sizeof(scan));
+  scan.table = table;
+  scan.emit = emit;
+  scan.state = state;
+  scan.pred = (select->where != NULL)
+                  ? predicate_compile(table, select->where->expr)
+                  : NULL;
+  scan.projection = projection;
+  scan.numProjected = N;
+  scan.values = values;
+  scan.limit = (select->limit != NULL) ? select->limit->N : -1;
+  scan.inOrder = (select->limit != NULL || select->into != NULL);
+
+  if (scan.limit != 0) {
+    scan_table(db, select->where, &scan);
+  }
+
+  if (scan.pred != NULL) {
+    predicate_destroy(scan.pred);
+  }
+  free(values);
+  free(projection);
+
+  return scan.stopped ? -1 : scan.numRows;
+}
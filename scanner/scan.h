@@ -0,0 +1,124 @@
+/*scan.h*/
+
+//
+// Table scans for SimpleSQL. A scan reads the live records of a
+// table, through an index range or the zone map when the WHERE
+// clause allows it and otherwise sequentially, and hands each one
+// to its destination: a columnar result holding every column, or,
+// for queries that can be evaluated a record at a time, a callback
+// that receives the projected values of each qualifying row.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "ast.h"
+#include "colresult.h"
+#include "database.h"
+#include "predicate.h"
+#include "readahead.h"
+
+//
+// receives the values of one row (in text form, strings without
+// quotes), which are only valid during the call; returns false to
+// stop the scan:
+//
+typedef bool (*ScanEmitFn)(void* state, char* values[]);
+
+//
+// how a scan reads the table:
+//
+#define SCAN_FULL     0  // every record, in order
+#define SCAN_INDEX    1  // an index range, for LIKE with a prefix
+#define SCAN_ZONE_MAP 2  // the blocks the zone map does not rule out
+
+//
+// how scan_table() would read a table, see scan_plan():
+//
+struct ScanPlan
+{
+  int    path;           // SCAN_FULL, SCAN_INDEX or SCAN_ZONE_MAP
+  long   numRecords;     // records in the data file, live or not
+  long   numDeleted;
+  long   numCandidates;  // records the path reads
+  long   numBlocks;      // zone map: blocks in the table...
+  long   numBlocksRead;  // ...and blocks not ruled out
+};
+
+struct Scan
+{
+  struct TableMeta*      table;
+  char**                 fields;      // scratch, one per column
+  int*                   lengths;     // scratch, length of each field
+  struct ColumnarResult* result;      // every record is added here, or...
+  ScanEmitFn             emit;        // ...filtered, projected and emitted
+  void*                  state;       // passed to emit
+  struct Predicate*      pred;        // emit: WHERE predicate, or NULL
+  int*                   projection;  // emit: table column of each value
+  int                    numProjected;
+  char**                 values;      // emit: scratch, one per value
+  long                   limit;       // emit: max rows, -1 => no limit
+  bool                   inOrder;     // records must come in file order
+  long                   numRows;     // emit: rows emitted so far
+  bool                   stopped;     // emit returned false
+  int                    path;        // SCAN_FULL, SCAN_INDEX, ...
+  long                   numRecords;  // records read, live or not
+  struct ReadAheadStats  io;          // bytes read; full scan: timings
+};
+
+
+//
+// functions:
+//
+
+//
+// scan_table
+//
+// Reads the table's live records into the scan's destination. For
+// a columnar result, the WHERE clause only picks the access path;
+// the caller still has to filter the rows.
+//
+void scan_table(struct Database* db, struct WHERE* where,
+                struct Scan* scan);
+
+//
+// scan_plan
+//
+// Decides, the same way scan_table() does but without reading the
+// data file, how the table would be read for the WHERE clause and
+// how many records that path reads. Returns false if the data file
+// cannot be opened.
+//
+bool scan_plan(struct Database* db, struct TableMeta* table,
+               struct WHERE* where, struct ScanPlan* plan);
+
+//
+// scan_pathName
+//
+// Returns a description of an access path, e.g. "zone map".
+//
+char* scan_pathName(int path);
+
+//
+// scan_isStreamable
+//
+// Returns true if the query can be evaluated a record at a time
+// with scan_select(), i.e. it has no aggregates.
+//
+bool scan_isStreamable(struct SELECT* select);
+
+//
+// scan_select
+//
+// Evaluates a streamable query without building a result set: the
+// values of the selected columns of every record that satisfies
+// the WHERE clause are passed to emit, up to the LIMIT. Returns the
+// number of rows emitted, or -1 if emit stopped the scan.
+//
+long scan_select(struct Database* db, struct SELECT* select,
+                 ScanEmitFn emit, void* state);
@@ -0,0 +1,181 @@
+/*schemamap.c*/
+
+//
+// Case-insensitive hash maps over the database schema.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include "database.h"
+#include "schemamap.h"
+#include "util.h"
+
+//
+// hash: FNV-1a over the lower-cased name, so that "Movies" and
+// "movies" land in the same slot.
+//
+static unsigned int hash(char* name) {
+  unsigned int h = 2166136261u;
+
+  for (char* cp = name; *cp != '\0'; cp++) {
+    h ^= (unsigned char)tolower((unsigned char)*cp);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+//
+// namemap_create
+//
+// Builds a map over N names, sized to at most 50% full so probe
+// sequences stay short.
+//
+static struct NameMap* namemap_create(char** names, int N) {
+  struct NameMap* map = (struct NameMap*)malloc(sizeof(struct NameMap));
+  if (map == NULL) {
+    panic("No memory");
+  }
+
+  map->capacity = 8;
+  while (map->capacity < 2 * N) {
+    map->capacity *= 2;
+  }
+
+  map->names = names;
+  map->slots = (int*)malloc(sizeof(int) * map->capacity);
+  if (map->slots == NULL) {
+    panic("No memory");
+  }
+  for (int i = 0; i < map->capacity; i++) {
+    map->slots[i] = -1;
+  }
+
+  int mask = map->capacity - 1;
+  for (int i = 0; i < N; i++) {
+    int s = hash(names[i]) & mask;
+    while (map->slots[s] != -1) {
+      s = (s + 1) & mask;
+    }
+    map->slots[s] = i;
+  }
+
+  return map;
+}
+
+//
+// namemap_find
+//
+// Returns the position of the name in the owning array, or -1.
+//
+static int namemap_find(struct NameMap* map, char* name) {
+  int mask = map->capacity - 1;
+  int s = hash(name) & mask;
+
+  while (map->slots[s] != -1) {
+    int i = map->slots[s];
+    if (strcasecmp(map->names[i], name) == 0) {
+      return i;
+    }
+    s = (s + 1) & mask;
+  }
+  return -1;
+}
+
+static void namemap_destroy(struct NameMap* map) {
+  if (map == NULL) {
+    return;
+  }
+  free(map->slots);
+  free(map->names);
+  free(map);
+}
+
+void schemamap_build(struct Database* db) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  char** tableNames = (char**)malloc(sizeof(char*) * (db->numTables + 1));
+  if (tableNames == NULL) {
+    panic("No memory");
+  }
+
+  for (int i = 0; i < db->numTables; i++) {
+    struct TableMeta* table = &db->tables[i];
+    tableNames[i] = table->name;
+
+    char** columnNames =
+        (char**)malloc(sizeof(char*) * (table->numColumns + 1));
+    if (columnNames == NULL) {
+      panic("No memory");
+    }
+    for (int j = 0; j < table->numColumns; j++) {
+      columnNames[j] = table->columns[j].name;
+    }
+    table->columnMap = namemap_create(columnNames, table->numColumns);
+  }
+
+  db->tableMap = namemap_create(tableNames, db->numTables);
+}
+
+void schemamap_destroy(struct Database* db) {
+  if (db == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < db->numTables; i++) {
+    namemap_destroy(db->tables[i].columnMap);
+    db->tables[i].columnMap = NULL;
+  }
+  namemap_destroy(db->tableMap);
+  db->tableMap = NULL;
+}
+
+struct TableMeta* database_findTable(struct Database* db, char* name) {
+  if (db->tableMap == NULL) {
+    panic("schema map not built (database_findTable)");
+  }
+
+  int i = namemap_find(db->tableMap, name);
+  return (i < 0) ? NULL : &db->tables[i];
+}
+
+struct ColumnMeta* database_findColumn(struct TableMeta* table, char* name) {
+  if (table->columnMap == NULL) {
+    panic("schema map not built (database_findColumn)");
+  }
+
+  int j = namemap_find(table->columnMap, name);
+  return (j < 0) ? NULL : &table->columns[j];
+}
+
+struct TableMeta* database_addTable(struct Database* db, char* name,
+                                    int recordSize, int numColumns,
+                                    struct ColumnMeta* columns) {
+  schemamap_destroy(db);
+
+  db->tables = (struct TableMeta*)realloc(
+      db->tables, sizeof(struct TableMeta) * (db->numTables + 1));
+  if (db->tables == NULL) {
+    panic("No memory");
+  }
+
+  struct TableMeta* table = &db->tables[db->numTables];
+  table->name = name;
+  table->recordSize = recordSize;
+  table->numColumns = numColumns;
+  table->columns = columns;
+  table->columnMap = NULL;
+  table->stats = NULL;
+  db->numTables++;
+
+  schemamap_build(db);
+  return table;
+}
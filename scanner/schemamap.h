@@ -0,0 +1,81 @@
+/*schemamap.h*/
+
+//
+// Case-insensitive hash maps over the database schema, so that
+// table and column names resolve in O(1) instead of by looping
+// over db->tables and table->columns.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include "database.h"
+
+//
+// open-addressing hash map from a name to its position in the
+// owning array (db->tables or table->columns):
+//
+struct NameMap
+{
+  int    capacity;  // always a power of 2
+  int*   slots;     // position in the owning array, -1 => empty
+  char** names;     // names[position]; the array is owned by the map,
+                    // the strings are NOT
+};
+
+
+//
+// functions:
+//
+
+//
+// schemamap_build
+//
+// Builds the table map for the database and the column map for
+// every table. Call this once, right after database_open(); the
+// maps share the name strings owned by the database.
+//
+void schemamap_build(struct Database* db);
+
+//
+// schemamap_destroy
+//
+// Frees the maps built by schemamap_build(); call this before
+// database_close().
+//
+void schemamap_destroy(struct Database* db);
+
+//
+// database_findTable
+//
+// Returns a pointer to the table's meta-data, or NULL if the
+// database has no table with this name (case-insensitive).
+//
+struct TableMeta* database_findTable(struct Database* db, char* name);
+
+//
+// database_findColumn
+//
+// Returns a pointer to the column's meta-data, or NULL if the
+// table has no column with this name (case-insensitive). The
+// column's 0-based position is (column - table->columns).
+//
+struct ColumnMeta* database_findColumn(struct TableMeta* table, char* name);
+
+//
+// database_addTable
+//
+// Registers a new table with the given columns; the database takes
+// ownership of name, columns and the column names, which must all
+// be malloc'd. The schema maps are rebuilt. Returns a pointer to
+// the new table's meta-data.
+//
+// NOTE: db->tables may move, so pointers returned earlier by
+// database_findTable() are invalid after this call.
+//
+struct TableMeta* database_addTable(struct Database* db, char* name,
+                                    int recordSize, int numColumns,
+                                    struct ColumnMeta* columns);
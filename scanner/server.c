@@ -0,0 +1,262 @@
+/*server.c*/
+
+//
+// Server mode for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "analyzer.h"
+#include "ast.h"
+#include "database.h"
+#include "execute.h"
+#include "explain.h"
+#include "modify.h"
+#include "parser.h"
+#include "schemamap.h"
+#include "server.h"
+#include "sharedscan.h"
+#include "tablefile.h"
+#include "util.h"
+#include "wal.h"
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onStop(int signum) {
+  stopping = 1;
+}
+
+char* server_socketPath(void) {
+  return getenv("SIMPLESQL_SERVER");
+}
+
+//
+// runQuery
+//
+// Executes (or explains) one query, holding the database lock:
+// shared to read, exclusive to write a table with SELECT ... INTO.
+//
+static void runQuery(struct Database* db, struct QUERY* query, int lockfd) {
+  bool writes =
+      (query->queryType == SELECT_QUERY && query->q.select->into != NULL);
+
+  // a table created by INTO would only be known to this worker
+  if (writes && database_findTable(db, query->q.select->into->table) == NULL) {
+    printf("**Error: the server cannot create table '%s', INTO an existing "
+           "table instead\n",
+           query->q.select->into->table);
+    return;
+  }
+
+  flock(lockfd, writes ? LOCK_EX : LOCK_SH);
+  if (explain_enabled()) {
+    explain_query(db, query);
+  } else {
+    execute_query(db, query);
+  }
+  flock(lockfd, LOCK_UN);
+}
+
+//
+// serveClient
+//
+// Runs the client's queries until it closes the connection, or
+// leaves it idle for SERVER_IDLE_SECONDS. The connection stands in
+// for stdout meanwhile, so the results reach the client exactly as
+// they would be printed.
+//
+static void serveClient(struct Database* db, int client, int lockfd) {
+  // a read or write that waits longer fails, and ends the connection
+  struct timeval idle;
+  idle.tv_sec = SERVER_IDLE_SECONDS;
+  idle.tv_usec = 0;
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+  setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &idle, sizeof(idle));
+
+  FILE* input = fdopen(client, "r");
+  if (input == NULL) {
+    close(client);
+    return;
+  }
+
+  fflush(stdout);
+  int savedStdout = dup(STDOUT_FILENO);
+  dup2(client, STDOUT_FILENO);
+
+  parser_init();
+  while (!stopping) {
+    struct TokenQueue* tokens = parser_parse(input);
+    if (tokens == NULL) {
+      if (parser_eof() || ferror(input)) {
+        break;
+      } else {
+        fflush(stdout);
+        continue;
+      }
+    }
+    struct QUERY* query = analyzer_build(db, tokens);
+    if (query != NULL) {
+      runQuery(db, query, lockfd);
+    }
+    fflush(stdout);  // the client sees each result as soon as it is done
+  }
+
+  fflush(stdout);
+  clearerr(stdout);  // e.g. the client went away before reading it all
+  dup2(savedStdout, STDOUT_FILENO);
+  close(savedStdout);
+  fclose(input);
+}
+
+//
+// work
+//
+// A worker process: accepts and serves connections, one at a time,
+// until told to stop.
+//
+static void work(struct Database* db, int listener, char* lockpath) {
+  // the server's onStop() is inherited, without SA_RESTART: a signal
+  // interrupts accept() or the client's reads, and the worker stops
+  // between queries, after the compaction and checkpoint they started
+  signal(SIGPIPE, SIG_IGN);  // a closed connection is a write error
+
+  // flock() locks belong to the open file, so every worker opens the
+  // lock file itself rather than sharing the server's descriptor
+  int lockfd = open(lockpath, O_RDWR);
+  if (lockfd < 0) {
+    perror(lockpath);
+    exit(-1);
+  }
+
+  while (!stopping) {
+    int client = accept(listener, NULL, NULL);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      perror("accept");
+      exit(-1);
+    }
+    serveClient(db, client, lockfd);
+  }
+  modify_waitForCompaction();
+  wal_waitForCheckpoint();
+  exit(0);
+}
+
+static pid_t startWorker(struct Database* db, int listener, char* lockpath) {
+  fflush(stdout);  // or the child would print it again
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    work(db, listener, lockpath);
+  } else if (pid < 0) {
+    printf("**Error: unable to start a worker\n");
+  }
+  return pid;
+}
+
+bool server_run(struct Database* db, char* socketPath) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(socketPath) >= sizeof(address.sun_path)) {
+    printf("**Error: socket path '%s' is too long\n", socketPath);
+    return false;
+  }
+  strcpy(address.sun_path, socketPath);
+
+  char lockpath[TABLEFILE_MAX_PATH];
+  snprintf(lockpath, sizeof(lockpath), "%s/%s", db->name, SERVER_LOCK_FILE);
+  int lockfd = open(lockpath, O_RDWR | O_CREAT, 0644);
+  if (lockfd < 0) {
+    printf("**Error: unable to create lock file '%s'\n", lockpath);
+    return false;
+  }
+  close(lockfd);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    printf("**Error: unable to create socket\n");
+    return false;
+  }
+  unlink(socketPath);  // left behind by an earlier server
+  if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+      listen(listener, SERVER_QUEUE_LENGTH) < 0) {
+    printf("**Error: unable to listen on '%s'\n", socketPath);
+    close(listener);
+    return false;
+  }
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int numWorkers = (cpus > SERVER_MAX_WORKERS) ? SERVER_MAX_WORKERS
+                   : (cpus > 1)                ? (int)cpus
+                                               : 1;
+
+  // no SA_RESTART, so that a signal interrupts wait()
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onStop;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  // workers scanning the same table share the reads
+  sharedscan_init();
+
+  printf("**Serving database '%s' on '%s' with %d workers**\n", db->name,
+         socketPath, numWorkers);
+
+  pid_t workers[SERVER_MAX_WORKERS];
+  for (int w = 0; w < numWorkers; w++) {
+    workers[w] = startWorker(db, listener, lockpath);
+  }
+
+  //
+  // replace workers that die, e.g. on a panic, until told to stop:
+  //
+  while (!stopping) {
+    pid_t pid = wait(NULL);
+    if (pid < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    for (int w = 0; w < numWorkers; w++) {
+      if (workers[w] == pid && !stopping) {
+        workers[w] = startWorker(db, listener, lockpath);
+      }
+    }
+  }
+
+  for (int w = 0; w < numWorkers; w++) {
+    if (workers[w] > 0) {
+      kill(workers[w], SIGTERM);
+    }
+  }
+  while (wait(NULL) > 0 || errno == EINTR) {
+    // reap them all
+  }
+
+  close(listener);
+  unlink(socketPath);
+  printf("**Server stopped**\n");
+  return true;
+}
@@ -0,0 +1,72 @@
+/*server.h*/
+
+//
+// Server mode for SimpleSQL: instead of reading queries from stdin,
+// the program listens on a Unix domain socket, given by the
+// environment variable SIMPLESQL_SERVER, and runs the queries that
+// clients send, streaming the results back over the connection.
+//
+// The database is opened once, before a fixed pool of worker
+// processes is forked; the workers share the schema and statistics
+// copy-on-write and each serves one connection at a time, so opening
+// the database is paid once rather than per request. Connections
+// wait in the listen queue, of SERVER_QUEUE_LENGTH, until a worker
+// accepts them. A worker that dies is replaced. A connection left
+// idle for SERVER_IDLE_SECONDS is closed, so that clients that hold
+// a connection open without querying cannot tie up every worker.
+//
+// A client writes queries exactly as they would be typed at the
+// "query?" prompt, e.g. with "nc -U <path>", and reads the output
+// each query would print.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "database.h"
+
+//
+// number of worker processes, at most one per CPU, and the number of
+// connections that may wait for a worker:
+//
+#define SERVER_MAX_WORKERS  8
+#define SERVER_QUEUE_LENGTH 64
+
+//
+// seconds a worker waits on a client, for its next query or to read
+// a result, before closing the connection:
+//
+#define SERVER_IDLE_SECONDS 30
+
+//
+// queries lock this file, next to the tables, so that SELECT ...
+// INTO in one worker does not run while others read:
+//
+#define SERVER_LOCK_FILE ".lock"
+
+
+//
+// functions:
+//
+
+//
+// server_socketPath
+//
+// Returns the value of SIMPLESQL_SERVER, or NULL if the program
+// should read queries from stdin.
+//
+char* server_socketPath(void);
+
+//
+// server_run
+//
+// Serves the database on the socket until the process receives
+// SIGINT or SIGTERM. Returns false (after printing an error) if the
+// socket cannot be set up.
+//
+bool server_run(struct Database* db, char* socketPath);
@@ -0,0 +1,517 @@
+/*setop.c*/
+
+//
+// Set operations for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "batch.h"
+#include "bloom.h"
+#include "database.h"
+#include "encode.h"
+#include "grouptable.h"
+#include "index.h"
+#include "modify.h"
+#include "resultset.h"
+#include "rowkey.h"
+#include "scan.h"
+#include "schemamap.h"
+#include "setop.h"
+#include "util.h"
+
+//
+// a spilled partition is split again, on the next 4 bits of the
+// hash, if it is still too big; past this depth the rows must share
+// most of their hash, so the table is simply allowed to grow:
+//
+#define SETOP_MAX_DEPTH 8
+
+//
+// one level of hashing: the top level reads the two queries, and
+// each spilled partition is re-read into a level of its own:
+//
+struct Level
+{
+  int    depth;
+  struct GroupTable* set;  // distinct rows, each with whether it was
+                           // output; NULL once spilled
+  FILE*  partitions[SETOP_PARTITIONS];
+};
+
+struct SetOp
+{
+  int    op;
+  int    numColumns;
+  int*   types;
+  struct TableMeta* table;  // the left query's, which names the columns
+  struct SELECT* left;
+  struct ResultSet* result; // the rows not yet written out
+  struct Encoder* encoder;  // NULL in the text format
+  long   numRows;
+  char   tag;        // kind of the rows being read, see consume()
+  struct Level top;
+  char*  key;        // the encoded row being emitted (rowkey.h)
+  int    keyCapacity;
+  struct Bloom* build;  // INTERSECT: the right query's rows, else NULL
+};
+
+static struct ResultSet* createResult(struct SetOp* so) {
+  struct ResultSet* rs = resultset_create();
+  int j = 0;
+  for (struct COLUMN* c = so->left->columns; c != NULL; c = c->next, j++) {
+    struct ColumnMeta* column = database_findColumn(so->table, c->name);
+    resultset_insertColumn(rs, j + 1, so->table->name, column->name,
+                           NO_FUNCTION, column->colType);
+  }
+  return rs;
+}
+
+//
+// addRow
+//
+// Adds a row to the result set. Unless the result is printed as
+// text, which prints it whole, the rows are written out a batch of
+// ENCODE_BATCH_ROWS at a time, so the result never has to fit in
+// memory.
+//
+static int addRow(struct SetOp* so) {
+  if (so->encoder != NULL && so->result->numRows >= ENCODE_BATCH_ROWS) {
+    encode_rows(so->encoder, so->result);
+    resultset_destroy(so->result);
+    so->result = createResult(so);
+  }
+  so->numRows++;
+  return resultset_addRow(so->result);
+}
+
+//
+// outputRow
+//
+// Decodes an encoded row into a new row of the result set.
+//
+static void outputRow(struct SetOp* so, char* key) {
+  int row = addRow(so);
+  rowkey_output(so->result, row, 1, so->types, NULL, so->numColumns, key);
+}
+
+static void level_init(struct Level* level, int depth) {
+  level->depth = depth;
+  level->set = grouptable_create(sizeof(bool), 0);
+  for (int p = 0; p < SETOP_PARTITIONS; p++) {
+    level->partitions[p] = NULL;
+  }
+}
+
+static void writePartition(struct Level* level, char tag, char* key,
+                           int length, unsigned long hash) {
+  int p = (int)(hash >> (60 - 4 * level->depth)) & (SETOP_PARTITIONS - 1);
+  FILE* output = level->partitions[p];
+
+  if (fwrite(&tag, 1, 1, output) != 1 ||
+      fwrite(&length, sizeof(int), 1, output) != 1 ||
+      fwrite(&hash, sizeof(hash), 1, output) != 1 ||
+      fwrite(key, 1, length, output) != (size_t)length) {
+    panic("unable to write set operation spill file");
+  }
+}
+
+//
+// spill
+//
+// Moves the level's rows out to its partition files, after which
+// every new row goes straight to a partition as well.
+//
+static void spill(struct SetOp* so, struct Level* level) {
+  for (int p = 0; p < SETOP_PARTITIONS; p++) {
+    level->partitions[p] = tmpfile();
+    if (level->partitions[p] == NULL) {
+      panic("unable to create set operation spill file");
+    }
+  }
+
+  // for UNION every row in the set has been output, for INTERSECT
+  // the set holds the right query's rows:
+  char tag = (so->op == SETOP_UNION) ? 'E' : 'R';
+  struct GroupTable* set = level->set;
+  for (long g = 0; g < set->count; g++) {
+    writePartition(level, tag, grouptable_key(set, g), set->keys[g].length,
+                   set->keys[g].hash);
+  }
+
+  grouptable_destroy(set);
+  level->set = NULL;
+}
+
+//
+// consume
+//
+// Processes one row at the given level. The tag says what the row
+// is:
+//   'E' - a row already output (UNION, re-read from a partition)
+//   'R' - a row of the right query (INTERSECT build side)
+//   'L' - any other row: output it if it is new (UNION), or if it
+//         is in the set and not output yet (INTERSECT)
+//
+static void consume(struct SetOp* so, struct Level* level, char tag,
+                    char* key, int length, unsigned long hash) {
+  if (level->set == NULL) {
+    writePartition(level, tag, key, length, hash);
+    return;
+  }
+
+  bool* emitted;
+  bool isNew;
+
+  if (tag == 'E') {
+    emitted = (bool*)grouptable_find(level->set, key, length, hash, &isNew);
+    *emitted = true;
+  } else if (tag == 'R') {
+    emitted = (bool*)grouptable_find(level->set, key, length, hash, &isNew);
+    if (isNew) {
+      *emitted = false;
+    }
+  } else if (so->op == SETOP_UNION) {
+    emitted = (bool*)grouptable_find(level->set, key, length, hash, &isNew);
+    if (isNew) {
+      *emitted = true;
+      outputRow(so, key);
+    }
+  } else {
+    emitted = (bool*)grouptable_lookup(level->set, key, length, hash);
+    if (emitted != NULL && !*emitted) {
+      *emitted = true;
+      outputRow(so, key);
+    }
+  }
+
+  if (grouptable_bytes(level->set) > SETOP_MEMORY_BYTES &&
+      level->depth < SETOP_MAX_DEPTH) {
+    spill(so, level);
+  }
+}
+
+//
+// finish
+//
+// Processes the partitions of a level that spilled, one at a time,
+// and frees the level.
+//
+static void finish(struct SetOp* so, struct Level* level) {
+  grouptable_destroy(level->set);
+  level->set = NULL;
+
+  char* key = NULL;
+  int capacity = 0;
+
+  for (int p = 0; p < SETOP_PARTITIONS; p++) {
+    FILE* input = level->partitions[p];
+    if (input == NULL) {
+      continue;
+    }
+    rewind(input);
+
+    struct Level child;
+    level_init(&child, level->depth + 1);
+
+    char tag;
+    int length;
+    unsigned long h;
+    while (fread(&tag, 1, 1, input) == 1 &&
+           fread(&length, sizeof(int), 1, input) == 1 &&
+           fread(&h, sizeof(h), 1, input) == 1) {
+      if (length > capacity) {
+        capacity = 2 * length;
+        key = (char*)realloc(key, capacity);
+        if (key == NULL) {
+          panic("No memory");
+        }
+      }
+      if (fread(key, 1, length, input) != (size_t)length) {
+        panic("unable to read set operation spill file");
+      }
+      consume(so, &child, tag, key, length, h);
+    }
+
+    fclose(input);
+    level->partitions[p] = NULL;
+    finish(so, &child);
+  }
+
+  free(key);
+}
+
+//
+// emitRow
+//
+// Scan callback: hands one row of either query to the set
+// operation.
+//
+static bool emitRow(void* state, char* values[]) {
+  struct SetOp* so = (struct SetOp*)state;
+  int length = rowkey_encode(so->types, NULL, so->numColumns, values,
+                             &so->key, &so->keyCapacity);
+
+  if (so->op == SETOP_UNION_ALL) {
+    outputRow(so, so->key);
+    return true;
+  }
+
+  unsigned long hash = rowkey_hash(so->key, length);
+  if (so->build != NULL) {
+    if (so->tag == 'R') {
+      bloom_add(so->build, hash);
+    } else if (!bloom_mayContain(so->build, hash)) {
+      return true;  // not in the right query: no need to probe or spill it
+    }
+  }
+  consume(so, &so->top, so->tag, so->key, length, hash);
+  return true;
+}
+
+static int compareKeys(int colType, char* a, char* b) {
+  if (colType == COL_TYPE_INT) {
+    int x, y;
+    memcpy(&x, a, sizeof(int));
+    memcpy(&y, b, sizeof(int));
+    return (x < y) ? -1 : (x > y);
+  } else if (colType == COL_TYPE_REAL) {
+    double x, y;
+    memcpy(&x, a, sizeof(double));
+    memcpy(&y, b, sizeof(double));
+    return (x < y) ? -1 : (x > y);
+  } else {
+    return strcmp(a, b);
+  }
+}
+
+static void outputKey(struct SetOp* so, char* key) {
+  int row = addRow(so);
+
+  if (so->types[0] == COL_TYPE_INT) {
+    int i;
+    memcpy(&i, key, sizeof(int));
+    resultset_putInt(so->result, row, 1, i);
+  } else if (so->types[0] == COL_TYPE_REAL) {
+    double r;
+    memcpy(&r, key, sizeof(double));
+    resultset_putReal(so->result, row, 1, r);
+  } else {
+    resultset_putString(so->result, row, 1, key);
+  }
+}
+
+//
+// sortedInput
+//
+// Returns the index whose keys are exactly the query's rows, in
+// sorted order: the query selects one indexed column of a table
+// with no deleted records, without WHERE or LIMIT. Returns NULL if
+// there is no such index.
+//
+static struct Index* sortedInput(struct Database* db, struct SELECT* select) {
+  if (select->columns->next != NULL || select->where != NULL ||
+      select->limit != NULL) {
+    return NULL;
+  }
+
+  struct TableMeta* table = database_findTable(db, select->table);
+  struct ColumnMeta* column = database_findColumn(table, select->columns->name);
+  if (column->indexType == COL_NON_INDEXED ||
+      modify_numDeleted(db, table) > 0) {
+    return NULL;
+  }
+  return index_open(db, table, column);
+}
+
+//
+// mergeIndexes
+//
+// UNION or INTERSECT of two sorted single-column inputs in one pass
+// over both, with no hash table; the result comes out sorted.
+//
+static void mergeIndexes(struct SetOp* so, struct Index* a, struct Index* b) {
+  int colType = so->types[0];
+  long i = 0, j = 0;
+
+  if (so->op == SETOP_UNION) {
+    char* last = NULL;
+    while (i < a->numEntries || j < b->numEntries) {
+      char* next;
+      if (j >= b->numEntries ||
+          (i < a->numEntries &&
+           compareKeys(colType, index_key(a, i), index_key(b, j)) <= 0)) {
+        next = index_key(a, i++);
+      } else {
+        next = index_key(b, j++);
+      }
+      if (last == NULL || compareKeys(colType, last, next) != 0) {
+        outputKey(so, next);
+        last = next;
+      }
+    }
+    return;
+  }
+
+  while (i < a->numEntries && j < b->numEntries) {
+    char* x = index_key(a, i);
+    int c = compareKeys(colType, x, index_key(b, j));
+    if (c < 0) {
+      i++;
+    } else if (c > 0) {
+      j++;
+    } else {
+      outputKey(so, x);
+      while (i < a->numEntries && compareKeys(colType, index_key(a, i), x) == 0) {
+        i++;
+      }
+      while (j < b->numEntries && compareKeys(colType, index_key(b, j), x) == 0) {
+        j++;
+      }
+    }
+  }
+}
+
+//
+// columnTypes
+//
+// Fills types[] with the types of the query's columns; returns the
+// number of columns, or -1 (after printing an error) if the query
+// cannot be part of a set operation.
+//
+static int columnTypes(struct Database* db, struct SELECT* select,
+                       int types[], int maxColumns) {
+  if (!scan_isStreamable(select) || select->into != NULL) {
+    printf("**Error: set operations do not support aggregates or INTO\n");
+    return -1;
+  }
+
+  struct TableMeta* table = database_findTable(db, select->table);
+  assert(table != NULL);
+
+  int N = 0;
+  for (struct COLUMN* c = select->columns; c != NULL; c = c->next) {
+    struct ColumnMeta* column = database_findColumn(table, c->name);
+    assert(column != NULL);
+    if (N < maxColumns) {
+      types[N] = column->colType;
+    }
+    N++;
+  }
+  return N;
+}
+
+void setop_execute(struct Database* db, struct SELECT* left,
+                   struct SELECT* right, int op) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  int N = 0;
+  for (struct COLUMN* c = left->columns; c != NULL; c = c->next) {
+    N++;
+  }
+
+  int* types = (int*)malloc(sizeof(int) * (N + 1));
+  int* rightTypes = (int*)malloc(sizeof(int) * (N + 1));
+  if (types == NULL || rightTypes == NULL) {
+    panic("No memory");
+  }
+
+  int numLeft = columnTypes(db, left, types, N);
+  int numRight = columnTypes(db, right, rightTypes, N);
+  if (numLeft < 0 || numRight < 0) {
+    free(rightTypes);
+    free(types);
+    return;
+  }
+  if (numLeft != numRight) {
+    printf("**Error: the queries of a set operation must select the same "
+           "number of columns\n");
+    free(rightTypes);
+    free(types);
+    return;
+  }
+  for (int j = 0; j < N; j++) {
+    if (types[j] != rightTypes[j]) {
+      printf("**Error: column %d has a different type in each query of the "
+             "set operation\n",
+             j + 1);
+      free(rightTypes);
+      free(types);
+      return;
+    }
+  }
+  free(rightTypes);
+
+  struct SetOp so;
+  so.op = op;
+  so.numColumns = N;
+  so.types = types;
+  so.table = database_findTable(db, left->table);
+  so.left = left;
+  so.result = createResult(&so);
+  so.encoder =
+      (encode_format() != ENCODE_TEXT) ? encode_begin(so.result) : NULL;
+  so.numRows = 0;
+  so.key = NULL;
+  so.keyCapacity = 0;
+  so.build = NULL;
+
+  struct Index* a = (op != SETOP_UNION_ALL) ? sortedInput(db, left) : NULL;
+  struct Index* b = (a != NULL) ? sortedInput(db, right) : NULL;
+
+  if (a != NULL && b != NULL) {
+    mergeIndexes(&so, a, b);
+  } else {
+    level_init(&so.top, 0);
+
+    // for INTERSECT the right query builds the set and the left one
+    // probes it, so the result keeps the left query's row order:
+    if (op == SETOP_INTERSECT) {
+      // a Bloom filter of the right query's rows, sized by the records
+      // its scan reads, drops most left rows that cannot match before
+      // they reach the set, or a spill file once the set has spilled
+      struct ScanPlan plan;
+      struct TableMeta* rightTable = database_findTable(db, right->table);
+      if (scan_plan(db, rightTable, right->where, &plan)) {
+        so.build = bloom_create(plan.numCandidates, SETOP_MEMORY_BYTES / 8);
+      }
+
+      so.tag = 'R';
+      scan_select(db, right, emitRow, &so);
+      so.tag = 'L';
+      scan_select(db, left, emitRow, &so);
+    } else {
+      so.tag = 'L';
+      scan_select(db, left, emitRow, &so);
+      scan_select(db, right, emitRow, &so);
+    }
+
+    finish(&so, &so.top);
+  }
+
+  index_close(a);
+  index_close(b);
+  bloom_destroy(so.build);
+
+  if (so.encoder != NULL) {
+    encode_rows(so.encoder, so.result);
+    encode_end(so.encoder);
+  } else {
+    encode_resultSet(so.result);
+  }
+  batch_countRows(so.numRows);
+  resultset_destroy(so.result);
+  free(so.key);
+  free(types);
+}
@@ -0,0 +1,59 @@
+/*setop.h*/
+
+//
+// UNION, UNION ALL and INTERSECT over two SELECTs for SimpleSQL.
+// Duplicates are found by hashing the rows, and memory use is
+// bounded: once the hash table grows past SETOP_MEMORY_BYTES, rows
+// are spilled to SETOP_PARTITIONS temporary files by hash and each
+// partition is processed on its own. The result is written out in
+// batches as it is produced (encode.h), except in the text format,
+// which prints it whole once it is complete. When both inputs select
+// a single indexed column, the two indexes are merged instead, since
+// they are already sorted.
+//
+// bench/setop_bench.c measures the time and peak memory of UNION
+// ALL and UNION over a large table.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include "ast.h"
+#include "database.h"
+
+//
+// memory for the hash table of rows before it is spilled, and the
+// number of partitions a spill splits the rows into; the memory can
+// be set at build time, as tests/setop_test.c does to spill small
+// tables:
+//
+#ifndef SETOP_MEMORY_BYTES
+#define SETOP_MEMORY_BYTES (64 * 1024 * 1024)
+#endif
+#define SETOP_PARTITIONS   16
+
+enum SetOperation
+{
+  SETOP_UNION = 0,   // rows of either query, without duplicates
+  SETOP_UNION_ALL,   // rows of either query
+  SETOP_INTERSECT    // rows of both queries, without duplicates
+};
+
+
+//
+// functions:
+//
+
+//
+// setop_execute
+//
+// Executes "left <op> right" and prints the result, whose columns
+// are named after the left query's. The queries must select the
+// same number of columns with the same types, and cannot use
+// aggregates or INTO.
+//
+void setop_execute(struct Database* db, struct SELECT* left,
+                   struct SELECT* right, int op);
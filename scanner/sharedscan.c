@@ -0,0 +1,407 @@
+/*sharedscan.c*/
+
+//
+// Shared (cooperative) full scans for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "readahead.h"
+#include "sharedscan.h"
+#include "util.h"
+
+//
+// a query attached to a scan, and the next chunk it will read (or
+// is decoding); the chunk in a ring slot may only be replaced once
+// every consumer is past it:
+//
+struct Consumer
+{
+  pid_t pid;   // 0 => free
+  long  next;
+};
+
+//
+// one in-flight scan, in shared memory:
+//
+struct Scan
+{
+  int   numConsumers;  // 0 => free
+  dev_t dev;           // identifies the data file
+  ino_t ino;
+  int   recordSize;
+  long  chunkBytes;    // a multiple of recordSize
+  off_t length;        // bytes of the file when the scan started
+  long  numChunks;
+  long  published;     // chunks [0, published) have been read
+  pid_t reader;        // reading chunk published, 0 => none
+  struct Consumer consumers[SHAREDSCAN_MAX_CONSUMERS];
+  long  chunkLength[SHAREDSCAN_RING];
+  char* data;          // SHAREDSCAN_RING chunks, in the shared area
+};
+
+struct SharedArea
+{
+  pthread_mutex_t lock;     // one lock for every scan
+  pthread_cond_t  changed;  // a chunk was read or released
+  struct Scan scans[SHAREDSCAN_MAX_SCANS];
+};
+
+//
+// a query's handle on a scan, private to the process:
+//
+struct SharedScan
+{
+  struct Scan* scan;     // NULL once the shared part is done
+  int    consumer;
+  long   start;          // the chunk the query attached at
+  long   chunkBytes;
+  int    recordSize;
+  bool   holding;        // consumers[consumer].next is being decoded
+  int    fd;
+  struct ReadAhead* missed;  // reads chunks [0, start) at the end
+  struct ReadAheadStats stats;
+  double returnedAt;
+};
+
+static struct SharedArea* area = NULL;
+
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//
+// lock
+//
+// The lock is robust: if a process dies holding it, e.g. on a
+// panic, the next one to lock it takes over.
+//
+static void lock(void) {
+  if (pthread_mutex_lock(&area->lock) == EOWNERDEAD) {
+    pthread_mutex_consistent(&area->lock);
+  }
+}
+
+static void unlock(void) {
+  pthread_mutex_unlock(&area->lock);
+}
+
+bool sharedscan_init(void) {
+  if (area != NULL) {
+    return true;
+  }
+
+  long chunkSpace = (long)SHAREDSCAN_MAX_SCANS * SHAREDSCAN_RING *
+                    (READAHEAD_CHUNK_BYTES + READAHEAD_ALIGNMENT);
+  void* memory = mmap(NULL, sizeof(struct SharedArea) + chunkSpace,
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1,
+                      0);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+
+  struct SharedArea* a = (struct SharedArea*)memory;
+  pthread_mutexattr_t mutexAttr;
+  pthread_mutexattr_init(&mutexAttr);
+  pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&mutexAttr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&a->lock, &mutexAttr);
+  pthread_mutexattr_destroy(&mutexAttr);
+
+  pthread_condattr_t condAttr;
+  pthread_condattr_init(&condAttr);
+  pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
+  pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+  pthread_cond_init(&a->changed, &condAttr);
+  pthread_condattr_destroy(&condAttr);
+
+  // the mapping is zeroed, so every scan starts out free
+  char* chunks = (char*)memory + sizeof(struct SharedArea);
+  for (int i = 0; i < SHAREDSCAN_MAX_SCANS; i++) {
+    a->scans[i].data = chunks + (long)i * SHAREDSCAN_RING *
+                                    (READAHEAD_CHUNK_BYTES + READAHEAD_ALIGNMENT);
+  }
+
+  area = a;
+  return true;
+}
+
+//
+// waitChanged
+//
+// Waits until another consumer makes progress, or 100 ms pass so
+// the caller can look for consumers that died.
+//
+static void waitChanged(void) {
+  struct timespec deadline;
+
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_nsec += 100 * 1000 * 1000;
+  if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000 * 1000 * 1000;
+  }
+  if (pthread_cond_timedwait(&area->changed, &area->lock, &deadline) ==
+      EOWNERDEAD) {
+    pthread_mutex_consistent(&area->lock);
+  }
+}
+
+static void removeConsumer(struct Scan* scan, int c) {
+  scan->consumers[c].pid = 0;
+  scan->numConsumers--;
+  pthread_cond_broadcast(&area->changed);
+}
+
+//
+// oldestNeeded
+//
+// The lowest chunk a live consumer still needs; consumers whose
+// process has died are dropped, so they cannot stall the scan.
+//
+static long oldestNeeded(struct Scan* scan) {
+  long oldest = scan->numChunks;
+
+  for (int c = 0; c < SHAREDSCAN_MAX_CONSUMERS; c++) {
+    struct Consumer* consumer = &scan->consumers[c];
+    if (consumer->pid == 0) {
+      continue;
+    }
+    if (kill(consumer->pid, 0) < 0 && errno == ESRCH) {
+      removeConsumer(scan, c);
+      continue;
+    }
+    if (consumer->next < oldest) {
+      oldest = consumer->next;
+    }
+  }
+  return oldest;
+}
+
+struct SharedScan* sharedscan_attach(int fd, struct TableMeta* table) {
+  struct stat info;
+
+  if (area == NULL || fstat(fd, &info) < 0) {
+    return NULL;
+  }
+
+  struct SharedScan* s = (struct SharedScan*)malloc(sizeof(struct SharedScan));
+  if (s == NULL) {
+    panic("No memory");
+  }
+  memset(s, 0, sizeof(struct SharedScan));
+  s->fd = fd;
+  s->consumer = -1;
+
+  lock();
+
+  // join a scan of the same file that is still reading, if any
+  struct Scan* scan = NULL;
+  for (int i = 0; i < SHAREDSCAN_MAX_SCANS && scan == NULL; i++) {
+    struct Scan* candidate = &area->scans[i];
+    if (candidate->numConsumers > 0 && candidate->dev == info.st_dev &&
+        candidate->ino == info.st_ino &&
+        candidate->recordSize == table->recordSize &&
+        candidate->published < candidate->numChunks &&
+        candidate->numConsumers < SHAREDSCAN_MAX_CONSUMERS) {
+      scan = candidate;
+    }
+  }
+
+  // otherwise start one
+  for (int i = 0; i < SHAREDSCAN_MAX_SCANS && scan == NULL; i++) {
+    struct Scan* candidate = &area->scans[i];
+    if (candidate->numConsumers == 0) {
+      scan = candidate;
+      scan->dev = info.st_dev;
+      scan->ino = info.st_ino;
+      scan->recordSize = table->recordSize;
+      scan->chunkBytes = (READAHEAD_CHUNK_BYTES / table->recordSize) *
+                         (long)table->recordSize;
+      scan->length =
+          (info.st_size / table->recordSize) * (off_t)table->recordSize;
+      scan->numChunks =
+          (long)((scan->length + scan->chunkBytes - 1) / scan->chunkBytes);
+      scan->published = 0;
+      scan->reader = 0;
+      memset(scan->consumers, 0, sizeof(scan->consumers));
+    }
+  }
+
+  if (scan == NULL || scan->chunkBytes == 0) {  // 0: a record > a chunk
+    unlock();
+    free(s);
+    return NULL;
+  }
+
+  for (int c = 0; c < SHAREDSCAN_MAX_CONSUMERS; c++) {
+    if (scan->consumers[c].pid == 0) {
+      s->consumer = c;
+      break;
+    }
+  }
+  s->scan = scan;
+  s->start = scan->published;
+  s->chunkBytes = scan->chunkBytes;
+  s->recordSize = scan->recordSize;
+  scan->consumers[s->consumer].pid = getpid();
+  scan->consumers[s->consumer].next = s->start;
+  scan->numConsumers++;
+
+  unlock();
+
+  s->returnedAt = now();
+  return s;
+}
+
+//
+// readChunk
+//
+// Reads chunk k of the scan into its ring slot; called without the
+// lock, by the one consumer that set scan->reader.
+//
+static long readChunk(struct SharedScan* s, long k) {
+  struct Scan* scan = s->scan;
+  char* slot = scan->data + (k % SHAREDSCAN_RING) *
+                                (long)(READAHEAD_CHUNK_BYTES + READAHEAD_ALIGNMENT);
+  off_t offset = (off_t)k * scan->chunkBytes;
+  long wanted = scan->chunkBytes;
+  if (offset + wanted > scan->length) {
+    wanted = (long)(scan->length - offset);
+  }
+
+  long done = 0;
+  while (done < wanted) {
+    ssize_t n = pread(s->fd, slot + done, wanted - done, offset + done);
+    if (n <= 0) {
+      break;  // the file shrank; the records that are left
+    }
+    done += n;
+  }
+  s->stats.bytesRead += done;
+  s->stats.numReads++;
+  return done - done % scan->recordSize;
+}
+
+//
+// nextShared
+//
+// The next chunk of the shared part, i.e. from the point of
+// attaching to the end, or NULL when it is done.
+//
+static char* nextShared(struct SharedScan* s, long* length) {
+  struct Scan* scan = s->scan;
+  struct Consumer* me = &scan->consumers[s->consumer];
+
+  lock();
+  if (s->holding) {
+    me->next++;  // done with the chunk returned last
+    s->holding = false;
+    pthread_cond_broadcast(&area->changed);
+  }
+
+  while (me->next < scan->numChunks) {
+    if (me->next < scan->published) {
+      long k = me->next;
+      *length = scan->chunkLength[k % SHAREDSCAN_RING];
+      s->holding = true;
+      unlock();
+      return scan->data + (k % SHAREDSCAN_RING) *
+                              (long)(READAHEAD_CHUNK_BYTES + READAHEAD_ALIGNMENT);
+    }
+
+    if (scan->reader != 0) {
+      if (kill(scan->reader, 0) < 0 && errno == ESRCH) {
+        scan->reader = 0;  // died reading it, read it again
+      } else {
+        waitChanged();  // another consumer is reading the chunk
+      }
+      continue;
+    }
+
+    // read it: once the slot's chunk is no longer needed by anyone
+    long k = scan->published;
+    if (oldestNeeded(scan) <= k - SHAREDSCAN_RING) {
+      waitChanged();
+      continue;
+    }
+    scan->reader = getpid();
+    unlock();
+
+    long n = readChunk(s, k);
+
+    lock();
+    scan->chunkLength[k % SHAREDSCAN_RING] = n;
+    scan->published = k + 1;
+    scan->reader = 0;
+    pthread_cond_broadcast(&area->changed);
+  }
+
+  removeConsumer(scan, s->consumer);
+  s->scan = NULL;
+  unlock();
+  return NULL;
+}
+
+char* sharedscan_next(struct SharedScan* s, long* length) {
+  if (s->scan != NULL) {
+    double start = now();
+    s->stats.cpuSeconds += start - s->returnedAt;
+
+    char* chunk = nextShared(s, length);
+
+    s->returnedAt = now();
+    s->stats.stallSeconds += s->returnedAt - start;
+    if (chunk != NULL) {
+      return chunk;
+    }
+    if (s->start > 0) {
+      // then the part the query missed, read on its own (and timed
+      // by the read-ahead)
+      s->missed = readahead_start(s->fd, 0, (off_t)s->start * s->chunkBytes,
+                                  s->recordSize);
+    }
+  }
+
+  return (s->missed != NULL) ? readahead_next(s->missed, length) : NULL;
+}
+
+void sharedscan_detach(struct SharedScan* s, struct ReadAheadStats* stats) {
+  if (s->scan != NULL) {
+    lock();
+    removeConsumer(s->scan, s->consumer);
+    unlock();
+  }
+
+  if (s->missed != NULL) {
+    readahead_finish(s->missed, &s->stats);
+  } else {
+    s->stats.cpuSeconds += now() - s->returnedAt;
+  }
+
+  if (stats != NULL) {
+    stats->bytesRead += s->stats.bytesRead;
+    stats->numReads += s->stats.numReads;
+    stats->stallSeconds += s->stats.stallSeconds;
+    stats->cpuSeconds += s->stats.cpuSeconds;
+  }
+  free(s);
+}
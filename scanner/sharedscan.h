@@ -0,0 +1,82 @@
+/*sharedscan.h*/
+
+//
+// Shared (cooperative) full scans for SimpleSQL. A query that needs
+// to read all of <table>.data while another query is already doing
+// so attaches to that scan: it receives the chunks from the current
+// position to the end of the file as the first query reads them,
+// then reads the part it missed, from the start of the file up to
+// where it attached, on its own. Each query decodes, filters and
+// projects the records itself; only the reads are shared.
+//
+// The in-flight scans live in memory shared by the processes forked
+// after sharedscan_init(), i.e. the server's workers. Without it
+// every scan reads the file on its own, with read-ahead.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "database.h"
+#include "readahead.h"
+
+//
+// at most SHAREDSCAN_MAX_SCANS tables are scanned at once, by up to
+// SHAREDSCAN_MAX_CONSUMERS queries each; a scan keeps its last
+// SHAREDSCAN_RING chunks, so a query may fall that many chunks
+// behind the fastest one before the reads wait for it:
+//
+#define SHAREDSCAN_MAX_SCANS     4
+#define SHAREDSCAN_MAX_CONSUMERS 16
+#define SHAREDSCAN_RING          4
+
+struct SharedScan;  // opaque
+
+
+//
+// functions:
+//
+
+//
+// sharedscan_init
+//
+// Sets up the shared scans; call once, before forking the processes
+// that should share them. Returns false if the shared memory cannot
+// be mapped, and scans then are not shared.
+//
+bool sharedscan_init(void);
+
+//
+// sharedscan_attach
+//
+// Joins the in-flight scan of the table's data file, open as fd, or
+// starts one that later queries can join. Returns NULL if scans are
+// not shared, or all SHAREDSCAN_MAX_SCANS are busy with other
+// tables; the caller then reads the file itself.
+//
+struct SharedScan* sharedscan_attach(int fd, struct TableMeta* table);
+
+//
+// sharedscan_next
+//
+// Returns the next chunk of whole records, and its length in bytes,
+// or NULL once the query has seen every record of the file as it
+// was when the scan started. The chunk is valid until the next call.
+// Chunks do not come in file order: the records after the point of
+// attaching come first, so a query whose result depends on the order
+// (a LIMIT, an INTO) must read the file itself.
+//
+char* sharedscan_next(struct SharedScan* s, long* length);
+
+//
+// sharedscan_detach
+//
+// Leaves the scan, e.g. early because of a LIMIT, and adds the
+// query's reads and timings to *stats (if not NULL).
+//
+void sharedscan_detach(struct SharedScan* s, struct ReadAheadStats* stats);
@@ -0,0 +1,390 @@
+/*snapshot.c*/
+
+//
+// Binary schema snapshot for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "snapshot.h"
+#include "tablefile.h"
+#include "util.h"
+
+#define SNAPSHOT_MAGIC "SQLSNAP1"
+
+#define SNAPSHOT_CHECKSUM_SEED 14695981039346656037ul
+
+//
+// the file: the header, then the tables, the columns (of every
+// table, in order) and the names, '\0'-terminated, which the
+// tables and columns refer to by their offset in the pool:
+//
+struct SnapshotHeader
+{
+  char magic[8];
+  int  version;
+  int  numTables;
+  int  numColumns;
+  int  poolBytes;
+  long metaSize;     // of the meta file the snapshot was made from,
+  long metaSeconds;  // and its modification time
+  long metaNanoseconds;
+  unsigned long checksum;  // FNV-1a over everything after the header
+};
+
+struct SnapshotTable
+{
+  int name;
+  int recordSize;
+  int numColumns;
+  int firstColumn;
+};
+
+struct SnapshotColumn
+{
+  int name;
+  int colType;
+  int indexType;
+};
+
+struct Snapshot
+{
+  void* mapping;
+  long  mappingSize;
+  char* pool;
+  int   poolBytes;
+  struct ColumnMeta* columns;  // of every table, one array
+  int   numColumns;
+};
+
+
+//
+// checksum
+//
+// FNV-1a, continued from h; start from SNAPSHOT_CHECKSUM_SEED.
+//
+static unsigned long checksum(unsigned long h, char* bytes, long length) {
+  for (long i = 0; i < length; i++) {
+    h ^= (unsigned char)bytes[i];
+    h *= 1099511628211ul;
+  }
+  return h;
+}
+
+//
+// isCurrent
+//
+// Returns true if the snapshot was made from the meta file as it
+// is now.
+//
+static bool isCurrent(struct SnapshotHeader* header, struct stat* meta) {
+  return header->metaSize == (long)meta->st_size &&
+         header->metaSeconds == (long)meta->st_mtim.tv_sec &&
+         header->metaNanoseconds == (long)meta->st_mtim.tv_nsec;
+}
+
+//
+// mapSnapshot
+//
+// Returns the database described by the snapshot at path, or NULL
+// if there is no snapshot, or it is out of date or damaged.
+//
+static struct Database* mapSnapshot(char* database, char* path,
+                                    struct stat* meta) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) < 0 ||
+      info.st_size < (off_t)sizeof(struct SnapshotHeader)) {
+    close(fd);
+    return NULL;
+  }
+
+  void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return NULL;
+  }
+
+  struct SnapshotHeader* header = (struct SnapshotHeader*)mapping;
+  struct SnapshotTable* tables =
+      (struct SnapshotTable*)((char*)mapping + sizeof(*header));
+
+  bool ok = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+            header->version == SNAPSHOT_VERSION && isCurrent(header, meta) &&
+            header->numTables > 0 && header->numColumns >= 0 &&
+            header->poolBytes > 0 &&
+            (long)info.st_size ==
+                (long)sizeof(*header) +
+                    (long)header->numTables * sizeof(struct SnapshotTable) +
+                    (long)header->numColumns * sizeof(struct SnapshotColumn) +
+                    header->poolBytes;
+  ok = ok && checksum(SNAPSHOT_CHECKSUM_SEED, (char*)tables,
+                      info.st_size - sizeof(*header)) == header->checksum;
+  if (!ok) {
+    munmap(mapping, info.st_size);
+    return NULL;
+  }
+
+  struct SnapshotColumn* columns =
+      (struct SnapshotColumn*)(tables + header->numTables);
+  char* pool = (char*)(columns + header->numColumns);
+
+  //
+  // a checksum that matches does not make the offsets safe to follow
+  // if the snapshot was written wrong:
+  //
+  ok = ok && pool[header->poolBytes - 1] == '\0';
+  for (int t = 0; ok && t < header->numTables; t++) {
+    ok = tables[t].name >= 0 && tables[t].name < header->poolBytes &&
+         tables[t].firstColumn >= 0 && tables[t].numColumns >= 0 &&
+         tables[t].firstColumn + tables[t].numColumns <= header->numColumns;
+  }
+  for (int c = 0; ok && c < header->numColumns; c++) {
+    ok = columns[c].name >= 0 && columns[c].name < header->poolBytes;
+  }
+
+  if (!ok) {
+    munmap(mapping, info.st_size);
+    return NULL;
+  }
+
+  struct Database* db = (struct Database*)malloc(sizeof(struct Database));
+  struct Snapshot* s = (struct Snapshot*)malloc(sizeof(struct Snapshot));
+  if (db == NULL || s == NULL) {
+    panic("No memory");
+  }
+
+  s->mapping = mapping;
+  s->mappingSize = info.st_size;
+  s->pool = pool;
+  s->poolBytes = header->poolBytes;
+  s->numColumns = header->numColumns;
+  s->columns = (struct ColumnMeta*)malloc(sizeof(struct ColumnMeta) *
+                                          (header->numColumns + 1));
+
+  db->name = strdup(database);
+  db->numTables = header->numTables;
+  db->tables = (struct TableMeta*)malloc(sizeof(struct TableMeta) *
+                                         header->numTables);
+  db->tableMap = NULL;
+  db->snapshot = s;
+  if (s->columns == NULL || db->name == NULL || db->tables == NULL) {
+    panic("No memory");
+  }
+
+  for (int c = 0; c < header->numColumns; c++) {
+    s->columns[c].name = pool + columns[c].name;
+    s->columns[c].colType = columns[c].colType;
+    s->columns[c].indexType = columns[c].indexType;
+  }
+  for (int t = 0; t < header->numTables; t++) {
+    struct TableMeta* table = &db->tables[t];
+    table->name = pool + tables[t].name;
+    table->recordSize = tables[t].recordSize;
+    table->numColumns = tables[t].numColumns;
+    table->columns = &s->columns[tables[t].firstColumn];
+    table->columnMap = NULL;
+    table->stats = NULL;
+  }
+
+  return db;
+}
+
+//
+// addName
+//
+// Appends the name to the pool and returns its offset.
+//
+static int addName(char** pool, int* poolBytes, int* capacity, char* name) {
+  int length = (int)strlen(name) + 1;
+
+  if (*poolBytes + length > *capacity) {
+    while (*poolBytes + length > *capacity) {
+      *capacity *= 2;
+    }
+    *pool = (char*)realloc(*pool, *capacity);
+    if (*pool == NULL) {
+      panic("No memory");
+    }
+  }
+  memcpy(*pool + *poolBytes, name, length);
+  *poolBytes += length;
+  return *poolBytes - length;
+}
+
+//
+// writeSnapshot
+//
+// Saves the schema of the database, parsed from the meta file as
+// described by meta, via a temporary file. Returns false if it
+// cannot be written; the next open then parses the schema again.
+//
+static bool writeSnapshot(struct Database* db, char* path,
+                          struct stat* meta) {
+  char tmppath[TABLEFILE_MAX_PATH + 32];
+  snprintf(tmppath, sizeof(tmppath), "%s.%d.tmp", path, (int)getpid());
+
+  int numColumns = 0;
+  for (int t = 0; t < db->numTables; t++) {
+    numColumns += db->tables[t].numColumns;
+  }
+
+  long tablesBytes = sizeof(struct SnapshotTable) * db->numTables;
+  long columnsBytes = sizeof(struct SnapshotColumn) * numColumns;
+  char* body = (char*)malloc(tablesBytes + columnsBytes + 1);
+  int capacity = 4096;
+  int poolBytes = 0;
+  char* pool = (char*)malloc(capacity);
+  if (body == NULL || pool == NULL) {
+    panic("No memory");
+  }
+
+  struct SnapshotTable* tables = (struct SnapshotTable*)body;
+  struct SnapshotColumn* columns =
+      (struct SnapshotColumn*)(body + tablesBytes);
+
+  int c = 0;
+  for (int t = 0; t < db->numTables; t++) {
+    struct TableMeta* table = &db->tables[t];
+
+    tables[t].name = addName(&pool, &poolBytes, &capacity, table->name);
+    tables[t].recordSize = table->recordSize;
+    tables[t].numColumns = table->numColumns;
+    tables[t].firstColumn = c;
+
+    for (int j = 0; j < table->numColumns; j++, c++) {
+      columns[c].name =
+          addName(&pool, &poolBytes, &capacity, table->columns[j].name);
+      columns[c].colType = table->columns[j].colType;
+      columns[c].indexType = table->columns[j].indexType;
+    }
+  }
+
+  //
+  // the checksum runs over the tables, columns and pool as they
+  // follow one another in the file:
+  //
+  struct SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.numTables = db->numTables;
+  header.numColumns = numColumns;
+  header.poolBytes = poolBytes;
+  header.metaSize = (long)meta->st_size;
+  header.metaSeconds = (long)meta->st_mtim.tv_sec;
+  header.metaNanoseconds = (long)meta->st_mtim.tv_nsec;
+
+  unsigned long h =
+      checksum(SNAPSHOT_CHECKSUM_SEED, body, tablesBytes + columnsBytes);
+  header.checksum = checksum(h, pool, poolBytes);
+
+  bool ok = false;
+  FILE* output = fopen(tmppath, "w");
+  if (output != NULL) {
+    ok = fwrite(&header, sizeof(header), 1, output) == 1 &&
+         fwrite(body, 1, tablesBytes + columnsBytes, output) ==
+             (size_t)(tablesBytes + columnsBytes) &&
+         fwrite(pool, 1, poolBytes, output) == (size_t)poolBytes;
+    ok = (fclose(output) == 0) && ok;
+    if (!ok || rename(tmppath, path) < 0) {
+      unlink(tmppath);
+      ok = false;
+    }
+  }
+
+  free(body);
+  free(pool);
+  return ok;
+}
+
+
+struct Database* snapshot_open(char* database) {
+  char path[TABLEFILE_MAX_PATH];
+  char metapath[TABLEFILE_MAX_PATH];
+  snprintf(path, sizeof(path), "%s/%s", database, SNAPSHOT_FILE);
+  snprintf(metapath, sizeof(metapath), "%s/%s", database,
+           SNAPSHOT_META_FILE);
+
+  //
+  // without a meta file to compare against, a snapshot could not be
+  // known to be current, so none is used:
+  //
+  struct stat meta;
+  bool hasMeta = (stat(metapath, &meta) == 0);
+
+  if (hasMeta) {
+    struct Database* db = mapSnapshot(database, path, &meta);
+    if (db != NULL) {
+      return db;
+    }
+  }
+
+  struct Database* db = database_open(database);
+  if (db == NULL) {
+    return NULL;
+  }
+  db->snapshot = NULL;
+
+  //
+  // the snapshot records the meta file as it was before parsing, so
+  // a change made while it was parsed makes the snapshot stale:
+  //
+  if (hasMeta && db->numTables > 0) {
+    writeSnapshot(db, path, &meta);
+  }
+  return db;
+}
+
+void snapshot_close(struct Database* db) {
+  if (db == NULL) {
+    return;
+  }
+
+  struct Snapshot* s = db->snapshot;
+  if (s == NULL) {
+    database_close(db);
+    return;
+  }
+
+  //
+  // tables added since the open own their names and columns, like
+  // those of a parsed schema:
+  //
+  for (int t = 0; t < db->numTables; t++) {
+    struct TableMeta* table = &db->tables[t];
+    bool mapped = (table->name >= s->pool &&
+                   table->name < s->pool + s->poolBytes);
+    if (mapped) {
+      continue;
+    }
+    for (int j = 0; j < table->numColumns; j++) {
+      free(table->columns[j].name);
+    }
+    free(table->columns);
+    free(table->name);
+  }
+
+  free(s->columns);
+  munmap(s->mapping, s->mappingSize);
+  free(s);
+  free(db->tables);
+  free(db->name);
+  free(db);
+}
@@ -0,0 +1,53 @@
+/*snapshot.h*/
+
+//
+// Binary schema snapshot for SimpleSQL. database_open() parses the
+// text meta file and allocates every table and column name on each
+// start; with many tables that dominates the startup of a short
+// run. The first open saves the parsed schema to a sidecar file next
+// to the tables, "schema.snap", and later opens map that file into
+// memory instead: the names are used in place, from the snapshot's
+// string pool, so opening costs one mmap() and two arrays of meta
+// data however many names there are.
+//
+// The snapshot has a version and a checksum, and records the size
+// and modification time of the meta file it was made from; if the
+// meta file has changed since, or the snapshot does not check out,
+// the schema is parsed again and the snapshot rewritten.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include "database.h"
+
+#define SNAPSHOT_FILE      "schema.snap"
+#define SNAPSHOT_META_FILE "schema.db"  // the file database_open() parses
+#define SNAPSHOT_VERSION   1
+
+
+//
+// functions:
+//
+
+//
+// snapshot_open
+//
+// Opens the database like database_open(), from its snapshot if it
+// is up to date. Returns NULL if the database does not exist.
+//
+// NOTE: it is the callers responsibility to free the data structure
+// by calling snapshot_close(), not database_close().
+//
+struct Database* snapshot_open(char* database);
+
+//
+// snapshot_close
+//
+// Frees a database opened by snapshot_open(), including tables
+// added since by database_addTable().
+//
+void snapshot_close(struct Database* db);
@@ -0,0 +1,539 @@
+/*stats.c*/
+
+//
+// Table statistics for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "database.h"
+#include "fieldparse.h"
+#include "modify.h"
+#include "readahead.h"
+#include "rowkey.h"
+#include "stats.h"
+#include "tablefile.h"
+#include "util.h"
+
+#define STATS_MAGIC "SQLSTAT1"
+
+#define HLL_REGISTERS (1 << STATS_HLL_BITS)
+
+struct StatsHeader
+{
+  char magic[8];
+  int  numColumns;
+  int  numBuckets;  // STATS_BUCKETS when written
+  long numRecords;
+  long numRows;
+};
+
+//
+// what ANALYZE accumulates for one column during the scan:
+//
+struct ColumnState
+{
+  unsigned char* registers;  // HLL_REGISTERS of them
+  double* sample;            // numeric columns, NULL otherwise
+  long    numSampled;
+  long    numSeen;
+};
+
+bool stats_analyzeEnabled(void) {
+  return getenv("SIMPLESQL_ANALYZE") != NULL;
+}
+
+//
+// mix
+//
+// Finalizer of MurmurHash3: FNV-1a leaves the high bits of short
+// keys poorly mixed, and HyperLogLog uses them for the register.
+//
+static unsigned long mix(unsigned long h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdUL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53UL;
+  h ^= h >> 33;
+  return h;
+}
+
+//
+// nextRandom
+//
+// xorshift64; the sample is drawn with a fixed seed, so that
+// analyzing the same table twice gives the same statistics.
+//
+static unsigned long nextRandom(unsigned long* state) {
+  unsigned long x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+static void hllAdd(unsigned char* registers, unsigned long hash) {
+  long r = (long)(hash >> (64 - STATS_HLL_BITS));
+  unsigned long rest = hash << STATS_HLL_BITS;
+  int rank = (rest == 0) ? (64 - STATS_HLL_BITS + 1)
+                         : (__builtin_clzl(rest) + 1);
+
+  if (rank > registers[r]) {
+    registers[r] = (unsigned char)rank;
+  }
+}
+
+//
+// hllEstimate
+//
+// The raw HyperLogLog estimate, with linear counting while many
+// registers are still 0; 64-bit hashes need no large-range
+// correction.
+//
+static double hllEstimate(unsigned char* registers) {
+  double m = HLL_REGISTERS;
+  double sum = 0;
+  long zeros = 0;
+
+  for (long r = 0; r < HLL_REGISTERS; r++) {
+    sum += ldexp(1.0, -registers[r]);
+    zeros += (registers[r] == 0);
+  }
+
+  double estimate = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+  if (estimate <= 2.5 * m && zeros > 0) {
+    estimate = m * log(m / zeros);
+  }
+  return estimate;
+}
+
+static int compareDoubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+
+  return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+//
+// finishColumn
+//
+// Turns the column's HLL registers and sample into its statistics.
+//
+static void finishColumn(struct ColumnState* state, long numRows,
+                         struct ColumnStats* cs) {
+  cs->distinct = hllEstimate(state->registers);
+  if (cs->distinct > numRows) {
+    cs->distinct = numRows;
+  }
+
+  cs->numBuckets = 0;
+  if (state->sample == NULL || state->numSampled == 0) {
+    return;
+  }
+
+  // equi-depth: each bucket holds the same share of the sample, so
+  // the bounds are its quantiles, with the true min and max as the
+  // outer bounds
+  qsort(state->sample, state->numSampled, sizeof(double), compareDoubles);
+
+  cs->numBuckets = STATS_BUCKETS;
+  for (int b = 0; b <= STATS_BUCKETS; b++) {
+    long i = (long)((double)b * (state->numSampled - 1) / STATS_BUCKETS);
+    cs->bounds[b] = state->sample[i];
+  }
+  cs->bounds[0] = cs->min;
+  cs->bounds[STATS_BUCKETS] = cs->max;
+}
+
+//
+// save
+//
+// Writes the statistics to the sidecar file, via a temporary file
+// so readers never see a partial one.
+//
+static bool save(struct Database* db, struct TableMeta* table,
+                 struct TableStats* ts) {
+  char path[TABLEFILE_MAX_PATH];
+  char tmppath[TABLEFILE_MAX_PATH + 4];
+
+  tablefile_path(db, table, ".stats", path);
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+
+  FILE* output = fopen(tmppath, "w");
+  if (output == NULL) {
+    return false;
+  }
+
+  struct StatsHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, STATS_MAGIC, sizeof(header.magic));
+  header.numColumns = ts->numColumns;
+  header.numBuckets = STATS_BUCKETS;
+  header.numRecords = ts->numRecords;
+  header.numRows = ts->numRows;
+
+  size_t N = ts->numColumns;
+  bool ok = fwrite(&header, sizeof(header), 1, output) == 1 &&
+            fwrite(ts->columns, sizeof(struct ColumnStats), N, output) == N;
+
+  ok = (fclose(output) == 0) && ok;
+  if (!ok || rename(tmppath, path) < 0) {
+    unlink(tmppath);
+    return false;
+  }
+  return true;
+}
+
+//
+// load
+//
+// Reads the sidecar file; returns NULL if it is missing or does not
+// match the table.
+//
+static struct TableStats* load(struct Database* db, struct TableMeta* table) {
+  char path[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".stats", path);
+
+  FILE* input = fopen(path, "r");
+  if (input == NULL) {
+    return NULL;
+  }
+
+  struct StatsHeader header;
+  if (fread(&header, sizeof(header), 1, input) != 1 ||
+      memcmp(header.magic, STATS_MAGIC, sizeof(header.magic)) != 0 ||
+      header.numColumns != table->numColumns ||
+      header.numBuckets != STATS_BUCKETS) {
+    fclose(input);
+    return NULL;
+  }
+
+  struct TableStats* ts = (struct TableStats*)malloc(sizeof(struct TableStats));
+  if (ts == NULL) {
+    panic("No memory");
+  }
+  ts->numRecords = header.numRecords;
+  ts->numRows = header.numRows;
+  ts->numColumns = header.numColumns;
+  ts->columns = (struct ColumnStats*)malloc(sizeof(struct ColumnStats) *
+                                            ts->numColumns);
+  if (ts->columns == NULL) {
+    panic("No memory");
+  }
+
+  size_t N = ts->numColumns;
+  if (fread(ts->columns, sizeof(struct ColumnStats), N, input) != N) {
+    free(ts->columns);
+    free(ts);
+    ts = NULL;
+  }
+
+  fclose(input);
+  return ts;
+}
+
+static void destroy(struct TableStats* ts) {
+  if (ts == NULL) {
+    return;
+  }
+  free(ts->columns);
+  free(ts);
+}
+
+//
+// addRecord
+//
+// Folds one live record, split into its fields, into the state of
+// every column.
+//
+static void addRecord(struct TableMeta* table, struct ColumnState* states,
+                      struct ColumnStats* columns, char* fields[],
+                      int lengths[], char** key, int* keyCapacity,
+                      unsigned long* random) {
+  for (int j = 0; j < table->numColumns; j++) {
+    int colType = table->columns[j].colType;
+    struct ColumnState* state = &states[j];
+
+    int length = rowkey_encode(&colType, NULL, 1, &fields[j], key, keyCapacity);
+    hllAdd(state->registers, mix(rowkey_hash(*key, length)));
+
+    if (state->sample == NULL) {
+      continue;
+    }
+
+    double value = (colType == COL_TYPE_INT)
+                       ? fieldparse_int(fields[j], lengths[j])
+                       : fieldparse_real(fields[j], lengths[j]);
+    if (value < columns[j].min) {
+      columns[j].min = value;
+    }
+    if (value > columns[j].max) {
+      columns[j].max = value;
+    }
+
+    // reservoir sampling: the i-th value replaces a random entry of
+    // a full sample with probability STATS_SAMPLE_ROWS / i
+    state->numSeen++;
+    if (state->numSampled < STATS_SAMPLE_ROWS) {
+      state->sample[state->numSampled++] = value;
+    } else {
+      unsigned long r = nextRandom(random) % (unsigned long)state->numSeen;
+      if (r < STATS_SAMPLE_ROWS) {
+        state->sample[r] = value;
+      }
+    }
+  }
+}
+
+bool stats_analyze(struct Database* db, struct TableMeta* table) {
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  int fd = open(datapath, O_RDONLY);
+  if (fd < 0) {
+    printf("**Error: unable to analyze table '%s'\n", table->name);
+    return false;
+  }
+
+  struct TableStats* ts = (struct TableStats*)malloc(sizeof(struct TableStats));
+  struct ColumnState* states = (struct ColumnState*)malloc(
+      sizeof(struct ColumnState) * table->numColumns);
+  char* buffer = (char*)malloc(table->recordSize + 1);
+  char** fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  int* lengths = (int*)malloc(sizeof(int) * table->numColumns);
+  if (ts == NULL || states == NULL || buffer == NULL || fields == NULL ||
+      lengths == NULL) {
+    panic("No memory");
+  }
+
+  ts->numRecords = tablefile_numRecords(fd, table);
+  ts->numRows = 0;
+  ts->numColumns = table->numColumns;
+  ts->columns = (struct ColumnStats*)malloc(sizeof(struct ColumnStats) *
+                                            ts->numColumns);
+  if (ts->columns == NULL) {
+    panic("No memory");
+  }
+
+  for (int j = 0; j < table->numColumns; j++) {
+    int colType = table->columns[j].colType;
+
+    memset(&ts->columns[j], 0, sizeof(struct ColumnStats));
+    ts->columns[j].min = INFINITY;
+    ts->columns[j].max = -INFINITY;
+
+    states[j].registers = (unsigned char*)calloc(HLL_REGISTERS, 1);
+    states[j].sample = NULL;
+    if (colType == COL_TYPE_INT || colType == COL_TYPE_REAL) {
+      states[j].sample =
+          (double*)malloc(sizeof(double) * STATS_SAMPLE_ROWS);
+      if (states[j].sample == NULL) {
+        panic("No memory");
+      }
+    }
+    states[j].numSampled = 0;
+    states[j].numSeen = 0;
+    if (states[j].registers == NULL) {
+      panic("No memory");
+    }
+  }
+
+  char* key = NULL;
+  int keyCapacity = 0;
+  unsigned long random = 0x9e3779b97f4a7c15UL;
+
+  //
+  // one sequential pass over the file:
+  //
+  struct ReadAhead* ra =
+      readahead_start(fd, 0, (off_t)ts->numRecords * table->recordSize,
+                      table->recordSize);
+  struct ReadAheadStats io;
+  memset(&io, 0, sizeof(io));
+
+  char* chunk;
+  long length;
+  while ((chunk = readahead_next(ra, &length)) != NULL) {
+    long numInChunk = length / table->recordSize;
+    for (long r = 0; r < numInChunk; r++) {
+      memcpy(buffer, chunk + r * table->recordSize, table->recordSize);
+      buffer[table->recordSize] = '\0';
+      if (tablefile_isDeleted(buffer) ||
+          fieldparse_split(buffer, fields, lengths, table->numColumns) !=
+              table->numColumns) {
+        continue;
+      }
+      addRecord(table, states, ts->columns, fields, lengths, &key,
+                &keyCapacity, &random);
+      ts->numRows++;
+    }
+  }
+  readahead_finish(ra, &io);
+  readahead_report(table->name, &io);
+  close(fd);
+
+  for (int j = 0; j < table->numColumns; j++) {
+    finishColumn(&states[j], ts->numRows, &ts->columns[j]);
+    free(states[j].registers);
+    free(states[j].sample);
+  }
+  free(key);
+  free(lengths);
+  free(fields);
+  free(buffer);
+  free(states);
+
+  if (!save(db, table, ts)) {
+    printf("**Error: unable to save statistics of table '%s'\n", table->name);
+  }
+
+  destroy(table->stats);
+  table->stats = ts;
+  return true;
+}
+
+void stats_load(struct Database* db) {
+  for (int i = 0; i < db->numTables; i++) {
+    db->tables[i].stats = load(db, &db->tables[i]);
+  }
+}
+
+void stats_unload(struct Database* db) {
+  for (int i = 0; i < db->numTables; i++) {
+    destroy(db->tables[i].stats);
+    db->tables[i].stats = NULL;
+  }
+}
+
+long stats_numRows(struct Database* db, struct TableMeta* table) {
+  struct TableStats* ts = table->stats;
+  if (ts == NULL) {
+    return -1;
+  }
+
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  int fd = open(datapath, O_RDONLY);
+  if (fd < 0) {
+    return ts->numRows;
+  }
+  long numRecords = tablefile_numRecords(fd, table);
+  close(fd);
+
+  if (ts->numRecords == 0) {
+    return numRecords;
+  }
+  return (long)((double)numRecords * ts->numRows / ts->numRecords + 0.5);
+}
+
+double stats_distinct(struct TableMeta* table, struct ColumnMeta* column) {
+  if (table->stats == NULL) {
+    return -1;
+  }
+  return table->stats->columns[column - table->columns].distinct;
+}
+
+//
+// fractionBelow
+//
+// Fraction of the values that are < v, interpolating linearly
+// within the bucket that holds v.
+//
+static double fractionBelow(struct ColumnStats* cs, double v) {
+  double below = 0;
+
+  for (int b = 0; b < cs->numBuckets; b++) {
+    double lo = cs->bounds[b];
+    double hi = cs->bounds[b + 1];
+    if (hi < v) {
+      below += 1;
+    } else if (lo < v) {
+      below += (v - lo) / (hi - lo);
+    }
+  }
+  return below / cs->numBuckets;
+}
+
+//
+// fractionEqual
+//
+// Fraction of the values that are = v: a value that fills whole
+// buckets is frequent, otherwise assume all values are equally
+// common.
+//
+static double fractionEqual(struct ColumnStats* cs, double v) {
+  if (v < cs->min || v > cs->max) {
+    return 0;
+  }
+
+  int full = 0;
+  for (int b = 0; b < cs->numBuckets; b++) {
+    full += (cs->bounds[b] == v && cs->bounds[b + 1] == v);
+  }
+
+  double uniform = (cs->distinct >= 1) ? 1 / cs->distinct : 1;
+  double frequent = (double)full / cs->numBuckets;
+  return (frequent > uniform) ? frequent : uniform;
+}
+
+double stats_selectivity(struct TableMeta* table, struct ColumnMeta* column,
+                         int oper, char* value) {
+  if (table->stats == NULL || oper == EXPR_LIKE) {
+    return -1;
+  }
+
+  struct ColumnStats* cs = &table->stats->columns[column - table->columns];
+  double uniform = (cs->distinct >= 1) ? 1 / cs->distinct : 1;
+
+  if (cs->numBuckets == 0) {
+    // strings: only equality can be estimated
+    if (oper == EXPR_EQUAL) {
+      return uniform;
+    }
+    if (oper == EXPR_NOT_EQUAL) {
+      return 1 - uniform;
+    }
+    return -1;
+  }
+
+  double v = atof(value);
+  double below = fractionBelow(cs, v);
+  double equal = fractionEqual(cs, v);
+  double f;
+
+  switch (oper) {
+    case EXPR_LT:
+      f = below;
+      break;
+    case EXPR_LTE:
+      f = below + equal;
+      break;
+    case EXPR_GT:
+      f = 1 - below - equal;
+      break;
+    case EXPR_GTE:
+      f = 1 - below;
+      break;
+    case EXPR_EQUAL:
+      f = equal;
+      break;
+    default:  // <>
+      f = 1 - equal;
+      break;
+  }
+  return (f < 0) ? 0 : (f > 1) ? 1 : f;
+}
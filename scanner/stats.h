@@ -0,0 +1,116 @@
+/*stats.h*/
+
+//
+// Table statistics for SimpleSQL, for planning: ANALYZE scans a
+// table once and records, per column, an estimate of the number of
+// distinct values (HyperLogLog), the min and max, and an equi-depth
+// histogram of a sample of the values. The statistics are saved in
+// a sidecar file next to the table's data file, <table>.stats, and
+// loaded with the schema. They are not maintained as the table
+// changes; run ANALYZE again to refresh them.
+//
+// Set the environment variable SIMPLESQL_ANALYZE to have the program
+// analyze every table when it opens the database.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "database.h"
+
+//
+// HyperLogLog with 2^STATS_HLL_BITS registers (standard error about
+// 1.04 / sqrt(4096) = 1.6%), histograms of STATS_BUCKETS buckets
+// built from a sample of at most STATS_SAMPLE_ROWS values:
+//
+#define STATS_HLL_BITS    12
+#define STATS_BUCKETS     16
+#define STATS_SAMPLE_ROWS (64 * 1024)
+
+struct ColumnStats
+{
+  double distinct;     // estimated number of distinct values
+  double min;          // numeric columns; min > max => no values
+  double max;
+  int    numBuckets;   // 0 => no histogram, e.g. a string column
+  double bounds[STATS_BUCKETS + 1];  // bucket b holds [bounds[b], bounds[b+1]]
+};
+
+struct TableStats
+{
+  long   numRecords;   // records in the data file when analyzed
+  long   numRows;      // live records, i.e. not deleted
+  int    numColumns;
+  struct ColumnStats* columns;  // pointer to ARRAY, one per column
+};
+
+
+//
+// functions:
+//
+
+//
+// stats_analyzeEnabled
+//
+// Returns true if SIMPLESQL_ANALYZE is set.
+//
+bool stats_analyzeEnabled(void);
+
+//
+// stats_analyze
+//
+// Scans the table, saves its statistics in the sidecar file and
+// makes them the table's statistics (table->stats). Returns false
+// (after printing an error) if the table cannot be read.
+//
+bool stats_analyze(struct Database* db, struct TableMeta* table);
+
+//
+// stats_load
+//
+// Loads the statistics of every table that has been analyzed; the
+// others get table->stats = NULL. Call this once, right after
+// schemamap_build().
+//
+void stats_load(struct Database* db);
+
+//
+// stats_unload
+//
+// Frees the statistics loaded by stats_load() or stats_analyze();
+// call this before database_close().
+//
+void stats_unload(struct Database* db);
+
+//
+// stats_numRows
+//
+// Estimated live rows in the table now: the current record count
+// (from the file size) scaled by the live fraction when analyzed.
+// Returns -1 if the table has no statistics.
+//
+long stats_numRows(struct Database* db, struct TableMeta* table);
+
+//
+// stats_distinct
+//
+// Estimated number of distinct values of the column, or -1 if the
+// table has no statistics.
+//
+double stats_distinct(struct TableMeta* table, struct ColumnMeta* column);
+
+//
+// stats_selectivity
+//
+// Estimated fraction of the table's live rows for which
+// "column <oper> value" holds, with oper as in the AST's EXPR;
+// returns -1 if the statistics cannot tell, e.g. for LIKE or a
+// range over a string column.
+//
+double stats_selectivity(struct TableMeta* table, struct ColumnMeta* column,
+                         int oper, char* value);
@@ -0,0 +1,130 @@
+/*tablefile.c*/
+
+//
+// Helpers for the fixed-width <table>.data files.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "fieldparse.h"
+#include "tablefile.h"
+#include "util.h"
+
+void tablefile_path(struct Database* db, struct TableMeta* table,
+                    char* suffix, char* path) {
+  snprintf(path, TABLEFILE_MAX_PATH, "%s/%s%s", db->name, table->name,
+           suffix);
+}
+
+long tablefile_numRecords(int fd, struct TableMeta* table) {
+  struct stat info;
+
+  if (fstat(fd, &info) < 0) {
+    return -1;
+  }
+  return (long)(info.st_size / table->recordSize);
+}
+
+bool tablefile_readRecord(int fd, struct TableMeta* table, long recno,
+                          char* buffer) {
+  off_t offset = (off_t)recno * table->recordSize;
+  ssize_t n = pread(fd, buffer, table->recordSize, offset);
+
+  if (n != table->recordSize) {
+    return false;
+  }
+  buffer[table->recordSize] = '\0';
+  return true;
+}
+
+bool tablefile_write(int fd, char* buffer, size_t N) {
+  while (N > 0) {
+    ssize_t n = write(fd, buffer, N);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    buffer += n;
+    N -= n;
+  }
+  return true;
+}
+
+bool tablefile_isDeleted(char* record) {
+  return record[0] == TABLEFILE_TOMBSTONE;
+}
+
+int tablefile_splitFields(char* record, char* fields[], int maxFields) {
+  return fieldparse_split(record, fields, NULL, maxFields);
+}
+
+bool tablefile_formatRecord(struct TableMeta* table, char* values[],
+                            char* record) {
+  int length = 0;
+  int max = table->recordSize - 1;  // room for the newline
+
+  for (int j = 0; j < table->numColumns; j++) {
+    char* value = values[j];
+    int colType = table->columns[j].colType;
+    char* end;
+    int n;
+
+    if (colType == COL_TYPE_INT) {
+      strtol(value, &end, 10);
+      if (end == value || *end != '\0') {
+        printf("**Error: '%s' is not an int value for column '%s'\n", value,
+               table->columns[j].name);
+        return false;
+      }
+      n = snprintf(record + length, max - length + 1, "%s%s",
+                   (j == 0) ? "" : " ", value);
+    } else if (colType == COL_TYPE_REAL) {
+      strtod(value, &end);
+      if (end == value || *end != '\0') {
+        printf("**Error: '%s' is not a real value for column '%s'\n", value,
+               table->columns[j].name);
+        return false;
+      }
+      n = snprintf(record + length, max - length + 1, "%s%s",
+                   (j == 0) ? "" : " ", value);
+    } else {
+      //
+      // strings are quoted with ' unless they contain one:
+      //
+      bool single = (strchr(value, '\'') != NULL);
+      if (single && strchr(value, '"') != NULL) {
+        printf("**Error: string value for column '%s' contains both "
+               "kinds of quotes\n",
+               table->columns[j].name);
+        return false;
+      }
+      char quote = single ? '"' : '\'';
+      n = snprintf(record + length, max - length + 1, "%s%c%s%c",
+                   (j == 0) ? "" : " ", quote, value, quote);
+    }
+
+    if (n < 0 || length + n > max) {
+      printf("**Error: record too long for table '%s' (record size %d)\n",
+             table->name, table->recordSize);
+      return false;
+    }
+    length += n;
+  }
+
+  memset(record + length, ' ', max - length);
+  record[max] = '\n';
+  return true;
+}
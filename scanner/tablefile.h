@@ -0,0 +1,102 @@
+/*tablefile.h*/
+
+//
+// Helpers for the fixed-width <table>.data files and the sidecar
+// files that live next to them. Every record is exactly
+// table->recordSize bytes (newline included), so record N starts
+// at byte N * recordSize.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "database.h"
+
+//
+// the first byte of a deleted record; no live record can start
+// with it, since every field is a number or a quoted string:
+//
+#define TABLEFILE_TOMBSTONE '#'
+
+//
+// big enough for "<database>/<table>.<column>.<extension>":
+//
+#define TABLEFILE_MAX_PATH ((3 * DATABASE_MAX_ID_LENGTH) + 16)
+
+
+//
+// functions:
+//
+
+//
+// tablefile_path
+//
+// Builds "<database>/<table><suffix>" into path, which must hold
+// TABLEFILE_MAX_PATH chars. For example, a suffix of ".data"
+// yields the table's data file.
+//
+void tablefile_path(struct Database* db, struct TableMeta* table,
+                    char* suffix, char* path);
+
+//
+// tablefile_numRecords
+//
+// Returns the number of records in the open data file, computed
+// from the file size; returns -1 on error.
+//
+long tablefile_numRecords(int fd, struct TableMeta* table);
+
+//
+// tablefile_readRecord
+//
+// Reads record recno into buffer, which must hold at least
+// recordSize + 1 chars, and null-terminates it. Returns false if
+// the record does not exist.
+//
+bool tablefile_readRecord(int fd, struct TableMeta* table, long recno,
+                          char* buffer);
+
+//
+// tablefile_write
+//
+// Writes all N bytes, normally with a single write call; returns
+// false on error.
+//
+bool tablefile_write(int fd, char* buffer, size_t N);
+
+//
+// tablefile_splitFields
+//
+// Splits a record in place into its fields: separators are
+// replaced by '\0' and fields[i] points to the value of column i,
+// with the quotes of string values removed. Returns the number of
+// fields found, at most maxFields. See fieldparse_split() to also
+// get the length of each field.
+//
+int tablefile_splitFields(char* record, char* fields[], int maxFields);
+
+//
+// tablefile_isDeleted
+//
+// Returns true if the record has been marked deleted.
+//
+bool tablefile_isDeleted(char* record);
+
+//
+// tablefile_formatRecord
+//
+// Formats one value per column (in text form, strings without
+// quotes) into a fixed-width record: fields separated by a space,
+// strings quoted, padded with spaces and ending in a newline; the
+// record is NOT null-terminated. Prints an error and returns false
+// if a value does not match its column type or the record would
+// not fit in recordSize bytes.
+//
+bool tablefile_formatRecord(struct TableMeta* table, char* values[],
+                            char* record);
@@ -0,0 +1,484 @@
+/*groupby_test.c*/
+
+//
+// Test of GROUP BY: runs grouped queries over a small table, which
+// is scanned by one thread, and a large one, which is scanned by
+// several, grouping by columns with few and with many distinct
+// values, and checks the groups written in the csv format against
+// the groups computed here. With the small memory the test is built
+// with, the many groups of the large table are spilled to
+// partitions, and most partitions are split again when merged.
+//
+// The tables are written to a temporary directory, which is removed
+// at the end. Build and run from the scanner directory, next to the
+// rest of the project's sources:
+//
+//   gcc -O2 -pthread -I. -DGROUPBY_MEMORY_BYTES=262144
+//     -DGROUPBY_PARALLEL_RECORDS=1000 -DGROUPBY_THREADS=4
+//     tests/groupby_test.c $(ls *.c | grep -v Schema_and_AST_Output.c)
+//     -lm -o groupby_test && ./groupby_test
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "database.h"
+#include "groupby.h"
+#include "schemamap.h"
+#include "tablefile.h"
+#include "util.h"
+
+#define TEST_RECORD_SIZE 32
+#define TEST_MAX_COLUMNS 8
+
+//
+// the columns of a test table; record i is "g h 'd' v r", where
+// g = i % 11, h = i * 7919 % 40000, d = "d<i % 3>", v = i % 50 and
+// r = i % 13 / 2:
+//
+static struct ColumnMeta columns[] = {
+    {"g", COL_TYPE_INT, COL_NON_INDEXED},
+    {"h", COL_TYPE_INT, COL_NON_INDEXED},
+    {"d", COL_TYPE_STRING, COL_NON_INDEXED},
+    {"v", COL_TYPE_INT, COL_NON_INDEXED},
+    {"r", COL_TYPE_REAL, COL_NON_INDEXED}};
+
+#define TEST_NUM_COLUMNS 5
+
+static double valueOf(long i, int column) {
+  switch (column) {
+    case 0:
+      return i % 11;
+    case 1:
+      return i * 7919 % 40000;
+    case 2:
+      return i % 3;
+    case 3:
+      return i % 50;
+    default:
+      return (i % 13) * 0.5;
+  }
+}
+
+//
+// a query: SELECT the group columns, then the aggregates, FROM the
+// table [WHERE v < below] GROUP BY the group columns [LIMIT limit];
+// below and limit are -1 if there is no such clause:
+//
+struct TestQuery
+{
+  char* groupBy[2];
+  int   numGroup;
+  int   functions[5];
+  char* aggregated[5];
+  int   numAggs;
+  int   below;
+  int   limit;
+};
+
+static struct TestQuery queries[] = {
+    {{"g"}, 1,
+     {COUNT_FUNCTION, SUM_FUNCTION, MIN_FUNCTION, MAX_FUNCTION, AVG_FUNCTION},
+     {"v", "v", "v", "v", "r"}, 5, -1, -1},
+    {{"d", "g"}, 2, {SUM_FUNCTION, MAX_FUNCTION}, {"r", "r"}, 2, -1, -1},
+    {{"g"}, 1, {SUM_FUNCTION, AVG_FUNCTION}, {"r", "v"}, 2, 25, -1},
+    {{"h"}, 1,
+     {COUNT_FUNCTION, SUM_FUNCTION, MIN_FUNCTION, MAX_FUNCTION},
+     {"d", "v", "r", "v"}, 4, -1, -1},
+    {{"h", "d"}, 2, {AVG_FUNCTION}, {"r"}, 1, 10, -1},
+    {{"g"}, 1, {COUNT_FUNCTION}, {"v"}, 1, -1, 4}};
+
+#define TEST_NUM_QUERIES 6
+
+static struct
+{
+  char* name;
+  long  numRecords;
+} testTables[] = {{"small", 500}, {"large", 60000}};
+
+#define TEST_NUM_TABLES 2
+
+//
+// removeDirectory
+//
+// Removes the temporary directory, with the data files and whatever
+// sidecar files were built next to them.
+//
+static void removeDirectory(char* dir) {
+  DIR* d = opendir(dir);
+  if (d != NULL) {
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+        continue;
+      }
+      char path[TABLEFILE_MAX_PATH];
+      snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+      unlink(path);
+    }
+    closedir(d);
+  }
+  rmdir(dir);
+}
+
+//
+// writeTable
+//
+// Writes records 0 .. numRecords - 1 to the table's data file;
+// returns false on error.
+//
+static bool writeTable(struct Database* db, struct TableMeta* table,
+                       long numRecords) {
+  char path[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", path);
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  bool ok = true;
+  char record[TEST_RECORD_SIZE];
+  for (long i = 0; ok && i < numRecords; i++) {
+    char text[TEST_NUM_COLUMNS][16];
+    char* values[TEST_NUM_COLUMNS];
+    for (int j = 0; j < TEST_NUM_COLUMNS; j++) {
+      values[j] = text[j];
+      if (columns[j].colType == COL_TYPE_STRING) {
+        snprintf(text[j], sizeof(text[j]), "d%.0f", valueOf(i, j));
+      } else if (columns[j].colType == COL_TYPE_REAL) {
+        snprintf(text[j], sizeof(text[j]), "%.1f", valueOf(i, j));
+      } else {
+        snprintf(text[j], sizeof(text[j]), "%.0f", valueOf(i, j));
+      }
+    }
+    ok = tablefile_formatRecord(table, values, record) &&
+         tablefile_write(fd, record, sizeof(record));
+  }
+
+  close(fd);
+  return ok;
+}
+
+static int columnOf(char* name) {
+  for (int j = 0; j < TEST_NUM_COLUMNS; j++) {
+    if (strcmp(columns[j].name, name) == 0) {
+      return j;
+    }
+  }
+  panic("no such test column");
+  return -1;
+}
+
+static int compareRows(const void* a, const void* b) {
+  return strcmp(*(char**)a, *(char**)b);
+}
+
+//
+// groupKey
+//
+// The group columns of record i, as they are written in the csv
+// format, followed by a comma.
+//
+static void groupKey(struct TestQuery* q, long i, char* key, int size) {
+  int length = 0;
+  for (int k = 0; k < q->numGroup; k++) {
+    int j = columnOf(q->groupBy[k]);
+    char* prefix = (columns[j].colType == COL_TYPE_STRING) ? "d" : "";
+    length += snprintf(key + length, size - length, "%s%.0f,", prefix,
+                       valueOf(i, j));
+  }
+}
+
+//
+// expectedRows
+//
+// The rows of the query over records 0 .. numRecords - 1, one per
+// group, sorted; returns how many.
+//
+static long expectedRows(struct TestQuery* q, long numRecords, char* rows[]) {
+  //
+  // the records to group, sorted by their group, with each record's
+  // number after its key:
+  //
+  char** keys = (char**)malloc(sizeof(char*) * (numRecords + 1));
+  if (keys == NULL) {
+    panic("No memory");
+  }
+  long n = 0;
+  for (long i = 0; i < numRecords; i++) {
+    if (q->below >= 0 && valueOf(i, 3) >= q->below) {
+      continue;
+    }
+    char key[64];
+    groupKey(q, i, key, sizeof(key));
+    keys[n] = (char*)malloc(strlen(key) + 16);
+    if (keys[n] == NULL) {
+      panic("No memory");
+    }
+    sprintf(keys[n], "%s%ld", key, i);
+    n++;
+  }
+  qsort(keys, n, sizeof(char*), compareRows);
+
+  long numRows = 0;
+  for (long first = 0; first < n;) {
+    char* last = strrchr(keys[first], ',');
+    int keyLength = (int)(last - keys[first]) + 1;
+    long end = first;
+    while (end < n && strncmp(keys[end], keys[first], keyLength) == 0 &&
+           strrchr(keys[end], ',') - keys[end] + 1 == keyLength) {
+      end++;
+    }
+
+    char row[256];
+    int length = snprintf(row, sizeof(row), "%.*s", keyLength - 1,
+                          keys[first]);
+    for (int a = 0; a < q->numAggs; a++) {
+      int j = columnOf(q->aggregated[a]);
+      long count = end - first;
+      double sum = 0, min = 0, max = 0;
+      for (long e = first; e < end; e++) {
+        double value = valueOf(atol(strrchr(keys[e], ',') + 1), j);
+        sum += value;
+        min = (e == first || value < min) ? value : min;
+        max = (e == first || value > max) ? value : max;
+      }
+
+      bool isInt = (columns[j].colType == COL_TYPE_INT);
+      switch (q->functions[a]) {
+        case COUNT_FUNCTION:
+          length += snprintf(row + length, sizeof(row) - length, ",%ld", count);
+          break;
+        case AVG_FUNCTION:
+          length += snprintf(row + length, sizeof(row) - length, ",%.17g",
+                             sum / count);
+          break;
+        default: {
+          double value = (q->functions[a] == SUM_FUNCTION)   ? sum
+                         : (q->functions[a] == MIN_FUNCTION) ? min
+                                                             : max;
+          length += isInt ? snprintf(row + length, sizeof(row) - length,
+                                     ",%d", (int)value)
+                          : snprintf(row + length, sizeof(row) - length,
+                                     ",%.17g", value);
+        }
+      }
+    }
+    rows[numRows++] = strdup(row);
+    first = end;
+  }
+
+  for (long e = 0; e < n; e++) {
+    free(keys[e]);
+  }
+  free(keys);
+  qsort(rows, numRows, sizeof(char*), compareRows);
+  return numRows;
+}
+
+//
+// run
+//
+// Runs the query over the table in the csv format, and checks its
+// rows; returns false, having said why, if they are wrong.
+//
+static bool run(struct Database* db, struct TableMeta* table,
+                long numRecords, struct TestQuery* q, int number) {
+  static char* prefixes[] = {"", "min_", "max_", "sum_", "avg_", "count_"};
+
+  char step[64];
+  snprintf(step, sizeof(step), "%s, query %d", table->name, number);
+
+  //
+  // the columns selected, then the GROUP BY columns, and the header
+  // line they are written under:
+  //
+  struct COLUMN selected[TEST_MAX_COLUMNS];
+  struct COLUMN grouped[2];
+  char header[256] = "";
+  int numSelected = q->numGroup + q->numAggs;
+  memset(selected, 0, sizeof(selected));
+  memset(grouped, 0, sizeof(grouped));
+  for (int c = 0; c < numSelected; c++) {
+    selected[c].table = table->name;
+    if (c < q->numGroup) {
+      selected[c].name = q->groupBy[c];
+      grouped[c].table = table->name;
+      grouped[c].name = q->groupBy[c];
+      grouped[c].next = (c + 1 < q->numGroup) ? &grouped[c + 1] : NULL;
+    } else {
+      selected[c].name = q->aggregated[c - q->numGroup];
+      selected[c].function = q->functions[c - q->numGroup];
+    }
+    selected[c].next = (c + 1 < numSelected) ? &selected[c + 1] : NULL;
+    snprintf(header + strlen(header), sizeof(header) - strlen(header),
+             "%s%s%s", (c > 0) ? "," : "", prefixes[selected[c].function],
+             selected[c].name);
+  }
+  strcat(header, "\n");
+
+  struct SELECT select;
+  memset(&select, 0, sizeof(select));
+  select.table = table->name;
+  select.columns = selected;
+
+  char value[16];
+  snprintf(value, sizeof(value), "%d", q->below);
+  struct COLUMN whereColumn;
+  memset(&whereColumn, 0, sizeof(whereColumn));
+  whereColumn.table = table->name;
+  whereColumn.name = "v";
+  struct EXPR expr;
+  memset(&expr, 0, sizeof(expr));
+  expr.column = &whereColumn;
+  expr.operator = EXPR_LT;
+  expr.value = value;
+  expr.litType = INTEGER_LITERAL;
+  struct WHERE where;
+  where.expr = &expr;
+  if (q->below >= 0) {
+    select.where = &where;
+  }
+  struct LIMIT limit;
+  limit.N = q->limit;
+  if (q->limit >= 0) {
+    select.limit = &limit;
+  }
+
+  //
+  // the output goes to a temporary file, read back below:
+  //
+  char path[] = "/tmp/groupby_test_outputXXXXXX";
+  int output = mkstemp(path);
+  if (output < 0) {
+    panic("unable to create the test's output file");
+  }
+  unlink(path);
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  dup2(output, STDOUT_FILENO);
+  groupby_execute(db, &select, grouped);
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+
+  char** expected = (char**)malloc(sizeof(char*) * (numRecords + 1));
+  char** actual = (char**)malloc(sizeof(char*) * (numRecords + 1));
+  if (expected == NULL || actual == NULL) {
+    panic("No memory");
+  }
+  long numExpected = expectedRows(q, numRecords, expected);
+
+  bool ok = true;
+  long numActual = 0;
+  char line[256];
+  FILE* input = fdopen(output, "r");
+  rewind(input);
+  if (fgets(line, sizeof(line), input) == NULL || strcmp(line, header) != 0) {
+    printf("**Error: %s: wrong header\n", step);
+    ok = false;
+  }
+  while (ok && fgets(line, sizeof(line), input) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+    if (numActual == numRecords) {
+      printf("**Error: %s: more groups than records\n", step);
+      ok = false;
+      break;
+    }
+    actual[numActual++] = strdup(line);
+  }
+  fclose(input);
+  qsort(actual, numActual, sizeof(char*), compareRows);
+
+  //
+  // every group once, or with a LIMIT that many of them, each right:
+  //
+  long numGroups = (q->limit >= 0 && q->limit < numExpected) ? q->limit
+                                                             : numExpected;
+  if (ok && numActual != numGroups) {
+    printf("**Error: %s: %ld groups, expected %ld\n", step, numActual,
+           numGroups);
+    ok = false;
+  }
+  for (long i = 0; ok && i < numActual; i++) {
+    if ((i > 0 && strcmp(actual[i - 1], actual[i]) == 0) ||
+        bsearch(&actual[i], expected, numExpected, sizeof(char*),
+                compareRows) == NULL) {
+      printf("**Error: %s: wrong group '%s'\n", step, actual[i]);
+      ok = false;
+    }
+  }
+
+  for (long i = 0; i < numActual; i++) {
+    free(actual[i]);
+  }
+  for (long i = 0; i < numExpected; i++) {
+    free(expected[i]);
+  }
+  free(actual);
+  free(expected);
+  return ok;
+}
+
+int main() {
+  char dir[] = "/tmp/groupby_testXXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    printf("**Error: unable to create a temporary directory\n");
+    return 1;
+  }
+
+  struct TableMeta tables[TEST_NUM_TABLES];
+  memset(tables, 0, sizeof(tables));
+  for (int t = 0; t < TEST_NUM_TABLES; t++) {
+    tables[t].name = testTables[t].name;
+    tables[t].recordSize = TEST_RECORD_SIZE;
+    tables[t].numColumns = TEST_NUM_COLUMNS;
+    tables[t].columns = columns;
+  }
+
+  struct Database db;
+  memset(&db, 0, sizeof(db));
+  db.name = dir;
+  db.numTables = TEST_NUM_TABLES;
+  db.tables = tables;
+  schemamap_build(&db);
+
+  for (int t = 0; t < TEST_NUM_TABLES; t++) {
+    if (!writeTable(&db, &tables[t], testTables[t].numRecords)) {
+      printf("**Error: unable to write test table '%s'\n", tables[t].name);
+      removeDirectory(dir);
+      return 1;
+    }
+  }
+
+  setenv("SIMPLESQL_FORMAT", "csv", 1);
+
+  int failures = 0;
+  for (int t = 0; t < TEST_NUM_TABLES; t++) {
+    for (int q = 0; q < TEST_NUM_QUERIES; q++) {
+      failures += !run(&db, &tables[t], testTables[t].numRecords, &queries[q],
+                       q + 1);
+    }
+  }
+
+  removeDirectory(dir);
+  schemamap_destroy(&db);
+
+  int runs = TEST_NUM_TABLES * TEST_NUM_QUERIES;
+  if (failures > 0) {
+    printf("groupby: %d of %d queries FAILED\n", failures, runs);
+    return 1;
+  }
+  printf("groupby: %d queries OK\n", runs);
+  return 0;
+}
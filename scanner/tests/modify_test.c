@@ -0,0 +1,380 @@
+/*modify_test.c*/
+
+//
+// Test of UPDATE, DELETE and compaction: runs a sequence of
+// statements over a small table, through its indexes and by
+// scanning, and after each one checks every record of the data file
+// against a copy of the table kept in memory. Deleting enough of the
+// table starts a compaction in the background, after which the
+// indexes, whose record numbers have changed, must still find the
+// right records.
+//
+// The table is written to a temporary directory, which is removed
+// at the end. Build and run from the scanner directory, next to the
+// rest of the project's sources:
+//
+//   gcc -O2 -pthread -I. tests/modify_test.c $(ls *.c | grep -v
+//     Schema_and_AST_Output.c) -lm -o modify_test && ./modify_test
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "database.h"
+#include "modify.h"
+#include "schemamap.h"
+#include "tablefile.h"
+#include "util.h"
+#include "wal.h"
+
+#define TEST_RECORDS     400
+#define TEST_RECORD_SIZE 32
+
+//
+// a record of the table: "id 'name' qty", where name is "n<id % 10>"
+// and qty is id % 100 until updated:
+//
+struct Row
+{
+  int  id;
+  char name[16];
+  int  qty;
+  bool live;
+};
+
+static struct Row rows[TEST_RECORDS];  // the records, in file order
+static long numRows;
+
+//
+// removeDirectory
+//
+// Removes the temporary directory, with the data file and whatever
+// sidecar files were built next to it.
+//
+static void removeDirectory(char* dir) {
+  DIR* d = opendir(dir);
+  if (d != NULL) {
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+        continue;
+      }
+      char path[TABLEFILE_MAX_PATH];
+      snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+      unlink(path);
+    }
+    closedir(d);
+  }
+  rmdir(dir);
+}
+
+//
+// writeTable
+//
+// Writes the rows to the table's data file; returns false on error.
+//
+static bool writeTable(struct Database* db, struct TableMeta* table) {
+  char path[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", path);
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  bool ok = true;
+  char record[TEST_RECORD_SIZE];
+  for (long r = 0; ok && r < numRows; r++) {
+    char id[16], qty[16];
+    snprintf(id, sizeof(id), "%d", rows[r].id);
+    snprintf(qty, sizeof(qty), "%d", rows[r].qty);
+    char* values[] = {id, rows[r].name, qty};
+    ok = tablefile_formatRecord(table, values, record) &&
+         tablefile_write(fd, record, sizeof(record));
+  }
+
+  close(fd);
+  return ok;
+}
+
+//
+// matches
+//
+// Whether the row satisfies "column <operator> value".
+//
+static bool matches(struct Row* row, char* column, int operator, char* value) {
+  int cmp;
+  if (strcmp(column, "name") == 0) {
+    cmp = strcmp(row->name, value);
+  } else {
+    int x = (strcmp(column, "id") == 0) ? row->id : row->qty;
+    int y = atoi(value);
+    cmp = (x < y) ? -1 : (x > y);
+  }
+
+  switch (operator) {
+    case EXPR_LT:
+      return cmp < 0;
+    case EXPR_LTE:
+      return cmp <= 0;
+    case EXPR_GT:
+      return cmp > 0;
+    case EXPR_GTE:
+      return cmp >= 0;
+    case EXPR_EQUAL:
+      return cmp == 0;
+    default:
+      return cmp != 0;
+  }
+}
+
+//
+// compact
+//
+// Drops the deleted rows, the way compaction drops their records.
+//
+static void compact(void) {
+  long n = 0;
+  for (long r = 0; r < numRows; r++) {
+    if (rows[r].live) {
+      rows[n++] = rows[r];
+    }
+  }
+  numRows = n;
+}
+
+//
+// check
+//
+// Compares every record of the data file with the rows; returns
+// false, having said why, if they differ.
+//
+static bool check(struct Database* db, struct TableMeta* table, char* step) {
+  char path[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", path);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("**Error: %s: unable to open the data file\n", step);
+    return false;
+  }
+
+  bool ok = true;
+  long numRecords = tablefile_numRecords(fd, table);
+  if (numRecords != numRows) {
+    printf("**Error: %s: %ld records, expected %ld\n", step, numRecords,
+           numRows);
+    ok = false;
+  }
+
+  long numDeleted = 0;
+  char record[TEST_RECORD_SIZE + 1];
+  for (long r = 0; ok && r < numRows; r++) {
+    if (!tablefile_readRecord(fd, table, r, record)) {
+      printf("**Error: %s: unable to read record %ld\n", step, r);
+      ok = false;
+      break;
+    }
+    if (tablefile_isDeleted(record)) {
+      numDeleted++;
+      if (rows[r].live) {
+        printf("**Error: %s: record %ld (id %d) is deleted\n", step, r,
+               rows[r].id);
+        ok = false;
+      }
+      continue;
+    }
+
+    char* fields[3];
+    if (!rows[r].live) {
+      printf("**Error: %s: record %ld (id %d) is not deleted\n", step, r,
+             rows[r].id);
+      ok = false;
+    } else if (tablefile_splitFields(record, fields, 3) != 3 ||
+               atoi(fields[0]) != rows[r].id ||
+               strcmp(fields[1], rows[r].name) != 0 ||
+               atoi(fields[2]) != rows[r].qty) {
+      printf("**Error: %s: record %ld is not id %d '%s' %d\n", step, r,
+             rows[r].id, rows[r].name, rows[r].qty);
+      ok = false;
+    }
+  }
+  close(fd);
+
+  if (ok && modify_numDeleted(db, table) != numDeleted) {
+    printf("**Error: %s: %ld deleted records counted, %ld in the file\n", step,
+           modify_numDeleted(db, table), numDeleted);
+    ok = false;
+  }
+  return ok;
+}
+
+//
+// run
+//
+// Runs "UPDATE items SET <set> = <value> WHERE <column> <operator>
+// <where>", or a DELETE if set is NULL, or without a WHERE clause if
+// column is NULL, applies it to the rows as well, and checks the
+// count and the data file.
+//
+static bool run(struct Database* db, struct TableMeta* table, char* set,
+                char* value, char* column, int operator, char* where) {
+  char step[128];
+  if (set != NULL) {
+    snprintf(step, sizeof(step), "update %s = %s where %s", set, value,
+             (column != NULL) ? column : "true");
+  } else {
+    snprintf(step, sizeof(step), "delete where %s",
+             (column != NULL) ? column : "true");
+  }
+
+  struct COLUMN whereColumn;
+  memset(&whereColumn, 0, sizeof(whereColumn));
+  whereColumn.table = table->name;
+  whereColumn.name = column;
+  struct EXPR expr;
+  memset(&expr, 0, sizeof(expr));
+  expr.column = &whereColumn;
+  expr.operator = operator;
+  expr.value = where;
+  expr.litType = (column != NULL && strcmp(column, "name") == 0)
+                     ? STRING_LITERAL
+                     : INTEGER_LITERAL;
+
+  long expected = 0;
+  for (long r = 0; r < numRows; r++) {
+    struct Row* row = &rows[r];
+    if (!row->live || (column != NULL && !matches(row, column, operator,
+                                                   where))) {
+      continue;
+    }
+    expected++;
+    if (set == NULL) {
+      row->live = false;
+    } else if (strcmp(set, "name") == 0) {
+      snprintf(row->name, sizeof(row->name), "%s", value);
+    } else {
+      row->qty = atoi(value);
+    }
+  }
+
+  struct EXPR* whereExpr = (column != NULL) ? &expr : NULL;
+  long count = (set != NULL)
+                   ? modify_update(db, table, set, value, whereExpr)
+                   : modify_delete(db, table, whereExpr);
+  if (count != expected) {
+    printf("**Error: %s: %ld records, expected %ld\n", step, count, expected);
+    return false;
+  }
+  return check(db, table, step);
+}
+
+int main() {
+  static struct ColumnMeta columns[] = {
+      {"id", COL_TYPE_INT, COL_UNIQUE_INDEXED},
+      {"name", COL_TYPE_STRING, COL_INDEXED},
+      {"qty", COL_TYPE_INT, COL_NON_INDEXED}};
+
+  char dir[] = "/tmp/modify_testXXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    printf("**Error: unable to create a temporary directory\n");
+    return 1;
+  }
+
+  struct TableMeta table;
+  memset(&table, 0, sizeof(table));
+  table.name = "items";
+  table.recordSize = TEST_RECORD_SIZE;
+  table.numColumns = 3;
+  table.columns = columns;
+
+  struct Database db;
+  memset(&db, 0, sizeof(db));
+  db.name = dir;
+  db.numTables = 1;
+  db.tables = &table;
+  schemamap_build(&db);
+
+  numRows = TEST_RECORDS;
+  for (int r = 0; r < TEST_RECORDS; r++) {
+    rows[r].id = r;
+    snprintf(rows[r].name, sizeof(rows[r].name), "n%d", r % 10);
+    rows[r].qty = r % 100;
+    rows[r].live = true;
+  }
+  if (!writeTable(&db, &table)) {
+    printf("**Error: unable to write the test table\n");
+    removeDirectory(dir);
+    return 1;
+  }
+
+  int failures = 0;
+  int steps = 0;
+
+  //
+  // updates by scanning, through the unique index, and through the
+  // index of a string column; then deletes of a tenth of the table
+  // through an index, which leave the deleted records in place:
+  //
+  failures += !run(&db, &table, "qty", "0", "qty", EXPR_GTE, "90");
+  failures += !run(&db, &table, "name", "renamed", "id", EXPR_EQUAL, "17");
+  failures += !run(&db, &table, "qty", "5", "name", EXPR_EQUAL, "n3");
+  failures += !run(&db, &table, NULL, NULL, "id", EXPR_LT, "40");
+  steps += 4;
+
+  //
+  // compacting drops them:
+  //
+  modify_waitForCompaction();
+  steps++;
+  if (!modify_compact(&db, &table)) {
+    printf("**Error: unable to compact the table\n");
+    failures++;
+  } else {
+    compact();
+    failures += !check(&db, &table, "compact");
+  }
+
+  //
+  // deleting more than MODIFY_COMPACT_THRESHOLD of the table by
+  // scanning compacts it in the background; the indexes must then
+  // find the records at their new record numbers:
+  //
+  failures += !run(&db, &table, NULL, NULL, "qty", EXPR_LT, "30");
+  modify_waitForCompaction();
+  compact();
+  failures += !check(&db, &table, "background compaction");
+  failures += !run(&db, &table, "qty", "77", "id", EXPR_EQUAL, "250");
+  failures += !run(&db, &table, "qty", "78", "id", EXPR_GT, "390");
+  failures += !run(&db, &table, NULL, NULL, "name", EXPR_EQUAL, "n7");
+  failures += !run(&db, &table, "qty", "79", "name", EXPR_EQUAL, "renamed");
+  steps += 6;
+
+  //
+  // and deleting every record leaves an empty table:
+  //
+  failures += !run(&db, &table, NULL, NULL, NULL, 0, NULL);
+  modify_waitForCompaction();
+  compact();
+  failures += !check(&db, &table, "empty");
+  steps += 2;
+
+  wal_waitForCheckpoint();
+  removeDirectory(dir);
+  schemamap_destroy(&db);
+
+  if (failures > 0) {
+    printf("modify: %d of %d steps FAILED\n", failures, steps);
+    return 1;
+  }
+  printf("modify: %d steps over %d records OK\n", steps, TEST_RECORDS);
+  return 0;
+}
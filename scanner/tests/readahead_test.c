@@ -0,0 +1,169 @@
+/*readahead_test.c*/
+
+//
+// Test of the read-ahead ring: scans a file of many chunks over and
+// over, with a reader that runs both ahead of and behind the caller,
+// and checks every scan returns each byte of the range exactly once,
+// in order.
+//
+// Build and run from the scanner directory:
+//
+//   gcc -O2 -pthread -I. tests/readahead_test.c readahead.c util.c
+//     -o readahead_test && ./readahead_test
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "readahead.h"
+
+#define TEST_RECORD_SIZE 100
+#define TEST_NUM_RECORDS (20 * 1024 * 1024 / TEST_RECORD_SIZE + 7)
+#define TEST_NUM_SCANS   500
+
+//
+// byteAt
+//
+// The byte at the given position of the test file.
+//
+static char byteAt(long position) {
+  return (char)((position * 31 + position / 4096) & 0xFF);
+}
+
+//
+// makeFile
+//
+// Writes the test file and returns it open for reading, or -1.
+//
+static int makeFile(char* path, long size) {
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    return -1;
+  }
+
+  char buffer[4096];
+  for (long position = 0; position < size; position += sizeof(buffer)) {
+    long n = size - position;
+    if (n > (long)sizeof(buffer)) {
+      n = sizeof(buffer);
+    }
+    for (long i = 0; i < n; i++) {
+      buffer[i] = byteAt(position + i);
+    }
+    if (write(fd, buffer, n) != n) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+//
+// scan
+//
+// Scans [offset, offset + length) of the file; every `slow` chunks
+// the caller dawdles, so the reader catches up and waits for a
+// buffer. Returns false, having said why, if the bytes returned are
+// not the range.
+//
+static bool scan(int fd, long offset, long length, int slow, int run) {
+  struct ReadAhead* ra = readahead_start(fd, offset, length,
+                                         TEST_RECORD_SIZE);
+  long total = 0;
+  long chunks = 0;
+  char* chunk;
+  long n;
+  bool ok = true;
+
+  while ((chunk = readahead_next(ra, &n)) != NULL) {
+    if (n % TEST_RECORD_SIZE != 0) {
+      printf("**Error: scan %d: chunk %ld of %ld bytes is not whole records\n",
+             run, chunks, n);
+      ok = false;
+      break;
+    }
+    for (long i = 0; i < n; i += 997) {
+      if (chunk[i] != byteAt(offset + total + i)) {
+        printf("**Error: scan %d: wrong byte at %ld\n", run,
+               offset + total + i);
+        ok = false;
+        break;
+      }
+    }
+    if (!ok) {
+      break;
+    }
+    total += n;
+    chunks++;
+    if (slow > 0 && chunks % slow == 0) {
+      usleep(200);
+    }
+  }
+
+  struct ReadAheadStats stats;
+  memset(&stats, 0, sizeof(stats));
+  readahead_finish(ra, &stats);
+
+  if (ok && (total != length || stats.bytesRead != length)) {
+    printf("**Error: scan %d: read %ld bytes in %ld chunks, expected %ld\n",
+           run, total, chunks, length);
+    ok = false;
+  }
+  return ok;
+}
+
+int main() {
+  char path[] = "/tmp/readahead_testXXXXXX";
+  int tmp = mkstemp(path);
+  if (tmp < 0) {
+    printf("**Error: unable to create test file\n");
+    return 1;
+  }
+  close(tmp);
+
+  long size = (long)TEST_NUM_RECORDS * TEST_RECORD_SIZE;
+  int fd = makeFile(path, size);
+  unlink(path);
+  if (fd < 0) {
+    printf("**Error: unable to write test file\n");
+    return 1;
+  }
+
+  int failures = 0;
+  for (int run = 0; run < TEST_NUM_SCANS; run++) {
+    //
+    // the whole file, and ranges starting at a record within it that
+    // end short of a whole chunk:
+    //
+    long offset = (run % 3 == 0) ? 0 : (long)(run % 17) * TEST_RECORD_SIZE;
+    long length = size - offset - (long)(run % 5) * TEST_RECORD_SIZE;
+    if (!scan(fd, offset, length, run % 4, run)) {
+      failures++;
+    }
+  }
+
+  //
+  // an empty range returns no chunks:
+  //
+  if (!scan(fd, size, 0, 0, TEST_NUM_SCANS)) {
+    failures++;
+  }
+
+  close(fd);
+
+  if (failures > 0) {
+    printf("readahead: %d of %d scans FAILED\n", failures,
+           TEST_NUM_SCANS + 1);
+    return 1;
+  }
+  printf("readahead: %d scans of %ld bytes OK\n", TEST_NUM_SCANS + 1, size);
+  return 0;
+}
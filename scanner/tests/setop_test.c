@@ -0,0 +1,391 @@
+/*setop_test.c*/
+
+//
+// Test of UNION, UNION ALL and INTERSECT: runs each over two pairs
+// of tables, selecting two columns, which hashes the rows, one
+// indexed column, which merges the two indexes, and two columns
+// with a WHERE clause, and checks the rows written in the csv
+// format against the rows computed here. The first pair of tables
+// is small enough for the hash table; the second is not, so its
+// rows are spilled to partitions, and split again once more.
+//
+// The tables are written to a temporary directory, which is removed
+// at the end. Build and run from the scanner directory, next to the
+// rest of the project's sources, with a small hash table:
+//
+//   gcc -O2 -pthread -I. -DSETOP_MEMORY_BYTES=65536 tests/setop_test.c
+//     $(ls *.c | grep -v Schema_and_AST_Output.c) -lm -o setop_test
+//     && ./setop_test
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "database.h"
+#include "schemamap.h"
+#include "setop.h"
+#include "tablefile.h"
+#include "util.h"
+
+#define TEST_RECORD_SIZE 24
+
+//
+// a test table: record i is "k 's<k % 3>'", k = (i * multiplier) %
+// modulus + offset, so keys repeat and the tables of a pair overlap:
+//
+struct TestTable
+{
+  char* name;
+  long  numRecords;
+  long  multiplier;
+  long  modulus;
+  long  offset;
+};
+
+static struct TestTable testTables[] = {{"a", 60, 7, 40, 0},
+                                        {"b", 50, 3, 45, 10},
+                                        {"c", 40000, 7919, 30000, 0},
+                                        {"d", 30000, 13, 25000, 10000}};
+
+#define TEST_NUM_TABLES 4
+
+static int keyOf(struct TestTable* t, long i) {
+  return (int)((i * t->multiplier) % t->modulus + t->offset);
+}
+
+//
+// removeDirectory
+//
+// Removes the temporary directory, with the data files and whatever
+// sidecar files were built next to them.
+//
+static void removeDirectory(char* dir) {
+  DIR* d = opendir(dir);
+  if (d != NULL) {
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+        continue;
+      }
+      char path[TABLEFILE_MAX_PATH];
+      snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+      unlink(path);
+    }
+    closedir(d);
+  }
+  rmdir(dir);
+}
+
+//
+// writeTable
+//
+// Writes the records of the test table to its data file; returns
+// false on error.
+//
+static bool writeTable(struct Database* db, struct TableMeta* table,
+                       struct TestTable* t) {
+  char path[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", path);
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  bool ok = true;
+  char record[TEST_RECORD_SIZE];
+  for (long i = 0; ok && i < t->numRecords; i++) {
+    char k[16], s[16];
+    snprintf(k, sizeof(k), "%d", keyOf(t, i));
+    snprintf(s, sizeof(s), "s%d", keyOf(t, i) % 3);
+    char* values[] = {k, s};
+    ok = tablefile_formatRecord(table, values, record) &&
+         tablefile_write(fd, record, sizeof(record));
+  }
+
+  close(fd);
+  return ok;
+}
+
+static int compareRows(const void* a, const void* b) {
+  return strcmp(*(char**)a, *(char**)b);
+}
+
+//
+// distinct
+//
+// Sorts the rows and drops the duplicates; returns how many are left.
+//
+static long distinct(char* rows[], long n) {
+  qsort(rows, n, sizeof(char*), compareRows);
+  long m = 0;
+  for (long i = 0; i < n; i++) {
+    if (m > 0 && strcmp(rows[m - 1], rows[i]) == 0) {
+      free(rows[i]);
+    } else {
+      rows[m++] = rows[i];
+    }
+  }
+  return m;
+}
+
+//
+// selectRows
+//
+// Appends the rows "SELECT k[, s] FROM t [WHERE k < below]" to
+// rows[*n...], below < 0 meaning no WHERE clause.
+//
+static void selectRows(struct TestTable* t, int numColumns, int below,
+                       char* rows[], long* n) {
+  for (long i = 0; i < t->numRecords; i++) {
+    int k = keyOf(t, i);
+    if (below >= 0 && k >= below) {
+      continue;
+    }
+    char row[32];
+    if (numColumns == 1) {
+      snprintf(row, sizeof(row), "%d", k);
+    } else {
+      snprintf(row, sizeof(row), "%d,s%d", k, k % 3);
+    }
+    rows[(*n)++] = strdup(row);
+  }
+}
+
+//
+// expectedRows
+//
+// The rows of "left <op> right", sorted; returns how many.
+//
+static long expectedRows(int op, struct TestTable* left,
+                         struct TestTable* right, int numColumns, int below,
+                         char* rows[]) {
+  long n = 0;
+  selectRows(left, numColumns, below, rows, &n);
+  long numLeft = n;
+  selectRows(right, numColumns, -1, rows, &n);
+
+  if (op == SETOP_UNION_ALL) {
+    qsort(rows, n, sizeof(char*), compareRows);
+    return n;
+  } else if (op == SETOP_UNION) {
+    return distinct(rows, n);
+  }
+
+  long numRight = distinct(rows + numLeft, n - numLeft);
+  char** rightRows = rows + numLeft;
+  long m = 0;
+  for (long i = 0; i < numLeft; i++) {
+    if (bsearch(&rows[i], rightRows, numRight, sizeof(char*), compareRows) !=
+        NULL) {
+      rows[m++] = rows[i];
+    } else {
+      free(rows[i]);
+    }
+  }
+  for (long i = 0; i < numRight; i++) {
+    free(rightRows[i]);
+  }
+  return distinct(rows, m);
+}
+
+//
+// run
+//
+// Runs "SELECT k[, s] FROM left [WHERE k < below] <op> SELECT k[, s]
+// FROM right" in the csv format, and checks its rows; returns false,
+// having said why, if they are wrong.
+//
+static bool run(struct Database* db, int op, struct TestTable* left,
+                struct TestTable* right, int numColumns, int below) {
+  static char* opNames[] = {"UNION", "UNION ALL", "INTERSECT"};
+  char step[128];
+  snprintf(step, sizeof(step), "%s %s %s, %d column%s%s", left->name,
+           opNames[op], right->name, numColumns, (numColumns > 1) ? "s" : "",
+           (below >= 0) ? ", where" : "");
+
+  struct COLUMN columns[2][2];
+  struct SELECT selects[2];
+  struct TestTable* tables[2] = {left, right};
+  for (int q = 0; q < 2; q++) {
+    memset(columns[q], 0, sizeof(columns[q]));
+    columns[q][0].table = tables[q]->name;
+    columns[q][0].name = "k";
+    columns[q][1].table = tables[q]->name;
+    columns[q][1].name = "s";
+    if (numColumns > 1) {
+      columns[q][0].next = &columns[q][1];
+    }
+    memset(&selects[q], 0, sizeof(selects[q]));
+    selects[q].table = tables[q]->name;
+    selects[q].columns = columns[q];
+  }
+
+  char value[16];
+  snprintf(value, sizeof(value), "%d", below);
+  struct EXPR expr;
+  memset(&expr, 0, sizeof(expr));
+  expr.column = &columns[0][0];
+  expr.operator = EXPR_LT;
+  expr.value = value;
+  expr.litType = INTEGER_LITERAL;
+  struct WHERE where;
+  where.expr = &expr;
+  if (below >= 0) {
+    selects[0].where = &where;
+  }
+
+  //
+  // the output goes to a temporary file, read back below:
+  //
+  char path[] = "/tmp/setop_test_outputXXXXXX";
+  int output = mkstemp(path);
+  if (output < 0) {
+    panic("unable to create the test's output file");
+  }
+  unlink(path);
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  dup2(output, STDOUT_FILENO);
+  setop_execute(db, &selects[0], &selects[1], op);
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+
+  long capacity = left->numRecords + right->numRecords + 1;
+  char** expected = (char**)malloc(sizeof(char*) * capacity);
+  char** actual = (char**)malloc(sizeof(char*) * capacity);
+  if (expected == NULL || actual == NULL) {
+    panic("No memory");
+  }
+  long numExpected = expectedRows(op, left, right, numColumns, below, expected);
+
+  bool ok = true;
+  long numActual = 0;
+  bool sorted = true;
+  char line[64];
+  FILE* input = fdopen(output, "r");
+  rewind(input);
+  if (fgets(line, sizeof(line), input) == NULL ||
+      strcmp(line, (numColumns > 1) ? "k,s\n" : "k\n") != 0) {
+    printf("**Error: %s: wrong header\n", step);
+    ok = false;
+  }
+  while (ok && fgets(line, sizeof(line), input) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+    if (numActual == capacity) {
+      printf("**Error: %s: more than %ld rows\n", step, capacity);
+      ok = false;
+      break;
+    }
+    if (numActual > 0 && atoi(line) < atoi(actual[numActual - 1])) {
+      sorted = false;
+    }
+    actual[numActual++] = strdup(line);
+  }
+  fclose(input);
+
+  //
+  // merging the indexes outputs the keys in order:
+  //
+  if (ok && numColumns == 1 && below < 0 && op != SETOP_UNION_ALL &&
+      !sorted) {
+    printf("**Error: %s: the merged keys are not in order\n", step);
+    ok = false;
+  }
+
+  qsort(actual, numActual, sizeof(char*), compareRows);
+  if (ok && numActual != numExpected) {
+    printf("**Error: %s: %ld rows, expected %ld\n", step, numActual,
+           numExpected);
+    ok = false;
+  }
+  for (long i = 0; ok && i < numActual; i++) {
+    if (strcmp(actual[i], expected[i]) != 0) {
+      printf("**Error: %s: row '%s', expected '%s'\n", step, actual[i],
+             expected[i]);
+      ok = false;
+    }
+  }
+
+  for (long i = 0; i < numActual; i++) {
+    free(actual[i]);
+  }
+  for (long i = 0; i < numExpected; i++) {
+    free(expected[i]);
+  }
+  free(actual);
+  free(expected);
+  return ok;
+}
+
+int main() {
+  static struct ColumnMeta columns[] = {{"k", COL_TYPE_INT, COL_INDEXED},
+                                        {"s", COL_TYPE_STRING, COL_NON_INDEXED}};
+
+  char dir[] = "/tmp/setop_testXXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    printf("**Error: unable to create a temporary directory\n");
+    return 1;
+  }
+
+  struct TableMeta tables[TEST_NUM_TABLES];
+  memset(tables, 0, sizeof(tables));
+  for (int t = 0; t < TEST_NUM_TABLES; t++) {
+    tables[t].name = testTables[t].name;
+    tables[t].recordSize = TEST_RECORD_SIZE;
+    tables[t].numColumns = 2;
+    tables[t].columns = columns;
+  }
+
+  struct Database db;
+  memset(&db, 0, sizeof(db));
+  db.name = dir;
+  db.numTables = TEST_NUM_TABLES;
+  db.tables = tables;
+  schemamap_build(&db);
+
+  for (int t = 0; t < TEST_NUM_TABLES; t++) {
+    if (!writeTable(&db, &tables[t], &testTables[t])) {
+      printf("**Error: unable to write test table '%s'\n", tables[t].name);
+      removeDirectory(dir);
+      return 1;
+    }
+  }
+
+  setenv("SIMPLESQL_FORMAT", "csv", 1);
+
+  int failures = 0;
+  int runs = 0;
+  for (int pair = 0; pair < 2; pair++) {
+    struct TestTable* left = &testTables[2 * pair];
+    struct TestTable* right = &testTables[2 * pair + 1];
+    int below = (int)(left->modulus / 2);
+
+    for (int op = SETOP_UNION; op <= SETOP_INTERSECT; op++) {
+      failures += !run(&db, op, left, right, 2, -1);
+      failures += !run(&db, op, left, right, 1, -1);
+      failures += !run(&db, op, left, right, 2, below);
+      runs += 3;
+    }
+  }
+
+  removeDirectory(dir);
+  schemamap_destroy(&db);
+
+  if (failures > 0) {
+    printf("setop: %d of %d queries FAILED\n", failures, runs);
+    return 1;
+  }
+  printf("setop: %d queries OK\n", runs);
+  return 0;
+}
@@ -0,0 +1,595 @@
+/*wal.c*/
+
+//
+// Write-ahead log for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "database.h"
+#include "matview.h"
+#include "schemamap.h"
+#include "tablefile.h"
+#include "util.h"
+#include "wal.h"
+
+#define WAL_MAGIC   0x314c4157u  // "WAL1"
+#define WAL_ABORTED 0x414c4157u  // "WALA", an entry wal_abort() undid
+
+//
+// log format: per transaction an entry header, then numWrites
+// writes, each a WalWrite followed by its bytes; the checksum is
+// over everything after the header
+//
+struct WalEntryHeader
+{
+  unsigned int  magic;
+  int           numWrites;
+  long          length;  // bytes after the header
+  unsigned long checksum;
+};
+
+struct WalWrite
+{
+  char table[DATABASE_MAX_ID_LENGTH + 1];
+  long offset;
+  long length;
+};
+
+//
+// a log, as seen by one process: entries it appended are numbered
+// from 1, and the ones up to numSynced are durable
+//
+struct Wal
+{
+  struct Database* db;  // NULL until the first transaction
+  char   path[TABLEFILE_MAX_PATH];
+  int    fd;            // O_APPEND, -1 until opened
+  pid_t  pid;           // that opened fd; a forked child reopens
+  pthread_mutex_t lock;
+  pthread_cond_t  changed;
+  long   numWritten;
+  long   numSynced;
+  long   numSyncs;
+  bool   syncing;       // a writer is in fdatasync
+  int    numActive;     // transactions begun and not ended
+  bool   checkpointing;
+  bool   checkpointStarted;  // the background checkpoint is running
+  bool   checkpointJoinable; // checkpointer has not been joined yet
+  pthread_t checkpointer;
+};
+
+static struct Wal dbWal = {.fd = -1,
+                           .lock = PTHREAD_MUTEX_INITIALIZER,
+                           .changed = PTHREAD_COND_INITIALIZER};
+
+// serializes starting and joining the background checkpoint, which
+// must not be done under dbWal.lock: the thread takes that lock
+static pthread_mutex_t checkpointerLock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long checksum(char* bytes, long length) {
+  unsigned long h = 14695981039346656037ul;
+
+  for (long i = 0; i < length; i++) {
+    h ^= (unsigned char)bytes[i];
+    h *= 1099511628211ul;
+  }
+  return h;
+}
+
+static bool pwriteAll(int fd, char* bytes, long length, off_t offset) {
+  while (length > 0) {
+    ssize_t n = pwrite(fd, bytes, length, offset);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += n;
+    length -= n;
+    offset += n;
+  }
+  return true;
+}
+
+//
+// walOpen
+//
+// Opens the log for appending if this process has not yet; must be
+// called with wal->lock held.
+//
+static void walOpen(struct Wal* wal) {
+  if (wal->fd >= 0 && wal->pid == getpid()) {
+    return;
+  }
+  if (wal->fd >= 0) {
+    // inherited across fork(): the parent's flock() is on that file
+    close(wal->fd);
+  }
+
+  wal->fd = open(wal->path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (wal->fd < 0) {
+    printf("**Error: unable to open write-ahead log '%s'\n", wal->path);
+    panic("stop execution");
+  }
+  wal->pid = getpid();
+  wal->numWritten = 0;
+  wal->numSynced = 0;
+  wal->numSyncs = 0;
+  wal->syncing = false;
+  wal->numActive = 0;
+  wal->checkpointing = false;
+  wal->checkpointStarted = false;
+  wal->checkpointJoinable = false;  // a parent's thread is not ours
+}
+
+static struct WalTxn* txnBegin(struct Wal* wal) {
+  pthread_mutex_lock(&wal->lock);
+  walOpen(wal);
+
+  while (wal->checkpointing) {
+    pthread_cond_wait(&wal->changed, &wal->lock);
+  }
+  // the first transaction of the process holds off the checkpoints
+  // of other processes until the last one ends
+  if (wal->numActive++ == 0) {
+    flock(wal->fd, LOCK_SH);
+  }
+
+  pthread_mutex_unlock(&wal->lock);
+
+  struct WalTxn* txn = (struct WalTxn*)malloc(sizeof(struct WalTxn));
+  if (txn == NULL) {
+    panic("No memory");
+  }
+  txn->wal = wal;
+  txn->capacity = 4096;
+  txn->buffer = (char*)malloc(txn->capacity);
+  if (txn->buffer == NULL) {
+    panic("No memory");
+  }
+  txn->length = sizeof(struct WalEntryHeader);
+  txn->offset = -1;
+  txn->numWrites = 0;
+  return txn;
+}
+
+struct WalTxn* wal_begin(struct Database* db) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  pthread_mutex_lock(&dbWal.lock);
+  if (dbWal.db == NULL) {
+    dbWal.db = db;
+    snprintf(dbWal.path, sizeof(dbWal.path), "%s/%s", db->name, WAL_FILE);
+  }
+  pthread_mutex_unlock(&dbWal.lock);
+
+  return txnBegin(&dbWal);
+}
+
+static void txnWrite(struct WalTxn* txn, char* tableName, off_t offset,
+                     char* bytes, long length) {
+  long needed = txn->length + (long)sizeof(struct WalWrite) + length;
+
+  if (needed > txn->capacity) {
+    while (needed > txn->capacity) {
+      txn->capacity *= 2;
+    }
+    txn->buffer = (char*)realloc(txn->buffer, txn->capacity);
+    if (txn->buffer == NULL) {
+      panic("No memory");
+    }
+  }
+
+  struct WalWrite w;
+  memset(&w, 0, sizeof(w));
+  snprintf(w.table, sizeof(w.table), "%s", tableName);
+  w.offset = (long)offset;
+  w.length = length;
+
+  memcpy(txn->buffer + txn->length, &w, sizeof(w));
+  memcpy(txn->buffer + txn->length + sizeof(w), bytes, length);
+  txn->length = needed;
+  txn->numWrites++;
+}
+
+void wal_write(struct WalTxn* txn, struct TableMeta* table, off_t offset,
+               char* bytes, long length) {
+  txnWrite(txn, table->name, offset, bytes, length);
+}
+
+bool wal_commit(struct WalTxn* txn) {
+  struct Wal* wal = txn->wal;
+
+  struct WalEntryHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = WAL_MAGIC;
+  header.numWrites = txn->numWrites;
+  header.length = txn->length - (long)sizeof(header);
+  header.checksum = checksum(txn->buffer + sizeof(header), header.length);
+  memcpy(txn->buffer, &header, sizeof(header));
+
+  pthread_mutex_lock(&wal->lock);
+
+  //
+  // one write per entry, under the lock, so entries never
+  // interleave; a failed write is cut off again, or recovery would
+  // stop at it and miss the entries after it
+  //
+  off_t end = lseek(wal->fd, 0, SEEK_END);
+  bool ok = (end >= 0) && tablefile_write(wal->fd, txn->buffer, txn->length);
+  if (!ok) {
+    if (end >= 0 && ftruncate(wal->fd, end) < 0) {
+      panic("unable to repair the write-ahead log");
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return false;
+  }
+  long ticket = ++wal->numWritten;
+  txn->offset = end;
+
+  //
+  // group commit: the first writer to find no sync in progress
+  // syncs for every entry appended so far; the others wait for a
+  // sync that covers theirs
+  //
+  while (ok && wal->numSynced < ticket) {
+    if (wal->syncing) {
+      pthread_cond_wait(&wal->changed, &wal->lock);
+      continue;
+    }
+
+    wal->syncing = true;
+    long target = wal->numWritten;
+    pthread_mutex_unlock(&wal->lock);
+
+    bool synced = (fdatasync(wal->fd) == 0);
+
+    pthread_mutex_lock(&wal->lock);
+    wal->syncing = false;
+    if (synced) {
+      wal->numSynced = target;
+      wal->numSyncs++;
+    } else {
+      ok = false;
+    }
+    pthread_cond_broadcast(&wal->changed);
+  }
+
+  pthread_mutex_unlock(&wal->lock);
+  return ok;
+}
+
+bool wal_abort(struct WalTxn* txn) {
+  struct Wal* wal = txn->wal;
+
+  //
+  // the transaction has not ended, so no checkpoint has emptied the
+  // log since it was committed; the log's own descriptor is
+  // O_APPEND, which pwrite() would append with
+  //
+  int fd = open(wal->path, O_WRONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  unsigned int magic = WAL_ABORTED;
+  bool ok = pwriteAll(fd, (char*)&magic, sizeof(magic), txn->offset) &&
+            (fdatasync(fd) == 0);
+  close(fd);
+  return ok;
+}
+
+bool wal_apply(struct WalTxn* txn, struct TableMeta* table, int fd) {
+  char* cp = txn->buffer + sizeof(struct WalEntryHeader);
+
+  for (int i = 0; i < txn->numWrites; i++) {
+    struct WalWrite w;
+    memcpy(&w, cp, sizeof(w));
+    cp += sizeof(w);
+
+    if (strcmp(w.table, table->name) == 0 &&
+        !pwriteAll(fd, cp, w.length, (off_t)w.offset)) {
+      return false;
+    }
+    cp += w.length;
+  }
+  return true;
+}
+
+//
+// checkpoint
+//
+// Waits for the transactions in progress, in this process and then
+// in the others, fsyncs the data files and empties the log.
+//
+static bool checkpoint(struct Wal* wal) {
+  struct Database* db = wal->db;
+
+  pthread_mutex_lock(&wal->lock);
+  walOpen(wal);
+  while (wal->checkpointing) {
+    pthread_cond_wait(&wal->changed, &wal->lock);
+  }
+  wal->checkpointing = true;
+  while (wal->numActive > 0) {
+    pthread_cond_wait(&wal->changed, &wal->lock);
+  }
+  pthread_mutex_unlock(&wal->lock);
+
+  // a separate open file, so the lock conflicts with our own
+  // process's LOCK_SH as well as everyone else's
+  int lockfd = open(wal->path, O_RDONLY);
+  if (lockfd >= 0) {
+    flock(lockfd, LOCK_EX);
+  }
+
+  bool ok = true;
+  for (int i = 0; i < db->numTables; i++) {
+    char datapath[TABLEFILE_MAX_PATH];
+    tablefile_path(db, &db->tables[i], ".data", datapath);
+
+    int fd = open(datapath, O_RDONLY);
+    if (fd >= 0) {
+      ok = (fsync(fd) == 0) && ok;
+      close(fd);
+    }
+  }
+  if (ok) {
+    ok = (ftruncate(wal->fd, 0) == 0) && (fdatasync(wal->fd) == 0);
+  }
+
+  if (lockfd >= 0) {
+    flock(lockfd, LOCK_UN);
+    close(lockfd);
+  }
+
+  pthread_mutex_lock(&wal->lock);
+  wal->checkpointing = false;
+  pthread_cond_broadcast(&wal->changed);
+  pthread_mutex_unlock(&wal->lock);
+  return ok;
+}
+
+static void* checkpointThread(void* arg) {
+  struct Wal* wal = (struct Wal*)arg;
+
+  checkpoint(wal);
+
+  pthread_mutex_lock(&wal->lock);
+  wal->checkpointStarted = false;
+  pthread_mutex_unlock(&wal->lock);
+  return NULL;
+}
+
+void wal_end(struct WalTxn* txn) {
+  if (txn == NULL) {
+    return;
+  }
+  struct Wal* wal = txn->wal;
+
+  pthread_mutex_lock(&wal->lock);
+
+  if (--wal->numActive == 0) {
+    flock(wal->fd, LOCK_UN);
+    pthread_cond_broadcast(&wal->changed);
+  }
+
+  bool start = false;
+  struct stat info;
+  if (wal->db != NULL && !wal->checkpointStarted &&
+      fstat(wal->fd, &info) == 0 && info.st_size > WAL_CHECKPOINT_BYTES) {
+    wal->checkpointStarted = true;
+    start = true;
+  }
+
+  pthread_mutex_unlock(&wal->lock);
+
+  if (start) {
+    //
+    // the thread is joined, by the next one started or by
+    // wal_waitForCheckpoint(), so the program can wait for it before
+    // the schema it walks is changed or freed
+    //
+    pthread_mutex_lock(&checkpointerLock);
+    if (wal->checkpointJoinable) {
+      pthread_join(wal->checkpointer, NULL);  // has finished, or is about to
+      wal->checkpointJoinable = false;
+    }
+    if (pthread_create(&wal->checkpointer, NULL, checkpointThread, wal) == 0) {
+      wal->checkpointJoinable = true;
+    } else {
+      pthread_mutex_lock(&wal->lock);
+      wal->checkpointStarted = false;
+      pthread_mutex_unlock(&wal->lock);
+    }
+    pthread_mutex_unlock(&checkpointerLock);
+  }
+
+  free(txn->buffer);
+  free(txn);
+}
+
+void wal_waitForCheckpoint(void) {
+  pthread_mutex_lock(&checkpointerLock);
+
+  // after a fork(), the thread belongs to the parent
+  if (dbWal.checkpointJoinable && dbWal.pid == getpid()) {
+    pthread_join(dbWal.checkpointer, NULL);
+    dbWal.checkpointJoinable = false;
+  }
+
+  pthread_mutex_unlock(&checkpointerLock);
+}
+
+bool wal_checkpoint(struct Database* db) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  pthread_mutex_lock(&dbWal.lock);
+  if (dbWal.db == NULL) {
+    dbWal.db = db;
+    snprintf(dbWal.path, sizeof(dbWal.path), "%s/%s", db->name, WAL_FILE);
+  }
+  pthread_mutex_unlock(&dbWal.lock);
+
+  return checkpoint(&dbWal);
+}
+
+//
+// replayWrite
+//
+// Writes the bytes at the offset of the table's data file unless
+// they are there already, so that replaying a log whose writes all
+// reached the data files leaves the files, and the sidecar files
+// checked against their modification times, alone. Sets *changed if
+// it wrote.
+//
+static bool replayWrite(int fd, char* bytes, long length, off_t offset,
+                        bool* changed) {
+  char* current = (char*)malloc(length + 1);
+  if (current == NULL) {
+    panic("No memory");
+  }
+
+  bool same = (pread(fd, current, length, offset) == length) &&
+              memcmp(current, bytes, length) == 0;
+  free(current);
+
+  if (same) {
+    return true;
+  }
+  *changed = true;
+  return pwriteAll(fd, bytes, length, offset);
+}
+
+long wal_recover(struct Database* db) {
+  if (db == NULL) {
+    panic("database is NULL");
+  }
+
+  char path[TABLEFILE_MAX_PATH];
+  snprintf(path, sizeof(path), "%s/%s", db->name, WAL_FILE);
+
+  FILE* input = fopen(path, "r");
+  if (input == NULL) {
+    if (errno == ENOENT) {
+      return 0;
+    }
+    printf("**Error: unable to read write-ahead log '%s'\n", path);
+    return -1;
+  }
+
+  int* fds = (int*)malloc(sizeof(int) * (db->numTables + 1));
+  bool* changed = (bool*)calloc(db->numTables + 1, sizeof(bool));
+  if (fds == NULL || changed == NULL) {
+    panic("No memory");
+  }
+  for (int i = 0; i < db->numTables; i++) {
+    fds[i] = -1;
+  }
+
+  //
+  // replay entries up to the first that is incomplete or fails its
+  // checksum, i.e. was being appended when the program stopped, and
+  // skip the aborted ones:
+  //
+  long numReplayed = 0;
+  bool empty = true;
+  bool ok = true;
+  struct WalEntryHeader header;
+  while (ok && fread(&header, sizeof(header), 1, input) == 1) {
+    empty = false;
+    if ((header.magic != WAL_MAGIC && header.magic != WAL_ABORTED) ||
+        header.numWrites < 0 || header.length < 0) {
+      break;
+    }
+    if (header.magic == WAL_ABORTED) {
+      if (fseek(input, header.length, SEEK_CUR) < 0) {
+        break;
+      }
+      continue;
+    }
+
+    char* entry = (char*)malloc(header.length + 1);
+    if (entry == NULL) {
+      panic("No memory");
+    }
+    if (fread(entry, 1, header.length, input) != (size_t)header.length ||
+        checksum(entry, header.length) != header.checksum) {
+      free(entry);
+      break;
+    }
+
+    char* cp = entry;
+    for (int i = 0; ok && i < header.numWrites; i++) {
+      struct WalWrite w;
+      memcpy(&w, cp, sizeof(w));
+      cp += sizeof(w);
+      w.table[DATABASE_MAX_ID_LENGTH] = '\0';
+
+      struct TableMeta* table = database_findTable(db, w.table);
+      if (table != NULL) {
+        int t = (int)(table - db->tables);
+        if (fds[t] < 0) {
+          char datapath[TABLEFILE_MAX_PATH];
+          tablefile_path(db, table, ".data", datapath);
+          fds[t] = open(datapath, O_RDWR | O_CREAT, 0644);
+        }
+        ok = (fds[t] >= 0) &&
+             replayWrite(fds[t], cp, w.length, (off_t)w.offset, &changed[t]);
+      }
+      cp += w.length;
+    }
+    free(entry);
+    numReplayed++;
+  }
+  fclose(input);
+
+  for (int i = 0; i < db->numTables; i++) {
+    if (fds[i] >= 0) {
+      ok = (fsync(fds[i]) == 0) && ok;
+      close(fds[i]);
+    }
+    if (changed[i]) {
+      // views were folded from the data before the crash
+      matview_invalidate(db, &db->tables[i]);
+    }
+  }
+  free(changed);
+  free(fds);
+
+  if (!ok) {
+    printf("**Error: unable to recover from write-ahead log '%s'\n", path);
+    return -1;
+  }
+  if (!empty && truncate(path, 0) < 0) {
+    printf("**Error: unable to empty write-ahead log '%s'\n", path);
+    return -1;
+  }
+  return numReplayed;
+}
+
+long wal_numSyncs(void) {
+  pthread_mutex_lock(&dbWal.lock);
+  long numSyncs = (dbWal.pid == getpid()) ? dbWal.numSyncs : 0;
+  pthread_mutex_unlock(&dbWal.lock);
+  return numSyncs;
+}
@@ -0,0 +1,148 @@
+/*wal.h*/
+
+//
+// Write-ahead log for SimpleSQL. A write statement (the records of
+// an insert batch, an UPDATE, a DELETE) collects the bytes it will
+// write into the tables' data files, at their offsets, in a
+// transaction; committing appends the transaction to the log,
+// "wal.log" next to the tables, and makes it durable with one
+// fdatasync. Only then are the bytes written to the data files,
+// without an fsync of their own.
+//
+// Group commit: while one writer is in fdatasync, the transactions
+// other writers append wait, and the next fdatasync makes them all
+// durable at once, so the cost of a sync is shared by every writer
+// committing at the same time.
+//
+// Checkpoint: once the log outgrows WAL_CHECKPOINT_BYTES, a
+// background thread waits for the transactions in progress (in every
+// process), fsyncs the data files and empties the log. Recovery,
+// when the database is opened, writes the committed transactions
+// in the log into the data files again; writes are of whole bytes at
+// fixed offsets, so writing one twice is harmless, and a transaction
+// torn by a crash fails its checksum and is ignored. A committed
+// transaction whose writes could not be made is marked aborted in
+// the log, and recovery skips it.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "database.h"
+
+#define WAL_FILE "wal.log"
+
+#define WAL_CHECKPOINT_BYTES (16 * 1024 * 1024)
+
+struct WalTxn
+{
+  struct Wal* wal;
+  char* buffer;    // the log entry being built
+  long  length;
+  long  capacity;
+  int   numWrites;
+  off_t offset;    // of the entry in the log, once committed
+};
+
+
+//
+// functions:
+//
+
+//
+// wal_begin
+//
+// Starts a transaction on the database's log, waiting for a
+// checkpoint, if one is running, to finish.
+//
+// NOTE: it is the callers responsibility to finish the transaction
+// by calling wal_end(), committed or not.
+//
+struct WalTxn* wal_begin(struct Database* db);
+
+//
+// wal_write
+//
+// Adds to the transaction the write of length bytes at the given
+// offset of the table's data file; the bytes are copied.
+//
+void wal_write(struct WalTxn* txn, struct TableMeta* table, off_t offset,
+               char* bytes, long length);
+
+//
+// wal_commit
+//
+// Appends the transaction to the log and waits until it is durable.
+// Returns false if the log cannot be written; the transaction's
+// writes must then not be applied.
+//
+bool wal_commit(struct WalTxn* txn);
+
+//
+// wal_abort
+//
+// Marks a committed transaction aborted, e.g. because its writes
+// failed, so that recovery does not make them after all. Returns
+// false if the log cannot be written.
+//
+bool wal_abort(struct WalTxn* txn);
+
+//
+// wal_apply
+//
+// Performs the transaction's writes to the table, whose data file
+// is open as fd (not in O_APPEND mode). Returns false if a write
+// fails.
+//
+bool wal_apply(struct WalTxn* txn, struct TableMeta* table, int fd);
+
+//
+// wal_end
+//
+// Frees the transaction, lets a checkpoint proceed, and starts one
+// in the background if the log has grown past WAL_CHECKPOINT_BYTES.
+//
+void wal_end(struct WalTxn* txn);
+
+//
+// wal_checkpoint
+//
+// Waits for the transactions in progress, fsyncs the data files of
+// the database and empties its log. Returns false if a data file
+// cannot be synced, in which case the log is kept.
+//
+bool wal_checkpoint(struct Database* db);
+
+//
+// wal_waitForCheckpoint
+//
+// Blocks until the background checkpoint, if one is running, has
+// finished. Call wherever modify_waitForCompaction() is called: the
+// checkpoint walks the tables of the schema.
+//
+void wal_waitForCheckpoint(void);
+
+//
+// wal_recover
+//
+// Writes the committed transactions in the database's log into the
+// data files, then checkpoints. Call this once, right after
+// schemamap_build(). Returns the number of transactions replayed,
+// or -1 if the log cannot be read.
+//
+long wal_recover(struct Database* db);
+
+//
+// wal_numSyncs
+//
+// Returns the number of fdatasyncs this process has made of the
+// log, e.g. to measure how many commits group commit makes durable
+// per sync.
+//
+long wal_numSyncs(void);
@@ -0,0 +1,605 @@
+/*zonemap.c*/
+
+//
+// Zone maps for SimpleSQL.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "bloom.h"
+#include "database.h"
+#include "rowkey.h"
+#include "tablefile.h"
+#include "util.h"
+#include "zonemap.h"
+
+#define ZONEMAP_MAGIC       "SQLZMAP4"
+#define ZONEMAP_BLOOM_MAGIC "SQLZBLM2"
+
+//
+// "<table>.zmap": the header, then the entries of every block;
+// "<table>.bloom": the header, padded to ZONEMAP_BLOOM_HEADER_BYTES,
+// then per block the filters of its columns, in column order. Both
+// files are updated in place, the header last: while the blocks are
+// being written, the magic is cleared, so a file a crash leaves
+// half-written is rebuilt rather than read. Both headers start with
+// the same fields, up to the data file's device and inode.
+//
+struct ZoneMapHeader
+{
+  char magic[8];
+  int  numColumns;
+  int  blockRecords;
+  unsigned long device;
+  unsigned long inode;
+  long numRecords;
+};
+
+struct BloomFileHeader
+{
+  char magic[8];
+  int  numColumns;
+  int  blockRecords;
+  unsigned long device;
+  unsigned long inode;
+  long numBlocks;
+  long bloomBits;
+};
+
+#define ZONEMAP_HEADER_PREFIX offsetof(struct ZoneMapHeader, numRecords)
+
+static struct ZoneMap* zonemap_create(int numColumns) {
+  struct ZoneMap* zm = (struct ZoneMap*)malloc(sizeof(struct ZoneMap));
+  if (zm == NULL) {
+    panic("No memory");
+  }
+
+  zm->numColumns = numColumns;
+  zm->blockRecords = ZONEMAP_BLOCK_RECORDS;
+  zm->numRecords = 0;
+  zm->numBlocks = 0;
+  zm->capacity = 0;
+  zm->entries = NULL;
+  zm->firstChanged = 0;
+  zm->bloomBits = ZONEMAP_BLOOM_BITS;
+  zm->mapped = NULL;
+  zm->mappedBytes = 0;
+  zm->numMapped = 0;
+  zm->changed = NULL;
+  zm->device = 0;
+  zm->inode = 0;
+  return zm;
+}
+
+//
+// blockBytes
+//
+// Bytes of the filters of one block, all columns.
+//
+static long blockBytes(struct ZoneMap* zm) {
+  return zm->bloomBits / 8 * zm->numColumns;
+}
+
+//
+// blockFilters
+//
+// The filters of the block, one per column, or NULL if no value of
+// the block has been added to them.
+//
+static unsigned long* blockFilters(struct ZoneMap* zm, long block) {
+  if (zm->changed[block] != NULL) {
+    return zm->changed[block];
+  }
+  if (block < zm->numMapped) {
+    return zm->mapped + (ZONEMAP_BLOOM_HEADER_BYTES + block * blockBytes(zm)) /
+                            sizeof(unsigned long);
+  }
+  return NULL;
+}
+
+//
+// grow
+//
+// Makes sure blocks [0, numBlocks) exist; new blocks start out
+// empty, i.e. min > max and no bits set.
+//
+static void grow(struct ZoneMap* zm, long numBlocks) {
+  if (numBlocks > zm->capacity) {
+    long capacity = (zm->capacity == 0) ? 16 : zm->capacity;
+    while (capacity < numBlocks) {
+      capacity *= 2;
+    }
+    zm->entries = (struct ZoneEntry*)realloc(
+        zm->entries, sizeof(struct ZoneEntry) * capacity * zm->numColumns);
+    zm->changed = (unsigned long**)realloc(zm->changed,
+                                           sizeof(unsigned long*) * capacity);
+    if (zm->entries == NULL || zm->changed == NULL) {
+      panic("No memory");
+    }
+    for (long b = zm->capacity; b < capacity; b++) {
+      zm->changed[b] = NULL;
+    }
+    zm->capacity = capacity;
+  }
+
+  for (long b = zm->numBlocks; b < numBlocks; b++) {
+    for (int j = 0; j < zm->numColumns; j++) {
+      zm->entries[b * zm->numColumns + j].min = INFINITY;
+      zm->entries[b * zm->numColumns + j].max = -INFINITY;
+    }
+  }
+  if (numBlocks > zm->numBlocks) {
+    if (zm->numBlocks < zm->firstChanged) {
+      zm->firstChanged = zm->numBlocks;
+    }
+    zm->numBlocks = numBlocks;
+  }
+}
+
+void zonemap_add(struct ZoneMap* zm, struct TableMeta* table, long recno,
+                 char* fields[]) {
+  long block = recno / zm->blockRecords;
+
+  grow(zm, block + 1);
+  if (block < zm->firstChanged) {
+    zm->firstChanged = block;
+  }
+
+  //
+  // the block's filters are copied into memory the first time one of
+  // its values is added, from the sidecar if they are in it:
+  //
+  if (zm->changed[block] == NULL) {
+    unsigned long* filters = blockFilters(zm, block);
+    zm->changed[block] = (unsigned long*)malloc(blockBytes(zm));
+    if (zm->changed[block] == NULL) {
+      panic("No memory");
+    }
+    if (filters != NULL) {
+      memcpy(zm->changed[block], filters, blockBytes(zm));
+    } else {
+      memset(zm->changed[block], 0, blockBytes(zm));
+    }
+  }
+
+  struct ZoneEntry* zone = &zm->entries[block * zm->numColumns];
+  for (int j = 0; j < zm->numColumns; j++) {
+    unsigned long* bloom = zm->changed[block] + j * (zm->bloomBits / 64);
+    bloom_setBits(bloom, zm->bloomBits, zonemap_hash(table, j, fields[j]));
+
+    int colType = table->columns[j].colType;
+    if (colType != COL_TYPE_INT && colType != COL_TYPE_REAL) {
+      continue;
+    }
+
+    double value = (colType == COL_TYPE_INT) ? atoi(fields[j]) : atof(fields[j]);
+    if (value < zone[j].min) {
+      zone[j].min = value;
+    }
+    if (value > zone[j].max) {
+      zone[j].max = value;
+    }
+  }
+
+  if (recno + 1 > zm->numRecords) {
+    zm->numRecords = recno + 1;
+  }
+}
+
+//
+// isStale
+//
+// Returns true if the sidecar file is missing or older than the
+// data file.
+//
+static bool isStale(char* path, char* datapath) {
+  struct stat info, dataInfo;
+
+  if (stat(path, &info) < 0 || stat(datapath, &dataInfo) < 0) {
+    return true;
+  }
+  return info.st_mtim.tv_sec < dataInfo.st_mtim.tv_sec ||
+         (info.st_mtim.tv_sec == dataInfo.st_mtim.tv_sec &&
+          info.st_mtim.tv_nsec < dataInfo.st_mtim.tv_nsec);
+}
+
+//
+// mapBlooms
+//
+// Maps the filters of the sidecar file in place of those mapped
+// before, if it is valid and holds every block of the map; the pages
+// of a column's filters are only read when they are first tested.
+// Returns false, keeping the old mapping, if not.
+//
+static bool mapBlooms(struct ZoneMap* zm, char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct BloomFileHeader header;
+  struct stat info;
+  long bytes = ZONEMAP_BLOOM_HEADER_BYTES + zm->numBlocks * blockBytes(zm);
+  bool ok = pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+            memcmp(header.magic, ZONEMAP_BLOOM_MAGIC, sizeof(header.magic)) ==
+                0 &&
+            header.numColumns == zm->numColumns &&
+            header.blockRecords == zm->blockRecords &&
+            header.device == zm->device && header.inode == zm->inode &&
+            header.bloomBits == zm->bloomBits &&
+            header.numBlocks == zm->numBlocks && fstat(fd, &info) == 0 &&
+            (long)info.st_size >= bytes;
+
+  void* mapping = MAP_FAILED;
+  if (ok) {
+    mapping = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  if (zm->mapped != NULL) {
+    munmap(zm->mapped, zm->mappedBytes);
+  }
+  zm->mapped = (unsigned long*)mapping;
+  zm->mappedBytes = bytes;
+  zm->numMapped = zm->numBlocks;
+  return true;
+}
+
+//
+// zonemap_build
+//
+// Scans the data file once, a block at a time.
+//
+static struct ZoneMap* zonemap_build(struct Database* db,
+                                     struct TableMeta* table) {
+  char datapath[TABLEFILE_MAX_PATH];
+  tablefile_path(db, table, ".data", datapath);
+
+  int fd = open(datapath, O_RDONLY);
+  struct stat data;
+  if (fd < 0 || fstat(fd, &data) < 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return NULL;
+  }
+
+  struct ZoneMap* zm = zonemap_create(table->numColumns);
+  zm->device = (unsigned long)data.st_dev;
+  zm->inode = (unsigned long)data.st_ino;
+  long numRecords = tablefile_numRecords(fd, table);
+  char* buffer = (char*)malloc(table->recordSize + 1);
+  char** fields = (char**)malloc(sizeof(char*) * table->numColumns);
+  if (buffer == NULL || fields == NULL) {
+    panic("No memory");
+  }
+
+  for (long recno = 0; recno < numRecords; recno++) {
+    if (!tablefile_readRecord(fd, table, recno, buffer)) {
+      break;
+    }
+    if (!tablefile_isDeleted(buffer) &&
+        tablefile_splitFields(buffer, fields, table->numColumns) ==
+            table->numColumns) {
+      zonemap_add(zm, table, recno, fields);
+    }
+  }
+  zm->numRecords = numRecords;
+  grow(zm, (numRecords + zm->blockRecords - 1) / zm->blockRecords);
+
+  free(fields);
+  free(buffer);
+  close(fd);
+
+  zonemap_save(db, table, zm);
+  return zm;
+}
+
+//
+// writeBlocks
+//
+// Writes the entries, or the filters, of blocks [from, zm->numBlocks)
+// at the given offset of the file, e.g. after its header. Filters of
+// blocks that are unchanged since they were mapped are left alone
+// unless all is set.
+//
+static bool writeBlocks(struct ZoneMap* zm, int fd, off_t offset, long from,
+                        bool filters, bool all) {
+  if (!filters) {
+    long bytes = sizeof(struct ZoneEntry) * zm->numColumns;
+    return from >= zm->numBlocks ||
+           pwrite(fd, &zm->entries[from * zm->numColumns],
+                  bytes * (zm->numBlocks - from), offset + from * bytes) ==
+               bytes * (zm->numBlocks - from);
+  }
+
+  char* zeros = NULL;
+  bool ok = true;
+  for (long b = from; ok && b < zm->numBlocks; b++) {
+    unsigned long* block = blockFilters(zm, b);
+    if (!all && zm->changed[b] == NULL && b < zm->numMapped) {
+      continue;
+    }
+    if (block == NULL) {
+      if (zeros == NULL && (zeros = (char*)calloc(1, blockBytes(zm))) == NULL) {
+        panic("No memory");
+      }
+      block = (unsigned long*)zeros;
+    }
+    ok = pwrite(fd, block, blockBytes(zm), offset + b * blockBytes(zm)) ==
+         blockBytes(zm);
+  }
+  free(zeros);
+  return ok;
+}
+
+//
+// saveFile
+//
+// Saves the entries, or the filters, to the sidecar file at path: in
+// place, if it is a valid file of the same layout, else by writing a
+// new one via a temporary file.
+//
+static bool saveFile(struct ZoneMap* zm, char* path, bool filters) {
+  struct ZoneMapHeader header;
+  struct BloomFileHeader bloomHeader;
+  char* head = filters ? (char*)&bloomHeader : (char*)&header;
+  long headBytes = filters ? (long)sizeof(bloomHeader) : (long)sizeof(header);
+  off_t offset = filters ? ZONEMAP_BLOOM_HEADER_BYTES : (off_t)sizeof(header);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ZONEMAP_MAGIC, sizeof(header.magic));
+  header.numColumns = zm->numColumns;
+  header.blockRecords = zm->blockRecords;
+  header.device = zm->device;
+  header.inode = zm->inode;
+  header.numRecords = zm->numRecords;
+
+  memset(&bloomHeader, 0, sizeof(bloomHeader));
+  memcpy(bloomHeader.magic, ZONEMAP_BLOOM_MAGIC, sizeof(bloomHeader.magic));
+  bloomHeader.numColumns = zm->numColumns;
+  bloomHeader.blockRecords = zm->blockRecords;
+  bloomHeader.device = zm->device;
+  bloomHeader.inode = zm->inode;
+  bloomHeader.numBlocks = zm->numBlocks;
+  bloomHeader.bloomBits = zm->bloomBits;
+
+  //
+  // in place: the blocks from the first one changed, or the first one
+  // the file does not have, are written between clearing the magic
+  // and writing the new header, if it has the same header prefix,
+  // i.e. describes the same data file.
+  //
+  int fd = open(path, O_RDWR);
+  if (fd >= 0) {
+    char old[sizeof(struct BloomFileHeader)];
+    bool valid = pread(fd, old, headBytes, 0) == headBytes &&
+                 memcmp(old, head, ZONEMAP_HEADER_PREFIX) == 0;
+    long onDisk = 0;
+    if (valid && filters) {
+      struct BloomFileHeader* h = (struct BloomFileHeader*)old;
+      valid = (h->bloomBits == zm->bloomBits);
+      onDisk = h->numBlocks;
+    } else if (valid) {
+      struct ZoneMapHeader* h = (struct ZoneMapHeader*)old;
+      onDisk = (h->numRecords + zm->blockRecords - 1) / zm->blockRecords;
+    }
+
+    if (valid) {
+      long from = filters ? 0 : zm->firstChanged;
+      if (onDisk < from) {
+        from = onDisk;
+      }
+      char cleared[8];
+      memset(cleared, 0, sizeof(cleared));
+      bool ok = pwrite(fd, cleared, sizeof(cleared), 0) == sizeof(cleared) &&
+                writeBlocks(zm, fd, offset, from, filters, false) &&
+                pwrite(fd, head, headBytes, 0) == headBytes;
+      ok = (close(fd) == 0) && ok;
+      return ok;
+    }
+    close(fd);
+  }
+
+  char tmppath[TABLEFILE_MAX_PATH + 4];
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+
+  fd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  // the header is padded to offset, where the blocks start
+  bool ok = pwrite(fd, head, headBytes, 0) == headBytes &&
+            ftruncate(fd, offset) == 0 &&
+            writeBlocks(zm, fd, offset, 0, filters, true);
+  ok = (close(fd) == 0) && ok;
+  if (!ok || rename(tmppath, path) < 0) {
+    unlink(tmppath);
+    return false;
+  }
+  return true;
+}
+
+bool zonemap_save(struct Database* db, struct TableMeta* table,
+                  struct ZoneMap* zm) {
+  char path[TABLEFILE_MAX_PATH];
+  char bloompath[TABLEFILE_MAX_PATH];
+
+  tablefile_path(db, table, ".zmap", path);
+  tablefile_path(db, table, ".bloom", bloompath);
+
+  bool ok = saveFile(zm, bloompath, true) && saveFile(zm, path, false);
+  if (!ok) {
+    return false;
+  }
+  zm->firstChanged = zm->numBlocks;
+
+  //
+  // the filters changed in memory are in the file now, so they are
+  // read from it again, as they are needed:
+  //
+  if (mapBlooms(zm, bloompath)) {
+    for (long b = 0; b < zm->numBlocks; b++) {
+      free(zm->changed[b]);
+      zm->changed[b] = NULL;
+    }
+  }
+  return true;
+}
+
+//
+// zonemap_load
+//
+// Reads the sidecar files; returns NULL if one is missing, stale,
+// made from another data file than the table's (e.g. before it was
+// compacted) or does not match the table. The filters are mapped,
+// not read.
+//
+static struct ZoneMap* zonemap_load(struct Database* db,
+                                    struct TableMeta* table) {
+  char path[TABLEFILE_MAX_PATH];
+  char bloompath[TABLEFILE_MAX_PATH];
+  char datapath[TABLEFILE_MAX_PATH];
+
+  tablefile_path(db, table, ".zmap", path);
+  tablefile_path(db, table, ".bloom", bloompath);
+  tablefile_path(db, table, ".data", datapath);
+
+  struct stat data;
+  if (isStale(path, datapath) || isStale(bloompath, datapath) ||
+      stat(datapath, &data) < 0) {
+    return NULL;
+  }
+
+  FILE* input = fopen(path, "r");
+  if (input == NULL) {
+    return NULL;
+  }
+
+  struct ZoneMapHeader header;
+  if (fread(&header, sizeof(header), 1, input) != 1 ||
+      memcmp(header.magic, ZONEMAP_MAGIC, sizeof(header.magic)) != 0 ||
+      header.numColumns != table->numColumns || header.blockRecords <= 0 ||
+      header.device != (unsigned long)data.st_dev ||
+      header.inode != (unsigned long)data.st_ino || header.numRecords < 0) {
+    fclose(input);
+    return NULL;
+  }
+
+  struct ZoneMap* zm = zonemap_create(header.numColumns);
+  zm->blockRecords = header.blockRecords;
+  zm->device = header.device;
+  zm->inode = header.inode;
+  grow(zm, (header.numRecords + zm->blockRecords - 1) / zm->blockRecords);
+  zm->numRecords = header.numRecords;
+  zm->firstChanged = zm->numBlocks;
+
+  size_t N = zm->numBlocks * zm->numColumns;
+  bool ok = (N == 0 || fread(zm->entries, sizeof(struct ZoneEntry), N,
+                             input) == N);
+  fclose(input);
+
+  if (!ok || !mapBlooms(zm, bloompath)) {
+    zonemap_close(zm);
+    return NULL;
+  }
+  return zm;
+}
+
+struct ZoneMap* zonemap_open(struct Database* db, struct TableMeta* table) {
+  struct ZoneMap* zm = zonemap_load(db, table);
+
+  if (zm == NULL) {
+    zm = zonemap_build(db, table);
+  }
+  return zm;
+}
+
+void zonemap_close(struct ZoneMap* zm) {
+  if (zm == NULL) {
+    return;
+  }
+  for (long b = 0; b < zm->numBlocks; b++) {
+    free(zm->changed[b]);
+  }
+  if (zm->mapped != NULL) {
+    munmap(zm->mapped, zm->mappedBytes);
+  }
+  free(zm->changed);
+  free(zm->entries);
+  free(zm);
+}
+
+bool zonemap_blockMayMatch(struct ZoneMap* zm, long block, int column,
+                           int oper, double value) {
+  if (block >= zm->numBlocks) {
+    return true;  // not covered yet, e.g. appended since the map was built
+  }
+
+  struct ZoneEntry* zone = &zm->entries[block * zm->numColumns + column];
+  if (zone->min > zone->max) {
+    return true;  // no numeric values recorded for this column
+  }
+
+  switch (oper) {
+    case EXPR_LT:
+      return zone->min < value;
+    case EXPR_LTE:
+      return zone->min <= value;
+    case EXPR_GT:
+      return zone->max > value;
+    case EXPR_GTE:
+      return zone->max >= value;
+    case EXPR_EQUAL:
+      return zone->min <= value && value <= zone->max;
+    default:
+      return true;
+  }
+}
+
+unsigned long zonemap_hash(struct TableMeta* table, int column, char* value) {
+  int colType = table->columns[column].colType;
+
+  if (colType == COL_TYPE_INT) {
+    int i = atoi(value);
+    return rowkey_hash((char*)&i, sizeof(int));
+  } else if (colType == COL_TYPE_REAL) {
+    double r = atof(value);
+    if (r == 0.0) {
+      r = 0.0;  // -0.0 and 0.0 are the same value
+    }
+    return rowkey_hash((char*)&r, sizeof(double));
+  } else {
+    return rowkey_hash(value, (int)strlen(value));
+  }
+}
+
+bool zonemap_blockMayContain(struct ZoneMap* zm, long block, int column,
+                             unsigned long hash) {
+  if (block >= zm->numBlocks) {
+    return true;  // not covered yet
+  }
+
+  // a block none of whose values was added holds none
+  unsigned long* filters = blockFilters(zm, block);
+  return filters != NULL &&
+         bloom_testBits(filters + column * (zm->bloomBits / 64), zm->bloomBits,
+                        hash);
+}
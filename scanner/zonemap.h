@@ -0,0 +1,127 @@
+/*zonemap.h*/
+
+//
+// Zone maps: the min and max of every numeric column over each
+// block of ZONEMAP_BLOCK_RECORDS consecutive records, stored in
+// the sidecar file "<table>.zmap". A scan with a range or equality
+// predicate skips the blocks whose [min, max] cannot match.
+//
+// Each block also has a Bloom filter (bloom.h) of the values of
+// every column, so an equality predicate, on any column, skips the
+// blocks that certainly do not hold the value even when it is
+// within [min, max], e.g. an id in a table not sorted by id. The
+// filters, a page per block and column, are kept apart in
+// "<table>.bloom" and mapped into memory, so opening the map reads
+// none of them and a scan reads only the probed column's.
+//
+// Saving writes only the blocks that changed, or were appended,
+// since the map was opened, in place.
+//
+// Sandy Bockarie
+// Northwestern University
+// CS 211, Winter 2023
+//
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "bloom.h"
+#include "database.h"
+
+#define ZONEMAP_BLOCK_RECORDS 4096
+#define ZONEMAP_BLOOM_BITS    (BLOOM_BITS_PER_KEY * ZONEMAP_BLOCK_RECORDS)
+#define ZONEMAP_BLOOM_HEADER_BYTES 4096  // so the filters are page-aligned
+
+struct ZoneEntry
+{
+  double min;
+  double max;
+};
+
+struct ZoneMap
+{
+  int    numColumns;
+  int    blockRecords;
+  long   numRecords;  // records covered
+  long   numBlocks;
+  long   capacity;    // blocks allocated
+  struct ZoneEntry* entries;  // entries[block * numColumns + column]
+  long   firstChanged;        // entries from this block on are not saved
+  long   bloomBits;   // per block and column, a power of 2
+  unsigned long*  mapped;     // "<table>.bloom", or NULL
+  long   mappedBytes;
+  long   numMapped;   // blocks whose filters are in the mapping
+  unsigned long** changed;    // changed[block]: its filters, once changed
+                              // in memory and until saved; else NULL
+  unsigned long   device;     // of the data file the map describes;
+  unsigned long   inode;      // compaction replaces the file
+};
+
+
+//
+// functions:
+//
+
+//
+// zonemap_open
+//
+// Loads the table's zone map, building it first if the sidecar
+// file is missing, older than the data file or built from another
+// one. Returns NULL if the data file cannot be read.
+//
+// NOTE: it is the callers responsibility to free the resources
+// by calling zonemap_close().
+//
+struct ZoneMap* zonemap_open(struct Database* db, struct TableMeta* table);
+
+//
+// zonemap_close
+//
+void zonemap_close(struct ZoneMap* zm);
+
+//
+// zonemap_add
+//
+// Folds record recno, already split into its fields, into the
+// zone of its block; used to maintain the map incrementally as
+// records are appended.
+//
+void zonemap_add(struct ZoneMap* zm, struct TableMeta* table, long recno,
+                 char* fields[]);
+
+//
+// zonemap_save
+//
+// Writes the zone map to the table's sidecar files.
+//
+bool zonemap_save(struct Database* db, struct TableMeta* table,
+                  struct ZoneMap* zm);
+
+//
+// zonemap_blockMayMatch
+//
+// Returns false only if no record in the block can satisfy
+// "column <oper> value"; column is 0-based, and oper is one of
+// EXPR_LT .. EXPR_EQUAL (ast.h). Anything else returns true.
+//
+bool zonemap_blockMayMatch(struct ZoneMap* zm, long block, int column,
+                           int oper, double value);
+
+//
+// zonemap_hash
+//
+// Hashes a value (in text form, strings without quotes) of the
+// given column of the table, for zonemap_blockMayContain(); equal
+// values hash the same, e.g. "7" and "07" in an int column.
+//
+unsigned long zonemap_hash(struct TableMeta* table, int column, char* value);
+
+//
+// zonemap_blockMayContain
+//
+// Returns false only if no record in the block has the value with
+// the given hash, see zonemap_hash(), in the column (0-based).
+//
+bool zonemap_blockMayContain(struct ZoneMap* zm, long block, int column,
+                             unsigned long hash);